@@ -43,7 +43,7 @@ typedef struct _OS_ACM_Store {
 } OS_ACM_Store;
 
 /* Internal Functions */
-static int acm_str_replace(char **dst, const char *src);
+static int acm_str_replace(Eventinfo *lf, char **dst, const char *src);
 static OS_ACM_Store *InitACMStore(void);
 static void FreeACMStore(OS_ACM_Store *obj);
 
@@ -132,31 +132,31 @@ Eventinfo *Accumulate(Eventinfo *lf)
         } else {
             /* Update the event */
             do_update = 1;
-            if (acm_str_replace(&lf->dstuser, stored_data->dstuser) == 0) {
+            if (acm_str_replace(lf, &lf->dstuser, stored_data->dstuser) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->dstuser to %s", _key, lf->dstuser);
             }
 
-            if (acm_str_replace(&lf->srcuser, stored_data->srcuser) == 0) {
+            if (acm_str_replace(lf, &lf->srcuser, stored_data->srcuser) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->srcuser to %s", _key, lf->srcuser);
             }
 
-            if (acm_str_replace(&lf->dstip, stored_data->dstip) == 0) {
+            if (acm_str_replace(lf, &lf->dstip, stored_data->dstip) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->dstip to %s", _key, lf->dstip);
             }
 
-            if (acm_str_replace(&lf->srcip, stored_data->srcip) == 0) {
+            if (acm_str_replace(lf, &lf->srcip, stored_data->srcip) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->srcip to %s", _key, lf->srcip);
             }
 
-            if (acm_str_replace(&lf->dstport, stored_data->dstport) == 0) {
+            if (acm_str_replace(lf, &lf->dstport, stored_data->dstport) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->dstport to %s", _key, lf->dstport);
             }
 
-            if (acm_str_replace(&lf->srcport, stored_data->srcport) == 0) {
+            if (acm_str_replace(lf, &lf->srcport, stored_data->srcport) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->srcport to %s", _key, lf->srcport);
             }
 
-            if (acm_str_replace(&lf->data, stored_data->data) == 0) {
+            if (acm_str_replace(lf, &lf->data, stored_data->data) == 0) {
                 debug2("accumulator: DEBUG: (%s) updated lf->data to %s", _key, lf->data);
             }
         }
@@ -166,31 +166,31 @@ Eventinfo *Accumulate(Eventinfo *lf)
 
     /* Store the object in the cache */
     stored_data->timestamp = current_ts;
-    if (acm_str_replace(&stored_data->dstuser, lf->dstuser) == 0) {
+    if (acm_str_replace(NULL, &stored_data->dstuser, lf->dstuser) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->dstuser to %s", _key, stored_data->dstuser);
     }
 
-    if (acm_str_replace(&stored_data->srcuser, lf->srcuser) == 0) {
+    if (acm_str_replace(NULL, &stored_data->srcuser, lf->srcuser) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->srcuser to %s", _key, stored_data->srcuser);
     }
 
-    if (acm_str_replace(&stored_data->dstip, lf->dstip) == 0) {
+    if (acm_str_replace(NULL, &stored_data->dstip, lf->dstip) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->dstip to %s", _key, stored_data->dstip);
     }
 
-    if (acm_str_replace(&stored_data->srcip, lf->srcip) == 0) {
+    if (acm_str_replace(NULL, &stored_data->srcip, lf->srcip) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->srcip to %s", _key, stored_data->srcip);
     }
 
-    if (acm_str_replace(&stored_data->dstport, lf->dstport) == 0) {
+    if (acm_str_replace(NULL, &stored_data->dstport, lf->dstport) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->dstport to %s", _key, stored_data->dstport);
     }
 
-    if (acm_str_replace(&stored_data->srcport, lf->srcport) == 0) {
+    if (acm_str_replace(NULL, &stored_data->srcport, lf->srcport) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->srcport to %s", _key, stored_data->srcport);
     }
 
-    if (acm_str_replace(&stored_data->data, lf->data) == 0) {
+    if (acm_str_replace(NULL, &stored_data->data, lf->data) == 0) {
         debug2("accumulator: DEBUG: (%s) updated stored_data->data to %s", _key, stored_data->data);
     }
 
@@ -304,7 +304,7 @@ void FreeACMStore(OS_ACM_Store *obj)
     }
 }
 
-int acm_str_replace(char **dst, const char *src)
+int acm_str_replace(Eventinfo *lf, char **dst, const char *src)
 {
     int result = 0;
 
@@ -324,9 +324,13 @@ int acm_str_replace(char **dst, const char *src)
         return -1;
     }
 
-    /* Free dst, and malloc the memory we need! */
+    /* Free dst (a string of lf, if set), and malloc the memory we need! */
     if ( *dst != NULL ) {
-        free(*dst);
+        if (lf) {
+            Free_EventinfoStr(lf, *dst);
+        } else {
+            free(*dst);
+        }
     }
     os_malloc(slen + 1, *dst);
 
@@ -15,6 +15,7 @@
 #include "log.h"
 #include "exec.h"
 #include "getloglocation.h"
+#include "logwriter.h"
 
 #endif
 
@@ -10,6 +10,7 @@
 /* Get the log directory/file based on the day/month/year */
 
 #include "getloglocation.h"
+#include "logwriter.h"
 #include "config.h"
 
 /* Global definitions */
@@ -21,6 +22,8 @@ FILE *_ejflog;
 
 /* Global variables */
 static int  __crt_day;
+static int  __crt_year;
+static char __crt_mon[4];
 static char __elogfile[OS_FLSIZE + 1];
 static char __alogfile[OS_FLSIZE + 1];
 static char __flogfile[OS_FLSIZE + 1];
@@ -48,6 +51,17 @@ void OS_InitLog()
 
     /* Set the umask */
     umask(0027);
+
+    /* Start the writer of the logs */
+    OS_InitLogWriter();
+}
+
+void OS_GetAlertsLogDate(alert_bus_pos *pos)
+{
+    pos->year = __crt_year;
+    pos->day = __crt_day;
+    strncpy(pos->mon, __crt_mon, 3);
+    pos->mon[3] = '\0';
 }
 
 int OS_GetLogLocation(const Eventinfo *lf)
@@ -56,8 +70,10 @@ int OS_GetLogLocation(const Eventinfo *lf)
      * Check if the year directory is there
      * If not, create it. Same for the month directory.
      */
-    
-     
+
+    /* Write everything queued to the files being closed */
+    OS_LogWriterPause();
+
     /* For the events */
     if (_eflog) {
         if (ftell(_eflog) == 0) {
@@ -302,6 +318,10 @@ int OS_GetLogLocation(const Eventinfo *lf)
 
     /* Setting the new day */
     __crt_day = lf->day;
+    __crt_year = lf->year;
+    strncpy(__crt_mon, lf->mon, 3);
+
+    OS_LogWriterResume();
 
     return (0);
 }
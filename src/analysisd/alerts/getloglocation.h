@@ -21,6 +21,9 @@ void OS_InitFwLog(void);
  */
 int OS_GetLogLocation(const Eventinfo *lf);
 
+/* Date of the alerts log being written */
+void OS_GetAlertsLogDate(alert_bus_pos *pos);
+
 /* Global declarations */
 extern FILE *_eflog;
 extern FILE *_ejflog;
@@ -11,6 +11,7 @@
 #include "log.h"
 #include "alerts.h"
 #include "getloglocation.h"
+#include "logwriter.h"
 #include "rules.h"
 #include "eventinfo.h"
 #include "config.h"
@@ -65,18 +66,18 @@ void OS_Store(const Eventinfo *lf)
         return;
     }
 
-    fprintf(_eflog,
-            "%d %s %02d %s %s%s%s %s\n",
-            lf->year,
-            lf->mon,
-            lf->day,
-            lf->hour,
-            lf->hostname != lf->location ? lf->hostname : "",
-            lf->hostname != lf->location ? "->" : "",
-            lf->location,
-            lf->full_log);
-
-    fflush(_eflog);
+    OS_LogWriterPrintf(LOGW_ARCHIVES,
+                       "%d %s %02d %s %s%s%s %s\n",
+                       lf->year,
+                       lf->mon,
+                       lf->day,
+                       lf->hour,
+                       lf->hostname != lf->location ? lf->hostname : "",
+                       lf->hostname != lf->location ? "->" : "",
+                       lf->location,
+                       lf->full_log);
+
+    OS_LogWriterCommit(LOGW_ARCHIVES);
     return;
 }
 
@@ -165,6 +166,160 @@ void OS_LogOutput(Eventinfo *lf)
     return;
 }
 
+/* Lines of the log kept by the readers of the alerts, each printed
+ * with "%.1256s\n"
+ */
+#define ALERT_LOG_LINES     20
+#define ALERT_LINE_SZ       1256
+
+/* First line of the full log of a changed file */
+#define SK_CHANGED_BEGIN    "Integrity checksum changed for: '"
+#define SK_CHANGED_BEGIN_SZ 33
+
+/* Room for the lines of the alert published to the bus: the full log,
+ * a line per last event and the file name
+ */
+static char alert_lines[(ALERT_LOG_LINES + 2) * (ALERT_LINE_SZ + 1)];
+
+/* Copy len bytes of text to buf, as a string */
+static char *OS_AlertDataCopy(char **buf, const char *text, size_t len)
+{
+    char *str = *buf;
+
+    memcpy(str, text, len);
+    str[len] = '\0';
+    *buf += len + 1;
+
+    return (str);
+}
+
+/* Add the lines of a text printed to the alert to its log, as the
+ * readers of the alerts log get them. The lines 1 to nfields go to
+ * the fields instead, past a prefix of the given length.
+ * Returns 0 at the blank line ending the alert.
+ */
+static int OS_AlertDataLines(alert_data *al_data, size_t *log_size, char **buf,
+                             const char *text, char **fields[], const size_t prefix[],
+                             size_t nfields)
+{
+    const char *end = text + strnlen(text, ALERT_LINE_SZ);
+    const char *nl;
+    size_t line;
+    size_t len;
+
+    for (line = 0; ; line++, text = nl + 1) {
+        nl = memchr(text, '\n', (size_t)(end - text));
+        len = nl ? (size_t)(nl - text) : (size_t)(end - text);
+
+        if (len == 0 && *log_size > 0) {
+            return (0);
+        }
+
+        if (line > 0 && line <= nfields && len >= prefix[line - 1]) {
+            *fields[line - 1] = OS_AlertDataCopy(buf, text + prefix[line - 1],
+                                                 len - prefix[line - 1]);
+        } else if (*log_size < ALERT_LOG_LINES) {
+            al_data->log[(*log_size)++] = OS_AlertDataCopy(buf, text, len);
+        }
+
+        if (!nl) {
+            return (1);
+        }
+    }
+}
+
+/* Fill the alert data of an alert written to the alerts log, as its
+ * readers would get it, for the alert bus. The strings point to lf,
+ * to the buffers given and to alert_lines.
+ */
+static void OS_AlertData(const Eventinfo *lf, alert_data *al_data, char **log,
+                         char *alertid, char *date, char *location, char *group)
+{
+    const RuleInfo *rule = lf->generated_rule;
+    char **fields[8];
+    size_t prefix[8];
+    size_t nfields = 0;
+    size_t log_size = 0;
+    char *buf = alert_lines;
+
+    memset(al_data, 0, sizeof(alert_data));
+
+    snprintf(alertid, OS_SIZE_128, "%ld.%ld", (long int)lf->time, __crt_ftell);
+    snprintf(date, OS_SIZE_128, "%d %s %02d %s", lf->year, lf->mon, lf->day, lf->hour);
+    snprintf(location, OS_BUFFER_SIZE, "%s%s%s",
+             lf->hostname != lf->location ? lf->hostname : "",
+             lf->hostname != lf->location ? "->" : "",
+             lf->location);
+    snprintf(group, OS_BUFFER_SIZE, " %s", rule->group);
+
+    al_data->alertid = alertid;
+    al_data->date = date;
+    al_data->location = location;
+    al_data->group = group;
+    al_data->rule = (unsigned int)rule->sigid;
+    al_data->level = (unsigned int)rule->level;
+    al_data->comment = rule->comment;
+    al_data->srcip = lf->srcip;
+    al_data->srcport = lf->srcport ? atoi(lf->srcport) : 0;
+    al_data->dstip = lf->dstip;
+    al_data->dstport = lf->dstport ? atoi(lf->dstport) : 0;
+    al_data->user = lf->dstuser;
+#ifdef LIBGEOIP_ENABLED
+    al_data->srcgeoip = lf->srcgeoip;
+    al_data->dstgeoip = lf->dstgeoip;
+#endif
+
+    /* The changes of a file, in the order of the syscheck full log */
+    if (lf->size_before) {
+        fields[nfields] = &al_data->file_size;
+        prefix[nfields++] = sizeof("Size changed from ") - 1;
+    }
+    if (lf->perm_before) {
+        fields[nfields] = &al_data->perm_chg;
+        prefix[nfields++] = sizeof("Permissions changed from ") - 1;
+    }
+    if (lf->owner_before) {
+        fields[nfields] = &al_data->owner_chg;
+        prefix[nfields++] = sizeof("Ownership was ") - 1;
+    }
+    if (lf->gowner_before) {
+        fields[nfields] = &al_data->group_chg;
+        prefix[nfields++] = sizeof("Group ownership was ") - 1;
+    }
+    if (lf->md5_before) {
+        fields[nfields] = &al_data->old_md5;
+        prefix[nfields++] = sizeof("Old md5sum was: ") - 1;
+        fields[nfields] = &al_data->new_md5;
+        prefix[nfields++] = sizeof("New md5sum is : ") - 1;
+    }
+    if (lf->sha1_before) {
+        fields[nfields] = &al_data->old_sha1;
+        prefix[nfields++] = sizeof("Old sha1sum was: ") - 1;
+        fields[nfields] = &al_data->new_sha1;
+        prefix[nfields++] = sizeof("New sha1sum is : ") - 1;
+    }
+
+    al_data->log = log;
+    if (OS_AlertDataLines(al_data, &log_size, &buf, lf->full_log,
+                          fields, prefix, nfields) && rule->last_events) {
+        char **lasts = rule->last_events;
+
+        while (*lasts && OS_AlertDataLines(al_data, &log_size, &buf, *lasts,
+                                           NULL, NULL, 0)) {
+            lasts++;
+        }
+    }
+    log[log_size] = NULL;
+
+    /* File of a syscheck alert, from the first line of its log */
+    if (log_size && strstr(group, "syscheck") &&
+            strncmp(log[0], SK_CHANGED_BEGIN, SK_CHANGED_BEGIN_SZ) == 0 &&
+            log[0][SK_CHANGED_BEGIN_SZ] != '\0') {
+        al_data->filename = OS_AlertDataCopy(&buf, log[0] + SK_CHANGED_BEGIN_SZ,
+                                             strlen(log[0]) - SK_CHANGED_BEGIN_SZ - 1);
+    }
+}
+
 void OS_Log(Eventinfo *lf)
 {
 #ifdef LIBGEOIP_ENABLED
@@ -179,73 +334,100 @@ void OS_Log(Eventinfo *lf)
 #endif
 
     /* Writing to the alert log file */
-    fprintf(_aflog,
-            "** Alert %ld.%ld:%s - %s\n"
-            "%d %s %02d %s %s%s%s\nRule: %d (level %d) -> '%s'"
-            "%s%s%s%s%s%s%s%s%s%s%s%s%s%s\n%.1256s\n",
-            (long int)lf->time,
-            __crt_ftell,
-            lf->generated_rule->alert_opts & DO_MAILALERT ? " mail " : "",
-            lf->generated_rule->group,
-            lf->year,
-            lf->mon,
-            lf->day,
-            lf->hour,
-            lf->hostname != lf->location ? lf->hostname : "",
-            lf->hostname != lf->location ? "->" : "",
-            lf->location,
-            lf->generated_rule->sigid,
-            lf->generated_rule->level,
-            lf->generated_rule->comment,
-
-            lf->srcip == NULL ? "" : "\nSrc IP: ",
-            lf->srcip == NULL ? "" : lf->srcip,
+    OS_LogWriterPrintf(LOGW_ALERTS,
+                       "** Alert %ld.%ld:%s - %s\n"
+                       "%d %s %02d %s %s%s%s\nRule: %d (level %d) -> '%s'"
+                       "%s%s%s%s%s%s%s%s%s%s%s%s%s%s\n%.1256s\n",
+                       (long int)lf->time,
+                       __crt_ftell,
+                       lf->generated_rule->alert_opts & DO_MAILALERT ? " mail " : "",
+                       lf->generated_rule->group,
+                       lf->year,
+                       lf->mon,
+                       lf->day,
+                       lf->hour,
+                       lf->hostname != lf->location ? lf->hostname : "",
+                       lf->hostname != lf->location ? "->" : "",
+                       lf->location,
+                       lf->generated_rule->sigid,
+                       lf->generated_rule->level,
+                       lf->generated_rule->comment,
+
+                       lf->srcip == NULL ? "" : "\nSrc IP: ",
+                       lf->srcip == NULL ? "" : lf->srcip,
 
 #ifdef LIBGEOIP_ENABLED
-            lf->srcgeoip == NULL ? "" : "\nSrc Location: ",
-            lf->srcgeoip == NULL ? "" : lf->srcgeoip,
+                       lf->srcgeoip == NULL ? "" : "\nSrc Location: ",
+                       lf->srcgeoip == NULL ? "" : lf->srcgeoip,
 #else
-            "",
-            "",
+                       "",
+                       "",
 #endif
 
 
-            lf->srcport == NULL ? "" : "\nSrc Port: ",
-            lf->srcport == NULL ? "" : lf->srcport,
+                       lf->srcport == NULL ? "" : "\nSrc Port: ",
+                       lf->srcport == NULL ? "" : lf->srcport,
 
-            lf->dstip == NULL ? "" : "\nDst IP: ",
-            lf->dstip == NULL ? "" : lf->dstip,
+                       lf->dstip == NULL ? "" : "\nDst IP: ",
+                       lf->dstip == NULL ? "" : lf->dstip,
 
 #ifdef LIBGEOIP_ENABLED
-            lf->dstgeoip == NULL ? "" : "\nDst Location: ",
-            lf->dstgeoip == NULL ? "" : lf->dstgeoip,
+                       lf->dstgeoip == NULL ? "" : "\nDst Location: ",
+                       lf->dstgeoip == NULL ? "" : lf->dstgeoip,
 #else
-            "",
-            "",
+                       "",
+                       "",
 #endif
 
 
 
-            lf->dstport == NULL ? "" : "\nDst Port: ",
-            lf->dstport == NULL ? "" : lf->dstport,
+                       lf->dstport == NULL ? "" : "\nDst Port: ",
+                       lf->dstport == NULL ? "" : lf->dstport,
 
-            lf->dstuser == NULL ? "" : "\nUser: ",
-            lf->dstuser == NULL ? "" : lf->dstuser,
+                       lf->dstuser == NULL ? "" : "\nUser: ",
+                       lf->dstuser == NULL ? "" : lf->dstuser,
 
-            lf->full_log);
+                       lf->full_log);
 
     /* Print the last events if present */
     if (lf->generated_rule->last_events) {
         char **lasts = lf->generated_rule->last_events;
         while (*lasts) {
-            fprintf(_aflog, "%.1256s\n", *lasts);
+            OS_LogWriterPrintf(LOGW_ALERTS, "%.1256s\n", *lasts);
             lasts++;
         }
+    }
+
+    OS_LogWriterPuts(LOGW_ALERTS, "\n");
+
+    /* Publish it to the readers of the alert bus */
+    if (Config.alert_bus && _aflog) {
+        char alertid[OS_SIZE_128];
+        char date[OS_SIZE_128];
+        char location[OS_BUFFER_SIZE];
+        char group[OS_BUFFER_SIZE];
+        char *log[ALERT_LOG_LINES + 1];
+        alert_data al_data;
+        alert_bus_pos pos;
+        size_t len;
+
+        OS_LogWriterRecord(LOGW_ALERTS, &len);
+        OS_AlertData(lf, &al_data, log, alertid, date, location, group);
+
+        OS_GetAlertsLogDate(&pos);
+        pos.offset = __crt_ftell;
+        pos.end = __crt_ftell + (long)len;
+
+        AlertBus_Publish(&al_data,
+                         lf->generated_rule->alert_opts & DO_MAILALERT ? ALERTBUS_MAIL : 0,
+                         &pos);
+    }
+
+    if (lf->generated_rule->last_events) {
         lf->generated_rule->last_events[0] = NULL;
     }
 
-    fprintf(_aflog, "\n");
-    fflush(_aflog);
+    OS_LogWriterCommit(LOGW_ALERTS);
 
     return;
 }
@@ -349,9 +531,9 @@ void OS_CustomLog(const Eventinfo *lf, const char *format)
         tmp_log = NULL;
     }
 
-    fprintf(_aflog, "%s", log);
-    fprintf(_aflog, "\n");
-    fflush(_aflog);
+    OS_LogWriterPuts(LOGW_ALERTS, log);
+    OS_LogWriterPuts(LOGW_ALERTS, "\n");
+    OS_LogWriterCommit(LOGW_ALERTS);
 
     if (log) {
         os_free(log);
@@ -397,7 +579,7 @@ int FW_Log(Eventinfo *lf)
         /* block */
         case 'b':
         case 'B':
-            os_free(lf->action);
+            Free_EventinfoStr(lf, lf->action);
             os_strdup("DROP", lf->action);
             break;
         /* Closed */
@@ -406,7 +588,7 @@ int FW_Log(Eventinfo *lf)
         /* Teardown */
         case 't':
         case 'T':
-            os_free(lf->action);
+            Free_EventinfoStr(lf, lf->action);
             os_strdup("CLOSED", lf->action);
             break;
         /* allow, accept, */
@@ -418,42 +600,42 @@ int FW_Log(Eventinfo *lf)
         /* open */
         case 'o':
         case 'O':
-            os_free(lf->action);
+            Free_EventinfoStr(lf, lf->action);
             os_strdup("ALLOW", lf->action);
             break;
         default:
             if (OSMatch_Execute(lf->action, strlen(lf->action), &FWDROPpm)) {
-                os_free(lf->action);
+                Free_EventinfoStr(lf, lf->action);
                 os_strdup("DROP", lf->action);
             }
             if (OSMatch_Execute(lf->action, strlen(lf->action), &FWALLOWpm)) {
-                os_free(lf->action);
+                Free_EventinfoStr(lf, lf->action);
                 os_strdup("ALLOW", lf->action);
             } else {
-                os_free(lf->action);
+                Free_EventinfoStr(lf, lf->action);
                 os_strdup("UNKNOWN", lf->action);
             }
             break;
     }
 
     /* Log to file */
-    fprintf(_fflog,
-            "%d %s %02d %s %s%s%s %s %s %s:%s->%s:%s\n",
-            lf->year,
-            lf->mon,
-            lf->day,
-            lf->hour,
-            lf->hostname != lf->location ? lf->hostname : "",
-            lf->hostname != lf->location ? "->" : "",
-            lf->location,
-            lf->action,
-            lf->protocol,
-            lf->srcip,
-            lf->srcport,
-            lf->dstip,
-            lf->dstport);
-
-    fflush(_fflog);
+    OS_LogWriterPrintf(LOGW_FIREWALL,
+                       "%d %s %02d %s %s%s%s %s %s %s:%s->%s:%s\n",
+                       lf->year,
+                       lf->mon,
+                       lf->day,
+                       lf->hour,
+                       lf->hostname != lf->location ? lf->hostname : "",
+                       lf->hostname != lf->location ? "->" : "",
+                       lf->location,
+                       lf->action,
+                       lf->protocol,
+                       lf->srcip,
+                       lf->srcport,
+                       lf->dstip,
+                       lf->dstport);
+
+    OS_LogWriterCommit(LOGW_FIREWALL);
 
     return (1);
 }
@@ -0,0 +1,491 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Writer of the alerts and archives
+ *
+ * The main thread builds each record (an alert, an archived event, a
+ * JSON line) in memory and queues it in a ring buffer. A writer thread
+ * takes the records from the ring and writes them to the files, which
+ * are flushed every log_flush_interval milliseconds (or also when the
+ * queue is empty, and with fsync, depending on log_durability) instead
+ * of after every record. The ring has a single producer and a single
+ * consumer, so queuing a record takes no lock: the mutex is only used
+ * to wake up the side that is waiting.
+ *
+ * The offset of the alerts file is kept as records are queued, so the
+ * alert ids are the same as if the file was written right away.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+
+#include "shared.h"
+#include "logwriter.h"
+#include "getloglocation.h"
+#include "config.h"
+
+/* Bytes of the ring (a power of two) */
+#define LOGW_RING_SIZE  (4 * 1024 * 1024)
+
+/* Milliseconds the writer sleeps with nothing to do */
+#define LOGW_IDLE_WAIT  1000
+
+/* Milliseconds the main thread waits for room in the ring, before
+ * waking up the writer again
+ */
+#define LOGW_FULL_WAIT  10
+
+/* Seconds to write the records queued when exiting */
+#define LOGW_STOP_WAIT  5
+
+typedef struct _logw_header {
+    uint32_t len;
+    uint32_t file;
+} logw_header;
+
+/* Record being built for each file */
+typedef struct _logw_record {
+    char *data;
+    size_t len;
+    size_t size;
+} logw_record;
+
+static logw_record logw_records[LOGW_FILES];
+static long logw_offset[LOGW_FILES];
+static FILE **logw_fp[LOGW_FILES] = { &_eflog, &_ejflog, &_aflog, &_jflog, &_fflog };
+
+static int logw_active = 0;
+static int logw_paused = 0;
+
+/* Ring: the main thread moves the tail, the writer the head */
+static char *logw_ring = NULL;
+static uint64_t logw_head = 0;
+static uint64_t logw_tail = 0;
+
+static int logw_sleeping = 0;
+static int logw_waiting = 0;
+static uint64_t logw_sync_wanted = 0;
+static uint64_t logw_sync_done = 0;
+
+/* Files written and not flushed yet (writer only) */
+static int logw_dirty[LOGW_FILES];
+
+static pthread_mutex_t logw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t logw_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t logw_room = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t logw_synced = PTHREAD_COND_INITIALIZER;
+
+/* Held by the writer while it uses the files */
+static pthread_mutex_t logw_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long long logw_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+static void logw_deadline(struct timespec *ts, long long ms)
+{
+    ts->tv_sec = (time_t)(ms / 1000);
+    ts->tv_nsec = (long)(ms % 1000) * 1000000;
+}
+
+/* Copy to and from the ring, across its end */
+static void logw_ring_write(uint64_t pos, const void *data, size_t len)
+{
+    size_t start = (size_t)(pos & (LOGW_RING_SIZE - 1));
+    size_t first = LOGW_RING_SIZE - start;
+
+    if (first > len) {
+        first = len;
+    }
+
+    memcpy(logw_ring + start, data, first);
+    memcpy(logw_ring, (const char *)data + first, len - first);
+}
+
+static void logw_ring_read(uint64_t pos, void *data, size_t len)
+{
+    size_t start = (size_t)(pos & (LOGW_RING_SIZE - 1));
+    size_t first = LOGW_RING_SIZE - start;
+
+    if (first > len) {
+        first = len;
+    }
+
+    memcpy(data, logw_ring + start, first);
+    memcpy((char *)data + first, logw_ring, len - first);
+}
+
+/* Wake up the writer if it is sleeping */
+static void logw_wake(void)
+{
+    if (__atomic_load_n(&logw_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&logw_mutex);
+        pthread_cond_signal(&logw_work);
+        pthread_mutex_unlock(&logw_mutex);
+    }
+}
+
+/* Write the records queued to the files */
+static void logw_drain(void)
+{
+    uint64_t head = logw_head;
+    uint64_t tail = __atomic_load_n(&logw_tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return;
+    }
+
+    pthread_mutex_lock(&logw_files_mutex);
+
+    while (head != tail) {
+        logw_header hdr;
+        size_t start;
+        size_t first;
+        FILE *fp;
+
+        logw_ring_read(head, &hdr, sizeof(hdr));
+        head += sizeof(hdr);
+
+        start = (size_t)(head & (LOGW_RING_SIZE - 1));
+        first = LOGW_RING_SIZE - start;
+        if (first > hdr.len) {
+            first = hdr.len;
+        }
+
+        if (hdr.file < LOGW_FILES && (fp = *logw_fp[hdr.file])) {
+            fwrite(logw_ring + start, 1, first, fp);
+            if (hdr.len > first) {
+                fwrite(logw_ring, 1, hdr.len - first, fp);
+            }
+            logw_dirty[hdr.file] = 1;
+        }
+
+        head += hdr.len;
+    }
+
+    pthread_mutex_unlock(&logw_files_mutex);
+
+    __atomic_store_n(&logw_head, head, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&logw_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&logw_mutex);
+        pthread_cond_signal(&logw_room);
+        pthread_mutex_unlock(&logw_mutex);
+    }
+}
+
+/* Flush the files written */
+static void logw_flush(void)
+{
+    int i;
+
+    pthread_mutex_lock(&logw_files_mutex);
+
+    for (i = 0; i < LOGW_FILES; i++) {
+        FILE *fp = *logw_fp[i];
+
+        if (!logw_dirty[i] || !fp) {
+            continue;
+        }
+
+        fflush(fp);
+        if (Config.log_durability == LOGW_FLUSH_SYNC) {
+            fsync(fileno(fp));
+        }
+
+        logw_dirty[i] = 0;
+    }
+
+    pthread_mutex_unlock(&logw_files_mutex);
+}
+
+static void *logw_thread(__attribute__((unused)) void *arg)
+{
+    long long next_flush = logw_now() + Config.log_flush_interval;
+    sigset_t sigset;
+
+    /* The signal handlers exit through logw_stop */
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+    while (1) {
+        uint64_t wanted = __atomic_load_n(&logw_sync_wanted, __ATOMIC_SEQ_CST);
+        long long now;
+        int empty;
+        int dirty;
+        int i;
+
+        logw_drain();
+
+        now = logw_now();
+        empty = __atomic_load_n(&logw_tail, __ATOMIC_SEQ_CST) == logw_head;
+
+        if (wanted != logw_sync_done || now >= next_flush ||
+                (empty && Config.log_durability != LOGW_FLUSH_INTERVAL)) {
+            logw_flush();
+            next_flush = now + Config.log_flush_interval;
+        }
+
+        if (wanted != logw_sync_done) {
+            pthread_mutex_lock(&logw_mutex);
+            logw_sync_done = wanted;
+            pthread_cond_broadcast(&logw_synced);
+            pthread_mutex_unlock(&logw_mutex);
+        }
+
+        if (!empty) {
+            continue;
+        }
+
+        for (dirty = 0, i = 0; i < LOGW_FILES; i++) {
+            dirty |= logw_dirty[i];
+        }
+
+        /* Sleep until there is something to write or flush */
+        pthread_mutex_lock(&logw_mutex);
+        __atomic_store_n(&logw_sleeping, 1, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&logw_tail, __ATOMIC_SEQ_CST) == logw_head &&
+                __atomic_load_n(&logw_sync_wanted, __ATOMIC_SEQ_CST) == logw_sync_done) {
+            struct timespec ts;
+
+            logw_deadline(&ts, dirty ? next_flush : logw_now() + LOGW_IDLE_WAIT);
+            pthread_cond_timedwait(&logw_work, &logw_mutex, &ts);
+        }
+
+        __atomic_store_n(&logw_sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&logw_mutex);
+    }
+
+    return (NULL);
+}
+
+/* Write the records queued before exiting */
+static void logw_stop(void)
+{
+    struct timespec ts;
+    uint64_t wanted;
+
+    if (!logw_active || logw_paused) {
+        return;
+    }
+
+    /* The exit may come from a signal while the mutex is held */
+    if (pthread_mutex_trylock(&logw_mutex) != 0) {
+        return;
+    }
+
+    wanted = __atomic_add_fetch(&logw_sync_wanted, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_signal(&logw_work);
+
+    logw_deadline(&ts, logw_now() + LOGW_STOP_WAIT * 1000);
+    while (logw_sync_done < wanted) {
+        if (pthread_cond_timedwait(&logw_synced, &logw_mutex, &ts) == ETIMEDOUT) {
+            merror("%s: ERROR: Timeout writing the alerts queued.", ARGV0);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&logw_mutex);
+}
+
+void OS_InitLogWriter()
+{
+    if (!Config.log_writer) {
+        return;
+    }
+
+    os_malloc(LOGW_RING_SIZE, logw_ring);
+
+    if (CreateThread(logw_thread, NULL) != 0) {
+        merror("%s: WARN: Writing the alerts on the main thread.", ARGV0);
+        free(logw_ring);
+        logw_ring = NULL;
+        return;
+    }
+
+    logw_active = 1;
+    atexit(logw_stop);
+
+    debug1("%s: DEBUG: Alerts written by a thread (flush every %d ms).",
+           ARGV0, Config.log_flush_interval);
+}
+
+void OS_LogWriterPrintf(int file, const char *format, ...)
+{
+    logw_record *rec = &logw_records[file];
+    va_list args;
+    int n;
+
+    while (1) {
+        size_t room = rec->size - rec->len;
+
+        va_start(args, format);
+        n = vsnprintf(rec->data ? rec->data + rec->len : NULL, room, format, args);
+        va_end(args);
+
+        if (n < 0) {
+            return;
+        }
+
+        if ((size_t)n < room) {
+            rec->len += (size_t)n;
+            return;
+        }
+
+        rec->size = (rec->len + (size_t)n + 1) * 2;
+        os_realloc(rec->data, rec->size, rec->data);
+    }
+}
+
+void OS_LogWriterPuts(int file, const char *str)
+{
+    logw_record *rec = &logw_records[file];
+    size_t len = strlen(str);
+
+    if (rec->len + len + 1 > rec->size) {
+        rec->size = (rec->len + len + 1) * 2;
+        os_realloc(rec->data, rec->size, rec->data);
+    }
+
+    memcpy(rec->data + rec->len, str, len + 1);
+    rec->len += len;
+}
+
+const char *OS_LogWriterRecord(int file, size_t *len)
+{
+    logw_record *rec = &logw_records[file];
+
+    *len = rec->len;
+    return (rec->data ? rec->data : "");
+}
+
+void OS_LogWriterCommit(int file)
+{
+    logw_record *rec = &logw_records[file];
+    FILE *fp = *logw_fp[file];
+    logw_header hdr;
+    uint64_t tail;
+    size_t need;
+
+    if (!fp || rec->len == 0) {
+        rec->len = 0;
+        return;
+    }
+
+    logw_offset[file] += (long)rec->len;
+
+    /* Without the writer (or a record too large for the ring) */
+    if (!logw_active || rec->len > LOGW_RING_SIZE / 2) {
+        OS_LogWriterPause();
+        fwrite(rec->data, 1, rec->len, fp);
+        fflush(fp);
+        if (logw_active && Config.log_durability == LOGW_FLUSH_SYNC) {
+            fsync(fileno(fp));
+        }
+        OS_LogWriterResume();
+
+        rec->len = 0;
+        return;
+    }
+
+    hdr.len = (uint32_t)rec->len;
+    hdr.file = (uint32_t)file;
+    need = sizeof(hdr) + rec->len;
+    tail = logw_tail;
+
+    /* Wait for room */
+    while (LOGW_RING_SIZE - (tail - __atomic_load_n(&logw_head, __ATOMIC_SEQ_CST)) < need) {
+        struct timespec ts;
+
+        pthread_mutex_lock(&logw_mutex);
+        __atomic_store_n(&logw_waiting, 1, __ATOMIC_SEQ_CST);
+        pthread_cond_signal(&logw_work);
+
+        if (LOGW_RING_SIZE - (tail - __atomic_load_n(&logw_head, __ATOMIC_SEQ_CST)) < need) {
+            logw_deadline(&ts, logw_now() + LOGW_FULL_WAIT);
+            pthread_cond_timedwait(&logw_room, &logw_mutex, &ts);
+        }
+
+        __atomic_store_n(&logw_waiting, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&logw_mutex);
+    }
+
+    logw_ring_write(tail, &hdr, sizeof(hdr));
+    logw_ring_write(tail + sizeof(hdr), rec->data, rec->len);
+    __atomic_store_n(&logw_tail, tail + need, __ATOMIC_SEQ_CST);
+
+    rec->len = 0;
+
+    /* Write now, or let the writer batch until the next flush */
+    if (Config.log_durability != LOGW_FLUSH_INTERVAL ||
+            tail + need - __atomic_load_n(&logw_head, __ATOMIC_SEQ_CST) > LOGW_RING_SIZE / 2) {
+        logw_wake();
+    }
+}
+
+long OS_LogWriterOffset(int file)
+{
+    FILE *fp = *logw_fp[file];
+
+    if (!logw_active) {
+        return (fp ? ftell(fp) : 0);
+    }
+
+    return (logw_offset[file]);
+}
+
+void OS_LogWriterPause()
+{
+    uint64_t wanted;
+
+    if (!logw_active) {
+        return;
+    }
+
+    pthread_mutex_lock(&logw_mutex);
+
+    wanted = __atomic_add_fetch(&logw_sync_wanted, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_signal(&logw_work);
+
+    while (logw_sync_done < wanted) {
+        pthread_cond_wait(&logw_synced, &logw_mutex);
+    }
+
+    pthread_mutex_unlock(&logw_mutex);
+
+    pthread_mutex_lock(&logw_files_mutex);
+    logw_paused = 1;
+}
+
+void OS_LogWriterResume()
+{
+    int i;
+
+    if (!logw_active) {
+        return;
+    }
+
+    /* The files may have been reopened */
+    for (i = 0; i < LOGW_FILES; i++) {
+        FILE *fp = *logw_fp[i];
+
+        logw_offset[i] = 0;
+        if (fp && fseek(fp, 0, SEEK_END) == 0) {
+            logw_offset[i] = ftell(fp);
+        }
+    }
+
+    logw_paused = 0;
+    pthread_mutex_unlock(&logw_files_mutex);
+}
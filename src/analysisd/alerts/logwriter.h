@@ -0,0 +1,51 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+#ifndef __LOGWRITER_H
+#define __LOGWRITER_H
+
+/* Log files written through the writer */
+#define LOGW_ARCHIVES       0   /* _eflog */
+#define LOGW_ARCHIVES_JSON  1   /* _ejflog */
+#define LOGW_ALERTS         2   /* _aflog */
+#define LOGW_ALERTS_JSON    3   /* _jflog */
+#define LOGW_FIREWALL       4   /* _fflog */
+#define LOGW_FILES          5
+
+/* Durability modes (analysisd.log_durability) */
+#define LOGW_FLUSH_INTERVAL 0   /* Flush every log_flush_interval ms */
+#define LOGW_FLUSH_IDLE     1   /* Also flush when the queue is empty */
+#define LOGW_FLUSH_SYNC     2   /* As 1, and fsync the files */
+
+/* Start the writer thread (if Config.log_writer is set) */
+void OS_InitLogWriter(void);
+
+/* Add text to the record being built for a file */
+void OS_LogWriterPrintf(int file, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void OS_LogWriterPuts(int file, const char *str);
+
+/* Record built so far for a file */
+const char *OS_LogWriterRecord(int file, size_t *len);
+
+/* Queue the record built for a file (written right away without
+ * the writer thread)
+ */
+void OS_LogWriterCommit(int file);
+
+/* Offset of the end of a file, with all the records queued so far */
+long OS_LogWriterOffset(int file);
+
+/* Wait until all the records queued are written and flushed, and
+ * keep the writer from using the files until OS_LogWriterResume
+ * (to close or reopen them)
+ */
+void OS_LogWriterPause(void);
+void OS_LogWriterResume(void);
+
+#endif /* __LOGWRITER_H */
@@ -15,6 +15,8 @@
 #define ARGV0 "ossec-analysisd"
 #endif
 
+#include <pthread.h>
+
 #include "shared.h"
 #include "alerts/alerts.h"
 #include "alerts/getloglocation.h"
@@ -24,6 +26,8 @@
 #include "active-response.h"
 #include "config.h"
 #include "rules.h"
+#include "rules_prefilter.h"
+#include "correlation.h"
 #include "stats.h"
 #include "eventinfo.h"
 #include "accumulator.h"
@@ -49,6 +53,14 @@
 void OS_ReadMSG(int m_queue);
 RuleInfo *OS_CheckIfRuleMatch(Eventinfo *lf, RuleNode *curr_node);
 static void LoopRule(RuleNode *curr_node, FILE *flog);
+static void OS_ProcessEvent(char msg_type, Eventinfo *lf,
+                            OSDecoderInfo *plugin, RuleInfo *stats_rule);
+static void OS_ReadRecord(mq_record *record, RuleInfo *stats_rule);
+static void OS_StartDecoders(int m_queue);
+static void *OS_RecvThread(void *m_queue);
+static void OS_QueueEvent(char *event, int size, const mq_record *record,
+                          time_t ev_time);
+static void *OS_DecodeThread(void *none);
 
 /* For decoders */
 void DecodeEvent(Eventinfo *lf);
@@ -81,6 +93,40 @@ static int hourly_events;
 static int hourly_syscheck;
 static int hourly_firewall;
 
+/* Decoding pipeline, used when analysisd.decode_threads > 0.
+ * One thread receives the events, the decoding threads pre-decode
+ * and decode them, and the main thread runs everything that keeps
+ * state (accumulator, rules, correlation, outputs) in the same
+ * order the events were received.
+ */
+#define DSLOT_FREE      0   /* Available for the receiver */
+#define DSLOT_RECEIVED  1   /* Waiting for a decoding thread */
+#define DSLOT_DECODING  2   /* Owned by a decoding thread */
+#define DSLOT_READY     3   /* Waiting for the main thread */
+
+typedef struct _decode_slot {
+    int status;
+    int size;
+    char *msg;
+    mq_record record;       /* No location until a text message is split */
+    Eventinfo *lf;          /* NULL if the message was invalid */
+    OSDecoderInfo *plugin;  /* Plugin decoder left to run */
+    time_t time;
+    int hour;
+    int wday;
+} decode_slot;
+
+static decode_slot *dslots;
+static unsigned int dslots_size;
+static unsigned long recv_seq;      /* Next slot to receive into */
+static unsigned long decode_seq;    /* Next slot to decode */
+static unsigned long done_seq;      /* Next slot to analyze */
+
+static pthread_mutex_t dslots_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dslots_received = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t dslots_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t dslots_free = PTHREAD_COND_INITIALIZER;
+
 
 /* Print help statement */
 __attribute__((noreturn))
@@ -428,6 +474,21 @@ int main_analysisd(int argc, char **argv)
         AddHash_Rule(tmp_node);
     }
 
+    /* Index the decoders by program name */
+    if (getDefine_Int("analysisd", "decoder_index", 0, 1)) {
+        OS_IndexOSDecoders();
+    }
+
+    /* Index the rules by decoder and literals */
+    if (getDefine_Int("analysisd", "rule_prefilter", 0, 1)) {
+        OS_BuildRulePrefilters();
+    }
+
+    /* Index the events of the frequency rules by their context */
+    if (getDefine_Int("analysisd", "correlation_index", 0, 1)) {
+        OS_BuildCorrelation();
+    }
+
     /* Ignored files on syscheck */
     {
         char **files;
@@ -445,6 +506,31 @@ int main_analysisd(int argc, char **argv)
                                  "log_fw",
                                  0, 1);
 
+    /* Get the number of decoding threads */
+    Config.decode_threads = getDefine_Int("analysisd",
+                                          "decode_threads",
+                                          0, 64);
+    Config.decode_queue_size = getDefine_Int("analysisd",
+                                             "decode_queue_size",
+                                             16, 65536);
+
+    /* Get how the alerts and archives are written */
+    Config.log_writer = getDefine_Int("analysisd",
+                                      "log_writer",
+                                      0, 1);
+    Config.log_flush_interval = getDefine_Int("analysisd",
+                                              "log_flush_interval",
+                                              0, 60000);
+    Config.log_durability = getDefine_Int("analysisd",
+                                          "log_durability",
+                                          0, 2);
+    Config.alert_bus = getDefine_Int("analysisd",
+                                     "alert_bus",
+                                     0, 1);
+    Config.alert_bus_size = getDefine_Int("analysisd",
+                                          "alert_bus_size",
+                                          1024, 1048576);
+
     /* Success on the configuration test */
     if (test_config) {
         exit(0);
@@ -532,8 +618,9 @@ void OS_ReadMSG_analysisd(int m_queue)
 #endif
 {
     int i;
-    char msg[OS_MAXSTR + 1];
+    char *msg;
     Eventinfo *lf;
+    mq_record record;
 
     RuleInfo *stats_rule = NULL;
 
@@ -543,6 +630,17 @@ void OS_ReadMSG_analysisd(int m_queue)
     /* Initialize the logs */
     OS_InitLog();
 
+    /* Publish the alerts to the daemons reading them */
+    if (Config.alert_bus) {
+        if (AlertBus_Create((size_t)Config.alert_bus_size * 1024) < 0) {
+            merror("%s: ERROR: Unable to create the alert bus, the alerts "
+                   "will be read from the log.", ARGV0);
+            Config.alert_bus = 0;
+        }
+    } else {
+        AlertBus_Remove();
+    }
+
     /* Initialize the integrity database */
     SyscheckInit();
 
@@ -637,16 +735,12 @@ void OS_ReadMSG_analysisd(int m_queue)
         stats_rule->comment = "Excessive number of events (above normal).";
     }
 
-    /* Do some cleanup */
-    memset(msg, '\0', OS_MAXSTR + 1);
+    /* Receive buffer, large enough for a batch */
+    os_calloc(MQ_BATCH_MAXSIZE + 1, sizeof(char), msg);
 
     /* Initialize the logs */
     {
-        lf = (Eventinfo *)calloc(1, sizeof(Eventinfo));
-        if (!lf) {
-            ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
-        }
-        os_calloc(Config.decoder_order_size, sizeof(char*), lf->fields);
+        lf = New_Eventinfo();
         lf->year = prev_year;
         strncpy(lf->mon, prev_month, 3);
         lf->day = today;
@@ -677,377 +771,678 @@ void OS_ReadMSG_analysisd(int m_queue)
         debug1("%s: INFO: Custom output found.!", ARGV0);
     }
 
-    /* Daemon loop */
-    while (1) {
-        lf = (Eventinfo *)calloc(1, sizeof(Eventinfo));
-        os_calloc(Config.decoder_order_size, sizeof(char*), lf->fields);
+    /* Decode on several threads */
+    if (Config.decode_threads > 0) {
+        OS_StartDecoders(m_queue);
 
-        /* This shouldn't happen */
-        if (lf == NULL) {
-            ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+        while (1) {
+            decode_slot *slot;
+
+            /* Wait for the next event, in the order it was received */
+            if (pthread_mutex_lock(&dslots_mutex) != 0) {
+                ErrorExit(MUTEX_ERROR, ARGV0);
+            }
+
+            slot = &dslots[done_seq % dslots_size];
+            while (slot->status != DSLOT_READY) {
+                pthread_cond_wait(&dslots_ready, &dslots_mutex);
+            }
+
+            if (pthread_mutex_unlock(&dslots_mutex) != 0) {
+                ErrorExit(MUTEX_ERROR, ARGV0);
+            }
+
+            if (slot->lf) {
+                /* Time of the event being analyzed */
+                c_time = slot->time;
+                __crt_hour = slot->hour;
+                __crt_wday = slot->wday;
+
+                OS_ProcessEvent(slot->record.loc, slot->lf, slot->plugin, stats_rule);
+            }
+
+            free(slot->msg);
+            slot->msg = NULL;
+            slot->lf = NULL;
+            slot->plugin = NULL;
+
+            /* Give the slot back to the receiver */
+            if (pthread_mutex_lock(&dslots_mutex) != 0) {
+                ErrorExit(MUTEX_ERROR, ARGV0);
+            }
+
+            slot->status = DSLOT_FREE;
+            done_seq++;
+            pthread_cond_signal(&dslots_free);
+
+            if (pthread_mutex_unlock(&dslots_mutex) != 0) {
+                ErrorExit(MUTEX_ERROR, ARGV0);
+            }
         }
+    }
 
+    /* Daemon loop */
+    while (1) {
         DEBUG_MSG("%s: DEBUG: Waiting for msgs - %d ", ARGV0, (int)time(0));
 
         /* Receive message from queue */
-        if ((i = OS_RecvUnix(m_queue, OS_MAXSTR, msg))) {
-            RuleNode *rulenode_pt;
-
+        if ((i = OS_RecvUnix(m_queue, MQ_BATCH_MAXSIZE + 1, msg))) {
             /* Get the time we received the event */
             c_time = time(NULL);
 
-            /* Default values for the log info */
-            Zero_Eventinfo(lf);
+            /* Batch of messages */
+            if (IsMQBatch(msg, (size_t)i)) {
+                size_t pos = 0;
+                int r;
+
+                while ((r = ReadMQBatch(msg, (size_t)i, &pos, &record)) > 0) {
+                    OS_ReadRecord(&record, stats_rule);
+                }
+
+                if (r < 0) {
+                    merror(IMSG_ERROR, ARGV0, "truncated batch");
+                }
+                continue;
+            }
+
+            /* Text messages are limited to OS_MAXSTR */
+            if (i >= OS_MAXSTR) {
+                i = OS_MAXSTR - 1;
+                msg[i] = '\0';
+            }
 
             /* Check for a valid message */
             if (i < 4) {
                 merror(IMSG_ERROR, ARGV0, msg);
-                Free_Eventinfo(lf);
                 continue;
             }
 
             /* Message before extracting header */
             DEBUG_MSG("%s: DEBUG: Received msg: %s ", ARGV0, msg);
 
-            /* Clean the msg appropriately */
-            if (OS_CleanMSG(msg, lf) < 0) {
+            if (OS_SplitMSG(msg, &record) < 0) {
                 merror(IMSG_ERROR, ARGV0, msg);
-                Free_Eventinfo(lf);
                 continue;
             }
 
-            /* Msg cleaned */
-            DEBUG_MSG("%s: DEBUG: Msg cleanup: %s ", ARGV0, lf->log);
+            OS_ReadRecord(&record, stats_rule);
+        }
+    }
+}
 
-            /* Current rule must be null in here */
-            currently_rule = NULL;
+/* Clean, decode and analyze a received message */
+static void OS_ReadRecord(mq_record *record, RuleInfo *stats_rule)
+{
+    OSDecoderInfo *plugin = NULL;
+    Eventinfo *lf;
+    struct tm p;
 
-            /** Check the date/hour changes **/
+    lf = New_Eventinfo();
 
-            /* Update the hour */
-            if (thishour != __crt_hour) {
-                /* Search all the rules and print the number
-                 * of alerts that each one fired
-                 */
-                DumpLogstats();
-                thishour = __crt_hour;
+    /* Default values for the log info */
+    Zero_Eventinfo(lf);
 
-                /* Check if the date has changed */
-                if (today != lf->day) {
-                    if (Config.stats) {
-                        /* Update the hourly stats (done daily) */
-                        Update_Hour();
-                    }
+    /* Clean the msg appropriately */
+    if (OS_CleanRecord_r(record, lf, c_time, &p) < 0) {
+        merror(IMSG_ERROR, ARGV0, record->message);
+        Free_Eventinfo(lf);
+        return;
+    }
 
-                    if (OS_GetLogLocation(lf) < 0) {
-                        ErrorExit("%s: Error allocating log files", ARGV0);
-                    }
+    /* Set the global hour/weekday */
+    __crt_hour = p.tm_hour;
+    __crt_wday = p.tm_wday;
 
-                    today = lf->day;
-                    strncpy(prev_month, lf->mon, 3);
-                    prev_year = lf->year;
-                }
-            }
+    /* Msg cleaned */
+    DEBUG_MSG("%s: DEBUG: Msg cleanup: %s ", ARGV0, lf->log);
 
+    /* Run the general decoders */
+    if (record->loc != SYSCHECK_MQ && record->loc != ROOTCHECK_MQ &&
+            record->loc != HOSTINFO_MQ) {
+        /* Get log size */
+        lf->size = strlen(lf->log);
 
-            /* Increment number of events received */
-            hourly_events++;
+        plugin = DecodeEvent_r(lf, NULL);
+    }
 
-            /***  Run decoders ***/
+    OS_ProcessEvent(record->loc, lf, plugin, stats_rule);
+}
 
-            /* Integrity check from syscheck */
-            if (msg[0] == SYSCHECK_MQ) {
-                hourly_syscheck++;
+/* Analyze an event already cleaned and, for the general events, decoded.
+ * Everything that keeps state is done in here, so it must always be
+ * called from the same thread and in the order the events were received.
+ * The event is released or kept in the state memory.
+ */
+static void OS_ProcessEvent(char msg_type, Eventinfo *lf,
+                            OSDecoderInfo *plugin, RuleInfo *stats_rule)
+{
+    RuleNode *rulenode_pt;
+    RuleCandidates candidates;
 
-                if (!DecodeSyscheck(lf)) {
-                    /* We don't process syscheck events further */
-                    goto CLMEM;
-                }
+    /* Current rule must be null in here */
+    currently_rule = NULL;
 
-                /* Get log size */
-                lf->size = strlen(lf->log);
-            }
+    /** Check the date/hour changes **/
 
-            /* Rootcheck decoding */
-            else if (msg[0] == ROOTCHECK_MQ) {
-                if (!DecodeRootcheck(lf)) {
-                    /* We don't process rootcheck events further */
-                    goto CLMEM;
-                }
-                lf->size = strlen(lf->log);
+    /* Update the hour */
+    if (thishour != __crt_hour) {
+        /* Search all the rules and print the number
+         * of alerts that each one fired
+         */
+        DumpLogstats();
+        thishour = __crt_hour;
+
+        /* Check if the date has changed */
+        if (today != lf->day) {
+            if (Config.stats) {
+                /* Update the hourly stats (done daily) */
+                Update_Hour();
             }
 
-            /* Host information special decoder */
-            else if (msg[0] == HOSTINFO_MQ) {
-                if (!DecodeHostinfo(lf)) {
-                    /* We don't process hostinfo events further */
-                    goto CLMEM;
-                }
-                lf->size = strlen(lf->log);
+            if (OS_GetLogLocation(lf) < 0) {
+                ErrorExit("%s: Error allocating log files", ARGV0);
             }
 
-            /* Run the general Decoders */
-            else {
-                /* Get log size */
-                lf->size = strlen(lf->log);
+            today = lf->day;
+            strncpy(prev_month, lf->mon, 3);
+            prev_year = lf->year;
+        }
+    }
 
-                DecodeEvent(lf);
-            }
 
-            /* Run accumulator */
-            if ( lf->decoder_info->accumulate == 1 ) {
-                lf = Accumulate(lf);
-            }
+    /* Increment number of events received */
+    hourly_events++;
 
-            /* Firewall event */
-            if (lf->decoder_info->type == FIREWALL) {
-                /* If we could not get any information from
-                 * the log, just ignore it
-                 */
-                hourly_firewall++;
-                if (Config.logfw) {
-                    if (!FW_Log(lf)) {
-                        goto CLMEM;
-                    }
-                }
-            }
+    /***  Run decoders ***/
 
-            /* We only check if the last message is
-             * duplicated on syslog
-             */
-            else if (lf->decoder_info->type == SYSLOG) {
-                /* Check if the message is duplicated */
-                if (LastMsg_Stats(lf->full_log) == 1) {
-                    goto CLMEM;
-                } else {
-                    LastMsg_Change(lf->full_log);
-                }
+    /* Integrity check from syscheck */
+    if (msg_type == SYSCHECK_MQ) {
+        hourly_syscheck++;
+
+        if (!DecodeSyscheck(lf)) {
+            /* We don't process syscheck events further */
+            goto CLMEM;
+        }
+
+        /* Get log size */
+        lf->size = strlen(lf->log);
+    }
+
+    /* Rootcheck decoding */
+    else if (msg_type == ROOTCHECK_MQ) {
+        if (!DecodeRootcheck(lf)) {
+            /* We don't process rootcheck events further */
+            goto CLMEM;
+        }
+        lf->size = strlen(lf->log);
+    }
+
+    /* Host information special decoder */
+    else if (msg_type == HOSTINFO_MQ) {
+        if (!DecodeHostinfo(lf)) {
+            /* We don't process hostinfo events further */
+            goto CLMEM;
+        }
+        lf->size = strlen(lf->log);
+    }
+
+    /* The general decoders already ran, except for the plugins */
+    else if (plugin) {
+        plugin->plugindecoder(lf);
+    }
+
+    /* Run accumulator */
+    if ( lf->decoder_info->accumulate == 1 ) {
+        lf = Accumulate(lf);
+    }
+
+    /* Firewall event */
+    if (lf->decoder_info->type == FIREWALL) {
+        /* If we could not get any information from
+         * the log, just ignore it
+         */
+        hourly_firewall++;
+        if (Config.logfw) {
+            if (!FW_Log(lf)) {
+                goto CLMEM;
             }
+        }
+    }
 
-            /* Stats checking */
-            if (Config.stats) {
-                if (Check_Hour() == 1) {
-                    RuleInfo *saved_rule = lf->generated_rule;
-                    char *saved_log;
-
-                    /* Save previous log */
-                    saved_log = lf->full_log;
-
-                    lf->generated_rule = stats_rule;
-                    lf->full_log = __stats_comment;
-
-                    /* Alert for statistical analysis */
-                    if (stats_rule->alert_opts & DO_LOGALERT) {
-                        __crt_ftell = ftell(_aflog);
-                        if (Config.custom_alert_output) {
-                            OS_CustomLog(lf, Config.custom_alert_output_format);
-                        } else {
-                            OS_Log(lf);
-                        }
-                        /* Log to json file */
-                        if (Config.jsonout_output) {
-                            jsonout_output_event(lf);
-                        }
+    /* We only check if the last message is
+     * duplicated on syslog
+     */
+    else if (lf->decoder_info->type == SYSLOG) {
+        /* Check if the message is duplicated */
+        if (LastMsg_Stats(lf->full_log) == 1) {
+            goto CLMEM;
+        } else {
+            LastMsg_Change(lf->full_log);
+        }
+    }
 
-                    }
+    /* Stats checking */
+    if (Config.stats) {
+        if (Check_Hour() == 1) {
+            RuleInfo *saved_rule = lf->generated_rule;
+            char *saved_log;
+
+            /* Save previous log */
+            saved_log = lf->full_log;
+
+            lf->generated_rule = stats_rule;
+            lf->full_log = __stats_comment;
 
-                    /* Set lf to the old values */
-                    lf->generated_rule = saved_rule;
-                    lf->full_log = saved_log;
+            /* Alert for statistical analysis */
+            if (stats_rule->alert_opts & DO_LOGALERT) {
+                __crt_ftell = OS_LogWriterOffset(LOGW_ALERTS);
+                if (Config.custom_alert_output) {
+                    OS_CustomLog(lf, Config.custom_alert_output_format);
+                } else {
+                    OS_Log(lf);
+                }
+                /* Log to json file */
+                if (Config.jsonout_output) {
+                    jsonout_output_event(lf);
                 }
+
             }
 
-            /* Check the rules */
-            DEBUG_MSG("%s: DEBUG: Checking the rules - %d ",
-                      ARGV0, lf->decoder_info->type);
+            /* Set lf to the old values */
+            lf->generated_rule = saved_rule;
+            lf->full_log = saved_log;
+        }
+    }
 
-            /* Loop over all the rules */
-            rulenode_pt = OS_GetFirstRule();
-            if (!rulenode_pt) {
-                ErrorExit("%s: Rules in an inconsistent state. Exiting.",
-                          ARGV0);
-            }
+    /* Check the rules */
+    DEBUG_MSG("%s: DEBUG: Checking the rules - %d ",
+              ARGV0, lf->decoder_info->type);
 
-            do {
-                if (lf->decoder_info->type == OSSEC_ALERT) {
-                    if (!lf->generated_rule) {
-                        goto CLMEM;
-                    }
+    /* Loop over all the rules */
+    rulenode_pt = OS_GetFirstRule();
+    if (!rulenode_pt) {
+        ErrorExit("%s: Rules in an inconsistent state. Exiting.",
+                  ARGV0);
+    }
 
-                    /* Process the alert */
-                    currently_rule = lf->generated_rule;
-                }
+    /* Only try the rules that can match the event */
+    for (rulenode_pt = OS_FirstRuleCandidate(
+                lf->decoder_info->type == OSSEC_ALERT ? NULL : OS_GetFirstRulePrefilter(),
+                rulenode_pt, lf, &candidates);
+            rulenode_pt;
+            rulenode_pt = OS_NextRuleCandidate(rulenode_pt, &candidates)) {
+        if (lf->decoder_info->type == OSSEC_ALERT) {
+            if (!lf->generated_rule) {
+                goto CLMEM;
+            }
 
-                /* Categories must match */
-                else if (rulenode_pt->ruleinfo->category !=
-                         lf->decoder_info->type) {
-                    continue;
-                }
+            /* Process the alert */
+            currently_rule = lf->generated_rule;
+        }
 
-                /* Check each rule */
-                else if ((currently_rule = OS_CheckIfRuleMatch(lf, rulenode_pt))
-                         == NULL) {
-                    continue;
-                }
+        /* Categories must match */
+        else if (rulenode_pt->ruleinfo->category !=
+                 lf->decoder_info->type) {
+            continue;
+        }
 
-                /* Ignore level 0 */
-                if (currently_rule->level == 0) {
-                    break;
-                }
+        /* Check each rule */
+        else if ((currently_rule = OS_CheckIfRuleMatch(lf, rulenode_pt))
+                 == NULL) {
+            continue;
+        }
 
-                /* Check ignore time */
-                if (currently_rule->ignore_time) {
-                    if (currently_rule->time_ignored == 0) {
-                        currently_rule->time_ignored = lf->time;
-                    }
-                    /* If the current time - the time the rule was ignored
-                     * is less than the time it should be ignored,
-                     * leave (do not alert again)
-                     */
-                    else if ((lf->time - currently_rule->time_ignored)
-                             < currently_rule->ignore_time) {
-                        break;
-                    } else {
-                        currently_rule->time_ignored = lf->time;
-                    }
-                }
+        /* Ignore level 0 */
+        if (currently_rule->level == 0) {
+            break;
+        }
 
-                /* Pointer to the rule that generated it */
-                lf->generated_rule = currently_rule;
+        /* Check ignore time */
+        if (currently_rule->ignore_time) {
+            if (currently_rule->time_ignored == 0) {
+                currently_rule->time_ignored = lf->time;
+            }
+            /* If the current time - the time the rule was ignored
+             * is less than the time it should be ignored,
+             * leave (do not alert again)
+             */
+            else if ((lf->time - currently_rule->time_ignored)
+                     < currently_rule->ignore_time) {
+                break;
+            } else {
+                currently_rule->time_ignored = lf->time;
+            }
+        }
 
-                /* Check if we should ignore it */
-                if (currently_rule->ckignore && IGnore(lf)) {
-                    /* Ignore rule */
-                    lf->generated_rule = NULL;
-                    break;
-                }
+        /* Pointer to the rule that generated it */
+        lf->generated_rule = currently_rule;
 
-                /* Check if we need to add to ignore list */
-                if (currently_rule->ignore) {
-                    AddtoIGnore(lf);
-                }
+        /* Check if we should ignore it */
+        if (currently_rule->ckignore && IGnore(lf)) {
+            /* Ignore rule */
+            lf->generated_rule = NULL;
+            break;
+        }
 
-                /* Log the alert if configured to */
-                if (currently_rule->alert_opts & DO_LOGALERT) {
-                    __crt_ftell = ftell(_aflog);
+        /* Check if we need to add to ignore list */
+        if (currently_rule->ignore) {
+            AddtoIGnore(lf);
+        }
 
-                    if (Config.custom_alert_output) {
-                        OS_CustomLog(lf, Config.custom_alert_output_format);
-                    } else {
-                        OS_Log(lf);
-                    }
-                    /* Log to json file */
-                    if (Config.jsonout_output) {
-                        jsonout_output_event(lf);
-                    }
-                }
+        /* Log the alert if configured to */
+        if (currently_rule->alert_opts & DO_LOGALERT) {
+            __crt_ftell = OS_LogWriterOffset(LOGW_ALERTS);
+
+            if (Config.custom_alert_output) {
+                OS_CustomLog(lf, Config.custom_alert_output_format);
+            } else {
+                OS_Log(lf);
+            }
+            /* Log to json file */
+            if (Config.jsonout_output) {
+                jsonout_output_event(lf);
+            }
+        }
 
 #ifdef PRELUDE_OUTPUT_ENABLED
-                /* Log to prelude */
-                if (Config.prelude) {
-                    if (Config.prelude_log_level <= currently_rule->level) {
-                        OS_PreludeLog(lf);
-                    }
-                }
+        /* Log to prelude */
+        if (Config.prelude) {
+            if (Config.prelude_log_level <= currently_rule->level) {
+                OS_PreludeLog(lf);
+            }
+        }
 #endif
 
 #ifdef ZEROMQ_OUTPUT_ENABLED
-                /* Log to zeromq */
-                if (Config.zeromq_output) {
-                    zeromq_output_event(lf);
-                }
+        /* Log to zeromq */
+        if (Config.zeromq_output) {
+            zeromq_output_event(lf);
+        }
 #endif
 
 
-                /* Execute an active response */
-                if (currently_rule->ar) {
-                    int do_ar;
-                    active_response **rule_ar;
+        /* Execute an active response */
+        if (currently_rule->ar) {
+            int do_ar;
+            active_response **rule_ar;
 
-                    rule_ar = currently_rule->ar;
-
-                    while (*rule_ar) {
-                        do_ar = 1;
-                        if ((*rule_ar)->ar_cmd->expect & USERNAME) {
-                            if (!lf->dstuser ||
-                                    !OS_PRegex(lf->dstuser, "^[a-zA-Z._0-9@?-]*$")) {
-                                if (lf->dstuser) {
-                                    merror(CRAFTED_USER, ARGV0, lf->dstuser);
-                                }
-                                do_ar = 0;
-                            }
-                        }
-                        if ((*rule_ar)->ar_cmd->expect & SRCIP) {
-                            if (!lf->srcip ||
-                                    !OS_PRegex(lf->srcip, "^[a-zA-Z.:_0-9-]*$")) {
-                                if (lf->srcip) {
-                                    merror(CRAFTED_IP, ARGV0, lf->srcip);
-                                }
-                                do_ar = 0;
-                            }
-                        }
-                        if ((*rule_ar)->ar_cmd->expect & FILENAME) {
-                            if (!lf->filename) {
-                                do_ar = 0;
-                            }
-                        }
+            rule_ar = currently_rule->ar;
 
-                        if (do_ar && execdq > 0) {
-                            OS_Exec(execdq, arq, lf, *rule_ar);
+            while (*rule_ar) {
+                do_ar = 1;
+                if ((*rule_ar)->ar_cmd->expect & USERNAME) {
+                    if (!lf->dstuser ||
+                            !OS_PRegex(lf->dstuser, "^[a-zA-Z._0-9@?-]*$")) {
+                        if (lf->dstuser) {
+                            merror(CRAFTED_USER, ARGV0, lf->dstuser);
                         }
-                        rule_ar++;
+                        do_ar = 0;
                     }
                 }
-
-                /* Copy the structure to the state memory of if_matched_sid */
-                if (currently_rule->sid_prev_matched) {
-                    if (!OSList_AddData(currently_rule->sid_prev_matched, lf)) {
-                        merror("%s: Unable to add data to sig list.", ARGV0);
-                    } else {
-                        lf->sid_node_to_delete =
-                            currently_rule->sid_prev_matched->last_node;
+                if ((*rule_ar)->ar_cmd->expect & SRCIP) {
+                    if (!lf->srcip ||
+                            !OS_PRegex(lf->srcip, "^[a-zA-Z.:_0-9-]*$")) {
+                        if (lf->srcip) {
+                            merror(CRAFTED_IP, ARGV0, lf->srcip);
+                        }
+                        do_ar = 0;
                     }
                 }
-                /* Group list */
-                else if (currently_rule->group_prev_matched) {
-                    unsigned int j = 0;
-
-                    while (j < currently_rule->group_prev_matched_sz) {
-                        if (!OSList_AddData(
-                                    currently_rule->group_prev_matched[j],
-                                    lf)) {
-                            merror("%s: Unable to add data to grp list.", ARGV0);
-                        }
-                        j++;
+                if ((*rule_ar)->ar_cmd->expect & FILENAME) {
+                    if (!lf->filename) {
+                        do_ar = 0;
                     }
                 }
 
-                OS_AddEvent(lf);
+                if (do_ar && execdq > 0) {
+                    OS_Exec(execdq, arq, lf, *rule_ar);
+                }
+                rule_ar++;
+            }
+        }
 
-                break;
+        /* Copy the structure to the state memory of if_matched_sid */
+        if (currently_rule->sid_prev_matched) {
+            if (!OSList_AddData(currently_rule->sid_prev_matched, lf)) {
+                merror("%s: Unable to add data to sig list.", ARGV0);
+            } else {
+                lf->sid_node_to_delete =
+                    currently_rule->sid_prev_matched->last_node;
+            }
+        }
+        /* Group list */
+        else if (currently_rule->group_prev_matched) {
+            unsigned int j = 0;
 
-            } while ((rulenode_pt = rulenode_pt->next) != NULL);
+            while (j < currently_rule->group_prev_matched_sz) {
+                if (!OSList_AddData(
+                            currently_rule->group_prev_matched[j],
+                            lf)) {
+                    merror("%s: Unable to add data to grp list.", ARGV0);
+                }
+                j++;
+            }
+        }
+        OS_CorrAddEvent(lf, currently_rule);
+
+        OS_AddEvent(lf);
 
-            /* If configured to log all, do it */
-            if (Config.logall)
-                OS_Store(lf);
-            if (Config.logall_json)
-                jsonout_output_archive(lf);
+        break;
+
+    }
+
+    /* If configured to log all, do it */
+    if (Config.logall)
+        OS_Store(lf);
+    if (Config.logall_json)
+        jsonout_output_archive(lf);
 
 CLMEM:
-            /** Cleaning the memory **/
+    /** Cleaning the memory **/
 
-            /* Only clear the memory if the eventinfo was not
-             * added to the stateful memory
-             * -- message is free inside clean event --
-             */
-            if (lf->generated_rule == NULL) {
-                Free_Eventinfo(lf);
+    /* Only clear the memory if the eventinfo was not
+     * added to the stateful memory
+     * -- message is free inside clean event --
+     */
+    if (lf->generated_rule == NULL) {
+        Free_Eventinfo(lf);
+    }
+}
+
+/* Start the receiver and the decoding threads */
+static void OS_StartDecoders(int m_queue)
+{
+    static int queue;
+    int i;
+
+    dslots_size = (unsigned int)Config.decode_queue_size;
+    os_calloc(dslots_size, sizeof(decode_slot), dslots);
+
+    verbose("%s: INFO: Starting %d decoding threads (queue size: %u).",
+            ARGV0, Config.decode_threads, dslots_size);
+
+    for (i = 0; i < Config.decode_threads; i++) {
+        if (CreateThread(OS_DecodeThread, NULL) != 0) {
+            ErrorExit(THREAD_ERROR, ARGV0);
+        }
+    }
+
+    queue = m_queue;
+    if (CreateThread(OS_RecvThread, (void *)&queue) != 0) {
+        ErrorExit(THREAD_ERROR, ARGV0);
+    }
+}
+
+/* Receive the events from the queue into the free slots */
+static void *OS_RecvThread(void *m_queue)
+{
+    int queue = *(int *)m_queue;
+    char *msg;
+    char *event;
+    mq_record record;
+    time_t ev_time;
+    int size;
+
+    os_malloc(MQ_BATCH_MAXSIZE + 1, msg);
+
+    while (1) {
+        if ((size = OS_RecvUnix(queue, MQ_BATCH_MAXSIZE + 1, msg)) == 0) {
+            continue;
+        }
+
+        ev_time = time(NULL);
+
+        /* Batch of messages: one slot per record */
+        if (IsMQBatch(msg, (size_t)size)) {
+            size_t pos = 0;
+            size_t event_size;
+            int r;
+
+            while ((r = ReadMQBatch(msg, (size_t)size, &pos, &record)) > 0) {
+                /* The location and the message follow each other */
+                event_size = record.location_size + record.message_size + 2;
+                os_malloc(event_size, event);
+                memcpy(event, record.location, event_size);
+
+                record.location = event;
+                record.message = event + record.location_size + 1;
+
+                OS_QueueEvent(event, (int)record.message_size, &record, ev_time);
             }
-        } else {
-            free(lf);
+
+            if (r < 0) {
+                merror(IMSG_ERROR, ARGV0, "truncated batch");
+            }
+            continue;
         }
+
+        /* Text messages are limited to OS_MAXSTR */
+        if (size >= OS_MAXSTR) {
+            size = OS_MAXSTR - 1;
+            msg[size] = '\0';
+        }
+
+        os_malloc(size + 1, event);
+        memcpy(event, msg, size + 1);
+
+        /* Split by the decoding threads */
+        memset(&record, 0, sizeof(mq_record));
+        record.loc = event[0];
+
+        OS_QueueEvent(event, size, &record, ev_time);
     }
+
+    return (NULL);
+}
+
+/* Put a received event in the next slot, waiting for the main thread
+ * if all the slots are taken
+ */
+static void OS_QueueEvent(char *event, int size, const mq_record *record,
+                          time_t ev_time)
+{
+    decode_slot *slot;
+
+    if (pthread_mutex_lock(&dslots_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+
+    while (recv_seq - done_seq >= dslots_size) {
+        pthread_cond_wait(&dslots_free, &dslots_mutex);
+    }
+
+    slot = &dslots[recv_seq % dslots_size];
+    slot->msg = event;
+    slot->size = size;
+    slot->record = *record;
+    slot->time = ev_time;
+    slot->status = DSLOT_RECEIVED;
+    recv_seq++;
+
+    pthread_cond_signal(&dslots_received);
+
+    if (pthread_mutex_unlock(&dslots_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+}
+
+/* Pre-decode and decode the received events.
+ * Only the thread safe decoders run in here: syscheck, rootcheck,
+ * hostinfo and the plugin decoders are left to the main thread.
+ */
+static void *OS_DecodeThread(__attribute__((unused)) void *none)
+{
+    OSRegexCtx ctx;
+    decode_slot *slot;
+    Eventinfo *lf;
+    struct tm p;
+
+    memset(&ctx, 0, sizeof(OSRegexCtx));
+
+    while (1) {
+        if (pthread_mutex_lock(&dslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        while (decode_seq == recv_seq) {
+            pthread_cond_wait(&dslots_received, &dslots_mutex);
+        }
+
+        slot = &dslots[decode_seq % dslots_size];
+        slot->status = DSLOT_DECODING;
+        decode_seq++;
+
+        if (pthread_mutex_unlock(&dslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        lf = New_Eventinfo();
+
+        /* Default values for the log info */
+        Zero_Eventinfo(lf);
+
+        /* Split the text messages */
+        if (!slot->record.location &&
+                (slot->size < 4 || OS_SplitMSG(slot->msg, &slot->record) < 0)) {
+            merror(IMSG_ERROR, ARGV0, slot->msg);
+            Free_Eventinfo(lf);
+            lf = NULL;
+        }
+
+        /* Clean the msg appropriately */
+        else if (OS_CleanRecord_r(&slot->record, lf, slot->time, &p) < 0) {
+            merror(IMSG_ERROR, ARGV0, slot->record.message);
+            Free_Eventinfo(lf);
+            lf = NULL;
+        }
+
+        else {
+            slot->hour = p.tm_hour;
+            slot->wday = p.tm_wday;
+
+            /* Run the general decoders */
+            if (slot->record.loc != SYSCHECK_MQ &&
+                    slot->record.loc != ROOTCHECK_MQ &&
+                    slot->record.loc != HOSTINFO_MQ) {
+                lf->size = strlen(lf->log);
+                slot->plugin = DecodeEvent_r(lf, &ctx);
+            }
+        }
+
+        if (pthread_mutex_lock(&dslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        slot->lf = lf;
+        slot->status = DSLOT_READY;
+        pthread_cond_signal(&dslots_ready);
+
+        if (pthread_mutex_unlock(&dslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+    }
+
+    return (NULL);
 }
 
 /* Checks if the current_rule matches the event information */
@@ -1606,8 +2001,9 @@ RuleInfo *OS_CheckIfRuleMatch(Eventinfo *lf, RuleNode *curr_node)
 
     /* Search for dependent rules */
     if (curr_node->child) {
-        RuleNode *child_node = curr_node->child;
+        RuleNode *child_node;
         RuleInfo *child_rule = NULL;
+        RuleCandidates candidates;
 
 #ifdef TESTRULE
         if (full_output && !alert_only) {
@@ -1615,13 +2011,14 @@ RuleInfo *OS_CheckIfRuleMatch(Eventinfo *lf, RuleNode *curr_node)
         }
 #endif
 
-        while (child_node) {
+        for (child_node = OS_FirstRuleCandidate(curr_node->child_prefilter,
+                                                curr_node->child, lf, &candidates);
+                child_node;
+                child_node = OS_NextRuleCandidate(child_node, &candidates)) {
             child_rule = OS_CheckIfRuleMatch(lf, child_node);
             if (child_rule != NULL) {
                 return (child_rule);
             }
-
-            child_node = child_node->next;
         }
     }
 
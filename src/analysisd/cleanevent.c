@@ -24,13 +24,45 @@ static const char *(month[]) = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
 /* Format a received message in the Eventinfo structure */
 int OS_CleanMSG(char *msg, Eventinfo *lf)
 {
-    size_t loglen;
+    struct tm p;
+
+    if (OS_CleanMSG_r(msg, lf, c_time, &p) < 0) {
+        return (-1);
+    }
+
+    /* Set the global hour/weekday */
+    __crt_hour = p.tm_hour;
+    __crt_wday = p.tm_wday;
+
+    return (0);
+}
+
+/* Reentrant version of OS_CleanMSG. The event is dated with ev_time
+ * and the broken down time is returned in p, instead of using
+ * c_time and setting the global hour/weekday.
+ */
+int OS_CleanMSG_r(char *msg, Eventinfo *lf, time_t ev_time, struct tm *p)
+{
+    mq_record record;
+
+    if (OS_SplitMSG(msg, &record) < 0) {
+        return (-1);
+    }
+
+    return (OS_CleanRecord_r(&record, lf, ev_time, p));
+}
+
+/* Split a text message in place, in the same fields as a record
+ * of a batch
+ */
+int OS_SplitMSG(char *msg, mq_record *record)
+{
     char *pieces;
-    struct tm *p;
 
     /* The message is formatted in the following way:
      * id:location:message.
      */
+    record->loc = msg[0];
 
     /* Ignore the id of the message in here */
     msg += 2;
@@ -56,13 +88,31 @@ int OS_CleanMSG(char *msg, Eventinfo *lf)
     *pieces = '\0';
     pieces++;
 
-    os_strdup(msg, lf->location);
+    record->location = msg;
+    record->location_size = (size_t)(pieces - msg - 1);
+    record->message = pieces;
+    record->message_size = strlen(pieces);
+
+    return (0);
+}
+
+/* Format a received message, already split in location and log,
+ * in the Eventinfo structure (see OS_CleanMSG_r)
+ */
+int OS_CleanRecord_r(const mq_record *record, Eventinfo *lf, time_t ev_time,
+                     struct tm *p)
+{
+    size_t loglen;
+    char *pieces = record->message;
 
     /* Get the log length */
-    loglen = strlen(pieces) + 1;
+    loglen = record->message_size + 1;
 
     /* Assign the values in the structure (lf->full_log) */
-    os_malloc((2 * loglen) + 1, lf->full_log);
+    lf->full_log = Alloc_EventinfoStr(lf, (2 * loglen) + 1);
+
+    lf->location = Alloc_EventinfoStr(lf, record->location_size + 1);
+    memcpy(lf->location, record->location, record->location_size + 1);
 
     /* Set the whole message at full_log */
     strncpy(lf->full_log, pieces, loglen);
@@ -536,8 +586,8 @@ int OS_CleanMSG(char *msg, Eventinfo *lf)
     }
 
     /* Set up the event data */
-    lf->time = c_time;
-    p = localtime(&c_time);
+    lf->time = ev_time;
+    localtime_r(&ev_time, p);
 
     /* Assign hour, day, year and month values */
     lf->day = p->tm_mday;
@@ -548,10 +598,6 @@ int OS_CleanMSG(char *msg, Eventinfo *lf)
              p->tm_min,
              p->tm_sec);
 
-    /* Set the global hour/weekday */
-    __crt_hour = p->tm_hour;
-    __crt_wday = p->tm_wday;
-
 #ifdef TESTRULE
     if (!alert_only) {
         print_out("**Phase 1: Completed pre-decoding.");
@@ -11,8 +11,13 @@
 #define _CLEANEVENT_H_
 
 #include "eventinfo.h"
+#include "shared.h"
 
 int OS_CleanMSG(char *msg, Eventinfo *lf);
+int OS_CleanMSG_r(char *msg, Eventinfo *lf, time_t ev_time, struct tm *p);
+int OS_SplitMSG(char *msg, mq_record *record);
+int OS_CleanRecord_r(const mq_record *record, Eventinfo *lf, time_t ev_time,
+                     struct tm *p);
 
 
 #endif /* _CLEANEVENT_H_ */
@@ -0,0 +1,573 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+#include "shared.h"
+#include "rules.h"
+#include "config.h"
+#include "analysisd.h"
+#include "correlation.h"
+
+/* Fields of the key of an index */
+#define CR_KEY_OPTS     (SAME_ID | SAME_SRCIP)
+#define CR_EXTRA_OPTS   (SAME_SRCPORT | SAME_DSTPORT | SAME_USER | SAME_LOCATION)
+
+#define CR_MIN_BUCKETS  64
+
+typedef struct _OSCorrList OSCorrList;
+typedef struct _OSCorrIndex OSCorrIndex;
+typedef struct _OSCorrBucket OSCorrBucket;
+
+/* Event in a bucket */
+struct _OSCorrEntry {
+    Eventinfo *lf;
+    unsigned long seq;
+    OSCorrBucket *bucket;
+    struct _OSCorrEntry *prev;      /* Bucket, oldest first */
+    struct _OSCorrEntry *next;
+    struct _OSCorrEntry *ev_prev;   /* Entries of the same event */
+    struct _OSCorrEntry *ev_next;
+};
+
+/* Events of a list with the same key */
+struct _OSCorrBucket {
+    unsigned int hash;
+    OSCorrIndex *index;
+    struct _OSCorrEntry *first;
+    struct _OSCorrEntry *last;
+    OSCorrBucket *next;
+};
+
+/* Buckets of a list for the key of one rule */
+struct _OSCorrIndex {
+    RuleInfo *rule;
+    int opts;
+    OSCorrList *clist;
+    OSCorrBucket **table;
+    unsigned int size;
+    unsigned int count;
+    OSCorrIndex *next;
+};
+
+/* Matched event: no event older than seq can be counted by
+ * rules up to this level
+ */
+typedef struct _cr_mark {
+    int level;
+    unsigned long seq;
+} cr_mark;
+
+/* Indexes of a list (sid_prev_matched or group_search) */
+struct _OSCorrList {
+    OSList *list;
+    OSCorrIndex *indexes;
+    cr_mark *marks;
+    int n_marks;
+    OSCorrList *next;
+};
+
+static OSCorrList **cr_lists = NULL;
+static unsigned int cr_lists_size = 0;
+static unsigned long cr_seq = 0;
+
+
+static unsigned int cr_ptr_hash(const void *ptr)
+{
+    return ((unsigned int)(((size_t)ptr >> 4) * 2654435761u));
+}
+
+static OSCorrList *cr_find_list(const OSList *list)
+{
+    OSCorrList *clist;
+
+    if (!cr_lists) {
+        return (NULL);
+    }
+
+    clist = cr_lists[cr_ptr_hash(list) & (cr_lists_size - 1)];
+    while (clist && clist->list != list) {
+        clist = clist->next;
+    }
+
+    return (clist);
+}
+
+/* Get a field of the key (NULL if the event does not have it) */
+static const char *cr_field(const Eventinfo *lf, int opt)
+{
+    switch (opt) {
+        case SAME_ID:
+            return (lf->id);
+        case SAME_SRCIP:
+            return (lf->srcip);
+        case SAME_SRCPORT:
+            return (lf->srcport);
+        case SAME_DSTPORT:
+            return (lf->dstport);
+        case SAME_USER:
+            return (lf->dstuser);
+        case SAME_LOCATION:
+            return (lf->hostname);
+    }
+
+    return (NULL);
+}
+
+static const int cr_fields[] = {
+    SAME_ID, SAME_SRCIP, SAME_SRCPORT, SAME_DSTPORT, SAME_USER, SAME_LOCATION, 0
+};
+
+/* Hash the key of an event.
+ * Returns -1 if the event is missing a field of the key
+ */
+static int cr_key_hash(const Eventinfo *lf, int opts, unsigned int *hash)
+{
+    unsigned int h = 2166136261u;
+    const unsigned char *str;
+    int i;
+
+    for (i = 0; cr_fields[i]; i++) {
+        if (!(opts & cr_fields[i])) {
+            continue;
+        }
+
+        str = (const unsigned char *)cr_field(lf, cr_fields[i]);
+        if (!str) {
+            return (-1);
+        }
+
+        for (; *str; str++) {
+            h = (h ^ *str) * 16777619u;
+        }
+        h = (h ^ 0xff) * 16777619u;
+    }
+
+    *hash = h;
+    return (0);
+}
+
+static int cr_key_equal(const Eventinfo *a, const Eventinfo *b, int opts)
+{
+    int i;
+
+    for (i = 0; cr_fields[i]; i++) {
+        if ((opts & cr_fields[i]) &&
+                strcmp(cr_field(a, cr_fields[i]), cr_field(b, cr_fields[i])) != 0) {
+            return (0);
+        }
+    }
+
+    return (1);
+}
+
+static OSCorrBucket *cr_find_bucket(const OSCorrIndex *index,
+                                    const Eventinfo *lf, unsigned int hash)
+{
+    OSCorrBucket *bucket = index->table[hash & (index->size - 1)];
+
+    while (bucket) {
+        if (bucket->hash == hash &&
+                cr_key_equal(bucket->last->lf, lf, index->opts)) {
+            return (bucket);
+        }
+        bucket = bucket->next;
+    }
+
+    return (NULL);
+}
+
+static void cr_grow(OSCorrIndex *index)
+{
+    OSCorrBucket **table;
+    OSCorrBucket *bucket;
+    OSCorrBucket *next;
+    unsigned int i;
+
+    os_calloc(index->size * 2, sizeof(OSCorrBucket *), table);
+
+    for (i = 0; i < index->size; i++) {
+        for (bucket = index->table[i]; bucket; bucket = next) {
+            next = bucket->next;
+            bucket->next = table[bucket->hash & (index->size * 2 - 1)];
+            table[bucket->hash & (index->size * 2 - 1)] = bucket;
+        }
+    }
+
+    free(index->table);
+    index->table = table;
+    index->size *= 2;
+}
+
+/* Remove an entry from its bucket and from its event.
+ * Empty buckets are freed.
+ */
+static void cr_remove_entry(struct _OSCorrEntry *entry)
+{
+    OSCorrBucket *bucket = entry->bucket;
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        bucket->first = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        bucket->last = entry->prev;
+    }
+
+    if (entry->ev_prev) {
+        entry->ev_prev->ev_next = entry->ev_next;
+    } else {
+        entry->lf->corr_entries = entry->ev_next;
+    }
+    if (entry->ev_next) {
+        entry->ev_next->ev_prev = entry->ev_prev;
+    }
+
+    free(entry);
+
+    if (!bucket->first) {
+        OSCorrIndex *index = bucket->index;
+        OSCorrBucket **pos = &index->table[bucket->hash & (index->size - 1)];
+
+        while (*pos != bucket) {
+            pos = &(*pos)->next;
+        }
+        *pos = bucket->next;
+        index->count--;
+        free(bucket);
+    }
+}
+
+static void cr_add_entry(OSCorrIndex *index, Eventinfo *lf)
+{
+    OSCorrBucket *bucket;
+    struct _OSCorrEntry *entry;
+    unsigned int hash;
+
+    if (cr_key_hash(lf, index->opts, &hash) < 0) {
+        return;
+    }
+
+    bucket = cr_find_bucket(index, lf, hash);
+    if (!bucket) {
+        if (index->count >= index->size) {
+            cr_grow(index);
+        }
+
+        os_calloc(1, sizeof(OSCorrBucket), bucket);
+        bucket->hash = hash;
+        bucket->index = index;
+        bucket->next = index->table[hash & (index->size - 1)];
+        index->table[hash & (index->size - 1)] = bucket;
+        index->count++;
+    }
+
+    os_calloc(1, sizeof(struct _OSCorrEntry), entry);
+    entry->lf = lf;
+    entry->seq = lf->corr_seq;
+    entry->bucket = bucket;
+
+    entry->prev = bucket->last;
+    if (bucket->last) {
+        bucket->last->next = entry;
+    } else {
+        bucket->first = entry;
+    }
+    bucket->last = entry;
+
+    entry->ev_next = lf->corr_entries;
+    if (lf->corr_entries) {
+        lf->corr_entries->ev_prev = entry;
+    }
+    lf->corr_entries = entry;
+}
+
+/* Record a matched event. Only the newest mark of each level
+ * that is not hidden by a newer mark of a higher level is kept.
+ */
+static void cr_add_mark(OSCorrList *clist, int level, unsigned long seq)
+{
+    int i;
+    int j = 0;
+
+    for (i = 0; i < clist->n_marks; i++) {
+        if (clist->marks[i].level >= level && clist->marks[i].seq >= seq) {
+            return;
+        }
+    }
+
+    for (i = 0; i < clist->n_marks; i++) {
+        if (clist->marks[i].level > level || clist->marks[i].seq > seq) {
+            clist->marks[j++] = clist->marks[i];
+        }
+    }
+
+    os_realloc(clist->marks, (size_t)(j + 1) * sizeof(cr_mark), clist->marks);
+    clist->marks[j].level = level;
+    clist->marks[j].seq = seq;
+    clist->n_marks = j + 1;
+}
+
+/* Newest event of the list matched by a rule of this level or higher */
+static unsigned long cr_barrier(const OSCorrList *clist, int level)
+{
+    unsigned long seq = 0;
+    int i;
+
+    for (i = 0; i < clist->n_marks; i++) {
+        if (clist->marks[i].level >= level && clist->marks[i].seq > seq) {
+            seq = clist->marks[i].seq;
+        }
+    }
+
+    return (seq);
+}
+
+static OSCorrList *cr_get_list(OSList *list)
+{
+    OSCorrList *clist = cr_find_list(list);
+    unsigned int i;
+
+    if (clist) {
+        return (clist);
+    }
+
+    os_calloc(1, sizeof(OSCorrList), clist);
+    clist->list = list;
+
+    i = cr_ptr_hash(list) & (cr_lists_size - 1);
+    clist->next = cr_lists[i];
+    cr_lists[i] = clist;
+
+    return (clist);
+}
+
+/* Key of a rule, 0 if its search must walk the list */
+static int cr_rule_opts(const RuleInfo *rule)
+{
+    int opts = rule->context_opts & CR_KEY_OPTS;
+
+    if (rule->alert_opts & SAME_EXTRAINFO) {
+        if (rule->context_opts & (DIFFERENT_URL | DIFFERENT_SRCGEOIP)) {
+            return (0);
+        }
+        opts |= rule->context_opts & CR_EXTRA_OPTS;
+    }
+
+    /* Every event is matched by a rule of level 0 or higher */
+    if (rule->level <= 0) {
+        return (0);
+    }
+
+    return (opts);
+}
+
+static void cr_build(RuleNode *node)
+{
+    while (node) {
+        RuleInfo *rule = node->ruleinfo;
+        OSList *list = NULL;
+        int opts;
+
+        if (rule->if_matched_sid) {
+            list = rule->sid_search;
+        } else if (rule->if_matched_group) {
+            list = rule->group_search;
+        }
+
+        opts = cr_rule_opts(rule);
+        if (list && opts && !rule->corr_index) {
+            OSCorrIndex *index;
+
+            os_calloc(1, sizeof(OSCorrIndex), index);
+            index->rule = rule;
+            index->opts = opts;
+            index->size = CR_MIN_BUCKETS;
+            os_calloc(index->size, sizeof(OSCorrBucket *), index->table);
+
+            index->clist = cr_get_list(list);
+            index->next = index->clist->indexes;
+            index->clist->indexes = index;
+
+            rule->corr_index = index;
+        }
+
+        if (node->child) {
+            cr_build(node->child);
+        }
+        node = node->next;
+    }
+}
+
+void OS_BuildCorrelation()
+{
+    cr_lists_size = 256;
+    os_calloc(cr_lists_size, sizeof(OSCorrList *), cr_lists);
+
+    cr_build(OS_GetFirstRule());
+}
+
+void OS_CorrAddEvent(Eventinfo *lf, RuleInfo *rule)
+{
+    OSCorrList *clist;
+    OSCorrIndex *index;
+    unsigned int i;
+
+    lf->corr_seq = ++cr_seq;
+
+    if (!cr_lists) {
+        return;
+    }
+
+    if (rule->sid_prev_matched) {
+        if (!(clist = cr_find_list(rule->sid_prev_matched))) {
+            return;
+        }
+
+        if (lf->matched > 0) {
+            cr_add_mark(clist, lf->matched, lf->corr_seq);
+        }
+        for (index = clist->indexes; index; index = index->next) {
+            cr_add_entry(index, lf);
+        }
+        return;
+    }
+
+    for (i = 0; rule->group_prev_matched && i < rule->group_prev_matched_sz; i++) {
+        if (!(clist = cr_find_list(rule->group_prev_matched[i]))) {
+            continue;
+        }
+
+        if (lf->matched > 0) {
+            cr_add_mark(clist, lf->matched, lf->corr_seq);
+        }
+        for (index = clist->indexes; index; index = index->next) {
+            cr_add_entry(index, lf);
+        }
+    }
+}
+
+void OS_CorrRemoveEvent(Eventinfo *lf)
+{
+    while (lf->corr_entries) {
+        cr_remove_entry(lf->corr_entries);
+    }
+}
+
+void OS_CorrMarkEvent(Eventinfo *lf, int level)
+{
+    RuleInfo *rule = lf->generated_rule;
+    OSCorrList *clist;
+    unsigned int i;
+
+    lf->matched = level;
+
+    /* Not in a list yet */
+    if (!lf->corr_seq || !rule || !cr_lists || level <= 0) {
+        return;
+    }
+
+    if (lf->sid_node_to_delete) {
+        if ((clist = cr_find_list(rule->sid_prev_matched))) {
+            cr_add_mark(clist, level, lf->corr_seq);
+        }
+        return;
+    }
+
+    for (i = 0; rule->group_prev_matched && i < rule->group_prev_matched_sz; i++) {
+        if ((clist = cr_find_list(rule->group_prev_matched[i]))) {
+            cr_add_mark(clist, level, lf->corr_seq);
+        }
+    }
+}
+
+Eventinfo *OS_CorrSearch(Eventinfo *my_lf, RuleInfo *rule, int sid_search)
+{
+    OSCorrIndex *index = rule->corr_index;
+    OSCorrBucket *bucket;
+    struct _OSCorrEntry *entry;
+    OSListNode *lf_node;
+    Eventinfo *first_lf;
+    Eventinfo *lf;
+    unsigned long barrier;
+    unsigned int hash;
+
+    lf_node = OSList_GetLastNode(index->clist->list);
+    if (!lf_node) {
+        return (NULL);
+    }
+    first_lf = (Eventinfo *)lf_node->data;
+
+    if (cr_key_hash(my_lf, index->opts, &hash) < 0) {
+        return (NULL);
+    }
+    if (!(bucket = cr_find_bucket(index, my_lf, hash))) {
+        return (NULL);
+    }
+
+    /* Drop the events outside the timeframe */
+    while ((c_time - bucket->first->lf->time) > rule->timeframe) {
+        if (bucket->first == bucket->last) {
+            cr_remove_entry(bucket->first);
+            return (NULL);
+        }
+        cr_remove_entry(bucket->first);
+    }
+
+    barrier = cr_barrier(index->clist, rule->level);
+
+    for (entry = bucket->last; entry; entry = entry->prev) {
+        lf = entry->lf;
+
+        /* If time is outside the timeframe, return */
+        if ((c_time - lf->time) > rule->timeframe) {
+            return (NULL);
+        }
+
+        /* We avoid multiple triggers for the same rule
+         * or rules with a lower level.
+         */
+        if (entry->seq <= barrier || lf->matched >= rule->level) {
+            return (NULL);
+        }
+
+        /* Check if the number of matches worked */
+        if (sid_search && rule->__frequency <= 10) {
+            rule->last_events[rule->__frequency]
+                = lf->full_log;
+            rule->last_events[rule->__frequency + 1]
+                = NULL;
+        }
+
+        if (rule->__frequency < rule->frequency) {
+            if (!sid_search && rule->__frequency <= 10) {
+                rule->last_events[rule->__frequency]
+                    = lf->full_log;
+                rule->last_events[rule->__frequency + 1]
+                    = NULL;
+            }
+
+            rule->__frequency++;
+            continue;
+        }
+        if (sid_search) {
+            rule->__frequency++;
+        }
+
+        /* If reached here, we matched */
+        OS_CorrMarkEvent(my_lf, rule->level);
+        OS_CorrMarkEvent(lf, rule->level);
+        OS_CorrMarkEvent(first_lf, rule->level);
+
+        return (lf);
+    }
+
+    return (NULL);
+}
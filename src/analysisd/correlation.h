@@ -0,0 +1,52 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Correlation index
+ *
+ * The frequency rules (if_matched_sid/if_matched_group) count the
+ * previous events of a list that share some fields with the current
+ * one (same_source_ip, same_id, ...). Instead of walking the whole
+ * list, the events of the list are kept in buckets by the fields of
+ * each rule, newest last, and only the bucket of the event is walked.
+ * Entries older than the timeframe of the rule are dropped from the
+ * bucket, and every entry goes away with its event.
+ *
+ * A search over the list stops at the newest event already matched
+ * by a rule of the same or higher level, whatever its fields. Each
+ * list keeps these marks, so the bucket walk stops at the same place.
+ *
+ * The index must only be used from the thread running the rules.
+ */
+
+#ifndef __CORRELATION_H
+#define __CORRELATION_H
+
+#include "eventinfo.h"
+
+/* Build the indexes of the frequency rules (after all the rules
+ * are loaded)
+ */
+void OS_BuildCorrelation(void);
+
+/* Index an event just added to the lists of its rule */
+void OS_CorrAddEvent(Eventinfo *lf, RuleInfo *rule);
+
+/* Remove an event from the indexes (when it is freed) */
+void OS_CorrRemoveEvent(Eventinfo *lf);
+
+/* Mark an event as matched by a rule of the given level */
+void OS_CorrMarkEvent(Eventinfo *lf, int level);
+
+/* Search the bucket of an event for a rule with an index.
+ * Same results as the list walk of Search_LastSids (sid_search set)
+ * or Search_LastGroups.
+ */
+Eventinfo *OS_CorrSearch(Eventinfo *my_lf, RuleInfo *rule, int sid_search);
+
+#endif /* __CORRELATION_H */
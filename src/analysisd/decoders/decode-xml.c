@@ -286,6 +286,7 @@ int ReadDecodeXML(const char *file)
         pi->regex = NULL;
         pi->prematch_pcre2 = NULL;
         pi->program_name_pcre2 = NULL;
+        pi->program_name_str = NULL;
         pi->pcre2 = NULL;
         pi->use_own_name = 0;
         pi->get_next = 0;
@@ -739,7 +740,8 @@ int ReadDecodeXML(const char *file)
                 return (0);
             }
 
-            free(p_name);
+            /* Kept for the index by program name */
+            pi->program_name_str = p_name;
         }
         else if (p_name_pcre2) {
             os_calloc(1, sizeof(OSPcre2), pi->program_name_pcre2);
@@ -748,7 +750,7 @@ int ReadDecodeXML(const char *file)
                 return (0);
             }
 
-            free(p_name_pcre2);
+            pi->program_name_str = p_name_pcre2;
         }
 
         /* We may not have the pi->regex */
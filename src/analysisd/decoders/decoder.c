@@ -14,24 +14,60 @@
 #include "decoder.h"
 #include "config.h"
 
+/* Regex execution state of the main thread */
+static OSRegexCtx main_ctx;
 
 
+/* Copy a sub string of the log to the arena of the event */
+static char *decode_span(Eventinfo *lf, const char *str, const OSRegexSpan *span)
+{
+    char *field = Alloc_EventinfoStr(lf, span->length + 1);
+
+    memcpy(field, str + span->offset, span->length);
+    field[span->length] = '\0';
+
+    return (field);
+}
+
 /* Use the osdecoders to decode the received event */
 void DecodeEvent(Eventinfo *lf)
+{
+    OSDecoderInfo *plugin;
+
+    plugin = DecodeEvent_r(lf, NULL);
+    if (plugin) {
+        plugin->plugindecoder(lf);
+    }
+}
+
+/* Run the osdecoders on the event, keeping the regex execution state
+ * in ctx, so several threads can decode at the same time (NULL for the
+ * main thread). The captured fields are copied to the arena of the
+ * event only when the decoder keeps them.
+ * Plugin decoders are not thread safe, so they are not executed here:
+ * the matched plugin decoder is returned to be run by the caller.
+ * Returns NULL if there is nothing else to run.
+ */
+OSDecoderInfo *DecodeEvent_r(Eventinfo *lf, OSRegexCtx *ctx)
 {
     OSDecoderNode *node;
     OSDecoderNode *child_node;
     OSDecoderInfo *nnode;
+    OSDecoderCandidates candidates;
 
     const char *llog = NULL;
     const char *pmatch = NULL;
     const char *cmatch = NULL;
     const char *regex_prev = NULL;
 
+    if (!ctx) {
+        ctx = &main_ctx;
+    }
+
     node = OS_GetFirstOSDecoder(lf->program_name);
 
     if (!node) {
-        return;
+        return (NULL);
     }
 
 #ifdef TESTRULE
@@ -40,19 +76,21 @@ void DecodeEvent(Eventinfo *lf)
     }
 #endif
 
-    do {
+    /* Only the decoders that can match the program name */
+    for (node = OS_FirstOSDecoderCandidate(node, lf->program_name, &candidates);
+            node; node = OS_NextOSDecoderCandidate(&candidates)) {
         nnode = node->osdecoder;
 
         /* First check program name */
         if (lf->program_name) {
             if (nnode->program_name) {
-                if (!OSMatch_Execute(lf->program_name, lf->p_name_size,
-                                     nnode->program_name)) {
+                if (!OSMatch_Execute_ex(lf->program_name, lf->p_name_size,
+                                        nnode->program_name, ctx)) {
                     continue;
                 }
                 pmatch = lf->log;
             } else if (nnode->program_name_pcre2) {
-                if (!OSPcre2_Execute(lf->program_name, nnode->program_name_pcre2)) {
+                if (!OSPcre2_Execute_ex(lf->program_name, nnode->program_name_pcre2, ctx)) {
                     continue;
                 }
                 pmatch = lf->log;
@@ -61,12 +99,12 @@ void DecodeEvent(Eventinfo *lf)
 
         /* If prematch fails, go to the next osdecoder in the list */
         if (nnode->prematch) {
-            if (!(pmatch = OSRegex_Execute(lf->log, nnode->prematch))) {
+            if (!(pmatch = OSRegex_Execute_ex(lf->log, nnode->prematch, ctx))) {
                 continue;
             }
         }
         else if (nnode->prematch_pcre2) {
-            if (!(pmatch = OSPcre2_Execute(lf->log, nnode->prematch_pcre2))) {
+            if (!(pmatch = OSPcre2_Execute_ex(lf->log, nnode->prematch_pcre2, ctx))) {
                 continue;
             }
         }
@@ -106,7 +144,7 @@ void DecodeEvent(Eventinfo *lf)
                         llog2 = lf->log;
                     }
 
-                    if ((cmatch = OSRegex_Execute(llog2, nnode->prematch))) {
+                    if ((cmatch = OSRegex_Execute_ex(llog2, nnode->prematch, ctx))) {
                         lf->decoder_info = nnode;
 
                         break;
@@ -121,7 +159,7 @@ void DecodeEvent(Eventinfo *lf)
                         llog2 = lf->log;
                     }
 
-                    if ((cmatch = OSPcre2_Execute(llog2, nnode->prematch_pcre2))) {
+                    if ((cmatch = OSPcre2_Execute_ex(llog2, nnode->prematch_pcre2, ctx))) {
                         lf->decoder_info = nnode;
 
                         break;
@@ -140,7 +178,7 @@ void DecodeEvent(Eventinfo *lf)
                     } while (child_node && child_node->osdecoder->get_next);
 
                     if (!child_node) {
-                        return;
+                        return (NULL);
                     }
 
                     child_node = child_node->next;
@@ -154,19 +192,18 @@ void DecodeEvent(Eventinfo *lf)
 
         /* Nothing matched */
         if (!nnode) {
-            return;
+            return (NULL);
         }
 
-        /* If we have an external decoder, execute it */
+        /* If we have an external decoder, let the caller execute it */
         if (nnode->plugindecoder) {
-            nnode->plugindecoder(lf);
-            return;
+            return (nnode);
         }
 
         /* Get the regex */
         while (child_node) {
             if (nnode->regex) {
-                int i;
+                size_t i;
 
                 /* With regex we have multiple options
                  * regarding the offset:
@@ -192,29 +229,25 @@ void DecodeEvent(Eventinfo *lf)
                 }
 
                 /* If Regex does not match, return */
-                if (!(regex_prev = OSRegex_Execute(llog, nnode->regex))) {
+                if (!(regex_prev = OSRegex_Execute_spans(llog, nnode->regex, ctx))) {
                     if (nnode->get_next) {
                         child_node = child_node->next;
                         nnode = child_node->osdecoder;
                         continue;
                     }
-                    return;
+                    return (NULL);
                 }
 
                 lf->decoder_info = nnode;
 
-                for (i = 0; nnode->regex->sub_strings[i]; i++) {
-                    if (i >= Config.decoder_order_size) {
+                for (i = 0; i < ctx->nspans; i++) {
+                    if (i >= (size_t)Config.decoder_order_size) {
                         ErrorExit("%s: ERROR: Regex has too many groups.", ARGV0);
                     }
 
-                    if (nnode->order[i])
-                        nnode->order[i](lf, nnode->regex->sub_strings[i], i);
-                    else
-                        /* We do not free any memory used above */
-                        os_free(nnode->regex->sub_strings[i]);
-
-                    nnode->regex->sub_strings[i] = NULL;
+                    if (nnode->order[i]) {
+                        nnode->order[i](lf, decode_span(lf, llog, &ctx->spans[i]), (int)i);
+                    }
                 }
 
                 /* If we have a next regex, try getting it */
@@ -227,7 +260,7 @@ void DecodeEvent(Eventinfo *lf)
                 break;
             }
             else if (nnode->pcre2) {
-                int i;
+                size_t i;
 
                 /* With regex we have multiple options
                  * regarding the offset:
@@ -253,30 +286,26 @@ void DecodeEvent(Eventinfo *lf)
                 }
 
                 /* If Regex does not match, return */
-                if (!(regex_prev = OSPcre2_Execute(llog, nnode->pcre2))) {
+                if (!(regex_prev = OSPcre2_Execute_spans(llog, nnode->pcre2, ctx))) {
                     if (nnode->get_next) {
                         child_node = child_node->next;
                         nnode = child_node->osdecoder;
                         continue;
                     }
-                    return;
+                    return (NULL);
                 }
 
 
                 lf->decoder_info = nnode;
 
-                for (i = 0; nnode->pcre2->sub_strings[i]; i++) {
-                    if (i >= Config.decoder_order_size) {
+                for (i = 0; i < ctx->nspans; i++) {
+                    if (i >= (size_t)Config.decoder_order_size) {
                         ErrorExit("%s: ERROR: Regex has too many groups.", ARGV0);
                     }
 
-                    if (nnode->order[i])
-                        nnode->order[i](lf, nnode->pcre2->sub_strings[i], i);
-                    else
-                        /* We do not free any memory used above */
-                        os_free(nnode->pcre2->sub_strings[i]);
-
-                    nnode->pcre2->sub_strings[i] = NULL;
+                    if (nnode->order[i]) {
+                        nnode->order[i](lf, decode_span(lf, llog, &ctx->spans[i]), (int)i);
+                    }
                 }
 
                 /* If we have a next regex, try getting it */
@@ -291,18 +320,20 @@ void DecodeEvent(Eventinfo *lf)
 
 
             /* If we don't have a regex, we may leave now */
-            return;
+            return (NULL);
         }
 
         /* ok to return  */
-        return;
-    } while ((node = node->next) != NULL);
+        return (NULL);
+    }
 
 #ifdef TESTRULE
     if (!alert_only) {
         print_out("       No decoder matched.");
     }
 #endif
+
+    return (NULL);
 }
 
 /*** Event decoders ****/
@@ -515,9 +546,9 @@ void *DynamicField_FP(Eventinfo *lf, char *field, int order)
     return (NULL);
 }
 
-void *None_FP(__attribute__((unused)) Eventinfo *lf, char *field, __attribute__((unused)) int order)
+void *None_FP(Eventinfo *lf, char *field, __attribute__((unused)) int order)
 {
-    free(field);
+    Free_EventinfoStr(lf, field);
     return (NULL);
 }
 
@@ -47,6 +47,7 @@ typedef struct {
     OSPcre2 *pcre2;
     OSPcre2 *prematch_pcre2;
     OSPcre2 *program_name_pcre2;
+    char *program_name_str;     /* Pattern of the program name, as written */
 
     void (*plugindecoder)(void *lf);
     void* (**order)(struct _Eventinfo *, char *, int);
@@ -59,13 +60,40 @@ typedef struct _OSDecoderNode {
     OSDecoderInfo *osdecoder;
 } OSDecoderNode;
 
+/* Most decoders that can be tried for an event at once (with the
+ * index by program name)
+ */
+#define OS_DECODER_CANDIDATES   64
+
+/* Position in the decoders that can match an event */
+typedef struct _OSDecoderCandidates {
+    OSDecoderNode *node;    /* Next decoder of the list (not indexed) */
+    int pos[OS_DECODER_CANDIDATES];
+    int size;
+    int next;
+} OSDecoderCandidates;
+
 /* Functions to Create the list, add a osdecoder to the
  * list and to get the first osdecoder
  */
 void OS_CreateOSDecoderList(void);
 int OS_AddOSDecoder(OSDecoderInfo *pi);
 OSDecoderNode *OS_GetFirstOSDecoder(const char *pname);
+
+/* Index the decoders with a program name by the literal prefix of
+ * their pattern (after all the decoders are loaded)
+ */
+void OS_IndexOSDecoders(void);
+
+/* Iterate over the decoders of a list that can match the program
+ * name of an event, in order. Without the index, every decoder of
+ * the list is returned.
+ */
+OSDecoderNode *OS_FirstOSDecoderCandidate(OSDecoderNode *list, const char *pname,
+                                          OSDecoderCandidates *it);
+OSDecoderNode *OS_NextOSDecoderCandidate(OSDecoderCandidates *it);
 int getDecoderfromlist(const char *name);
+OSDecoderInfo *DecodeEvent_r(struct _Eventinfo *lf, OSRegexCtx *ctx);
 char *GetGeoInfobyIP(char *ip_addr);
 int SetDecodeXML(void);
 void HostinfoInit(void);
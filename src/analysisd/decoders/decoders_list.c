@@ -15,6 +15,23 @@
 #include "decoder.h"
 #include "error_messages/error_messages.h"
 
+/* Longest program name prefix indexed */
+#define OS_DECODER_KEY_MAX  64
+
+/* Decoders of the list with program name, indexed by the literal
+ * prefix their pattern requires (as ^sshd, ^su$ or ^ftpd|^in\.ftpd),
+ * in lower case. The decoders with other patterns are tried for every
+ * event. The program name is still checked with the pattern of each
+ * decoder returned.
+ */
+typedef struct _OSDecoderIndex {
+    OSDecoderNode **nodes;      /* Decoders of the list, in order */
+    int size;
+    OSHash *prefixes;           /* Positions of the decoders, by prefix (-1 ends) */
+    int *fallback;              /* Positions of the decoders not indexed (-1 ends) */
+    char lengths[OS_DECODER_KEY_MAX + 1];   /* Lengths of the prefixes */
+} OSDecoderIndex;
+
 /* We have two internal lists. One with the program_name
  * and one without. This is going to improve greatly the
  * performance of our decoder matching.
@@ -22,7 +39,11 @@
 static OSDecoderNode *osdecodernode_forpname;
 static OSDecoderNode *osdecodernode_nopname;
 
+static OSDecoderIndex *osdecoder_index = NULL;
+
 static OSDecoderNode *_OS_AddOSDecoder(OSDecoderNode *s_node, OSDecoderInfo *pi);
+static char **_OS_PnamePrefixes(const OSDecoderInfo *pi);
+static void _OS_AddPosition(int **list, int pos);
 
 /* Create the Event List */
 void OS_CreateOSDecoderList()
@@ -205,3 +226,281 @@ int OS_AddOSDecoder(OSDecoderInfo *pi)
     return (1);
 }
 
+
+/* Literal prefixes (in lower case) of the program name pattern of a
+ * decoder: one per alternative, each anchored with ^ and only literal
+ * ASCII characters after it (with an optional $ at the end).
+ * Returns NULL if the pattern has any other form.
+ */
+static char **_OS_PnamePrefixes(const OSDecoderInfo *pi)
+{
+    const char *p;
+    char **prefixes = NULL;
+    char key[OS_DECODER_KEY_MAX + 1];
+    size_t n = 0;
+    size_t len;
+    int pcre2;
+
+    if (!pi->program_name_str) {
+        return (NULL);
+    }
+
+    p = pi->program_name_str;
+    pcre2 = pi->program_name_pcre2 ? 1 : 0;
+
+    while (1) {
+        if (*p != '^') {
+            goto fail;
+        }
+        p++;
+
+        for (len = 0; *p && *p != '|' && *p != '$'; p++) {
+            char c = *p;
+
+            if (c & 0x80) {
+                goto fail;
+            }
+
+            if (pcre2) {
+                if (c == '\\') {
+                    /* Only escaped punctuation is literal */
+                    c = *++p;
+                    if (!c || (c & 0x80) || isalnum((unsigned char)c)) {
+                        goto fail;
+                    }
+                } else if (strchr("^.?*+()[]{}", c)) {
+                    goto fail;
+                }
+            } else if (c == '^' || c == '\\') {
+                goto fail;
+            }
+
+            if (len >= OS_DECODER_KEY_MAX) {
+                goto fail;
+            }
+            key[len++] = (char)tolower((unsigned char)c);
+        }
+
+        if (*p == '$') {
+            p++;
+        }
+
+        if (len == 0 || (*p && *p != '|')) {
+            goto fail;
+        }
+
+        key[len] = '\0';
+        os_realloc(prefixes, (n + 2) * sizeof(char *), prefixes);
+        os_strdup(key, prefixes[n]);
+        prefixes[++n] = NULL;
+
+        if (*p == '\0') {
+            break;
+        }
+        p++;
+    }
+
+    return (prefixes);
+
+fail:
+    if (prefixes) {
+        for (n = 0; prefixes[n]; n++) {
+            free(prefixes[n]);
+        }
+        free(prefixes);
+    }
+    return (NULL);
+}
+
+/* Add a position to a list ended by -1 */
+static void _OS_AddPosition(int **list, int pos)
+{
+    int n = 0;
+
+    if (*list) {
+        while ((*list)[n] != -1) {
+            n++;
+        }
+
+        /* Two alternatives with the same prefix */
+        if (n > 0 && (*list)[n - 1] == pos) {
+            return;
+        }
+    }
+
+    os_realloc(*list, (size_t)(n + 2) * sizeof(int), *list);
+    (*list)[n] = pos;
+    (*list)[n + 1] = -1;
+}
+
+void OS_IndexOSDecoders()
+{
+    OSDecoderIndex *index;
+    OSDecoderNode *node;
+    int indexed = 0;
+    int i;
+
+    os_calloc(1, sizeof(OSDecoderIndex), index);
+
+    for (node = osdecodernode_forpname; node; node = node->next) {
+        index->size++;
+    }
+
+    if (index->size == 0) {
+        free(index);
+        return;
+    }
+
+    os_calloc((size_t)index->size, sizeof(OSDecoderNode *), index->nodes);
+
+    index->prefixes = OSHash_Create();
+    if (!index->prefixes) {
+        ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+    }
+
+    for (node = osdecodernode_forpname, i = 0; node; node = node->next, i++) {
+        char **prefixes;
+        char **prefix;
+
+        index->nodes[i] = node;
+
+        prefixes = _OS_PnamePrefixes(node->osdecoder);
+        if (!prefixes) {
+            _OS_AddPosition(&index->fallback, i);
+            continue;
+        }
+
+        for (prefix = prefixes; *prefix; prefix++) {
+            int *list = (int *)OSHash_Get(index->prefixes, *prefix);
+
+            if (!list) {
+                _OS_AddPosition(&list, i);
+                if (OSHash_Add(index->prefixes, *prefix, list) != 2) {
+                    ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+                }
+            } else {
+                _OS_AddPosition(&list, i);
+                OSHash_Update(index->prefixes, *prefix, list);
+            }
+
+            index->lengths[strlen(*prefix)] = 1;
+            free(*prefix);
+        }
+
+        free(prefixes);
+        indexed++;
+    }
+
+    debug1("%s: DEBUG: Decoders indexed by program name: %d of %d.",
+           ARGV0, indexed, index->size);
+
+    osdecoder_index = index;
+}
+
+/* Add the positions of a list ended by -1 to the candidates.
+ * Returns -1 if there are too many.
+ */
+static int _OS_AddCandidates(OSDecoderCandidates *it, const int *list)
+{
+    for (; *list != -1; list++) {
+        if (it->size >= OS_DECODER_CANDIDATES) {
+            return (-1);
+        }
+        it->pos[it->size++] = *list;
+    }
+
+    return (0);
+}
+
+OSDecoderNode *OS_FirstOSDecoderCandidate(OSDecoderNode *list, const char *pname,
+                                          OSDecoderCandidates *it)
+{
+    char key[OS_DECODER_KEY_MAX + 1];
+    size_t len;
+    size_t i;
+    int j;
+
+    it->node = list;
+    it->size = -1;
+    it->next = 0;
+
+    /* The index is only for the list with program name */
+    if (!osdecoder_index || !pname || list != osdecodernode_forpname) {
+        return (OS_NextOSDecoderCandidate(it));
+    }
+
+    /* Lower case prefix of the program name. With other characters,
+     * caseless matching may be different: try every decoder.
+     */
+    for (len = 0; pname[len] && len < OS_DECODER_KEY_MAX; len++) {
+        if (pname[len] & 0x80) {
+            return (OS_NextOSDecoderCandidate(it));
+        }
+        key[len] = (char)tolower((unsigned char)pname[len]);
+    }
+
+    it->size = 0;
+
+    if (osdecoder_index->fallback &&
+            _OS_AddCandidates(it, osdecoder_index->fallback) < 0) {
+        it->size = -1;
+        return (OS_NextOSDecoderCandidate(it));
+    }
+
+    for (i = 1; i <= len; i++) {
+        const int *positions;
+
+        if (!osdecoder_index->lengths[i]) {
+            continue;
+        }
+
+        key[i] = '\0';
+        positions = (const int *)OSHash_Get(osdecoder_index->prefixes, key);
+        if (i < len) {
+            key[i] = (char)tolower((unsigned char)pname[i]);
+        }
+
+        if (positions && _OS_AddCandidates(it, positions) < 0) {
+            it->size = -1;
+            return (OS_NextOSDecoderCandidate(it));
+        }
+    }
+
+    /* Back to the order of the list */
+    for (i = 1; i < (size_t)it->size; i++) {
+        int pos = it->pos[i];
+
+        for (j = (int)i - 1; j >= 0 && it->pos[j] > pos; j--) {
+            it->pos[j + 1] = it->pos[j];
+        }
+        it->pos[j + 1] = pos;
+    }
+
+    return (OS_NextOSDecoderCandidate(it));
+}
+
+OSDecoderNode *OS_NextOSDecoderCandidate(OSDecoderCandidates *it)
+{
+    OSDecoderNode *node;
+
+    /* Not indexed: every decoder of the list */
+    if (it->size < 0) {
+        node = it->node;
+        if (node) {
+            it->node = node->next;
+        }
+        return (node);
+    }
+
+    /* Skip the decoders found by more than one prefix */
+    while (it->next < it->size && it->next > 0 &&
+            it->pos[it->next] == it->pos[it->next - 1]) {
+        it->next++;
+    }
+
+    if (it->next >= it->size) {
+        return (NULL);
+    }
+
+    return (osdecoder_index->nodes[it->pos[it->next++]]);
+}
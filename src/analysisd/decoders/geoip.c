@@ -24,6 +24,11 @@
 #include "GeoIP.h"
 #include "GeoIPCity.h"
 
+#include <pthread.h>
+
+/* The GeoIP handle is shared by the decoding threads */
+static pthread_mutex_t geoip_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 char *GetGeoInfobyIP(char *ip_addr)
 {
@@ -41,7 +46,9 @@ char *GetGeoInfobyIP(char *ip_addr)
         return(NULL);
     }
 
+    pthread_mutex_lock(&geoip_mutex);
     geoiprecord = GeoIP_record_by_name(geoipdb, (const char *)ip_addr);
+    pthread_mutex_unlock(&geoip_mutex);
     if(geoiprecord == NULL)
     {
         return(NULL);
@@ -123,7 +123,7 @@ void *OSSECAlert_Decoder_Exec(Eventinfo *lf)
              AGENTINFO_DIR, lf->hostname, lf->location);
 
     snprintf(oa_newlocation, 255, "%s|%s", lf->location, oa_location);
-    free(lf->location);
+    Free_EventinfoStr(lf, lf->location);
     os_strdup(oa_newlocation, lf->location);
     lf->hostname = lf->location;
 
@@ -181,7 +181,7 @@ void *OSSECAlert_Decoder_Exec(Eventinfo *lf)
     tmpstr_buffer[4095] = '\0';
     strncpy(tmpstr_buffer, tmp_str, 4094);
 
-    free(lf->full_log);
+    Free_EventinfoStr(lf, lf->full_log);
     lf->full_log = NULL;
     os_strdup(tmpstr_buffer, lf->full_log);
     lf->log = lf->full_log;
@@ -22,8 +22,8 @@
 /* Regex for the web proxy messages */
 #define SONICWALL_PROXY "result=(\\d+) dstname=(\\S+) arg=(\\S+)$"
 
-/* Global variables -- not thread safe. If we ever multi thread
- * analysisd, these will need to be changed.
+/* Global variables -- not thread safe. Plugin decoders are only
+ * executed from the analysisd main thread (see DecodeEvent_r).
  */
 static OSRegex *__sonic_regex_prid = NULL;
 static OSRegex *__sonic_regex_sdip = NULL;
@@ -224,7 +224,7 @@ void *SonicWall_Decoder_Exec(Eventinfo *lf)
 
         /* Get HTTP responde code as id */
         if (__sonic_regex_prox->sub_strings[0]) {
-            free(lf->id);
+            Free_EventinfoStr(lf, lf->id);
             lf->id = __sonic_regex_prox->sub_strings[0];
             __sonic_regex_prox->sub_strings[0] = NULL;
         } else {
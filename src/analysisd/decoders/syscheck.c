@@ -33,6 +33,7 @@ typedef struct __sdb {
     char agent_cp[MAX_AGENTS + 1][1];
     char *agent_ips[MAX_AGENTS + 1];
     FILE *agent_fps[MAX_AGENTS + 1];
+    sk_idx *agent_idx[MAX_AGENTS + 1];
 
     int db_err;
 
@@ -46,9 +47,6 @@ typedef struct __sdb {
     /* Syscheck rule */
     OSDecoderInfo  *syscheck_dec;
 
-    /* File search variables */
-    fpos_t init_pos;
-
 } _sdb; /* syscheck db information */
 
 /* Local variables */
@@ -96,6 +94,7 @@ void SyscheckInit()
     for (; i <= MAX_AGENTS; i++) {
         sdb.agent_ips[i] = NULL;
         sdb.agent_fps[i] = NULL;
+        sdb.agent_idx[i] = NULL;
         sdb.agent_cp[i][0] = '0';
     }
 
@@ -184,7 +183,9 @@ static void DB_SetCompleted(const Eventinfo *lf)
 }
 
 
-/* Return the file pointer to be used to verify the integrity */
+/* Return the file pointer to be used to verify the integrity.
+ * The index of the file is opened along with it.
+ */
 static FILE *DB_File(const char *agent, int *agent_id)
 {
     int i = 0;
@@ -192,8 +193,6 @@ static FILE *DB_File(const char *agent, int *agent_id)
     /* Find file pointer */
     while (sdb.agent_ips[i] != NULL  &&  i < MAX_AGENTS) {
         if (strcmp(sdb.agent_ips[i], agent) == 0) {
-            /* Point to the beginning of the file */
-            fseek(sdb.agent_fps[i], 0, SEEK_SET);
             *agent_id = i;
             return (sdb.agent_fps[i]);
         }
@@ -232,8 +231,18 @@ static FILE *DB_File(const char *agent, int *agent_id)
         return (NULL);
     }
 
-    /* Return the opened pointer (the beginning of it) */
-    fseek(sdb.agent_fps[i], 0, SEEK_SET);
+    /* Open the index, importing the file if needed */
+    sdb.agent_idx[i] = sk_idx_open(sdb.buf);
+    if (!sdb.agent_idx[i]) {
+        merror("%s: Unable to open the index of '%s'", ARGV0, sdb.buf);
+
+        fclose(sdb.agent_fps[i]);
+        sdb.agent_fps[i] = NULL;
+        free(sdb.agent_ips[i]);
+        sdb.agent_ips[i] = NULL;
+        return (NULL);
+    }
+
     *agent_id = i;
 
     /* Check if the agent was completed */
@@ -248,13 +257,16 @@ static FILE *DB_File(const char *agent, int *agent_id)
 static int DB_Search(const char *f_name, const char *c_sum, Eventinfo *lf)
 {
     int p = 0;
-    size_t sn_size;
     int agent_id;
+    long log_pos;
+    long saved_pos;
+    char saved_marks[4];
 
     char *saved_sum;
-    char *saved_name;
 
     FILE *fp;
+    sk_idx *idx;
+    sk_idx_entry *entry;
 
     /* Expose filename variable for active response */
     os_strdup(f_name, lf->filename);
@@ -269,357 +281,331 @@ static int DB_Search(const char *f_name, const char *c_sum, Eventinfo *lf)
         lf->data = NULL;
         return (0);
     }
+    idx = sdb.agent_idx[agent_id];
 
-    /* Read the integrity file and search for a possible entry */
-    if (fgetpos(fp, &sdb.init_pos) == -1) {
-        merror("%s: Error handling integrity database (fgetpos).", ARGV0);
+    /* The index is rebuilt if the file changed behind our back */
+    if (fseek(fp, 0, SEEK_END) != 0 || (log_pos = ftell(fp)) < 0 ||
+            sk_idx_check(idx, (uint64_t)log_pos) < 0) {
+        merror("%s: Error handling integrity database (index).", ARGV0);
+        sdb.db_err++;
+        lf->data = NULL;
         return (0);
     }
 
-    /* Loop over the file */
-    while (fgets(sdb.buf, OS_MAXSTR, fp) != NULL) {
-        /* Ignore blank lines and lines with a comment */
-        if (sdb.buf[0] == '\n' || sdb.buf[0] == '#') {
-            fgetpos(fp, &sdb.init_pos); /* Get next location */
-            continue;
-        }
+    /* Search for a possible entry */
+    entry = sk_idx_get(idx, f_name);
+    if (entry == NULL) {
+        /* If we reach here, this file is not present in our database */
+        fprintf(fp, "+++%s !%ld %s\n", c_sum, (long int)lf->time, f_name);
+        fflush(fp);
 
-        /* Get name */
-        saved_name = strchr(sdb.buf, ' ');
-        if (saved_name == NULL) {
-            merror("%s: Invalid integrity message in the database.", ARGV0);
-            fgetpos(fp, &sdb.init_pos); /* Get next location */
-            continue;
-        }
-        *saved_name = '\0';
-        saved_name++;
-
-        /* New format - with a timestamp */
-        if (*saved_name == '!') {
-            saved_name = strchr(saved_name, ' ');
-            if (saved_name == NULL) {
-                merror("%s: Invalid integrity message in the database", ARGV0);
-                fgetpos(fp, &sdb.init_pos); /* Get next location */
-                continue;
-            }
-            saved_name++;
+        if (sk_idx_put(idx, f_name, "+++", c_sum, lf->time, (uint64_t)log_pos) < 0) {
+            merror("%s: Error handling integrity database (index).", ARGV0);
         }
+        sk_idx_sync(idx, (uint64_t)ftell(fp));
 
-        /* Remove newline from saved_name */
-        sn_size = strlen(saved_name);
-        sn_size -= 1;
-        if (saved_name[sn_size] == '\n') {
-            saved_name[sn_size] = '\0';
-        }
+        /* Alert if configured to notify on new files */
+        /* TODO: debugging this - Scott */
+        /* if ((Config.syscheck_alert_new == 1) && (DB_IsCompleted(agent_id))) { */
+        if (Config.syscheck_alert_new == 1)  {
+            sdb.syscheck_dec->id = sdb.idn;
 
-        /* If name is different, go to next one */
-        if (strcmp(f_name, saved_name) != 0) {
-            /* Save current location */
-            fgetpos(fp, &sdb.init_pos);
-            continue;
-        }
+            /* New file message */
+            snprintf(sdb.comment, OS_MAXSTR,
+                     "New file '%.756s' "
+                     "added to the file system.", f_name);
 
-        saved_sum = sdb.buf;
 
-        /* First three bytes are for frequency check */
-        saved_sum += 3;
+            /* Create a new log message */
+            Free_EventinfoStr(lf, lf->full_log);
+            os_strdup(sdb.comment, lf->full_log);
+            lf->log = lf->full_log;
 
-        /* Checksum match, we can just return and keep going */
-        if (strcmp(saved_sum, c_sum) == 0) {
+            /* Set decoder */
+            lf->decoder_info = sdb.syscheck_dec;
             lf->data = NULL;
-            return (0);
+
+            return (1);
         }
 
+        lf->data = NULL;
+        return (0);
+    }
 
+    /* Checksum match, we can just return and keep going */
+    if (strcmp(sk_idx_sum(entry), c_sum) == 0) {
+        lf->data = NULL;
+        return (0);
+    }
 
+    /* Keep a copy of the old values, as the entry is about to change */
+    strncpy(sdb.buf, sk_idx_sum(entry), OS_MAXSTR);
+    saved_sum = sdb.buf;
+    memcpy(saved_marks, entry->marks, sizeof(saved_marks));
+    saved_pos = (long)entry->log_pos;
 
-        /* If we reached here, the checksum of the file has changed */
-        if (saved_sum[-3] == '!') {
+    /* If we reached here, the checksum of the file has changed */
+    if (saved_marks[0] == '!') {
+        p++;
+        if (saved_marks[1] == '!') {
             p++;
-            if (saved_sum[-2] == '!') {
+            if (saved_marks[2] == '!') {
                 p++;
-                if (saved_sum[-1] == '!') {
-                    p++;
-                } else if (saved_sum[-1] == '?') {
-                    p += 2;
-                }
+            } else if (saved_marks[2] == '?') {
+                p += 2;
             }
         }
+    }
 
-        /* Check the number of changes */
-        if (!Config.syscheck_auto_ignore) {
-            sdb.syscheck_dec->id = sdb.id1;
-        } else {
-            switch (p) {
-                case 0:
-                    sdb.syscheck_dec->id = sdb.id1;
-                    break;
-
-                case 1:
-                    sdb.syscheck_dec->id = sdb.id2;
-                    break;
-
-                case 2:
-                    sdb.syscheck_dec->id = sdb.id3;
-                    break;
-
-                default:
-                    lf->data = NULL;
-                    return (0);
-                    break;
-            }
-        }
+    /* Check the number of changes */
+    if (!Config.syscheck_auto_ignore) {
+        sdb.syscheck_dec->id = sdb.id1;
+    } else {
+        switch (p) {
+            case 0:
+                sdb.syscheck_dec->id = sdb.id1;
+                break;
 
-        /* Add new checksum to the database */
-        /* Commenting the file entry and adding a new one later */
-        if (fsetpos(fp, &sdb.init_pos)) {
-            merror("%s: Error handling integrity database (fsetpos).", ARGV0);
-            return (0);
-        }
-        fputc('#', fp);
-
-        /* Add the new entry at the end of the file */
-        fseek(fp, 0, SEEK_END);
-        fprintf(fp, "%c%c%c%s !%ld %s\n",
-                '!',
-                p >= 1 ? '!' : '+',
-                p == 2 ? '!' : (p > 2) ? '?' : '+',
-                c_sum,
-                (long int)lf->time,
-                f_name);
-        fflush(fp);
+            case 1:
+                sdb.syscheck_dec->id = sdb.id2;
+                break;
 
-        /* File deleted */
-        if (c_sum[0] == '-' && c_sum[1] == '1') {
-            sdb.syscheck_dec->id = sdb.idd;
-            snprintf(sdb.comment, OS_MAXSTR,
-                     "File '%.756s' was deleted. Unable to retrieve "
-                     "checksum.", f_name);
-        }
+            case 2:
+                sdb.syscheck_dec->id = sdb.id3;
+                break;
 
-        /* If file was re-added, do not compare changes */
-        else if (saved_sum[0] == '-' && saved_sum[1] == '1') {
-            sdb.syscheck_dec->id = sdb.idn;
-            snprintf(sdb.comment, OS_MAXSTR,
-                     "File '%.756s' was re-added.", f_name);
+            default:
+                lf->data = NULL;
+                return (0);
+                break;
         }
+    }
+
+    /* Add new checksum to the database */
+    /* Commenting the file entry and adding a new one later */
+    if (fseek(fp, saved_pos, SEEK_SET)) {
+        merror("%s: Error handling integrity database (fseek).", ARGV0);
+        return (0);
+    }
+    fputc('#', fp);
+
+    /* Add the new entry at the end of the file */
+    saved_marks[0] = '!';
+    saved_marks[1] = p >= 1 ? '!' : '+';
+    saved_marks[2] = p == 2 ? '!' : (p > 2) ? '?' : '+';
+    saved_marks[3] = '\0';
+
+    fseek(fp, 0, SEEK_END);
+    log_pos = ftell(fp);
+    fprintf(fp, "%s%s !%ld %s\n",
+            saved_marks,
+            c_sum,
+            (long int)lf->time,
+            f_name);
+    fflush(fp);
 
-        else {
-            int oldperm = 0, newperm = 0;
-
-            /* Provide more info about the file change */
-            const char *oldsize = NULL, *newsize = NULL;
-            char *olduid = NULL, *newuid = NULL;
-            char *c_oldperm = NULL, *c_newperm = NULL;
-            char *oldgid = NULL, *newgid = NULL;
-            char *oldmd5 = NULL, *newmd5 = NULL;
-            char *oldsha1 = NULL, *newsha1 = NULL;
-
-            oldsize = saved_sum;
-            newsize = c_sum;
-
-            c_oldperm = strchr(saved_sum, ':');
-            c_newperm = strchr(c_sum, ':');
-
-            /* Get old/new permissions */
-            if (c_oldperm && c_newperm) {
-                *c_oldperm = '\0';
-                c_oldperm++;
-
-                *c_newperm = '\0';
-                c_newperm++;
-
-                /* Get old/new uid/gid */
-                olduid = strchr(c_oldperm, ':');
-                newuid = strchr(c_newperm, ':');
-
-                if (olduid && newuid) {
-                    *olduid = '\0';
-                    *newuid = '\0';
-                    olduid++;
-                    newuid++;
-
-                    oldgid = strchr(olduid, ':');
-                    newgid = strchr(newuid, ':');
-
-                    if (oldgid && newgid) {
-                        *oldgid = '\0';
-                        *newgid = '\0';
-                        oldgid++;
-                        newgid++;
-
-                        /* Get MD5 */
-                        oldmd5 = strchr(oldgid, ':');
-                        newmd5 = strchr(newgid, ':');
-
-                        if (oldmd5 && newmd5) {
-                            *oldmd5 = '\0';
-                            *newmd5 = '\0';
-                            oldmd5++;
-                            newmd5++;
-
-                            /* Get SHA-1 */
-                            oldsha1 = strchr(oldmd5, ':');
-                            newsha1 = strchr(newmd5, ':');
-
-                            if (oldsha1 && newsha1) {
-                                *oldsha1 = '\0';
-                                *newsha1 = '\0';
-                                oldsha1++;
-                                newsha1++;
-                            }
+    if (sk_idx_put(idx, f_name, saved_marks, c_sum, lf->time, (uint64_t)log_pos) < 0) {
+        merror("%s: Error handling integrity database (index).", ARGV0);
+    }
+    sk_idx_sync(idx, (uint64_t)ftell(fp));
+
+    /* File deleted */
+    if (c_sum[0] == '-' && c_sum[1] == '1') {
+        sdb.syscheck_dec->id = sdb.idd;
+        snprintf(sdb.comment, OS_MAXSTR,
+                 "File '%.756s' was deleted. Unable to retrieve "
+                 "checksum.", f_name);
+    }
+
+    /* If file was re-added, do not compare changes */
+    else if (saved_sum[0] == '-' && saved_sum[1] == '1') {
+        sdb.syscheck_dec->id = sdb.idn;
+        snprintf(sdb.comment, OS_MAXSTR,
+                 "File '%.756s' was re-added.", f_name);
+    }
+
+    else {
+        int oldperm = 0, newperm = 0;
+
+        /* Provide more info about the file change */
+        const char *oldsize = NULL, *newsize = NULL;
+        char *olduid = NULL, *newuid = NULL;
+        char *c_oldperm = NULL, *c_newperm = NULL;
+        char *oldgid = NULL, *newgid = NULL;
+        char *oldmd5 = NULL, *newmd5 = NULL;
+        char *oldsha1 = NULL, *newsha1 = NULL;
+
+        oldsize = saved_sum;
+        newsize = c_sum;
+
+        c_oldperm = strchr(saved_sum, ':');
+        c_newperm = strchr(c_sum, ':');
+
+        /* Get old/new permissions */
+        if (c_oldperm && c_newperm) {
+            *c_oldperm = '\0';
+            c_oldperm++;
+
+            *c_newperm = '\0';
+            c_newperm++;
+
+            /* Get old/new uid/gid */
+            olduid = strchr(c_oldperm, ':');
+            newuid = strchr(c_newperm, ':');
+
+            if (olduid && newuid) {
+                *olduid = '\0';
+                *newuid = '\0';
+                olduid++;
+                newuid++;
+
+                oldgid = strchr(olduid, ':');
+                newgid = strchr(newuid, ':');
+
+                if (oldgid && newgid) {
+                    *oldgid = '\0';
+                    *newgid = '\0';
+                    oldgid++;
+                    newgid++;
+
+                    /* Get MD5 */
+                    oldmd5 = strchr(oldgid, ':');
+                    newmd5 = strchr(newgid, ':');
+
+                    if (oldmd5 && newmd5) {
+                        *oldmd5 = '\0';
+                        *newmd5 = '\0';
+                        oldmd5++;
+                        newmd5++;
+
+                        /* Get SHA-1 */
+                        oldsha1 = strchr(oldmd5, ':');
+                        newsha1 = strchr(newmd5, ':');
+
+                        if (oldsha1 && newsha1) {
+                            *oldsha1 = '\0';
+                            *newsha1 = '\0';
+                            oldsha1++;
+                            newsha1++;
                         }
                     }
                 }
             }
+        }
 
-            /* Get integer values */
-            if (c_newperm && c_oldperm) {
-                newperm = atoi(c_newperm);
-                oldperm = atoi(c_oldperm);
-            }
+        /* Get integer values */
+        if (c_newperm && c_oldperm) {
+            newperm = atoi(c_newperm);
+            oldperm = atoi(c_oldperm);
+        }
 
-            /* Generate size message */
-            if (!oldsize || !newsize || strcmp(oldsize, newsize) == 0) {
-                sdb.size[0] = '\0';
-            } else {
-                snprintf(sdb.size, OS_FLSIZE,
-                         "Size changed from '%s' to '%s'\n",
-                         oldsize, newsize);
+        /* Generate size message */
+        if (!oldsize || !newsize || strcmp(oldsize, newsize) == 0) {
+            sdb.size[0] = '\0';
+        } else {
+            snprintf(sdb.size, OS_FLSIZE,
+                     "Size changed from '%.100s' to '%.100s'\n",
+                     oldsize, newsize);
 
-                os_strdup(oldsize, lf->size_before);
-                os_strdup(newsize, lf->size_after);
-            }
+            os_strdup(oldsize, lf->size_before);
+            os_strdup(newsize, lf->size_after);
+        }
 
-            /* Permission message */
-            if (oldperm == newperm) {
-                sdb.perm[0] = '\0';
-            } else if (oldperm > 0 && newperm > 0) {
+        /* Permission message */
+        if (oldperm == newperm) {
+            sdb.perm[0] = '\0';
+        } else if (oldperm > 0 && newperm > 0) {
 		char opstr[10];
 		char npstr[10];
 
 		strncpy(opstr, agent_file_perm(c_oldperm), sizeof(opstr) - 1);
 		strncpy(npstr, agent_file_perm(c_newperm), sizeof(npstr) - 1);
 
-                snprintf(sdb.perm, OS_FLSIZE, "Permissions changed from "
-                         "'%9.9s' to '%9.9s'\n", opstr, npstr);
-
-                lf->perm_before = oldperm;
-                lf->perm_after = newperm;
-            }
-
-            /* Ownership message */
-            if (!newuid || !olduid || strcmp(newuid, olduid) == 0) {
-                sdb.owner[0] = '\0';
-            } else {
-                snprintf(sdb.owner, OS_FLSIZE, "Ownership was '%s', "
-                         "now it is '%s'\n",
-                         olduid, newuid);
-
-
-                os_strdup(olduid, lf->owner_before);
-                os_strdup(newuid, lf->owner_after);
-            }
-
-            /* Group ownership message */
-            if (!newgid || !oldgid || strcmp(newgid, oldgid) == 0) {
-                sdb.gowner[0] = '\0';
-            } else {
-                snprintf(sdb.gowner, OS_FLSIZE, "Group ownership was '%s', "
-                         "now it is '%s'\n",
-                         oldgid, newgid);
-                os_strdup(oldgid, lf->gowner_before);
-                os_strdup(newgid, lf->gowner_after);
-            }
-
-            /* MD5 message */
-            if (!newmd5 || !oldmd5 || strcmp(newmd5, oldmd5) == 0) {
-                sdb.md5[0] = '\0';
-            } else {
-                snprintf(sdb.md5, OS_FLSIZE, "Old md5sum was: '%s'\n"
-                         "New md5sum is : '%s'\n",
-                         oldmd5, newmd5);
-                os_strdup(oldmd5, lf->md5_before);
-                os_strdup(newmd5, lf->md5_after);
-            }
-
-            /* SHA-1 message */
-            if (!newsha1 || !oldsha1 || strcmp(newsha1, oldsha1) == 0) {
-                sdb.sha1[0] = '\0';
-            } else {
-                snprintf(sdb.sha1, OS_FLSIZE, "Old sha1sum was: '%s'\n"
-                         "New sha1sum is : '%s'\n",
-                         oldsha1, newsha1);
-                os_strdup(oldsha1, lf->sha1_before);
-                os_strdup(newsha1, lf->sha1_after);
-            }
+            snprintf(sdb.perm, OS_FLSIZE, "Permissions changed from "
+                     "'%9.9s' to '%9.9s'\n", opstr, npstr);
 
-            /* Provide information about the file */
-            snprintf(sdb.comment, OS_MAXSTR, "Integrity checksum changed for: "
-                     "'%.756s'\n"
-                     "%s"
-                     "%s"
-                     "%s"
-                     "%s"
-                     "%s"
-                     "%s"
-                     "%s%s",
-                     f_name,
-                     sdb.size,
-                     sdb.perm,
-                     sdb.owner,
-                     sdb.gowner,
-                     sdb.md5,
-                     sdb.sha1,
-                     lf->data == NULL ? "" : "What changed:\n",
-                     lf->data == NULL ? "" : lf->data
-                    );
+            lf->perm_before = oldperm;
+            lf->perm_after = newperm;
         }
 
-        /* Create a new log message */
-        free(lf->full_log);
-        os_strdup(sdb.comment, lf->full_log);
-        lf->log = lf->full_log;
-        lf->data = NULL;
-
-        /* Set decoder */
-        lf->decoder_info = sdb.syscheck_dec;
-
-        return (1);
-
-    } /* Continue */
-
-    /* If we reach here, this file is not present in our database */
-    fseek(fp, 0, SEEK_END);
-    fprintf(fp, "+++%s !%ld %s\n", c_sum, (long int)lf->time, f_name);
-    fflush(fp);
+        /* Ownership message */
+        if (!newuid || !olduid || strcmp(newuid, olduid) == 0) {
+            sdb.owner[0] = '\0';
+        } else {
+            snprintf(sdb.owner, OS_FLSIZE, "Ownership was '%s', "
+                     "now it is '%s'\n",
+                     olduid, newuid);
 
-    /* Alert if configured to notify on new files */
-    /* TODO: debugging this - Scott */
-    /* if ((Config.syscheck_alert_new == 1) && (DB_IsCompleted(agent_id))) { */
-    if (Config.syscheck_alert_new == 1)  {
-        sdb.syscheck_dec->id = sdb.idn;
 
-        /* New file message */
-        snprintf(sdb.comment, OS_MAXSTR,
-                 "New file '%.756s' "
-                 "added to the file system.", f_name);
+            os_strdup(olduid, lf->owner_before);
+            os_strdup(newuid, lf->owner_after);
+        }
 
+        /* Group ownership message */
+        if (!newgid || !oldgid || strcmp(newgid, oldgid) == 0) {
+            sdb.gowner[0] = '\0';
+        } else {
+            snprintf(sdb.gowner, OS_FLSIZE, "Group ownership was '%s', "
+                     "now it is '%s'\n",
+                     oldgid, newgid);
+            os_strdup(oldgid, lf->gowner_before);
+            os_strdup(newgid, lf->gowner_after);
+        }
 
-        /* Create a new log message */
-        free(lf->full_log);
-        os_strdup(sdb.comment, lf->full_log);
-        lf->log = lf->full_log;
+        /* MD5 message */
+        if (!newmd5 || !oldmd5 || strcmp(newmd5, oldmd5) == 0) {
+            sdb.md5[0] = '\0';
+        } else {
+            snprintf(sdb.md5, OS_FLSIZE, "Old md5sum was: '%s'\n"
+                     "New md5sum is : '%s'\n",
+                     oldmd5, newmd5);
+            os_strdup(oldmd5, lf->md5_before);
+            os_strdup(newmd5, lf->md5_after);
+        }
 
-        /* Set decoder */
-        lf->decoder_info = sdb.syscheck_dec;
-        lf->data = NULL;
+        /* SHA-1 message */
+        if (!newsha1 || !oldsha1 || strcmp(newsha1, oldsha1) == 0) {
+            sdb.sha1[0] = '\0';
+        } else {
+            snprintf(sdb.sha1, OS_FLSIZE, "Old sha1sum was: '%s'\n"
+                     "New sha1sum is : '%s'\n",
+                     oldsha1, newsha1);
+            os_strdup(oldsha1, lf->sha1_before);
+            os_strdup(newsha1, lf->sha1_after);
+        }
 
-        return (1);
+        /* Provide information about the file */
+        snprintf(sdb.comment, OS_MAXSTR, "Integrity checksum changed for: "
+                 "'%.756s'\n"
+                 "%s"
+                 "%s"
+                 "%s"
+                 "%s"
+                 "%s"
+                 "%s"
+                 "%s%s",
+                 f_name,
+                 sdb.size,
+                 sdb.perm,
+                 sdb.owner,
+                 sdb.gowner,
+                 sdb.md5,
+                 sdb.sha1,
+                 lf->data == NULL ? "" : "What changed:\n",
+                 lf->data == NULL ? "" : lf->data
+                );
     }
 
+    /* Create a new log message */
+    Free_EventinfoStr(lf, lf->full_log);
+    os_strdup(sdb.comment, lf->full_log);
+    lf->log = lf->full_log;
     lf->data = NULL;
-    return (0);
+
+    /* Set decoder */
+    lf->decoder_info = sdb.syscheck_dec;
+
+    return (1);
 }
 
 /* Special decoder for syscheck
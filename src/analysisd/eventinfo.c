@@ -7,9 +7,12 @@
  * Foundation.
  */
 
+#include <pthread.h>
+
 #include "config.h"
 #include "analysisd.h"
 #include "eventinfo.h"
+#include "correlation.h"
 #include "os_regex/os_regex.h"
 
 /* Global definitions */
@@ -37,6 +40,11 @@ Eventinfo *Search_LastSids(Eventinfo *my_lf, RuleInfo *rule)
         return (NULL);
     }
 
+    /* Only walk the events with the same context */
+    if (rule->corr_index) {
+        return (OS_CorrSearch(my_lf, rule, 1));
+    }
+
     /* Get last node */
     lf_node = OSList_GetLastNode(rule->sid_search);
     if (!lf_node) {
@@ -173,9 +181,9 @@ Eventinfo *Search_LastSids(Eventinfo *my_lf, RuleInfo *rule)
 
 
         /* If reached here, we matched */
-        my_lf->matched = rule->level;
-        lf->matched = rule->level;
-        first_lf->matched = rule->level;
+        OS_CorrMarkEvent(my_lf, rule->level);
+        OS_CorrMarkEvent(lf, rule->level);
+        OS_CorrMarkEvent(first_lf, rule->level);
 
         return (lf);
 
@@ -202,6 +210,11 @@ Eventinfo *Search_LastGroups(Eventinfo *my_lf, RuleInfo *rule)
         return (NULL);
     }
 
+    /* Only walk the events with the same context */
+    if (rule->corr_index) {
+        return (OS_CorrSearch(my_lf, rule, 0));
+    }
+
     /* Get last node */
     lf_node = OSList_GetLastNode(rule->group_search);
     if (!lf_node) {
@@ -338,9 +351,9 @@ Eventinfo *Search_LastGroups(Eventinfo *my_lf, RuleInfo *rule)
 
 
         /* If reached here, we matched */
-        my_lf->matched = rule->level;
-        lf->matched = rule->level;
-        first_lf->matched = rule->level;
+        OS_CorrMarkEvent(my_lf, rule->level);
+        OS_CorrMarkEvent(lf, rule->level);
+        OS_CorrMarkEvent(first_lf, rule->level);
 
         return (lf);
 
@@ -481,9 +494,9 @@ Eventinfo *Search_LastEvents(Eventinfo *my_lf, RuleInfo *rule)
         }
 
         /* If reached here, we matched */
-        my_lf->matched = rule->level;
-        lf->matched = rule->level;
-        first_lf->matched = rule->level;
+        OS_CorrMarkEvent(my_lf, rule->level);
+        OS_CorrMarkEvent(lf, rule->level);
+        OS_CorrMarkEvent(first_lf, rule->level);
 
         return (lf);
 
@@ -492,6 +505,231 @@ Eventinfo *Search_LastEvents(Eventinfo *my_lf, RuleInfo *rule)
     return (NULL);
 }
 
+/* Event pool: the structures (with their fields array and arena)
+ * are kept for the next events instead of being freed
+ */
+#define EV_POOL_SIZE    1024
+#define EV_ARENA_SIZE   OS_SIZE_2048    /* Initial size of an arena */
+#define EV_ARENA_KEEP   OS_SIZE_8192    /* Larger arenas are not kept */
+
+static Eventinfo *ev_pool[EV_POOL_SIZE];
+static int ev_pool_count = 0;
+
+/* Arenas left by promoted events */
+static char *ev_arenas[EV_POOL_SIZE];
+static size_t ev_arenas_size[EV_POOL_SIZE];
+static int ev_arenas_count = 0;
+
+static pthread_mutex_t ev_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void ev_pool_lock()
+{
+    if (pthread_mutex_lock(&ev_pool_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+}
+
+static void ev_pool_unlock()
+{
+    if (pthread_mutex_unlock(&ev_pool_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+}
+
+/* Keep an arena for the next events (pool locked) */
+static void ev_keep_arena(char *arena, size_t size)
+{
+    if (size <= EV_ARENA_KEEP && ev_arenas_count < EV_POOL_SIZE) {
+        ev_arenas[ev_arenas_count] = arena;
+        ev_arenas_size[ev_arenas_count] = size;
+        ev_arenas_count++;
+    } else {
+        free(arena);
+    }
+}
+
+Eventinfo *New_Eventinfo()
+{
+    Eventinfo *lf = NULL;
+    char **fields = NULL;
+    char *arena = NULL;
+    size_t arena_size = 0;
+
+    ev_pool_lock();
+
+    if (ev_pool_count > 0) {
+        lf = ev_pool[--ev_pool_count];
+        fields = lf->fields;
+        arena = lf->arena;
+        arena_size = lf->arena_size;
+    }
+
+    if (!arena && ev_arenas_count > 0) {
+        ev_arenas_count--;
+        arena = ev_arenas[ev_arenas_count];
+        arena_size = ev_arenas_size[ev_arenas_count];
+    }
+
+    ev_pool_unlock();
+
+    if (lf) {
+        memset(lf, 0, sizeof(Eventinfo));
+        lf->fields = fields;
+    } else {
+        os_calloc(1, sizeof(Eventinfo), lf);
+        os_calloc(Config.decoder_order_size, sizeof(char *), lf->fields);
+    }
+
+    if (!arena) {
+        arena_size = EV_ARENA_SIZE;
+        os_malloc(arena_size, arena);
+    }
+
+    lf->arena = arena;
+    lf->arena_size = arena_size;
+    lf->arena_used = 0;
+    lf->arena_pooled = 1;
+
+    return (lf);
+}
+
+/* Return an event to the pool */
+static void ev_release(Eventinfo *lf)
+{
+    ev_pool_lock();
+
+    if (lf->arena && (!lf->arena_pooled || lf->arena_size > EV_ARENA_KEEP)) {
+        free(lf->arena);
+        lf->arena = NULL;
+    }
+
+    if (ev_pool_count < EV_POOL_SIZE) {
+        ev_pool[ev_pool_count++] = lf;
+        lf = NULL;
+    }
+
+    ev_pool_unlock();
+
+    if (lf) {
+        free(lf->arena);
+        free(lf->fields);
+        free(lf);
+    }
+}
+
+static int ev_in_arena(const Eventinfo *lf, const char *str)
+{
+    return ((uintptr_t)str >= (uintptr_t)lf->arena &&
+            (uintptr_t)str < (uintptr_t)lf->arena + lf->arena_size);
+}
+
+char *Alloc_EventinfoStr(Eventinfo *lf, size_t size)
+{
+    char *str;
+
+    /* Grow the arena while nothing is allocated in it, leaving
+     * room for the strings that follow
+     */
+    if (lf->arena_used == 0 && size > lf->arena_size / 2 && lf->arena_pooled) {
+        size_t arena_size = lf->arena_size ? lf->arena_size : EV_ARENA_SIZE;
+
+        while (arena_size < 2 * size) {
+            arena_size *= 2;
+        }
+
+        free(lf->arena);
+        os_malloc(arena_size, lf->arena);
+        lf->arena_size = arena_size;
+    }
+
+    if (!lf->arena_pooled || size > lf->arena_size - lf->arena_used) {
+        os_malloc(size, str);
+        return (str);
+    }
+
+    str = lf->arena + lf->arena_used;
+    lf->arena_used += size;
+
+    return (str);
+}
+
+void Free_EventinfoStr(Eventinfo *lf, char *str)
+{
+    if (str && !ev_in_arena(lf, str)) {
+        free(str);
+    }
+}
+
+/* Move a pointer of an event to the promoted arena */
+#define EV_REBASE(lf, old, ptr) \
+    if ((ptr) && (uintptr_t)(ptr) >= (uintptr_t)(old) && \
+            (uintptr_t)(ptr) < (uintptr_t)(old) + (lf)->arena_used) { \
+        (ptr) = (lf)->arena + ((ptr) - (old)); \
+    }
+
+void Promote_Eventinfo(Eventinfo *lf)
+{
+    char *old = lf->arena;
+    size_t old_size = lf->arena_size;
+    int i;
+
+    if (!lf->arena_pooled) {
+        return;
+    }
+
+    if (lf->arena_used == 0) {
+        lf->arena = NULL;
+        lf->arena_size = 0;
+    } else {
+        os_malloc(lf->arena_used, lf->arena);
+        memcpy(lf->arena, old, lf->arena_used);
+        lf->arena_size = lf->arena_used;
+
+        EV_REBASE(lf, old, lf->log);
+        EV_REBASE(lf, old, lf->full_log);
+        EV_REBASE(lf, old, lf->location);
+        EV_REBASE(lf, old, lf->hostname);
+        EV_REBASE(lf, old, lf->program_name);
+        EV_REBASE(lf, old, lf->srcip);
+        EV_REBASE(lf, old, lf->srcgeoip);
+        EV_REBASE(lf, old, lf->dstip);
+        EV_REBASE(lf, old, lf->dstgeoip);
+        EV_REBASE(lf, old, lf->srcport);
+        EV_REBASE(lf, old, lf->dstport);
+        EV_REBASE(lf, old, lf->protocol);
+        EV_REBASE(lf, old, lf->action);
+        EV_REBASE(lf, old, lf->srcuser);
+        EV_REBASE(lf, old, lf->dstuser);
+        EV_REBASE(lf, old, lf->id);
+        EV_REBASE(lf, old, lf->status);
+        EV_REBASE(lf, old, lf->command);
+        EV_REBASE(lf, old, lf->url);
+        EV_REBASE(lf, old, lf->data);
+        EV_REBASE(lf, old, lf->systemname);
+        EV_REBASE(lf, old, lf->filename);
+        EV_REBASE(lf, old, lf->md5_before);
+        EV_REBASE(lf, old, lf->md5_after);
+        EV_REBASE(lf, old, lf->sha1_before);
+        EV_REBASE(lf, old, lf->sha1_after);
+        EV_REBASE(lf, old, lf->size_before);
+        EV_REBASE(lf, old, lf->size_after);
+        EV_REBASE(lf, old, lf->owner_before);
+        EV_REBASE(lf, old, lf->owner_after);
+        EV_REBASE(lf, old, lf->gowner_before);
+        EV_REBASE(lf, old, lf->gowner_after);
+
+        for (i = 0; i < Config.decoder_order_size; i++) {
+            EV_REBASE(lf, old, lf->fields[i]);
+        }
+    }
+
+    lf->arena_pooled = 0;
+
+    ev_pool_lock();
+    ev_keep_arena(old, old_size);
+    ev_pool_unlock();
+}
+
 /* Zero the loginfo structure */
 void Zero_Eventinfo(Eventinfo *lf)
 {
@@ -535,6 +773,8 @@ void Zero_Eventinfo(Eventinfo *lf)
 
     lf->generated_rule = NULL;
     lf->sid_node_to_delete = NULL;
+    lf->corr_seq = 0;
+    lf->corr_entries = NULL;
     lf->decoder_info = NULL_Decoder;
 
     lf->filename = NULL;
@@ -563,108 +803,113 @@ void Free_Eventinfo(Eventinfo *lf)
     }
 
     if (lf->full_log) {
-        free(lf->full_log);
+        Free_EventinfoStr(lf, lf->full_log);
     }
     if (lf->location) {
-        free(lf->location);
+        Free_EventinfoStr(lf, lf->location);
     }
 
     if (lf->srcip) {
-        free(lf->srcip);
+        Free_EventinfoStr(lf, lf->srcip);
     }
 
     if(lf->srcgeoip) {
-        free(lf->srcgeoip);
+        Free_EventinfoStr(lf, lf->srcgeoip);
         lf->srcgeoip = NULL;
     }
 
     if (lf->dstip) {
-        free(lf->dstip);
+        Free_EventinfoStr(lf, lf->dstip);
     }
 
     if(lf->dstgeoip) {
-        free(lf->dstgeoip);
+        Free_EventinfoStr(lf, lf->dstgeoip);
         lf->dstgeoip = NULL;
     }
 
     if (lf->srcport) {
-        free(lf->srcport);
+        Free_EventinfoStr(lf, lf->srcport);
     }
     if (lf->dstport) {
-        free(lf->dstport);
+        Free_EventinfoStr(lf, lf->dstport);
     }
     if (lf->protocol) {
-        free(lf->protocol);
+        Free_EventinfoStr(lf, lf->protocol);
     }
     if (lf->action) {
-        free(lf->action);
+        Free_EventinfoStr(lf, lf->action);
     }
     if (lf->status) {
-        free(lf->status);
+        Free_EventinfoStr(lf, lf->status);
     }
     if (lf->srcuser) {
-        free(lf->srcuser);
+        Free_EventinfoStr(lf, lf->srcuser);
     }
     if (lf->dstuser) {
-        free(lf->dstuser);
+        Free_EventinfoStr(lf, lf->dstuser);
     }
     if (lf->id) {
-        free(lf->id);
+        Free_EventinfoStr(lf, lf->id);
     }
     if (lf->command) {
-        free(lf->command);
+        Free_EventinfoStr(lf, lf->command);
     }
     if (lf->url) {
-        free(lf->url);
+        Free_EventinfoStr(lf, lf->url);
     }
 
     if (lf->data) {
-        free(lf->data);
+        Free_EventinfoStr(lf, lf->data);
     }
     if (lf->systemname) {
-        free(lf->systemname);
+        Free_EventinfoStr(lf, lf->systemname);
     }
 
     if (lf->fields) {
         int i;
         for (i = 0; i < Config.decoder_order_size; i++) {
-            free(lf->fields[i]);
+            Free_EventinfoStr(lf, lf->fields[i]);
+            lf->fields[i] = NULL;
         }
-        free(lf->fields);
     }
 
     if (lf->filename) {
-        free(lf->filename);
+        Free_EventinfoStr(lf, lf->filename);
     }
     if (lf->md5_before) {
-        free(lf->md5_before);
+        Free_EventinfoStr(lf, lf->md5_before);
     }
     if (lf->md5_after) {
-        free(lf->md5_after);
+        Free_EventinfoStr(lf, lf->md5_after);
     }
     if (lf->sha1_before) {
-        free(lf->sha1_before);
+        Free_EventinfoStr(lf, lf->sha1_before);
     }
     if (lf->sha1_after) {
-        free(lf->sha1_after);
+        Free_EventinfoStr(lf, lf->sha1_after);
     }
     if (lf->size_before) {
-        free(lf->size_before);
+        Free_EventinfoStr(lf, lf->size_before);
     }
     if (lf->size_after) {
-        free(lf->size_after);
+        Free_EventinfoStr(lf, lf->size_after);
     }
     if (lf->owner_before) {
-        free(lf->owner_before);
+        Free_EventinfoStr(lf, lf->owner_before);
     }
     if (lf->owner_after) {
-        free(lf->owner_after);
+        Free_EventinfoStr(lf, lf->owner_after);
     }
     if (lf->gowner_before) {
-        free(lf->gowner_before);
+        Free_EventinfoStr(lf, lf->gowner_before);
     }
     if (lf->gowner_after) {
-        free(lf->gowner_after);
+        Free_EventinfoStr(lf, lf->gowner_after);
+    }
+
+    /* Remove from the correlation indexes */
+    if (lf->corr_entries) {
+        OS_CorrRemoveEvent(lf);
     }
 
     /* Free node to delete */
@@ -684,8 +929,7 @@ void Free_Eventinfo(Eventinfo *lf)
      * fts
      * comment
      */
-    free(lf);
-    lf = NULL;
+    ev_release(lf);
 
     return;
 }
@@ -52,6 +52,12 @@ typedef struct _Eventinfo {
     /* Sid node to delete */
     OSListNode *sid_node_to_delete;
 
+    /* Position in the lists of previous events and entries in
+     * the correlation indexes
+     */
+    unsigned long corr_seq;
+    struct _OSCorrEntry *corr_entries;
+
     /* Extract when the event fires a rule */
     size_t size;
     size_t p_name_size;
@@ -79,6 +85,16 @@ typedef struct _Eventinfo {
     char *owner_after;
     char *gowner_before;
     char *gowner_after;
+
+    /* Buffer holding the strings of the event (location, full_log,
+     * decoded fields).
+     * It comes from the event pool, or from the heap once the event
+     * is promoted.
+     */
+    char *arena;
+    size_t arena_size;
+    size_t arena_used;
+    int arena_pooled;
 } Eventinfo;
 
 /* Events List structure */
@@ -124,12 +140,30 @@ Eventinfo *Search_LastEvents(Eventinfo *lf, RuleInfo *currently_rule);
 Eventinfo *Search_LastSids(Eventinfo *my_lf, RuleInfo *currently_rule);
 Eventinfo *Search_LastGroups(Eventinfo *my_lf, RuleInfo *currently_rule);
 
+/* Get an eventinfo structure from the pool, with its fields
+ * array allocated (to be set up by Zero_Eventinfo)
+ */
+Eventinfo *New_Eventinfo(void);
+
 /* Zero the eventinfo structure */
 void Zero_Eventinfo(Eventinfo *lf);
 
-/* Free the eventinfo structure */
+/* Free the eventinfo structure (back to the pool) */
 void Free_Eventinfo(Eventinfo *lf);
 
+/* Allocate a string in the arena of an event. It is released with
+ * the event: it must only be freed with Free_EventinfoStr.
+ */
+char *Alloc_EventinfoStr(Eventinfo *lf, size_t size);
+
+/* Free a string of an event, unless it is in its arena */
+void Free_EventinfoStr(Eventinfo *lf, char *str);
+
+/* Move the strings of an event out of the pool arena, before it is
+ * kept in the state memory
+ */
+void Promote_Eventinfo(Eventinfo *lf);
+
 /* Add and event to the list of previous events */
 void OS_AddEvent(Eventinfo *lf);
 
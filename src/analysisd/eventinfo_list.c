@@ -44,6 +44,9 @@ void OS_AddEvent(Eventinfo *lf)
 {
     EventNode *tmp_node = eventnode;
 
+    /* Kept until it falls off the list: release its pool arena */
+    Promote_Eventinfo(lf);
+
     if (tmp_node) {
         EventNode *new_node;
         new_node = (EventNode *)calloc(1, sizeof(EventNode));
@@ -6,365 +6,266 @@
 #include "json_extended.h"
 #include <stddef.h>
 
-#define MAX_MATCHES 10
 #define MAX_STRING 1024
-#define MAX_STRING_LESS 30
+#define MAX_GROUPS (MAX_STRING / 2)
 
-void W_ParseJSON(cJSON* root, const Eventinfo* lf)
+void W_ParseJSON(json_buffer *jb, const Eventinfo *lf)
 {
 
     // Parse hostname & Parse AGENTIP
     if(lf->hostname) {
-        W_JSON_ParseHostname(root, lf->hostname);
-        W_JSON_ParseAgentIP(root, lf);
+        W_JSON_ParseHostname(jb, lf->hostname);
+        W_JSON_ParseAgentIP(jb, lf);
     }
     // Parse timestamp
     if(lf->year && (strnlen(lf->mon, 3) > 0) && lf->day && (strnlen(lf->hour, 2) > 0)) {
-        W_JSON_ParseTimestamp(root, lf);
+        W_JSON_ParseTimestamp(jb, lf);
     }
     // Parse Location
     if(lf->location) {
-        W_JSON_ParseLocation(root, lf, 0);
+        W_JSON_ParseLocation(jb, lf);
     }
-    // Parse groups && Parse PCIDSS && Parse CIS
-    if(lf->generated_rule->group) {
-        W_JSON_ParseGroups(root, lf, 1);
-    }
-    // Parse CIS and PCIDSS rules from rootcheck .txt benchmarks
-    if(lf->full_log && W_isRootcheck(root, 1)) {
-        W_JSON_ParseRootcheck(root, lf, 1);
+}
+
+
+// Split the groups of the rule (at most MAX_STRING - 1 characters of them) in buffer.
+static int W_SplitGroups(const Eventinfo *lf, char *buffer, char *groups[MAX_GROUPS])
+{
+    int total = 0;
+    char *token;
+
+    strncpy(buffer, lf->generated_rule->group, MAX_STRING - 1);
+    buffer[MAX_STRING - 1] = '\0';
+
+    token = strtok(buffer, ",");
+    while(token && total < MAX_GROUPS) {
+        groups[total++] = token;
+        token = strtok(0, ",");
     }
+    return total;
 }
 
 
 // Detect if the alert is coming from rootcheck controls.
-
-int W_isRootcheck(cJSON* root, int nested)
+int W_isRootcheck(const Eventinfo *lf)
 {
-    cJSON* groups;
-    cJSON* group;
-    cJSON* rule;
-    char* group_json;
-
+    char buffer[MAX_STRING];
+    char *groups[MAX_GROUPS];
     int totalGroups, i;
 
-    if(!nested)
-        rule = root;
-    else
-        rule = cJSON_GetObjectItem(root, "rule");
+    if(!lf->generated_rule || !lf->generated_rule->group)
+        return 0;
 
-    groups = cJSON_GetObjectItem(rule, "groups");
-    totalGroups = cJSON_GetArraySize(groups);
+    totalGroups = W_SplitGroups(lf, buffer, groups);
     for(i = 0; i < totalGroups; i++) {
-        group = cJSON_GetArrayItem(groups, i);
-        group_json = cJSON_Print(group);
-        if(strcmp(group_json, "\"rootcheck\"") == 0) {
-            free(group_json);
+        if(strcmp(groups[i], "rootcheck") == 0) {
             return 1;
         }
-        free(group_json);
     }
     return 0;
 }
 
 
-// Getting security compliance field from rootcheck rules benchmarks .txt
-void W_JSON_ParseRootcheck(cJSON* root, const Eventinfo* lf, int nested)
+// Characters of the rootcheck compliance, as in the expression
+// \{([A-Za-z0-9_]*: [A-Za-z0-9_., ]*)\}
+static int W_isComplianceKey(char c)
 {
-    regex_t r;
-    cJSON* rule;
-    cJSON* compliance;
-    const char* regex_text;
-    const char* find_text;
-    char* token;
-    char* token2;
-    char* results[MAX_MATCHES];
-    int matches, i, j;
-    const char delim[2] = ":";
-    const char delim2[2] = ",";
-    char fullog[MAX_STRING];
-
-    // Allocate memory
-    for(i = 0; i < MAX_MATCHES; i++)
-        results[i] = malloc((MAX_STRING_LESS) * sizeof(char));
-
-    // Getting groups object JSON
-    if(!nested)
-        rule = root;
-    else
-        rule = cJSON_GetObjectItem(root, "rule");
-
-    // Getting full log string
-    strncpy(fullog, lf->full_log, MAX_STRING - 1);
-    // Searching regex
-    regex_text = "\\{([A-Za-z0-9_]*: [A-Za-z0-9_., ]*)\\}";
-    find_text = fullog;
-    compile_regex(&r, regex_text);
-    matches = match_regex(&r, find_text, results);
-
-    if(matches > 0) {
-        for(i = 0; i < matches; i++) {
-            token = strtok(results[i], delim);
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
 
-            trim(token);
-            cJSON_AddItemToObject(rule, token, compliance = cJSON_CreateArray());
-            for(j = 0; token[j]; j++) {
-                token[j] = tolower(token[j]);
-            }
-            if(token) {
-                token = strtok(0, delim);
-                trim(token);
-                token2 = strtok(token, delim2);
-                while(token2) {
-
-                    trim(token2);
-                    cJSON_AddItemToArray(compliance, cJSON_CreateString(token2));
-                    token2 = strtok(0, delim2);
-                }
-            }
-        }
-     }
-    regfree(&r);
-    for(i = 0; i < MAX_MATCHES; i++)
-         free(results[i]);
+static int W_isComplianceValue(char c)
+{
+    return W_isComplianceKey(c) || c == '.' || c == ',' || c == ' ';
 }
 
+// Find the next "{key: values}" in [p, end), setting the text between the braces.
+static const char *W_NextCompliance(const char *p, const char *end, const char **start, size_t *len)
+{
+    const char *q;
+
+    for(; (p = memchr(p, '{', (size_t)(end - p))); p++) {
+        q = p + 1;
+        while(q < end && W_isComplianceKey(*q))
+            q++;
+        if(q + 1 >= end || q[0] != ':' || q[1] != ' ')
+            continue;
+        q += 2;
+        while(q < end && W_isComplianceValue(*q))
+            q++;
+        if(q >= end || *q != '}')
+            continue;
+
+        *start = p + 1;
+        *len = (size_t)(q - p - 1);
+        return q + 1;
+    }
+    return NULL;
+}
 
 
-// STRTOK every "-" delimiter to get differents groups to our json array.
-void W_JSON_ParseGroups(cJSON* root, const Eventinfo* lf, int nested)
+// Getting security compliance field from rootcheck rules benchmarks .txt
+void W_JSON_ParseRootcheck(json_buffer *jb, const Eventinfo *lf)
 {
-    cJSON* groups;
-    cJSON* rule;
-    int firstPCI, firstCIS, foundCIS, foundPCI;
-    char delim[2];
-    char buffer[MAX_STRING];
+    const char *p = lf->full_log;
+    const char *end = p + strnlen(p, MAX_STRING - 1);
+    const char *match;
+    size_t len;
+    char result[MAX_STRING];
     char* token;
+    char* token2;
+
+    while((p = W_NextCompliance(p, end, &match, &len))) {
+        memcpy(result, match, len);
+        result[len] = '\0';
+
+        token = strtok(result, ":");
+        if(!token)
+            continue;
 
-    firstPCI = firstCIS = 1;
-    foundPCI = foundCIS = 0;
-    delim[0] = ',';
-    delim[1] = 0;
-
-    if(!nested)
-        rule = root;
-    else
-        rule = cJSON_GetObjectItem(root, "rule");
-
-    cJSON_AddItemToObject(rule, "groups", groups = cJSON_CreateArray());
-    strncpy(buffer, lf->generated_rule->group, sizeof(buffer) - 1);
-
-    token = strtok(buffer, delim);
-    while(token) {
-        foundPCI = foundCIS = 0;
-        foundPCI = add_groupPCI(rule, token, firstPCI);
-        if(!foundPCI)
-            foundCIS = add_groupCIS(rule, token, firstCIS);
-
-        if(foundPCI && firstPCI)
-            firstPCI = 0;
-        if(foundCIS && firstCIS)
-            firstCIS = 0;
-
-        if(!foundPCI && !foundCIS) {
-            cJSON_AddItemToArray(groups, cJSON_CreateString(token));
+        trim(token);
+        jb_open(jb, token, '[');
+
+        token = strtok(0, ":");
+        if(token) {
+            trim(token);
+            token2 = strtok(token, ",");
+            while(token2) {
+                trim(token2);
+                jb_add_string(jb, NULL, token2);
+                token2 = strtok(0, ",");
+            }
         }
-        token = strtok(0, delim);
+        jb_close(jb, '[');
     }
 }
 
 
- // Parse groups PCI
-int add_groupPCI(cJSON* rule, char* group, int firstPCI)
+// Add the groups with a compliance prefix, without it, to their own array.
+static void W_JSON_AddCompliance(json_buffer *jb, const char *name, const char *prefix, char *groups[], int totalGroups)
 {
-    //char* len = NULL;
-    cJSON* pci;
-    char aux[strlen(group)];
-    // If group begin with pci_dss_ we have a PCI group
-    if((startsWith("pci_dss_", group)) == 1) {
-        // Once we add pci_dss group and create array for PCI_DSS requirements
-        if(firstPCI == 1) {
-            pci = cJSON_CreateArray();
-            cJSON_AddItemToObject(rule, "PCI_DSS", pci);
-        } else {
-            pci = cJSON_GetObjectItem(rule, "PCI_DSS");
+    size_t prefix_len = strlen(prefix);
+    int i;
+
+    jb_open(jb, name, '[');
+    for(i = 0; i < totalGroups; i++) {
+        if(startsWith(prefix, groups[i])) {
+            jb_add_string(jb, NULL, groups[i] + prefix_len);
         }
-        // Prepare string and add it to PCI dss array
-        strncpy(aux, group, strlen(group) - 1 );
-        str_cut(aux, 0, 8);
-        cJSON_AddItemToArray(pci, cJSON_CreateString(aux));
-        return 1;
     }
-    return 0;
+    jb_close(jb, '[');
 }
 
 
-int add_groupCIS(cJSON* rule, char* group, int firstCIS)
+// STRTOK every "," delimiter to get differents groups to our json array.
+// The PCI DSS and CIS groups go to their own arrays, after the groups,
+// in the order they first appear.
+void W_JSON_ParseGroups(json_buffer *jb, const Eventinfo *lf)
 {
-    //char* len = NULL;
-    cJSON* cis;
-    char aux[strlen(group)];
-    if((startsWith("cis_", group)) == 1) {
-        if(firstCIS == 1) {
-            cis = cJSON_CreateArray();
-            cJSON_AddItemToObject(rule, "CIS", cis);
+    char buffer[MAX_STRING];
+    char *groups[MAX_GROUPS];
+    int totalGroups, i;
+    int firstPCI = -1, firstCIS = -1;
+
+    totalGroups = W_SplitGroups(lf, buffer, groups);
+
+    jb_open(jb, "groups", '[');
+    for(i = 0; i < totalGroups; i++) {
+        if(startsWith("pci_dss_", groups[i])) {
+            if(firstPCI < 0)
+                firstPCI = i;
+        } else if(startsWith("cis_", groups[i])) {
+            if(firstCIS < 0)
+                firstCIS = i;
         } else {
-            cis = cJSON_GetObjectItem(rule, "CIS");
+            jb_add_string(jb, NULL, groups[i]);
         }
-        strncpy(aux, group, strlen(group) - 1);
-        str_cut(aux, 0, 4);
-        cJSON_AddItemToArray(cis, cJSON_CreateString(aux));
-        return 1;
     }
-    return 0;
+    jb_close(jb, '[');
+
+    if(firstPCI >= 0 && (firstCIS < 0 || firstPCI < firstCIS)) {
+        W_JSON_AddCompliance(jb, "PCI_DSS", "pci_dss_", groups, totalGroups);
+        if(firstCIS >= 0)
+            W_JSON_AddCompliance(jb, "CIS", "cis_", groups, totalGroups);
+    } else if(firstCIS >= 0) {
+        W_JSON_AddCompliance(jb, "CIS", "cis_", groups, totalGroups);
+        if(firstPCI >= 0)
+            W_JSON_AddCompliance(jb, "PCI_DSS", "pci_dss_", groups, totalGroups);
+    }
 }
 
 
 // If hostname being with "(" means that alerts came from an agent, so we will remove the brakets
-// ** TODO ** Regex instead str_cut
-void W_JSON_ParseHostname(cJSON* root, char* hostname)
+void W_JSON_ParseHostname(json_buffer *jb, const char *hostname)
 {
     if(hostname[0] == '(') {
-        char* search;
-        char string[MAX_STRING];
-        strncpy(string, hostname, MAX_STRING - 1);
-        int index;
-        search = strchr(string, ')');
+        const char *search;
+        size_t len = strnlen(hostname, MAX_STRING - 1);
+
+        search = memchr(hostname, ')', len);
         if(search) {
-            index = (int)(search - string);
-            str_cut(string, index, -1);
-            str_cut(string, 0, 1);
-            cJSON_AddStringToObject(root, "agent_name", string);
+            jb_add_string_n(jb, "agent_name", hostname + 1, (size_t)(search - hostname - 1));
         }
     } else {
-        cJSON_AddStringToObject(root, "agent_name", hostname);
+        jb_add_string(jb, "agent_name", hostname);
     }
 }
 // Parse timestamp
-void W_JSON_ParseTimestamp(cJSON* root, const Eventinfo* lf)
+void W_JSON_ParseTimestamp(json_buffer *jb, const Eventinfo *lf)
 {
-    char* dateTimestamp = malloc(21);
-    sprintf(dateTimestamp, "%d %s %02d %s", lf->year, lf->mon, lf->day, lf->hour);
-    cJSON_AddStringToObject(root, "timestamp", dateTimestamp);
-    free(dateTimestamp);
+    char dateTimestamp[64];
+
+    snprintf(dateTimestamp, sizeof(dateTimestamp), "%d %s %02d %s", lf->year, lf->mon, lf->day, lf->hour);
+    jb_add_string(jb, "timestamp", dateTimestamp);
 }
 
 
-// The IP of an agent usually comes in "hostname" field, we will extract it.
-// ** TODO ** Regex instead str_cut
-void W_JSON_ParseAgentIP(cJSON* root, const Eventinfo* lf)
+// The IP of an agent usually comes in "hostname" field, we will extract it
+// ("(name) ip->location").
+void W_JSON_ParseAgentIP(json_buffer *jb, const Eventinfo *lf)
 {
     if(lf->hostname[0] == '(') {
-        char* search;
-        char string[MAX_STRING];
-        strncpy(string, lf->hostname, MAX_STRING - 1);
-        int index;
-        search = strchr(string, ')');
+        const char *search;
+        const char *start;
+        const char *end = lf->hostname + strnlen(lf->hostname, MAX_STRING - 1);
+
+        search = memchr(lf->hostname, ')', (size_t)(end - lf->hostname));
         if(search) {
-            index = (int)(search - string);
-            str_cut(string, 0, index);
-            str_cut(string, 0, 2);
-            search = strchr(string, '-');
-            index = (int)(search - string);
-            str_cut(string, index, -1);
-            cJSON_AddStringToObject(root, "agentip", string);
+            start = end - search >= 2 ? search + 2 : end;
+            search = memchr(start, '-', (size_t)(end - start));
+            if(search)
+                end = search;
+            jb_add_string_n(jb, "agentip", start, (size_t)(end - start));
         }
 
     }
 }
  // The file location usually comes with more information about the alert (like hostname or ip) we will extract just the "/var/folder/file.log".
-void W_JSON_ParseLocation(cJSON* root, const Eventinfo* lf, int archives)
+void W_JSON_ParseLocation(json_buffer *jb, const Eventinfo *lf)
 {
-    if (archives != 0) {
-        debug1("ossec-analysisd: DEBUG: archives != 0");
-    }
     if(lf->location[0] == '(') {
-        char* search;
-        char string[MAX_STRING];
-        strncpy(string, lf->location, MAX_STRING - 1);
-        int index;
-        search = strchr(string, '>');
-        if(search) {
-            index = (int)(search - string);
-            str_cut(string, 0, index);
-            str_cut(string, 0, 1);
+        const char *search;
+        size_t len = strnlen(lf->location, MAX_STRING - 1);
 
-            cJSON_AddStringToObject(root, "logfile", string);
+        search = memchr(lf->location, '>', len);
+        if(search) {
+            search++;
+            jb_add_string_n(jb, "logfile", search, len - (size_t)(search - lf->location));
         }
     } else {
-        cJSON_AddStringToObject(root, "logfile", lf->location);
-    }
-}
-
-
-#define MAX_ERROR_MSG 0x1000
-// Regex compilator
-int compile_regex(regex_t* r, const char* regex_text)
-{
-    int status = regcomp(r, regex_text, REG_EXTENDED | REG_NEWLINE);
-    if(status != 0) {
-        char error_message[MAX_ERROR_MSG];
-        regerror(status, r, error_message, MAX_ERROR_MSG);
-        debug1("Regex error compiling '%s': %s\n", regex_text, error_message);
-        return 1;
+        jb_add_string(jb, "logfile", lf->location);
     }
-    return 0;
 }
 
-int match_regex(regex_t* r, const char* to_match, char* results[MAX_MATCHES])
-{
-    const char* p = to_match;
-    const int n_matches = 10;
-    regmatch_t m[n_matches];
-    int totalResults = 0;
-    while(1) {
-        int i = 0;
-        int nomatch = regexec(r, p, n_matches, m, 0);
-        if(nomatch) {
-            //printf ("No more matches.\n");
-            return totalResults;
-        }
-        for(i = 0; i < n_matches; i++) {
-            int start;
-            int finish;
-            if(m[i].rm_so == -1) {
-
-                break;
-            }
-            start = m[i].rm_so + (p - to_match);
-            finish = m[i].rm_eo + (p - to_match);
-            if(i > 0) {
-                sprintf(results[totalResults], "%.*s", (finish - start), to_match + start);
-                totalResults = totalResults + 1;
-            }
-
-        }
-        p += m[0].rm_eo;
-    }
-    return 0;
-}
-
-int str_cut(char* str, int begin, int len)
-{
-    int l = strlen(str);
-
-    if(len < 0)
-        len = l - begin;
-    if(begin + len > l)
-        len = l - begin;
-    memmove(str + begin, str + begin + len, l - len + 1);
-
-    return len;
-}
 
 void trim(char* s)
 {
     char* p = s;
     int l = strlen(p);
 
-    while(isspace(p[l - 1]))
+    while(l > 0 && isspace((unsigned char)p[l - 1]))
         p[--l] = 0;
-    while(*p && isspace(*p))
+    while(*p && isspace((unsigned char)*p))
         ++p, --l;
 
     memmove(s, p, l + 1);
@@ -376,4 +277,3 @@ int startsWith(const char *pre, const char *str)
            lenstr = strlen(str);
     return lenstr < lenpre ? 0 : strncmp(pre, str, lenpre) == 0;
 }
-
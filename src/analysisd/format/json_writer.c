@@ -0,0 +1,177 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+#include "shared.h"
+#include "json_writer.h"
+
+/* Initial size of a buffer */
+#define JB_SIZE     8192
+
+/* Characters escaped as by cJSON: 0 for the ones copied as they are,
+ * the letter of the short escape, or 'u' for \u00XX
+ */
+static const char jb_escapes[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+/* Make room for len more bytes (and the terminator) */
+static void jb_grow(json_buffer *jb, size_t len)
+{
+    size_t size = jb->size ? jb->size : JB_SIZE;
+
+    while (jb->len + len >= size) {
+        size *= 2;
+    }
+
+    os_realloc(jb->data, size, jb->data);
+    jb->size = size;
+}
+
+static void jb_reserve(json_buffer *jb, size_t len)
+{
+    if (jb->len + len >= jb->size) {
+        jb_grow(jb, len);
+    }
+}
+
+void jb_reset(json_buffer *jb)
+{
+    jb_reserve(jb, 0);
+
+    jb->len = 0;
+    jb->data[0] = '\0';
+    jb->first = 1;
+}
+
+void jb_free(json_buffer *jb)
+{
+    free(jb->data);
+    jb->data = NULL;
+    jb->len = jb->size = 0;
+}
+
+void jb_append(json_buffer *jb, const char *str, size_t len)
+{
+    jb_reserve(jb, len);
+    memcpy(jb->data + jb->len, str, len);
+    jb->len += len;
+    jb->data[jb->len] = '\0';
+}
+
+/* Write a string, quoted and escaped, at out (with room for 6 bytes
+ * for each character and the quotes). Returns the end of it.
+ */
+static char *jb_quote(char *out, const char *str, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)str;
+    const unsigned char *end = p + len;
+
+    *out++ = '"';
+
+    while (p < end) {
+        const unsigned char *run = p;
+
+        while (p < end && !jb_escapes[*p]) {
+            p++;
+        }
+
+        memcpy(out, run, (size_t)(p - run));
+        out += p - run;
+
+        if (p == end) {
+            break;
+        }
+
+        *out++ = '\\';
+        if (jb_escapes[*p] == 'u') {
+            out += sprintf(out, "u%04x", *p);
+        } else {
+            *out++ = jb_escapes[*p];
+        }
+        p++;
+    }
+
+    *out++ = '"';
+    return (out);
+}
+
+/* Start a member (or an item of an array), with room for extra
+ * more bytes after it
+ */
+static char *jb_key(json_buffer *jb, const char *key, size_t extra)
+{
+    size_t key_len = key ? strlen(key) : 0;
+    char *out;
+
+    jb_reserve(jb, key_len * 6 + 4 + extra);
+    out = jb->data + jb->len;
+
+    if (!jb->first) {
+        *out++ = ',';
+    }
+    jb->first = 0;
+
+    if (key) {
+        out = jb_quote(out, key, key_len);
+        *out++ = ':';
+    }
+
+    return (out);
+}
+
+/* End what was written at out */
+static void jb_end(json_buffer *jb, char *out)
+{
+    *out = '\0';
+    jb->len = (size_t)(out - jb->data);
+}
+
+void jb_open(json_buffer *jb, const char *key, char type)
+{
+    char *out = jb_key(jb, key, 1);
+
+    *out++ = type;
+    jb_end(jb, out);
+    jb->first = 1;
+}
+
+void jb_close(json_buffer *jb, char type)
+{
+    char end = type == '{' ? '}' : ']';
+
+    jb_append(jb, &end, 1);
+    jb->first = 0;
+}
+
+void jb_add_string(json_buffer *jb, const char *key, const char *value)
+{
+    jb_add_string_n(jb, key, value, strlen(value));
+}
+
+void jb_add_string_n(json_buffer *jb, const char *key, const char *value, size_t len)
+{
+    char *out = jb_key(jb, key, len * 6 + 2);
+
+    jb_end(jb, jb_quote(out, value, len));
+}
+
+/* cJSON prints the numbers with "%1.15g", the same as "%lld" for
+ * integers of up to 15 digits (all the numbers of the events)
+ */
+void jb_add_number(json_buffer *jb, const char *key, long long value)
+{
+    char *out = jb_key(jb, key, 24);
+
+    jb_end(jb, out + sprintf(out, "%lld", value));
+}
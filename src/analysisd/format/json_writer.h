@@ -0,0 +1,46 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include <stddef.h>
+
+/* JSON text built directly into a buffer, in the format of
+ * cJSON_PrintUnformatted (no spaces, same escaping). The buffer is
+ * kept between events, so it only grows to the largest one.
+ */
+typedef struct _json_buffer {
+    char *data;
+    size_t len;
+    size_t size;
+    int first;          /* Nothing added to the current object or array */
+} json_buffer;
+
+/* Empty the buffer (allocating it the first time) */
+void jb_reset(json_buffer *jb);
+
+/* Release the memory of the buffer */
+void jb_free(json_buffer *jb);
+
+/* Start and end an object or array ('{' or '['). The key is NULL
+ * for the root and for the items of an array.
+ */
+void jb_open(json_buffer *jb, const char *key, char type);
+void jb_close(json_buffer *jb, char type);
+
+/* Add a member (or an item, with a NULL key) */
+void jb_add_string(json_buffer *jb, const char *key, const char *value);
+void jb_add_string_n(json_buffer *jb, const char *key, const char *value, size_t len);
+void jb_add_number(json_buffer *jb, const char *key, long long value);
+
+/* Add raw text, outside of the JSON */
+void jb_append(json_buffer *jb, const char *str, size_t len);
+
+#endif /* __JSON_WRITER_H__ */
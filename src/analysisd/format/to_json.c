@@ -4,380 +4,354 @@
  * This program is a free software; you can redistribute it
  * and/or modify it under the terms of the GNU General Public
  * License (version 2) as published by the FSF - Free Software
- * Foundation.  
+ * Foundation.
+ */
+
+/* The events are written straight into a json_buffer, in the order
+ * and format cJSON gave them when the JSON was built as a tree
+ * first (tests/json has the output expected).
  */
 
 #include "to_json.h"
 #include "json_extended.h"
 #include "shared.h"
 #include "rules.h"
-#include "cJSON.h"
 #include "config.h"
-#include <sys/resource.h>
 
 
+/* Add the members of the rule */
+static void add_rule(json_buffer *jb, const Eventinfo *lf)
+{
+    const RuleInfo *rule = lf->generated_rule;
 
-/* Convert Eventinfo to json */
-char *Eventinfo_to_jsonstr(const Eventinfo *lf)
+    if (rule->level) {
+        jb_add_number(jb, "level", rule->level);
+    }
+    if (rule->comment) {
+        jb_add_string(jb, "comment", rule->comment);
+    }
+    if (rule->sigid) {
+        jb_add_number(jb, "sidid", rule->sigid);
+    }
+    if (rule->cve) {
+        jb_add_string(jb, "cve", rule->cve);
+    }
+    if (rule->info) {
+        jb_add_string(jb, "info", rule->info);
+    }
+    if (rule->frequency) {
+        jb_add_number(jb, "frequency", rule->frequency);
+    }
+    if (rule->firedtimes) {
+        jb_add_number(jb, "firedtimes", rule->firedtimes);
+    }
+
+    // Parse groups && Parse PCIDSS && Parse CIS
+    if (rule->group) {
+        W_JSON_ParseGroups(jb, lf);
+    }
+    // Parse CIS and PCIDSS rules from rootcheck .txt benchmarks
+    if (lf->full_log && W_isRootcheck(lf)) {
+        W_JSON_ParseRootcheck(jb, lf);
+    }
+}
+
+/* Add a before/after pair of the syscheck when both are set, and
+ * they differ (or are the same, with same set)
+ */
+static void add_pair(json_buffer *jb, const char *before_key, const char *after_key,
+                     const char *before, const char *after, int same)
+{
+    if (before && after && (strcmp(before, after) == 0) == same) {
+        jb_add_string(jb, before_key, before);
+        jb_add_string(jb, after_key, after);
+    }
+}
+
+/* Add the dynamic fields of the decoder */
+static void add_fields(json_buffer *jb, const Eventinfo *lf)
 {
-    cJSON *root;
-    cJSON *rule;
-    cJSON *file_diff;
-    char *out;
     int i;
 
+    if (lf->decoder_info->fields) {
+        for (i = 0; i < Config.decoder_order_size; i++) {
+            if (lf->decoder_info->fields[i] && lf->fields[i]) {
+                jb_add_string(jb, lf->decoder_info->fields[i], lf->fields[i]);
+            }
+        }
+    }
+}
+
+/* Add the description of the decoder */
+static void add_decoder(json_buffer *jb, const char *key, const OSDecoderInfo *decoder)
+{
+    jb_open(jb, key, '{');
+
+    if (decoder->fts) {
+        jb_add_number(jb, "fts", decoder->fts);
+    }
+    if (decoder->accumulate) {
+        jb_add_number(jb, "accumulate", decoder->accumulate);
+    }
+    if (decoder->parent) {
+        jb_add_string(jb, "parent", decoder->parent);
+    }
+    if (decoder->name) {
+        jb_add_string(jb, "name", decoder->name);
+    }
+    if (decoder->ftscomment) {
+        jb_add_string(jb, "ftscomment", decoder->ftscomment);
+    }
+
+    jb_close(jb, '{');
+}
+
+/* Write the alert of an event in jb */
+void Eventinfo_to_jsonbuf(const Eventinfo *lf, json_buffer *jb)
+{
     extern long int __crt_ftell;
 
-    root = cJSON_CreateObject();
-    
-    cJSON_AddItemToObject(root, "rule", rule = cJSON_CreateObject());
+    jb_reset(jb);
+    jb_open(jb, NULL, '{');
+
+    jb_open(jb, "rule", '{');
+    if (lf->generated_rule) {
+        add_rule(jb, lf);
+    }
+    jb_close(jb, '{');
 
     if ( lf->time ) {
 
         char alert_id[23];
-        double timestamp_ms;
-        timestamp_ms = ((double)lf->time)*1000;
         alert_id[22] = '\0';
         if((snprintf(alert_id, 22, "%ld.%ld", (long int)lf->time, __crt_ftell)) < 0) {
             merror("snprintf failed");
         }
 
-        cJSON_AddStringToObject(root, "id", alert_id);
-        cJSON_AddNumberToObject(root, "TimeStamp", timestamp_ms);
-    }
-
-
-    if(lf->generated_rule){
-        if(lf->generated_rule->level) {
-            cJSON_AddNumberToObject(rule, "level", lf->generated_rule->level);
-        }
-        if(lf->generated_rule->comment) {
-            cJSON_AddStringToObject(rule, "comment", lf->generated_rule->comment);
-        }
-        if(lf->generated_rule->sigid) {
-            cJSON_AddNumberToObject(rule, "sidid", lf->generated_rule->sigid);
-        }
-        if(lf->generated_rule->cve) {
-            cJSON_AddStringToObject(rule, "cve", lf->generated_rule->cve);
-        }
-        if(lf->generated_rule->info) {
-            cJSON_AddStringToObject(rule, "info", lf->generated_rule->info);
-        }
-        if(lf->generated_rule->frequency){
-            cJSON_AddNumberToObject(rule, "frequency", lf->generated_rule->frequency);
-        }
-        if(lf->generated_rule->firedtimes){
-            cJSON_AddNumberToObject(rule, "firedtimes", lf->generated_rule->firedtimes);
-        }
+        jb_add_string(jb, "id", alert_id);
+        jb_add_number(jb, "TimeStamp", (long long)lf->time * 1000);
     }
 
     if( lf->decoder_info->name ) {
-        cJSON_AddStringToObject(root, "decoder", lf->decoder_info->name);
+        jb_add_string(jb, "decoder", lf->decoder_info->name);
     }
     if( lf->decoder_info->parent ) {
-        cJSON_AddStringToObject(root, "decoder_parent", lf->decoder_info->parent);
+        jb_add_string(jb, "decoder_parent", lf->decoder_info->parent);
     }
 
     if (lf->action) {
-        cJSON_AddStringToObject(root, "action", lf->action);
+        jb_add_string(jb, "action", lf->action);
     }
     if (lf->protocol) {
-        cJSON_AddStringToObject(root, "protocol", lf->protocol);
+        jb_add_string(jb, "protocol", lf->protocol);
     }
     if (lf->srcip) {
-        cJSON_AddStringToObject(root, "srcip", lf->srcip);
+        jb_add_string(jb, "srcip", lf->srcip);
     }
 
 #ifdef LIBGEOIP_ENABLED
     if (lf->srcgeoip && Config.geoip_jsonout) {
-        cJSON_AddStringToObject(root, "srcgeoip", lf->srcgeoip);
+        jb_add_string(jb, "srcgeoip", lf->srcgeoip);
     }
 #endif
 
     if (lf->srcport) {
-        cJSON_AddStringToObject(root, "srcport", lf->srcport);
+        jb_add_string(jb, "srcport", lf->srcport);
     }
     if (lf->srcuser) {
-        cJSON_AddStringToObject(root, "srcuser", lf->srcuser);
+        jb_add_string(jb, "srcuser", lf->srcuser);
     }
     if (lf->dstip) {
-        cJSON_AddStringToObject(root, "dstip", lf->dstip);
+        jb_add_string(jb, "dstip", lf->dstip);
     }
 #ifdef LIBGEOIP_ENABLED
     if (lf->dstgeoip && Config.geoip_jsonout) {
-        cJSON_AddStringToObject(root, "dstgeoip", lf->dstgeoip);
+        jb_add_string(jb, "dstgeoip", lf->dstgeoip);
     }
 #endif
 
     if (lf->dstport) {
-        cJSON_AddStringToObject(root, "dstport", lf->dstport);
+        jb_add_string(jb, "dstport", lf->dstport);
     }
     if (lf->dstuser) {
-        cJSON_AddStringToObject(root, "dstuser", lf->dstuser);
+        jb_add_string(jb, "dstuser", lf->dstuser);
     }
     if (lf->location) {
-        cJSON_AddStringToObject(root, "location", lf->location);
+        jb_add_string(jb, "location", lf->location);
     }
     if (lf->full_log) {
-        cJSON_AddStringToObject(root, "full_log", lf->full_log);
+        jb_add_string(jb, "full_log", lf->full_log);
     }
-    if (lf->generated_rule->last_events && lf->generated_rule->last_events[1] && lf->generated_rule->last_events[1][0]) {
-        cJSON_AddStringToObject(root, "previous_output", lf->generated_rule->last_events[1]);
+    if (lf->generated_rule && lf->generated_rule->last_events &&
+            lf->generated_rule->last_events[1] && lf->generated_rule->last_events[1][0]) {
+        jb_add_string(jb, "previous_output", lf->generated_rule->last_events[1]);
     }
 
     if (lf->filename) {
-        file_diff = cJSON_CreateObject();
-        cJSON_AddItemToObject(root, "SyscheckFile", file_diff);
+        jb_open(jb, "SyscheckFile", '{');
 
-        cJSON_AddStringToObject(file_diff, "path", lf->filename);
+        jb_add_string(jb, "path", lf->filename);
+
+        add_pair(jb, "md5_before", "md5_after", lf->md5_before, lf->md5_after, 0);
+        add_pair(jb, "sha1_before", "sha1_after", lf->sha1_before, lf->sha1_after, 0);
+        add_pair(jb, "owner_before", "owner_after", lf->owner_before, lf->owner_after, 0);
+        add_pair(jb, "gowner_before", "gowner_after", lf->gowner_before, lf->gowner_after, 0);
 
-        if (lf->md5_before && lf->md5_after && strcmp(lf->md5_before, lf->md5_after) != 0  ) {
-            cJSON_AddStringToObject(file_diff, "md5_before", lf->md5_before);
-            cJSON_AddStringToObject(file_diff, "md5_after", lf->md5_after);
-        }
-        if(lf->sha1_before && lf->sha1_after && strcmp(lf->sha1_before, lf->sha1_after) != 0) {
-            cJSON_AddStringToObject(file_diff, "sha1_before", lf->sha1_before);
-            cJSON_AddStringToObject(file_diff, "sha1_after", lf->sha1_after);
-        }
-        if(lf->owner_before && lf->owner_after && strcmp(lf->owner_before, lf->owner_after) != 0) {
-            cJSON_AddStringToObject(file_diff, "owner_before", lf->owner_before);
-            cJSON_AddStringToObject(file_diff, "owner_after", lf->owner_after);
-        }
-        if(lf->gowner_before && lf->gowner_after && strcmp(lf->gowner_before, lf->gowner_after) != 0) {
-            cJSON_AddStringToObject(file_diff, "gowner_before", lf->gowner_before);
-            cJSON_AddStringToObject(file_diff, "gowner_after", lf->gowner_after);
-        }
         if(lf->perm_before && lf->perm_after && (lf->perm_before != lf->perm_after)) {
-            cJSON_AddNumberToObject(file_diff, "perm_before", lf->perm_before);
-            cJSON_AddNumberToObject(file_diff, "perm_after", lf->perm_after);
+            jb_add_number(jb, "perm_before", lf->perm_before);
+            jb_add_number(jb, "perm_after", lf->perm_after);
         }
+
+        jb_close(jb, '{');
     }
     if ( lf->hostname ) {
-        cJSON_AddStringToObject(root, "hostname", lf->hostname);
+        jb_add_string(jb, "hostname", lf->hostname);
     }
     if ( lf->program_name ) {
-        cJSON_AddStringToObject(root, "program_name", lf->program_name);
+        jb_add_string(jb, "program_name", lf->program_name);
     }
     if ( lf->status ) {
-        cJSON_AddStringToObject(root, "status", lf->status);
+        jb_add_string(jb, "status", lf->status);
     }
     if(lf->command)
-        cJSON_AddStringToObject(root, "command", lf->command);
- 
+        jb_add_string(jb, "command", lf->command);
+
     if ( lf->url ) {
-        cJSON_AddStringToObject(root, "url", lf->url);
+        jb_add_string(jb, "url", lf->url);
     }
     if ( lf->data ) {
-        cJSON_AddStringToObject(root, "data", lf->data);
+        jb_add_string(jb, "data", lf->data);
     }
     if ( lf->systemname ) {
-        cJSON_AddStringToObject(root, "systemname", lf->systemname);
+        jb_add_string(jb, "systemname", lf->systemname);
     }
 
     // DecoderInfo
     if(lf->decoder_info){
-        cJSON *decoder;
-        // Dynamic fields
-        if (lf->decoder_info->fields) {
-            for (i = 0; i < Config.decoder_order_size; i++) {
-                if (lf->decoder_info->fields[i] && lf->fields[i]) {
-                    cJSON_AddStringToObject(root, lf->decoder_info->fields[i], lf->fields[i]);
-                }
-            }
-        }
-
-        cJSON_AddItemToObject(root, "decoder_desc", decoder = cJSON_CreateObject());
-
-        if (lf->decoder_info->fts)
-            cJSON_AddNumberToObject(decoder, "fts", lf->decoder_info->fts);
-        if (lf->decoder_info->accumulate)
-            cJSON_AddNumberToObject(decoder, "accumulate", lf->decoder_info->accumulate);
-
-        if (lf->decoder_info->parent)
-            cJSON_AddStringToObject(decoder, "parent", lf->decoder_info->parent);
-        if (lf->decoder_info->name)
-            cJSON_AddStringToObject(decoder, "name", lf->decoder_info->name);
-        if (lf->decoder_info->ftscomment)
-            cJSON_AddStringToObject(decoder, "ftscomment", lf->decoder_info->ftscomment);
-
+        add_fields(jb, lf);
+        add_decoder(jb, "decoder_desc", lf->decoder_info);
     }
 
+    W_ParseJSON(jb, lf);
 
-    W_ParseJSON(root, lf);
-
-    out = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    return out;
+    jb_close(jb, '{');
 }
 
-/* Convert Archiveinfo to json */
-char *Archiveinfo_to_jsonstr(const Eventinfo *lf)
+/* Write the archive of an event in jb */
+void Archiveinfo_to_jsonbuf(const Eventinfo *lf, json_buffer *jb)
 {
-    cJSON *root;
-    char *out;
-    int i;
-
-    root = cJSON_CreateObject();
+    jb_reset(jb);
+    jb_open(jb, NULL, '{');
 
     if(lf->program_name)
-	   cJSON_AddStringToObject(root, "program_name", lf->program_name);
+       jb_add_string(jb, "program_name", lf->program_name);
 
     if(lf->log)
-       cJSON_AddStringToObject(root, "log", lf->log);
-
-   if(lf->srcip)
-       cJSON_AddStringToObject(root, "srcip", lf->srcip); 
-
-   if(lf->dstip)
-       cJSON_AddStringToObject(root, "dstip", lf->dstip); 
-
-   if(lf->srcport)
-       cJSON_AddStringToObject(root, "srcport", lf->srcport); 
-
-   if(lf->dstport)
-       cJSON_AddStringToObject(root, "dstport", lf->dstport); 
-
-   if(lf->protocol)
-       cJSON_AddStringToObject(root, "protocol", lf->protocol);
-
-   if(lf->action)
-       cJSON_AddStringToObject(root, "action", lf->action);
+       jb_add_string(jb, "log", lf->log);
 
-   if(lf->srcuser)
-       cJSON_AddStringToObject(root, "srcuser", lf->srcuser);
+    if(lf->srcip)
+       jb_add_string(jb, "srcip", lf->srcip);
 
-   if(lf->dstuser)
-       cJSON_AddStringToObject(root, "dstuser", lf->dstuser);
+    if(lf->dstip)
+       jb_add_string(jb, "dstip", lf->dstip);
 
-   if(lf->id)
-       cJSON_AddStringToObject(root, "id", lf->id);
+    if(lf->srcport)
+       jb_add_string(jb, "srcport", lf->srcport);
 
-   if(lf->status)
-       cJSON_AddStringToObject(root, "status", lf->status);
+    if(lf->dstport)
+       jb_add_string(jb, "dstport", lf->dstport);
 
-   if(lf->command)
-       cJSON_AddStringToObject(root, "command", lf->command);
+    if(lf->protocol)
+       jb_add_string(jb, "protocol", lf->protocol);
 
-   if(lf->url)
-       cJSON_AddStringToObject(root, "url", lf->url);
+    if(lf->action)
+       jb_add_string(jb, "action", lf->action);
 
-   if(lf->data)
-       cJSON_AddStringToObject(root, "data", lf->data);
+    if(lf->srcuser)
+       jb_add_string(jb, "srcuser", lf->srcuser);
 
-   if(lf->systemname)
-       cJSON_AddStringToObject(root, "systemname", lf->systemname);
+    if(lf->dstuser)
+       jb_add_string(jb, "dstuser", lf->dstuser);
 
-  
-   if (lf->filename) {
-       cJSON_AddStringToObject(root, "filename", lf->filename);
+    if(lf->id)
+       jb_add_string(jb, "id", lf->id);
 
-       if (lf->md5_before && lf->md5_after && (strcmp(lf->md5_before, lf->md5_after) != 0)) {
-           cJSON_AddStringToObject(root, "md5_before", lf->md5_before);
-           cJSON_AddStringToObject(root, "md5_after", lf->md5_after);
-       }
-       if (lf->sha1_before && lf->sha1_after && !(strcmp(lf->sha1_before, lf->sha1_after) != 0)) {
-           cJSON_AddStringToObject(root, "sha1_before", lf->sha1_before);
-           cJSON_AddStringToObject(root, "sha1_after", lf->sha1_after);
-       }
-       if (lf->owner_before && lf->owner_after && !(strcmp(lf->owner_before, lf->owner_after) != 0)) {
-           cJSON_AddStringToObject(root, "owner_before", lf->owner_before);
-           cJSON_AddStringToObject(root, "owner_after", lf->owner_after);
-       }
-       if (lf->gowner_before && lf->gowner_after && !(strcmp(lf->gowner_before, lf->gowner_after) != 0)) {
-           cJSON_AddStringToObject(root, "gowner_before", lf->gowner_before);
-           cJSON_AddStringToObject(root, "gowner_after", lf->gowner_after);
-       }
-       if (lf->perm_before && lf->perm_after && lf->perm_before != lf->perm_after) {
-           cJSON_AddNumberToObject(root, "perm_before", lf->perm_before);
-           cJSON_AddNumberToObject(root, "perm_after", lf->perm_after);
-       }
-   }
+    if(lf->status)
+       jb_add_string(jb, "status", lf->status);
 
+    if(lf->command)
+       jb_add_string(jb, "command", lf->command);
 
-   // RuleInfo
-    if(lf->generated_rule){
-        cJSON *rule;
-
-        cJSON_AddItemToObject(root, "rule", rule = cJSON_CreateObject());
-
-        if (lf->generated_rule->level) 
-            cJSON_AddNumberToObject(rule, "level", lf->generated_rule->level);
-
-        if (lf->generated_rule->comment) 
-            cJSON_AddStringToObject(rule, "comment", lf->generated_rule->comment);
-        
-        if (lf->generated_rule->sigid) 
-            cJSON_AddNumberToObject(rule, "sidid", lf->generated_rule->sigid);
-        
-        if (lf->generated_rule->cve) 
-            cJSON_AddStringToObject(rule, "cve", lf->generated_rule->cve);
-        
-        if (lf->generated_rule->info) 
-            cJSON_AddStringToObject(rule, "info", lf->generated_rule->info);
+    if(lf->url)
+       jb_add_string(jb, "url", lf->url);
 
-        if (lf->generated_rule->frequency) 
-            cJSON_AddNumberToObject(rule, "frequency", lf->generated_rule->frequency);
+    if(lf->data)
+       jb_add_string(jb, "data", lf->data);
 
-        if (lf->generated_rule->firedtimes) 
-            cJSON_AddNumberToObject(rule, "firedtimes", lf->generated_rule->firedtimes);
+    if(lf->systemname)
+       jb_add_string(jb, "systemname", lf->systemname);
 
-        if (lf->generated_rule->group) {
-            W_JSON_ParseGroups(root,lf,1);
+    if (lf->filename) {
+        jb_add_string(jb, "filename", lf->filename);
+
+        /* The archives have always had sha1, owner and gowner when
+         * they did not change
+         */
+        add_pair(jb, "md5_before", "md5_after", lf->md5_before, lf->md5_after, 0);
+        add_pair(jb, "sha1_before", "sha1_after", lf->sha1_before, lf->sha1_after, 1);
+        add_pair(jb, "owner_before", "owner_after", lf->owner_before, lf->owner_after, 1);
+        add_pair(jb, "gowner_before", "gowner_after", lf->gowner_before, lf->gowner_after, 1);
+
+        if (lf->perm_before && lf->perm_after && lf->perm_before != lf->perm_after) {
+            jb_add_number(jb, "perm_before", lf->perm_before);
+            jb_add_number(jb, "perm_after", lf->perm_after);
         }
+    }
 
-        if (lf->full_log && W_isRootcheck(root,1)) {
-            W_JSON_ParseRootcheck(root,lf,1);
-        }  
-
+    // RuleInfo
+    if(lf->generated_rule){
+        jb_open(jb, "rule", '{');
+        add_rule(jb, lf);
+        jb_close(jb, '{');
     }
 
     // DecoderInfo
     if(lf->decoder_info){
-        cJSON *decoder;
-        // Dynamic fields
-        if (lf->decoder_info->fields) {
-            for (i = 0; i < Config.decoder_order_size; i++) {
-                if (lf->decoder_info->fields[i] && lf->fields[i]) {
-                    cJSON_AddStringToObject(root, lf->decoder_info->fields[i], lf->fields[i]);
-                }
-            }
-        }
-
-        cJSON_AddItemToObject(root, "decoder", decoder = cJSON_CreateObject());
-
-        if (lf->decoder_info->fts) 
-            cJSON_AddNumberToObject(decoder, "fts", lf->decoder_info->fts);
-        if (lf->decoder_info->accumulate) 
-            cJSON_AddNumberToObject(decoder, "accumulate", lf->decoder_info->accumulate);
-
-        if (lf->decoder_info->parent) 
-            cJSON_AddStringToObject(decoder, "parent", lf->decoder_info->parent);
-        if (lf->decoder_info->name) 
-            cJSON_AddStringToObject(decoder, "name", lf->decoder_info->name);
-        if (lf->decoder_info->ftscomment) 
-            cJSON_AddStringToObject(decoder, "ftscomment", lf->decoder_info->ftscomment);
-
+        add_fields(jb, lf);
+        add_decoder(jb, "decoder", lf->decoder_info);
     }
 
-
     if (lf->full_log)
-        cJSON_AddStringToObject(root, "full_log", lf->full_log);
+        jb_add_string(jb, "full_log", lf->full_log);
 
     if(lf->year && strnlen(lf->mon, 4) && lf->day && strnlen(lf->hour, 10))
-        W_JSON_ParseTimestamp(root, lf);
+        W_JSON_ParseTimestamp(jb, lf);
 
     if(lf->hostname){
-        W_JSON_ParseHostname(root, lf->hostname);
-        W_JSON_ParseAgentIP(root, lf); 
+        W_JSON_ParseHostname(jb, lf->hostname);
+        W_JSON_ParseAgentIP(jb, lf);
     }
 
     if (lf->location)
-       W_JSON_ParseLocation(root,lf,0);
+        W_JSON_ParseLocation(jb, lf);
 
+    jb_close(jb, '{');
+}
+
+/* Convert Eventinfo to json */
+char *Eventinfo_to_jsonstr(const Eventinfo *lf)
+{
+    json_buffer jb = { NULL, 0, 0, 0 };
 
+    Eventinfo_to_jsonbuf(lf, &jb);
+    return (jb.data);
+}
 
+/* Convert Archiveinfo to json */
+char *Archiveinfo_to_jsonstr(const Eventinfo *lf)
+{
+    json_buffer jb = { NULL, 0, 0, 0 };
 
-    out = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    return out;
+    Archiveinfo_to_jsonbuf(lf, &jb);
+    return (jb.data);
 }
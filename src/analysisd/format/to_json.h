@@ -11,6 +11,13 @@
 #define __TO_JSON_H__
 
 #include "eventinfo.h"
+#include "json_writer.h"
+
+/* Write the JSON of an alert or archive in a buffer (emptied first) */
+void Eventinfo_to_jsonbuf(const Eventinfo *lf, json_buffer *jb);
+void Archiveinfo_to_jsonbuf(const Eventinfo *lf, json_buffer *jb);
+
+/* The same, in a new string to be freed by the caller */
 char *Eventinfo_to_jsonstr(const Eventinfo *lf);
 char *Archiveinfo_to_jsonstr(const Eventinfo *lf);
 #endif /* __TO_JSON_H__ */
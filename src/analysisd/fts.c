@@ -9,40 +9,589 @@
 
 /* First time seen functions */
 
+#include <sys/mman.h>
+
 #include "fts.h"
 #include "eventinfo.h"
 
+/* Snapshot of the FTS store: the header, then each entry (oldest
+ * first) as the time it was last seen (int64_t), its size (uint32_t)
+ * and the entry. The FTS queue only has the entries added after it.
+ */
+#define FTS_MAGIC       "OSFTS01"
+
+/* Rows of the FTS table */
+#define FTS_ROWS        2048
+
+/* Entries in the FTS queue allowed (above the entries of the store)
+ * before the snapshot is written again
+ */
+#define FTS_MIN_QUEUE   1024
+
+/* Write the snapshot at least this often (seconds) if entries were
+ * seen since, to keep their age
+ */
+#define FTS_SAVE_TIME   3600
+
+/* First line of the ignore list. The lines after it are the time
+ * each entry was added and the entry. Without it (older versions),
+ * the lines are only the entries.
+ */
+#define IG_HEADER       "#ossec-ig-queue 1"
+
+/* Rows of the ignore table */
+#define IG_ROWS         1024
+
+/* Lines of the ignore list not in the table (expired or repeated)
+ * allowed before it is written again
+ */
+#define IG_MIN_STALE    1024
+
+typedef struct _fts_snapshot_header {
+    char magic[8];
+    uint64_t entries;
+} fts_snapshot_header;
+
+/* Entry of the store, in the order they were seen (oldest first) */
+typedef struct _fts_entry {
+    time_t seen;
+    struct _fts_entry *prev;
+    struct _fts_entry *next;
+    char key[1];
+} fts_entry;
+
 /* Local variables */
 static unsigned int fts_minsize_for_str = 0;
 
-static OSList *fts_list = NULL;
 static OSHash *fts_store = NULL;
+static fts_entry *fts_oldest = NULL;
+static fts_entry *fts_newest = NULL;
+static unsigned int fts_entries = 0;
+static unsigned int fts_max_entries = 0;
+static unsigned int fts_max_age = 0;
+
+/* Entries in the FTS queue, and when the snapshot was written */
+static unsigned int fts_queued = 0;
+static time_t fts_saved = 0;
+static int fts_seen = 0;
+
+/* Prefix (fts_min_size_for_str + 1 chars) of the last IDS entries,
+ * with its hash (0 if the entry is shorter), to find similar ones
+ */
+static unsigned int *fts_prints = NULL;
+static char *fts_prefixes = NULL;
+static int fts_prints_size = 0;
+static int fts_prints_next = 0;
 
 static FILE *fp_list = NULL;
 static FILE *fp_ignore = NULL;
 
+/* Ignore list: time each entry was added, by entry */
+static OSHash *ig_store = NULL;
+static unsigned int ig_ttl = 0;
+static unsigned int ig_entries = 0;
+static unsigned int ig_lines = 0;
+static time_t ig_compacted = 0;
+
+/* Prototypes */
+static void FTS_Grow(void);
+static fts_entry *FTS_Add(const char *key, time_t seen);
+static void FTS_Touch(fts_entry *entry, time_t now);
+static void FTS_Evict(time_t now);
+static unsigned int FTS_LoadSnapshot(time_t now);
+#ifndef TESTRULE
+static int FTS_Save(time_t now);
+#endif
+static void FTS_Sync(time_t now);
+static unsigned int FTS_Print(const char *line);
+static int FTS_Similar(const char *line);
+static void FTS_Remember(const char *line);
+static int IG_Expired(const time_t *added, time_t now);
+static int IG_Add(const char *entry, time_t added);
+static void IG_Load(void);
+static int IG_Compact(time_t now);
+
+
+/* Move the store to a larger table as it grows */
+static void FTS_Grow()
+{
+    OSHash *store;
+    fts_entry *entry;
+
+    store = OSHash_Create();
+    if (!store) {
+        return;
+    }
+
+    if (!OSHash_setSize(store, fts_store->rows * 4)) {
+        OSHash_Free(store);
+        return;
+    }
+
+    for (entry = fts_oldest; entry; entry = entry->next) {
+        if (OSHash_Add(store, entry->key, entry) != 2) {
+            OSHash_Free(store);
+            return;
+        }
+    }
+
+    OSHash_Free(fts_store);
+    fts_store = store;
+}
+
+/* Add an entry to the store, as the newest */
+static fts_entry *FTS_Add(const char *key, time_t seen)
+{
+    fts_entry *entry;
+    size_t len = strlen(key);
+
+    if (fts_entries >= fts_store->rows * 2) {
+        FTS_Grow();
+    }
+
+    os_malloc(sizeof(fts_entry) + len, entry);
+    memcpy(entry->key, key, len + 1);
+    entry->seen = seen;
+
+    if (OSHash_Add(fts_store, entry->key, entry) != 2) {
+        free(entry);
+        return (NULL);
+    }
+
+    entry->prev = fts_newest;
+    entry->next = NULL;
+    if (fts_newest) {
+        fts_newest->next = entry;
+    } else {
+        fts_oldest = entry;
+    }
+    fts_newest = entry;
+    fts_entries++;
+
+    return (entry);
+}
+
+/* An entry was seen again: make it the newest */
+static void FTS_Touch(fts_entry *entry, time_t now)
+{
+    entry->seen = now;
+
+    /* The snapshot only needs the new time if entries expire */
+    if (fts_max_age) {
+        fts_seen = 1;
+    }
+
+    if (entry == fts_newest) {
+        return;
+    }
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        fts_oldest = entry->next;
+    }
+    entry->next->prev = entry->prev;
+
+    entry->prev = fts_newest;
+    entry->next = NULL;
+    fts_newest->next = entry;
+    fts_newest = entry;
+}
+
+/* Forget the oldest entries, above fts_max_entries or not seen
+ * for fts_max_age seconds
+ */
+static void FTS_Evict(time_t now)
+{
+    while (fts_oldest &&
+            ((fts_max_entries && fts_entries > fts_max_entries) ||
+             (fts_max_age && now - fts_oldest->seen >= (time_t)fts_max_age))) {
+        fts_entry *entry = fts_oldest;
+
+        fts_oldest = entry->next;
+        if (fts_oldest) {
+            fts_oldest->prev = NULL;
+        } else {
+            fts_newest = NULL;
+        }
+
+        OSHash_Delete(fts_store, entry->key);
+        free(entry);
+        fts_entries--;
+    }
+}
+
+/* Read the snapshot of the store, without the entries over the
+ * limits. Returns the number of entries read.
+ */
+static unsigned int FTS_LoadSnapshot(time_t now)
+{
+    fts_snapshot_header header;
+    struct stat st;
+    uint64_t skip = 0;
+    char *map;
+    size_t pos;
+    uint64_t i;
+    int fd;
+
+    fd = open(FTS_SNAPSHOT, O_RDONLY);
+    if (fd < 0) {
+        return (0);
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(header)) {
+        close(fd);
+        return (0);
+    }
+
+    map = (char *) mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        merror("%s: WARN: Unable to map '%s' (%d): %s.", ARGV0, FTS_SNAPSHOT,
+               errno, strerror(errno));
+        return (0);
+    }
+
+    memcpy(&header, map, sizeof(header));
+    pos = sizeof(header);
+
+    if (memcmp(header.magic, FTS_MAGIC, sizeof(FTS_MAGIC)) != 0) {
+        merror("%s: WARN: Invalid FTS snapshot '%s'.", ARGV0, FTS_SNAPSHOT);
+        munmap(map, (size_t)st.st_size);
+        return (0);
+    }
+
+    /* The oldest entries would be forgotten right away */
+    if (fts_max_entries && header.entries > fts_max_entries) {
+        skip = header.entries - fts_max_entries;
+    }
+
+    for (i = 0; i < header.entries; i++) {
+        char key[OS_FLSIZE + 1];
+        int64_t seen;
+        uint32_t len;
+
+        if ((size_t)st.st_size - pos < sizeof(seen) + sizeof(len)) {
+            break;
+        }
+
+        memcpy(&seen, map + pos, sizeof(seen));
+        memcpy(&len, map + pos + sizeof(seen), sizeof(len));
+        pos += sizeof(seen) + sizeof(len);
+
+        if (len > OS_FLSIZE || (size_t)st.st_size - pos < len) {
+            break;
+        }
+
+        if (i < skip || (fts_max_age && now - (time_t)seen >= (time_t)fts_max_age)) {
+            pos += len;
+            continue;
+        }
+
+        memcpy(key, map + pos, len);
+        key[len] = '\0';
+        pos += len;
+
+        FTS_Add(key, (time_t)seen);
+    }
+
+    if (i < header.entries) {
+        merror("%s: WARN: FTS snapshot '%s' is truncated.", ARGV0, FTS_SNAPSHOT);
+    }
+
+    munmap(map, (size_t)st.st_size);
+    return ((unsigned int)i);
+}
+
+#ifndef TESTRULE
+/* Write the snapshot of the store and empty the FTS queue */
+static int FTS_Save(time_t now)
+{
+    char tmp_path[OS_FLSIZE + 1];
+    fts_snapshot_header header;
+    fts_entry *entry;
+    FILE *fp;
+
+    snprintf(tmp_path, OS_FLSIZE, "%s.tmp", FTS_SNAPSHOT);
+
+    fp = fopen(tmp_path, "w");
+    if (!fp) {
+        merror(FOPEN_ERROR, ARGV0, tmp_path, errno, strerror(errno));
+        return (0);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FTS_MAGIC, sizeof(FTS_MAGIC));
+    header.entries = fts_entries;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    for (entry = fts_oldest; entry; entry = entry->next) {
+        int64_t seen = (int64_t)entry->seen;
+        uint32_t len = (uint32_t)strlen(entry->key);
+
+        fwrite(&seen, sizeof(seen), 1, fp);
+        fwrite(&len, sizeof(len), 1, fp);
+        fwrite(entry->key, len, 1, fp);
+    }
+
+    if (ferror(fp) || fclose(fp) != 0 || chmod(tmp_path, 0640) == -1 ||
+            rename(tmp_path, FTS_SNAPSHOT) == -1) {
+        merror(RENAME_ERROR, ARGV0, tmp_path, FTS_SNAPSHOT, errno, strerror(errno));
+        unlink(tmp_path);
+        return (0);
+    }
+
+    fts_saved = now;
+    fts_seen = 0;
+
+    /* The entries of the queue are in the snapshot now */
+    fp = fopen(FTS_QUEUE, "w");
+    if (!fp) {
+        merror(FOPEN_ERROR, ARGV0, FTS_QUEUE, errno, strerror(errno));
+        return (0);
+    }
+
+    fclose(fp_list);
+    fp_list = fp;
+    fts_queued = 0;
+
+    return (1);
+}
+#endif
+
+/* Write the snapshot if the queue grew too much, or to keep the
+ * age of the entries seen
+ */
+static void FTS_Sync(time_t now)
+{
+#ifndef TESTRULE
+    if (fts_queued > fts_entries + FTS_MIN_QUEUE ||
+            (fts_seen && now - fts_saved >= FTS_SAVE_TIME)) {
+        FTS_Save(now);
+    }
+#else
+    (void)now;
+#endif
+}
+
+/* Hash of the prefix of an entry compared for similar ones
+ * (0 if the entry is not longer than fts_min_size_for_str)
+ */
+static unsigned int FTS_Print(const char *line)
+{
+    unsigned int hash = 2166136261U;
+    unsigned int i;
+
+    for (i = 0; i <= fts_minsize_for_str; i++) {
+        if (line[i] == '\0') {
+            return (0);
+        }
+
+        hash ^= (unsigned char)line[i];
+        hash *= 16777619U;
+    }
+
+    return (hash ? hash : 1);
+}
+
+/* Check if more than two of the last IDS entries start as this one
+ * (with more than fts_min_size_for_str chars in common)
+ */
+static int FTS_Similar(const char *line)
+{
+    unsigned int hash = FTS_Print(line);
+    int number_of_matches = 0;
+    int i;
+
+    if (!hash) {
+        return (0);
+    }
+
+    for (i = 0; i < fts_prints_size; i++) {
+        if (fts_prints[i] == hash &&
+                memcmp(fts_prefixes + (size_t)i * (fts_minsize_for_str + 1),
+                       line, fts_minsize_for_str + 1) == 0) {
+            if (++number_of_matches > 2) {
+                return (1);
+            }
+        }
+    }
+
+    return (0);
+}
+
+/* Keep the prefix of an IDS entry (replacing the oldest) */
+static void FTS_Remember(const char *line)
+{
+    unsigned int hash = FTS_Print(line);
+
+    fts_prints[fts_prints_next] = hash;
+    if (hash) {
+        memcpy(fts_prefixes + (size_t)fts_prints_next * (fts_minsize_for_str + 1),
+               line, fts_minsize_for_str + 1);
+    }
+
+    fts_prints_next = (fts_prints_next + 1) % fts_prints_size;
+}
+
+/* Check if an entry of the ignore list is too old (ignore_ttl) */
+static int IG_Expired(const time_t *added, time_t now)
+{
+    if (!ig_ttl) {
+        return (0);
+    }
+
+    return (now - *added >= (time_t)ig_ttl);
+}
+
+/* Add (or renew) an entry of the ignore list in memory */
+static int IG_Add(const char *entry, time_t added)
+{
+    time_t *ig_time;
+
+    ig_time = (time_t *)OSHash_Get(ig_store, entry);
+    if (ig_time) {
+        *ig_time = added;
+        return (1);
+    }
+
+    os_calloc(1, sizeof(time_t), ig_time);
+    *ig_time = added;
+
+    if (OSHash_Add(ig_store, entry, ig_time) != 2) {
+        free(ig_time);
+        merror(LIST_ADD_ERROR, ARGV0);
+        return (0);
+    }
+
+    ig_entries++;
+    return (1);
+}
+
+/* Read the ignore list from the file */
+static void IG_Load()
+{
+    char _line[OS_MAXSTR + 1];
+    int timed = 0;
+    time_t now = time(0);
+
+    _line[OS_MAXSTR] = '\0';
+
+    fseek(fp_ignore, 0, SEEK_SET);
+    while (fgets(_line, OS_MAXSTR, fp_ignore) != NULL) {
+        char *entry = _line;
+        char *tmp_s;
+        time_t added = now;
+
+        /* Remove newlines */
+        tmp_s = strchr(_line, '\n');
+        if (tmp_s) {
+            *tmp_s = '\0';
+        }
+
+        if (ig_lines == 0 && strcmp(_line, IG_HEADER) == 0) {
+            timed = 1;
+            continue;
+        }
+
+        ig_lines++;
+
+        /* Only one space after the time (the entry may start with one) */
+        if (timed) {
+            added = (time_t)strtol(_line, &entry, 10);
+            if (entry == _line || *entry != ' ') {
+                merror("%s: WARN: Invalid entry in the ignore list: '%s'.",
+                       ARGV0, _line);
+                continue;
+            }
+            entry++;
+        }
+
+        if (IG_Expired(&added, now)) {
+            continue;
+        }
+
+        IG_Add(entry, added);
+    }
+}
+
+/* Write the ignore list again, without the entries expired or repeated */
+static int IG_Compact(time_t now)
+{
+    char tmp_path[OS_FLSIZE + 1];
+    unsigned int i;
+    FILE *fp;
+
+    snprintf(tmp_path, OS_FLSIZE, "%s.tmp", IG_QUEUE);
+
+    fp = fopen(tmp_path, "w");
+    if (!fp) {
+        merror(FOPEN_ERROR, ARGV0, tmp_path, errno, strerror(errno));
+        return (0);
+    }
+
+    fprintf(fp, "%s\n", IG_HEADER);
+    ig_lines = 0;
+
+    for (i = 0; i < ig_store->rows; i++) {
+        OSHashNode *node = ig_store->table[i];
+
+        while (node) {
+            time_t *ig_time = (time_t *)node->data;
+            OSHashNode *next = node->next;
+
+            if (IG_Expired(ig_time, now)) {
+                free(OSHash_Delete(ig_store, node->key));
+                ig_entries--;
+            } else if (!strchr(node->key, '\n')) {
+                fprintf(fp, "%ld %s\n", (long)*ig_time, node->key);
+                ig_lines++;
+            }
+
+            node = next;
+        }
+    }
+
+    if (fclose(fp) != 0 || chmod(tmp_path, 0640) == -1 ||
+            rename(tmp_path, IG_QUEUE) == -1) {
+        merror(RENAME_ERROR, ARGV0, tmp_path, IG_QUEUE, errno, strerror(errno));
+        unlink(tmp_path);
+        return (0);
+    }
+
+    ig_compacted = now;
+
+    fp = fopen(IG_QUEUE, "a");
+    if (!fp) {
+        merror(FOPEN_ERROR, ARGV0, IG_QUEUE, errno, strerror(errno));
+        return (0);
+    }
+
+    fclose(fp_ignore);
+    fp_ignore = fp;
+
+    return (1);
+}
+
 
 /* Start the FTS module */
 int FTS_Init()
 {
     int fts_list_size;
+    unsigned int fts_loaded;
     char _line[OS_FLSIZE + 1];
+    time_t now = time(0);
 
     _line[OS_FLSIZE] = '\0';
 
-    fts_list = OSList_Create();
-    if (!fts_list) {
-        merror(LIST_ERROR, ARGV0);
-        return (0);
-    }
-
     /* Create store data */
     fts_store = OSHash_Create();
     if (!fts_store) {
         merror(LIST_ERROR, ARGV0);
         return (0);
     }
-    if (!OSHash_setSize(fts_store, 2048)) {
+    if (!OSHash_setSize(fts_store, FTS_ROWS)) {
         merror(LIST_ERROR, ARGV0);
         return (0);
     }
@@ -57,10 +606,18 @@ int FTS_Init()
                           "fts_min_size_for_str",
                           6, 128);
 
-    if (!OSList_SetMaxSize(fts_list, fts_list_size)) {
-        merror(LIST_SIZE_ERROR, ARGV0);
-        return (0);
-    }
+    /* Limits of the store (0 for none) */
+    fts_max_entries = (unsigned int) getDefine_Int("analysisd",
+                      "fts_max_entries",
+                      0, 100000000);
+
+    fts_max_age = (unsigned int) getDefine_Int("analysisd",
+                  "fts_max_age",
+                  0, 31536000);
+
+    fts_prints_size = fts_list_size;
+    os_calloc((size_t)fts_prints_size, sizeof(unsigned int), fts_prints);
+    os_calloc((size_t)fts_prints_size, fts_minsize_for_str + 1, fts_prefixes);
 
     /* Create fts list */
     fp_list = fopen(FTS_QUEUE, "r+");
@@ -92,7 +649,11 @@ int FTS_Init()
         }
     }
 
-    /* Add content from the files to memory */
+    /* Add content from the files to memory: the snapshot, then
+     * the entries added after it
+     */
+    fts_loaded = FTS_LoadSnapshot(now);
+
     fseek(fp_list, 0, SEEK_SET);
     while (fgets(_line, OS_FLSIZE , fp_list) != NULL) {
         char *tmp_s;
@@ -103,13 +664,21 @@ int FTS_Init()
             *tmp_s = '\0';
         }
 
-        os_strdup(_line, tmp_s);
-        if (OSHash_Add(fts_store, tmp_s, tmp_s) <= 0) {
-            free(tmp_s);
-            merror(LIST_ADD_ERROR, ARGV0);
-        }
+        FTS_Add(_line, now);
+        fts_queued++;
     }
 
+    FTS_Evict(now);
+    fts_saved = now;
+
+#ifndef TESTRULE
+    if ((fts_queued || fts_entries != fts_loaded) && !FTS_Save(now)) {
+        return (0);
+    }
+#else
+    (void)fts_loaded;
+#endif
+
     /* Create ignore list */
     fp_ignore = fopen(IG_QUEUE, "r+");
     if (!fp_ignore) {
@@ -140,6 +709,26 @@ int FTS_Init()
         }
     }
 
+    /* Keep the ignore list in memory */
+    ig_store = OSHash_Create();
+    if (!ig_store || !OSHash_setSize(ig_store, IG_ROWS)) {
+        merror(LIST_ERROR, ARGV0);
+        return (0);
+    }
+
+    /* Time to live of the entries (0 to keep them forever) */
+    ig_ttl = (unsigned int) getDefine_Int("analysisd",
+                                          "ignore_ttl",
+                                          0, 31536000);
+
+    IG_Load();
+
+#ifndef TESTRULE
+    if (!IG_Compact(time(0))) {
+        return (0);
+    }
+#endif
+
     debug1("%s: DEBUG: FTSInit completed.", ARGV0);
 
     return (1);
@@ -148,14 +737,17 @@ int FTS_Init()
 /* Add a pattern to be ignored */
 void AddtoIGnore(Eventinfo *lf)
 {
-    fseek(fp_ignore, 0, SEEK_END);
+    char _line[OS_FLSIZE + 1];
+    time_t *ig_time;
 
 #ifdef TESTRULE
     return;
 #endif
 
+    _line[OS_FLSIZE] = '\0';
+
     /* Assign the values to the FTS */
-    fprintf(fp_ignore, "%s %s %s %s %s %s %s %s\n",
+    snprintf(_line, OS_FLSIZE, "%s %s %s %s %s %s %s %s",
             (lf->decoder_info->name && (lf->generated_rule->ignore & FTS_NAME)) ?
             lf->decoder_info->name : "",
             (lf->id && (lf->generated_rule->ignore & FTS_ID)) ? lf->id : "",
@@ -171,7 +763,27 @@ void AddtoIGnore(Eventinfo *lf)
             lf->systemname : "",
             (lf->generated_rule->ignore & FTS_LOCATION) ? lf->location : "");
 
-    fflush(fp_ignore);
+    /* Already ignored */
+    ig_time = (time_t *)OSHash_Get(ig_store, _line);
+    if (ig_time && !IG_Expired(ig_time, lf->time)) {
+        return;
+    }
+
+    if (!IG_Add(_line, lf->time)) {
+        return;
+    }
+
+    if (!strchr(_line, '\n')) {
+        fprintf(fp_ignore, "%ld %s\n", (long)lf->time, _line);
+        fflush(fp_ignore);
+        ig_lines++;
+    }
+
+    /* Drop the expired and repeated lines from the file */
+    if (ig_lines > 2 * ig_entries + IG_MIN_STALE ||
+            (ig_ttl && lf->time - ig_compacted >= (time_t)ig_ttl)) {
+        IG_Compact(lf->time);
+    }
 
     return;
 }
@@ -182,12 +794,12 @@ void AddtoIGnore(Eventinfo *lf)
 int IGnore(Eventinfo *lf)
 {
     char _line[OS_FLSIZE + 1];
-    char _fline[OS_FLSIZE + 1];
+    time_t *ig_time;
 
     _line[OS_FLSIZE] = '\0';
 
     /* Assign the values to the FTS */
-    snprintf(_line, OS_FLSIZE, "%s %s %s %s %s %s %s %s\n",
+    snprintf(_line, OS_FLSIZE, "%s %s %s %s %s %s %s %s",
              (lf->decoder_info->name && (lf->generated_rule->ckignore & FTS_NAME)) ?
              lf->decoder_info->name : "",
              (lf->id && (lf->generated_rule->ckignore & FTS_ID)) ? lf->id : "",
@@ -203,21 +815,20 @@ int IGnore(Eventinfo *lf)
              lf->systemname : "",
              (lf->generated_rule->ckignore & FTS_LOCATION) ? lf->location : "");
 
-    _fline[OS_FLSIZE] = '\0';
-
     /** Check if the ignore is present **/
-    /* Point to the beginning of the file */
-    fseek(fp_ignore, 0, SEEK_SET);
-    while (fgets(_fline, OS_FLSIZE , fp_ignore) != NULL) {
-        if (strcmp(_fline, _line) != 0) {
-            continue;
-        }
+    ig_time = (time_t *)OSHash_Get(ig_store, _line);
+    if (!ig_time) {
+        return (0);
+    }
 
-        /* If we match, we can return 1 */
-        return (1);
+    if (IG_Expired(ig_time, lf->time)) {
+        free(OSHash_Delete(ig_store, _line));
+        ig_entries--;
+        return (0);
     }
 
-    return (0);
+    /* If we match, we can return 1 */
+    return (1);
 }
 
 /*  Check if the word "msg" is present on the "queue".
@@ -225,10 +836,8 @@ int IGnore(Eventinfo *lf)
  */
 int FTS(Eventinfo *lf)
 {
-    int number_of_matches = 0;
     char _line[OS_FLSIZE + 1];
-    char *line_for_list = NULL;
-    OSListNode *fts_node;
+    fts_entry *entry;
 
     _line[OS_FLSIZE] = '\0';
 
@@ -245,7 +854,9 @@ int FTS(Eventinfo *lf)
              (lf->decoder_info->fts & FTS_LOCATION) ? lf->location : "");
 
     /** Check if FTS is already present **/
-    if (OSHash_Get(fts_store, _line)) {
+    if ((entry = (fts_entry *)OSHash_Get(fts_store, _line))) {
+        FTS_Touch(entry, lf->time);
+        FTS_Sync(lf->time);
         return (0);
     }
 
@@ -253,35 +864,25 @@ int FTS(Eventinfo *lf)
      * If yes, we just ignore it.
      */
     if (lf->decoder_info->type == IDS) {
-        fts_node = OSList_GetLastNode(fts_list);
-        while (fts_node) {
-            if (OS_StrHowClosedMatch((char *)fts_node->data, _line) >
-                    fts_minsize_for_str) {
-                number_of_matches++;
-
-                /* We go and add this new entry to the list */
-                if (number_of_matches > 2) {
-                    _line[fts_minsize_for_str] = '\0';
-                    break;
-                }
-            }
-
-            fts_node = OSList_GetPrevNode(fts_list);
+        if (FTS_Similar(_line)) {
+            _line[fts_minsize_for_str] = '\0';
         }
 
-        os_strdup(_line, line_for_list);
-        OSList_AddData(fts_list, line_for_list);
-    }
+        FTS_Remember(_line);
 
-    /* Store new entry */
-    if (line_for_list == NULL) {
-        os_strdup(_line, line_for_list);
+        if ((entry = (fts_entry *)OSHash_Get(fts_store, _line))) {
+            FTS_Touch(entry, lf->time);
+            FTS_Sync(lf->time);
+            return (0);
+        }
     }
 
-    if (OSHash_Add(fts_store, line_for_list, line_for_list) <= 1) {
+    /* Store new entry */
+    if (!FTS_Add(_line, lf->time)) {
         return (0);
     }
 
+    FTS_Evict(lf->time);
 
 #ifdef TESTRULE
     return (1);
@@ -291,7 +892,9 @@ int FTS(Eventinfo *lf)
     fseek(fp_list, 0, SEEK_END);
     fprintf(fp_list, "%s\n", _line);
     fflush(fp_list);
+    fts_queued++;
+
+    FTS_Sync(lf->time);
 
     return (1);
 }
-
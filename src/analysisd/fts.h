@@ -15,9 +15,11 @@
 /* FTS queues */
 #ifdef TESTRULE
 #define FTS_QUEUE "queue/fts/fts-queue"
+#define FTS_SNAPSHOT "queue/fts/fts-queue.db"
 #define IG_QUEUE  "queue/fts/ig-queue"
 #else
 #define FTS_QUEUE "/queue/fts/fts-queue"
+#define FTS_SNAPSHOT "/queue/fts/fts-queue.db"
 #define IG_QUEUE  "/queue/fts/ig-queue"
 #endif
 
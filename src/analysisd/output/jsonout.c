@@ -9,29 +9,27 @@
 
 #include "jsonout.h"
 #include "alerts/getloglocation.h"
+#include "alerts/logwriter.h"
 #include "format/to_json.h"
 
+/* Buffer of the JSON, kept between the events */
+static json_buffer jsonout_buffer;
+
 void jsonout_output_event(const Eventinfo *lf)
 {
-    char *json_alert = Eventinfo_to_jsonstr(lf);
-
-    fprintf(_jflog,
-            "%s\n",
-            json_alert);
+    Eventinfo_to_jsonbuf(lf, &jsonout_buffer);
+    jb_append(&jsonout_buffer, "\n", 1);
 
-    fflush(_jflog);
-    free(json_alert);
+    OS_LogWriterPuts(LOGW_ALERTS_JSON, jsonout_buffer.data);
+    OS_LogWriterCommit(LOGW_ALERTS_JSON);
     return;
 }
 void jsonout_output_archive(const Eventinfo *lf)
 {
-    char *json_alert = Archiveinfo_to_jsonstr(lf);
-
-    fprintf(_ejflog,
-            "%s\n",
-            json_alert);
+    Archiveinfo_to_jsonbuf(lf, &jsonout_buffer);
+    jb_append(&jsonout_buffer, "\n", 1);
 
-    fflush(_ejflog);
-    free(json_alert);
+    OS_LogWriterPuts(LOGW_ARCHIVES_JSON, jsonout_buffer.data);
+    OS_LogWriterCommit(LOGW_ARCHIVES_JSON);
     return;
 }
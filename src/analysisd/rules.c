@@ -1144,7 +1144,7 @@ int Rules_OP_ReadRules(const char *rulefile)
                                config_ruleinfo->pcre2->error);
                         return (-1);
                     }
-                    free(pcre2);
+                    config_ruleinfo->pcre2_pattern = pcre2;
                     pcre2 = NULL;
                 }
 
@@ -1156,7 +1156,7 @@ int Rules_OP_ReadRules(const char *rulefile)
                                config_ruleinfo->match->error);
                         return (-1);
                     }
-                    free(match);
+                    config_ruleinfo->match_pattern = match;
                     match = NULL;
                 }
                 else if (match_pcre2) {
@@ -1166,7 +1166,7 @@ int Rules_OP_ReadRules(const char *rulefile)
                                config_ruleinfo->match_pcre2->error);
                         return (-1);
                     }
-                    free(match_pcre2);
+                    config_ruleinfo->match_pattern = match_pcre2;
                     match_pcre2 = NULL;
                 }
 
@@ -1313,7 +1313,7 @@ int Rules_OP_ReadRules(const char *rulefile)
                                config_ruleinfo->program_name->error);
                         return (-1);
                     }
-                    free(program_name);
+                    config_ruleinfo->program_name_pattern = program_name;
                     program_name = NULL;
                 }
                 else if (program_name_pcre2) {
@@ -1324,7 +1324,7 @@ int Rules_OP_ReadRules(const char *rulefile)
                                config_ruleinfo->program_name_pcre2->error);
                         return (-1);
                     }
-                    free(program_name_pcre2);
+                    config_ruleinfo->program_name_pattern = program_name_pcre2;
                     program_name_pcre2 = NULL;
                 }
 
@@ -1680,6 +1680,9 @@ RuleInfo *zerorulemember(int id, int level,
     ruleinfo_pt->group = NULL;
     ruleinfo_pt->regex = NULL;
     ruleinfo_pt->match = NULL;
+    ruleinfo_pt->match_pattern = NULL;
+    ruleinfo_pt->pcre2_pattern = NULL;
+    ruleinfo_pt->program_name_pattern = NULL;
     ruleinfo_pt->decoded_as = 0;
 
     ruleinfo_pt->comment = NULL;
@@ -1721,6 +1724,7 @@ RuleInfo *zerorulemember(int id, int level,
     ruleinfo_pt->group_search = NULL;
 
     ruleinfo_pt->event_search = NULL;
+    ruleinfo_pt->corr_index = NULL;
     ruleinfo_pt->compiled_rule = NULL;
     ruleinfo_pt->lists = NULL;
 
@@ -128,12 +128,24 @@ typedef struct _RuleInfo {
     /* Function pointer to the event_search */
     void *(*event_search)(void *lf, void *rule);
 
+    /* Index of the events of sid_search/group_search by the
+     * context of this rule (NULL to walk the list)
+     */
+    struct _OSCorrIndex *corr_index;
+
     char *group;
     OSMatch *match;
     OSPcre2 *match_pcre2;
     OSRegex *regex;
     OSPcre2 *pcre2;
 
+    /* Source of the match, pcre2 and program name patterns
+     * (used to build the rule prefilters)
+     */
+    char *match_pattern;
+    char *pcre2_pattern;
+    char *program_name_pattern;
+
     /* Policy-based rules */
     char *day_time;
     char *week_day;
@@ -191,6 +203,7 @@ typedef struct _RuleNode {
     RuleInfo *ruleinfo;
     struct _RuleNode *next;
     struct _RuleNode *child;
+    struct _RulePrefilter *child_prefilter;
 } RuleNode;
 
 
@@ -287,7 +287,11 @@ int OS_AddRuleInfo(RuleNode *r_node, RuleInfo *newrule, int sid)
 
             r_node->ruleinfo->group = newrule->group;
             r_node->ruleinfo->match = newrule->match;
+            r_node->ruleinfo->match_pcre2 = newrule->match_pcre2;
             r_node->ruleinfo->regex = newrule->regex;
+            r_node->ruleinfo->pcre2 = newrule->pcre2;
+            r_node->ruleinfo->match_pattern = newrule->match_pattern;
+            r_node->ruleinfo->pcre2_pattern = newrule->pcre2_pattern;
             r_node->ruleinfo->day_time = newrule->day_time;
             r_node->ruleinfo->week_day = newrule->week_day;
             r_node->ruleinfo->srcip = newrule->srcip;
@@ -300,6 +304,8 @@ int OS_AddRuleInfo(RuleNode *r_node, RuleInfo *newrule, int sid)
             r_node->ruleinfo->status = newrule->status;
             r_node->ruleinfo->hostname = newrule->hostname;
             r_node->ruleinfo->program_name = newrule->program_name;
+            r_node->ruleinfo->program_name_pcre2 = newrule->program_name_pcre2;
+            r_node->ruleinfo->program_name_pattern = newrule->program_name_pattern;
             r_node->ruleinfo->extra_data = newrule->extra_data;
             r_node->ruleinfo->action = newrule->action;
             r_node->ruleinfo->comment = newrule->comment;
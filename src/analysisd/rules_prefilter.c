@@ -0,0 +1,807 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+#include "shared.h"
+#include "rules.h"
+#include "rules_prefilter.h"
+
+/* Lists shorter than this are tried rule by rule */
+#define RP_MIN_RULES    8
+
+/* Rule flags */
+#define RP_NEED_PNAME   0x01    /* Needs a program name */
+#define RP_PNAME        0x02    /* Program name must contain a literal */
+#define RP_LOG          0x04    /* Log must contain a literal */
+
+/* Aho-Corasick automaton over the lowercase literals of a list */
+typedef struct _rp_ac {
+    unsigned char cls[256];     /* Byte class, 0 for bytes in no literal */
+    int nclass;
+    int nstates;
+    int *next;                  /* Transitions: nstates * nclass */
+    int *term;                  /* Literal ending at each state (-1 if none) */
+    int *dict;                  /* Next state with a literal on the failure chain */
+    int nlits;
+    int *lit_first;             /* Rules of each literal */
+    int *lit_rules;
+    unsigned int *lit_stamp;
+} rp_ac;
+
+struct _RulePrefilter {
+    int size;
+    RuleNode **nodes;
+    unsigned char *flags;
+
+    /* Rules accepting any decoder and rules of each decoder (by id),
+     * in list order
+     */
+    int *any;
+    int n_any;
+    int max_dec;
+    int *dec_first;
+    int *dec_rules;
+
+    rp_ac *log_ac;
+    rp_ac *pname_ac;
+
+    /* Per event state */
+    unsigned int stamp;
+    unsigned int *log_hit;
+    unsigned int *pname_hit;
+    int log_on;
+    int pname_on;
+    int has_pname;
+};
+
+/* Literals collected for an automaton */
+typedef struct _rp_lits {
+    char **str;
+    int *rule;
+    int size;
+} rp_lits;
+
+static RulePrefilter *top_prefilter = NULL;
+
+
+/* Add a literal to a NULL terminated list */
+static void rp_push(char ***lits, size_t *n, const char *str, size_t len)
+{
+    size_t i;
+
+    os_realloc(*lits, (*n + 2) * sizeof(char *), *lits);
+    os_calloc(len + 1, sizeof(char), (*lits)[*n]);
+
+    for (i = 0; i < len; i++) {
+        (*lits)[*n][i] = (char)tolower((unsigned char)str[i]);
+    }
+
+    (*n)++;
+    (*lits)[*n] = NULL;
+}
+
+static void rp_free_list(char **lits)
+{
+    char **lit;
+
+    if (!lits) {
+        return;
+    }
+
+    for (lit = lits; *lit; lit++) {
+        free(*lit);
+    }
+    free(lits);
+}
+
+/* Literals of an OSMatch pattern: one per alternative, the longest
+ * ASCII run (matching is caseless and Unicode aware).
+ * Returns NULL if some alternative does not need any literal.
+ */
+static char **rp_match_literals(const char *pattern)
+{
+    char **lits = NULL;
+    size_t n = 0;
+    const char *alt = pattern;
+
+    while (1) {
+        const char *end = strchr(alt, '|');
+        const char *start = alt;
+        const char *stop;
+        const char *p;
+        const char *best = NULL;
+        const char *run = NULL;
+        size_t best_len = 0;
+
+        if (!end) {
+            end = alt + strlen(alt);
+        }
+        stop = end;
+
+        if (start < stop && *start == '^') {
+            start++;
+        }
+        if (stop > start && stop[-1] == '$') {
+            stop--;
+        }
+
+        for (p = start; p <= stop; p++) {
+            if (p < stop && (*p == '^' || *p == '$')) {
+                rp_free_list(lits);
+                return (NULL);
+            }
+
+            if (p < stop && !(*p & 0x80)) {
+                if (!run) {
+                    run = p;
+                }
+            } else if (run) {
+                if ((size_t)(p - run) > best_len) {
+                    best = run;
+                    best_len = (size_t)(p - run);
+                }
+                run = NULL;
+            }
+        }
+
+        if (best_len == 0) {
+            rp_free_list(lits);
+            return (NULL);
+        }
+        rp_push(&lits, &n, best, best_len);
+
+        if (*end == '\0') {
+            break;
+        }
+        alt = end + 1;
+    }
+
+    return (lits);
+}
+
+/* Skip a character class. Returns the character after it */
+static const char *rp_skip_class(const char *p)
+{
+    p++;
+    if (*p == '^') {
+        p++;
+    }
+    if (*p == ']') {
+        p++;
+    }
+
+    while (*p) {
+        if (*p == '\\') {
+            if (!p[1]) {
+                return (NULL);
+            }
+            p += 2;
+        } else if (p[0] == '[' && p[1] == ':') {
+            const char *end = strstr(p + 2, ":]");
+            if (!end) {
+                return (NULL);
+            }
+            p = end + 2;
+        } else if (*p == ']') {
+            return (p + 1);
+        } else {
+            p++;
+        }
+    }
+
+    return (NULL);
+}
+
+/* Skip a group. Returns the character after it */
+static const char *rp_skip_group(const char *p)
+{
+    int depth = 0;
+
+    while (*p) {
+        if (*p == '\\') {
+            if (!p[1]) {
+                return (NULL);
+            }
+            p += 2;
+            continue;
+        } else if (*p == '[') {
+            if ((p = rp_skip_class(p)) == NULL) {
+                return (NULL);
+            }
+            continue;
+        } else if (*p == '(') {
+            depth++;
+        } else if (*p == ')') {
+            if (--depth == 0) {
+                return (p + 1);
+            }
+        }
+        p++;
+    }
+
+    return (NULL);
+}
+
+/* Skip a {n,m} quantifier. Returns NULL if p is a literal brace */
+static const char *rp_skip_quantifier(const char *p)
+{
+    for (p++; *p; p++) {
+        if (*p == '}') {
+            return (p + 1);
+        }
+        if (!isdigit((unsigned char)*p) && *p != ',' && *p != ' ') {
+            break;
+        }
+    }
+
+    return (NULL);
+}
+
+/* Literals of a PCRE2 pattern: one per top level alternative, the
+ * longest run of characters every match of the alternative contains.
+ * Returns NULL if some alternative does not need any literal or if
+ * the pattern uses a syntax that is not understood here.
+ */
+static char **rp_pcre2_literals(const char *pattern)
+{
+    char **lits = NULL;
+    size_t n = 0;
+    const char *p = pattern;
+    char *run;
+    char *best;
+    size_t run_len = 0;
+    size_t best_len = 0;
+
+/* End the current run of literal characters */
+#define RP_END_RUN() do { \
+        if (run_len > best_len) { \
+            memcpy(best, run, run_len); \
+            best_len = run_len; \
+        } \
+        run_len = 0; \
+    } while (0)
+
+    /* Comments, quoting and verbs */
+    if (strstr(pattern, "(?#") || strstr(pattern, "\\Q") ||
+            strstr(pattern, "(*")) {
+        return (NULL);
+    }
+
+    os_calloc(strlen(pattern) + 1, sizeof(char), run);
+    os_calloc(strlen(pattern) + 1, sizeof(char), best);
+
+    while (1) {
+        const char *q;
+
+        switch (*p) {
+            case '\0':
+            case '|':
+                RP_END_RUN();
+                if (best_len == 0) {
+                    goto fail;
+                }
+                rp_push(&lits, &n, best, best_len);
+                best_len = 0;
+
+                if (*p == '\0') {
+                    free(run);
+                    free(best);
+                    return (lits);
+                }
+                p++;
+                break;
+
+            case '\\':
+                p++;
+                if (*p == '\0') {
+                    goto fail;
+                }
+
+                if (isalnum((unsigned char)*p)) {
+                    /* Classes, assertions and single characters. The
+                     * others (\x, \p, \g, back references...) go on after
+                     * the next character.
+                     */
+                    if (!strchr("dDwWsSbBhHvVRAzZGKXCEtnrfae", *p)) {
+                        goto fail;
+                    }
+                    RP_END_RUN();
+                } else if (*p & 0x80) {
+                    RP_END_RUN();
+                } else {
+                    run[run_len++] = *p;
+                }
+                p++;
+                break;
+
+            case '(':
+                /* Options set for the rest of the pattern */
+                if (p[1] == '?') {
+                    for (q = p + 2; isalpha((unsigned char)*q) || *q == '-' ||
+                            *q == '^'; q++) {
+                        if (*q == 'x') {
+                            goto fail;
+                        }
+                    }
+                }
+
+                RP_END_RUN();
+                if ((p = rp_skip_group(p)) == NULL) {
+                    goto fail;
+                }
+                break;
+
+            case '[':
+                RP_END_RUN();
+                if ((p = rp_skip_class(p)) == NULL) {
+                    goto fail;
+                }
+                break;
+
+            case '*':
+            case '+':
+            case '?':
+                if (run_len) {
+                    run_len--;
+                }
+                RP_END_RUN();
+                p++;
+                break;
+
+            case '{':
+                if (run_len) {
+                    run_len--;
+                }
+                RP_END_RUN();
+                if ((q = rp_skip_quantifier(p)) != NULL) {
+                    p = q;
+                } else {
+                    p++;
+                }
+                break;
+
+            case '.':
+            case '^':
+            case '$':
+                RP_END_RUN();
+                p++;
+                break;
+
+            case ')':
+                goto fail;
+
+            default:
+                if (*p & 0x80) {
+                    RP_END_RUN();
+                } else {
+                    run[run_len++] = *p;
+                }
+                p++;
+                break;
+        }
+    }
+
+#undef RP_END_RUN
+
+fail:
+    free(run);
+    free(best);
+    rp_free_list(lits);
+    return (NULL);
+}
+
+static void rp_lits_add(rp_lits *l, char **lits, int rule)
+{
+    char **lit;
+
+    for (lit = lits; *lit; lit++) {
+        os_realloc(l->str, (l->size + 1) * sizeof(char *), l->str);
+        os_realloc(l->rule, (l->size + 1) * sizeof(int), l->rule);
+        l->str[l->size] = *lit;
+        l->rule[l->size] = rule;
+        l->size++;
+    }
+
+    /* The strings now belong to l */
+    free(lits);
+}
+
+static void rp_lits_free(rp_lits *l)
+{
+    int i;
+
+    for (i = 0; i < l->size; i++) {
+        free(l->str[i]);
+    }
+    free(l->str);
+    free(l->rule);
+}
+
+/* Build the automaton of a set of literals */
+static rp_ac *rp_ac_build(const rp_lits *l)
+{
+    rp_ac *ac;
+    int max_states = 1;
+    int *lit_of;
+    int *fail;
+    int *queue;
+    int head = 0;
+    int tail = 0;
+    int i;
+    int c;
+
+    if (l->size == 0) {
+        return (NULL);
+    }
+
+    os_calloc(1, sizeof(rp_ac), ac);
+
+    /* Byte classes. Literals are lowercase, events are not */
+    ac->nclass = 1;
+    for (i = 0; i < l->size; i++) {
+        const unsigned char *s;
+
+        for (s = (const unsigned char *)l->str[i]; *s; s++) {
+            if (!ac->cls[*s]) {
+                ac->cls[*s] = (unsigned char)ac->nclass;
+                if (islower(*s)) {
+                    ac->cls[toupper(*s)] = (unsigned char)ac->nclass;
+                }
+                ac->nclass++;
+            }
+        }
+        max_states += (int)strlen(l->str[i]);
+    }
+
+    os_calloc((size_t)max_states * (size_t)ac->nclass, sizeof(int), ac->next);
+    os_calloc(max_states, sizeof(int), ac->term);
+    os_calloc(max_states, sizeof(int), ac->dict);
+    os_calloc(l->size, sizeof(int), lit_of);
+
+    for (i = 0; i < max_states; i++) {
+        ac->term[i] = -1;
+        ac->dict[i] = -1;
+    }
+
+    /* Trie */
+    ac->nstates = 1;
+    for (i = 0; i < l->size; i++) {
+        const unsigned char *s;
+        int state = 0;
+
+        for (s = (const unsigned char *)l->str[i]; *s; s++) {
+            int *t = &ac->next[state * ac->nclass + ac->cls[*s]];
+            if (!*t) {
+                *t = ac->nstates++;
+            }
+            state = *t;
+        }
+
+        if (ac->term[state] < 0) {
+            ac->term[state] = ac->nlits++;
+        }
+        lit_of[i] = ac->term[state];
+    }
+
+    /* Rules of each literal */
+    os_calloc(ac->nlits + 1, sizeof(int), ac->lit_first);
+    os_calloc(l->size, sizeof(int), ac->lit_rules);
+    os_calloc(ac->nlits, sizeof(unsigned int), ac->lit_stamp);
+
+    for (i = 0; i < l->size; i++) {
+        ac->lit_first[lit_of[i] + 1]++;
+    }
+    for (i = 0; i < ac->nlits; i++) {
+        ac->lit_first[i + 1] += ac->lit_first[i];
+    }
+    {
+        int *pos;
+
+        os_calloc(ac->nlits, sizeof(int), pos);
+        for (i = 0; i < l->size; i++) {
+            ac->lit_rules[ac->lit_first[lit_of[i]] + pos[lit_of[i]]++] = l->rule[i];
+        }
+        free(pos);
+    }
+
+    /* Failure links, breadth first */
+    os_calloc(ac->nstates, sizeof(int), fail);
+    os_calloc(ac->nstates, sizeof(int), queue);
+
+    for (c = 0; c < ac->nclass; c++) {
+        if (ac->next[c]) {
+            queue[tail++] = ac->next[c];
+        }
+    }
+
+    while (head < tail) {
+        int s = queue[head++];
+
+        for (c = 0; c < ac->nclass; c++) {
+            int *t = &ac->next[s * ac->nclass + c];
+            int f = ac->next[fail[s] * ac->nclass + c];
+
+            if (*t) {
+                fail[*t] = f;
+                ac->dict[*t] = ac->term[f] >= 0 ? f : ac->dict[f];
+                queue[tail++] = *t;
+            } else {
+                *t = f;
+            }
+        }
+    }
+
+    os_realloc(ac->next, (size_t)ac->nstates * (size_t)ac->nclass * sizeof(int),
+               ac->next);
+
+    free(queue);
+    free(fail);
+    free(lit_of);
+
+    return (ac);
+}
+
+/* Mark the rules with a literal in str.
+ * Returns 0 if str is not ASCII (it can match the rules caselessly
+ * without containing their literals).
+ */
+static int rp_ac_scan(rp_ac *ac, const char *str, unsigned int *hits,
+                      unsigned int stamp)
+{
+    const unsigned char *p;
+    int state = 0;
+
+    for (p = (const unsigned char *)str; *p; p++) {
+        int t;
+
+        if (*p & 0x80) {
+            return (0);
+        }
+
+        state = ac->next[state * ac->nclass + ac->cls[*p]];
+
+        for (t = ac->term[state] >= 0 ? state : ac->dict[state];
+                t >= 0; t = ac->dict[t]) {
+            int lit = ac->term[t];
+            int i;
+
+            /* The rest of the chain was marked with it */
+            if (ac->lit_stamp[lit] == stamp) {
+                break;
+            }
+            ac->lit_stamp[lit] = stamp;
+
+            for (i = ac->lit_first[lit]; i < ac->lit_first[lit + 1]; i++) {
+                hits[ac->lit_rules[i]] = stamp;
+            }
+        }
+    }
+
+    return (1);
+}
+
+/* Build the prefilter of a list, and of the lists below it */
+static RulePrefilter *rp_build(RuleNode *list)
+{
+    RulePrefilter *pf;
+    RuleNode *node;
+    rp_lits log_lits = { NULL, NULL, 0 };
+    rp_lits pname_lits = { NULL, NULL, 0 };
+    int filtered = 0;
+    int size = 0;
+    int i;
+
+    for (node = list; node; node = node->next) {
+        if (node->child) {
+            node->child_prefilter = rp_build(node->child);
+        }
+        size++;
+    }
+
+    if (size < RP_MIN_RULES) {
+        return (NULL);
+    }
+
+    os_calloc(1, sizeof(RulePrefilter), pf);
+    pf->size = size;
+    os_calloc(size, sizeof(RuleNode *), pf->nodes);
+    os_calloc(size, sizeof(unsigned char), pf->flags);
+
+    for (node = list, i = 0; node; node = node->next, i++) {
+        RuleInfo *rule = node->ruleinfo;
+        char **lits = NULL;
+
+        pf->nodes[i] = node;
+
+        if (rule->decoded_as) {
+            if (rule->decoded_as > pf->max_dec) {
+                pf->max_dec = rule->decoded_as;
+            }
+            filtered = 1;
+        }
+
+        if (rule->program_name || rule->program_name_pcre2) {
+            pf->flags[i] |= RP_NEED_PNAME;
+
+            if (rule->program_name_pattern) {
+                lits = rule->program_name ?
+                       rp_match_literals(rule->program_name_pattern) :
+                       rp_pcre2_literals(rule->program_name_pattern);
+            }
+            if (lits) {
+                pf->flags[i] |= RP_PNAME;
+                rp_lits_add(&pname_lits, lits, i);
+            }
+            filtered = 1;
+        }
+
+        lits = NULL;
+        if (rule->match_pattern) {
+            if (rule->match) {
+                lits = rp_match_literals(rule->match_pattern);
+            } else if (rule->match_pcre2) {
+                lits = rp_pcre2_literals(rule->match_pattern);
+            }
+        }
+        if (!lits && rule->pcre2 && rule->pcre2_pattern) {
+            lits = rp_pcre2_literals(rule->pcre2_pattern);
+        }
+        if (lits) {
+            pf->flags[i] |= RP_LOG;
+            rp_lits_add(&log_lits, lits, i);
+            filtered = 1;
+        }
+    }
+
+    if (!filtered) {
+        free(pf->nodes);
+        free(pf->flags);
+        free(pf);
+        return (NULL);
+    }
+
+    /* Rules by decoder */
+    os_calloc(pf->max_dec + 2, sizeof(int), pf->dec_first);
+    os_calloc(size, sizeof(int), pf->dec_rules);
+    os_calloc(size, sizeof(int), pf->any);
+
+    for (i = 0; i < size; i++) {
+        u_int16_t dec = pf->nodes[i]->ruleinfo->decoded_as;
+        if (dec) {
+            pf->dec_first[dec + 1]++;
+        } else {
+            pf->any[pf->n_any++] = i;
+        }
+    }
+    for (i = 0; i <= pf->max_dec; i++) {
+        pf->dec_first[i + 1] += pf->dec_first[i];
+    }
+    {
+        int *pos;
+
+        os_calloc(pf->max_dec + 1, sizeof(int), pos);
+        for (i = 0; i < size; i++) {
+            u_int16_t dec = pf->nodes[i]->ruleinfo->decoded_as;
+            if (dec) {
+                pf->dec_rules[pf->dec_first[dec] + pos[dec]++] = i;
+            }
+        }
+        free(pos);
+    }
+
+    pf->log_ac = rp_ac_build(&log_lits);
+    pf->pname_ac = rp_ac_build(&pname_lits);
+    rp_lits_free(&log_lits);
+    rp_lits_free(&pname_lits);
+
+    os_calloc(size, sizeof(unsigned int), pf->log_hit);
+    os_calloc(size, sizeof(unsigned int), pf->pname_hit);
+
+    return (pf);
+}
+
+void OS_BuildRulePrefilters()
+{
+    top_prefilter = rp_build(OS_GetFirstRule());
+}
+
+RulePrefilter *OS_GetFirstRulePrefilter()
+{
+    return (top_prefilter);
+}
+
+static RuleNode *rp_next(RuleCandidates *it)
+{
+    RulePrefilter *pf = it->pf;
+
+    while (1) {
+        int i;
+        unsigned char flags;
+
+        if (it->any < it->any_end &&
+                (it->dec == it->dec_end || *it->any < *it->dec)) {
+            i = *it->any++;
+        } else if (it->dec < it->dec_end) {
+            i = *it->dec++;
+        } else {
+            return (NULL);
+        }
+
+        flags = pf->flags[i];
+
+        if ((flags & RP_NEED_PNAME) && !pf->has_pname) {
+            continue;
+        }
+        if ((flags & RP_PNAME) && pf->pname_on &&
+                pf->pname_hit[i] != pf->stamp) {
+            continue;
+        }
+        if ((flags & RP_LOG) && pf->log_on &&
+                pf->log_hit[i] != pf->stamp) {
+            continue;
+        }
+
+        return (pf->nodes[i]);
+    }
+}
+
+RuleNode *OS_FirstRuleCandidate(RulePrefilter *pf, RuleNode *list,
+                                const Eventinfo *lf, RuleCandidates *it)
+{
+    u_int16_t dec;
+
+    it->pf = pf;
+    if (!pf) {
+        return (list);
+    }
+
+    /* New event */
+    if (++pf->stamp == 0) {
+        memset(pf->log_hit, 0, pf->size * sizeof(unsigned int));
+        memset(pf->pname_hit, 0, pf->size * sizeof(unsigned int));
+        if (pf->log_ac) {
+            memset(pf->log_ac->lit_stamp, 0,
+                   pf->log_ac->nlits * sizeof(unsigned int));
+        }
+        if (pf->pname_ac) {
+            memset(pf->pname_ac->lit_stamp, 0,
+                   pf->pname_ac->nlits * sizeof(unsigned int));
+        }
+        pf->stamp = 1;
+    }
+
+    pf->log_on = pf->log_ac && lf->log &&
+                 rp_ac_scan(pf->log_ac, lf->log, pf->log_hit, pf->stamp);
+
+    pf->has_pname = lf->program_name != NULL;
+    pf->pname_on = pf->pname_ac && lf->program_name &&
+                   rp_ac_scan(pf->pname_ac, lf->program_name, pf->pname_hit,
+                              pf->stamp);
+
+    it->any = pf->any;
+    it->any_end = pf->any + pf->n_any;
+
+    dec = lf->decoder_info ? lf->decoder_info->id : 0;
+    if (dec && dec <= pf->max_dec) {
+        it->dec = pf->dec_rules + pf->dec_first[dec];
+        it->dec_end = pf->dec_rules + pf->dec_first[dec + 1];
+    } else {
+        it->dec = it->dec_end = NULL;
+    }
+
+    return (rp_next(it));
+}
+
+RuleNode *OS_NextRuleCandidate(RuleNode *node, RuleCandidates *it)
+{
+    if (!it->pf) {
+        return (node->next);
+    }
+
+    return (rp_next(it));
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Rule prefilters
+ *
+ * Every event is checked against the rules of a list (the top level
+ * rules or the children of a rule) in order, until one matches. Most
+ * rules are rejected by their first checks: decoded_as, program_name
+ * and match/pcre2. A prefilter indexes these checks for a whole list:
+ * the rules by decoder and the literal strings every match of their
+ * patterns must contain, in two Aho-Corasick automatons (one for the
+ * program name, one for the log). The event is scanned once and only
+ * the rules that can still match are tried, in the original order.
+ *
+ * The prefilters keep per event state: they must only be used from
+ * the thread running the rules.
+ */
+
+#ifndef __RULES_PREFILTER_H
+#define __RULES_PREFILTER_H
+
+#include "eventinfo.h"
+
+typedef struct _RulePrefilter RulePrefilter;
+
+/* Position in the candidates of a list */
+typedef struct _RuleCandidates {
+    RulePrefilter *pf;
+    const int *any;         /* Rules accepting any decoder */
+    const int *any_end;
+    const int *dec;         /* Rules for the decoder of the event */
+    const int *dec_end;
+} RuleCandidates;
+
+/* Build the prefilters of the top level rules and of every children
+ * list (after all the rules are loaded)
+ */
+void OS_BuildRulePrefilters(void);
+
+/* Prefilter of the top level rules (NULL if there is none) */
+RulePrefilter *OS_GetFirstRulePrefilter(void);
+
+/* Iterate over the rules of a list that can match an event.
+ * Without a prefilter, every rule of the list is returned.
+ */
+RuleNode *OS_FirstRuleCandidate(RulePrefilter *pf, RuleNode *list,
+                                const Eventinfo *lf, RuleCandidates *it);
+RuleNode *OS_NextRuleCandidate(RuleNode *node, RuleCandidates *it);
+
+#endif /* __RULES_PREFILTER_H */
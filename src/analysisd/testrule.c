@@ -21,6 +21,8 @@
 #include "active-response.h"
 #include "config.h"
 #include "rules.h"
+#include "rules_prefilter.h"
+#include "correlation.h"
 #include "stats.h"
 #include "eventinfo.h"
 #include "accumulator.h"
@@ -309,6 +311,23 @@ int main(int argc, char **argv)
         AddHash_Rule(tmp_node);
     }
 
+    /* Index the decoders by program name */
+    if (getDefine_Int("analysisd", "decoder_index", 0, 1)) {
+        OS_IndexOSDecoders();
+    }
+
+    /* Index the rules by decoder and literals. The verbose output
+     * shows every rule tried, so it keeps trying all of them.
+     */
+    if (!full_output && getDefine_Int("analysisd", "rule_prefilter", 0, 1)) {
+        OS_BuildRulePrefilters();
+    }
+
+    /* Index the events of the frequency rules by their context */
+    if (getDefine_Int("analysisd", "correlation_index", 0, 1)) {
+        OS_BuildCorrelation();
+    }
+
     if (test_config == 1) {
         exit(0);
     }
@@ -392,14 +411,7 @@ void OS_ReadMSG(char *ut_str)
 
     /* Daemon loop */
     while (1) {
-        lf = (Eventinfo *)calloc(1, sizeof(Eventinfo));
-        os_calloc(Config.decoder_order_size, sizeof(char*), lf->fields);
-
-
-        /* This shouldn't happen */
-        if (lf == NULL) {
-            ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
-        }
+        lf = New_Eventinfo();
 
         /* Fix the msg */
         snprintf(msg, 15, "1:stdin:");
@@ -407,6 +419,7 @@ void OS_ReadMSG(char *ut_str)
         /* Receive message from queue */
         if (fgets(msg + 8, OS_MAXSTR - 8, stdin)) {
             RuleNode *rulenode_pt;
+            RuleCandidates candidates;
 
             /* Get the time we received the event */
             c_time = time(NULL);
@@ -418,6 +431,7 @@ void OS_ReadMSG(char *ut_str)
 
             /* Make sure we ignore blank lines */
             if (strlen(msg) < 10) {
+                Free_Eventinfo(lf);
                 continue;
             }
 
@@ -466,7 +480,11 @@ void OS_ReadMSG(char *ut_str)
             }
 #endif
 
-            do {
+            for (rulenode_pt = OS_FirstRuleCandidate(
+                        lf->decoder_info->type == OSSEC_ALERT ? NULL : OS_GetFirstRulePrefilter(),
+                        rulenode_pt, lf, &candidates);
+                    rulenode_pt;
+                    rulenode_pt = OS_NextRuleCandidate(rulenode_pt, &candidates)) {
                 if (lf->decoder_info->type == OSSEC_ALERT) {
                     if (!lf->generated_rule) {
                         break;
@@ -571,11 +589,12 @@ void OS_ReadMSG(char *ut_str)
                         i++;
                     }
                 }
+                OS_CorrAddEvent(lf, currently_rule);
 
                 OS_AddEvent(lf);
                 break;
 
-            } while ((rulenode_pt = rulenode_pt->next) != NULL);
+            }
 
             if (ut_str) {
                 /* Set up exit code if we are doing unit testing */
@@ -20,6 +20,8 @@ void AgentdStart(const char *dir, int uid, int gid, const char *user, const char
 {
     int rc = 0;
     int maxfd = 0;
+    long batch_timeout;
+    long spool_delay;
     fd_set fdset;
     struct timeval fdtimeout;
 
@@ -106,6 +108,9 @@ void AgentdStart(const char *dir, int uid, int gid, const char *user, const char
     OS_ReadKeys(&keys);
     OS_StartCounter(&keys);
 
+    /* Events spooled by the last run */
+    spool_init();
+
     os_write_agent_info(keys.keyentries[0]->name, NULL, keys.keyentries[0]->id,
                         agt->profile);
 
@@ -171,6 +176,24 @@ void AgentdStart(const char *dir, int uid, int gid, const char *user, const char
         fdtimeout.tv_sec = 1;
         fdtimeout.tv_usec = 0;
 
+        /* Wake up to send the batched events in time */
+        batch_timeout = events_timeout();
+        if (batch_timeout == 0) {
+            flush_events();
+        } else if (batch_timeout > 0 && batch_timeout < 1000) {
+            fdtimeout.tv_sec = 0;
+            fdtimeout.tv_usec = batch_timeout * 1000;
+        }
+
+        /* And the spooled ones, at their rate */
+        spool_send();
+        spool_delay = spool_timeout();
+        if (spool_delay >= 0 &&
+                spool_delay * 1000 < fdtimeout.tv_sec * 1000000 + fdtimeout.tv_usec) {
+            fdtimeout.tv_sec = 0;
+            fdtimeout.tv_usec = spool_delay * 1000;
+        }
+
         /* Continuously send notifications */
 #ifdef WIN32
         run_notify();
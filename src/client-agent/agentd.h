@@ -17,6 +17,28 @@
 #include <imsg.h>
 #endif //WIN32
 
+/* Event spool */
+#ifndef WIN32
+#define SPOOL_DIR       "/queue/spool"
+#else
+#define SPOOL_DIR       "spool"
+#endif
+#define SPOOL_INDEX     "index"
+
+/* Segments of the event spool */
+typedef struct _spool_queue {
+    const char *dir;        /* Kept by the caller */
+    long segment_size;
+    FILE *index_fp;
+    FILE *head_fp;          /* Segment being read */
+    FILE *tail_fp;          /* Segment being written */
+    unsigned int head;      /* Sequence of the first segment */
+    unsigned int tail;      /* And of the last one */
+    long head_offset;       /* Sent from the first segment */
+    long tail_size;
+    unsigned long size;     /* Bytes waiting to be sent */
+} spool_queue;
+
 /*** Function Prototypes ***/
 
 /* Client configuration */
@@ -44,6 +66,37 @@ int intcheck_file(const char *file_name, const char *dir);
 /* Send message to server */
 int send_msg(int agentid, const char *msg);
 
+/* Send an event to the server, batched with the next ones */
+int send_event(const char *msg);
+
+/* Send the events batched */
+int flush_events(void);
+
+/* Milliseconds until the batch must be sent, or -1 if it is empty */
+long events_timeout(void);
+
+/* Event spool */
+void spool_init(void);
+int spool_write(const char *msg) __attribute__((nonnull));
+void spool_send(void);
+int spool_active(void);
+long spool_timeout(void);
+void spool_server(int available);
+int spool_server_down(void);
+void spool_wait(unsigned int seconds);
+
+/* Segments of the event spool */
+int spool_queue_open(spool_queue *q, const char *dir, long segment_size) __attribute__((nonnull));
+void spool_queue_close(spool_queue *q) __attribute__((nonnull));
+void spool_queue_clear(spool_queue *q) __attribute__((nonnull));
+void spool_queue_save(spool_queue *q) __attribute__((nonnull));
+int spool_queue_write(spool_queue *q, const char *msg) __attribute__((nonnull));
+int spool_queue_open_head(spool_queue *q) __attribute__((nonnull));
+int spool_queue_read(spool_queue *q, char *event) __attribute__((nonnull));
+void spool_queue_sent(spool_queue *q) __attribute__((nonnull));
+void spool_queue_rewind(spool_queue *q) __attribute__((nonnull));
+int spool_queue_next(spool_queue *q) __attribute__((nonnull));
+
 /* Extract the shared files */
 char *getsharedfiles(void);
 
@@ -20,20 +20,40 @@
 void *EventForward(void)
 {
     ssize_t recv_b;
-    char msg[OS_MAXSTR + 1];
+    char msg[MQ_BATCH_MAXSIZE + 1];
+    char tmp_msg[OS_MAXSTR + 1];
+    mq_record record;
 
     /* Initialize variables */
     msg[0] = '\0';
-    msg[OS_MAXSTR] = '\0';
+    msg[MQ_BATCH_MAXSIZE] = '\0';
+    tmp_msg[OS_MAXSTR] = '\0';
 
-    while ((recv_b = recv(agt->m_queue, msg, OS_MAXSTR, MSG_DONTWAIT)) > 0) {
+    while ((recv_b = recv(agt->m_queue, msg, MQ_BATCH_MAXSIZE, MSG_DONTWAIT)) > 0) {
         msg[recv_b] = '\0';
 
-        send_msg(0, msg);
+        /* Forward each message of a batch on its own */
+        if (IsMQBatch(msg, (size_t)recv_b)) {
+            size_t pos = 0;
+
+            while (ReadMQBatch(msg, (size_t)recv_b, &pos, &record) > 0) {
+                snprintf(tmp_msg, OS_MAXSTR, "%c:%s:%s", record.loc,
+                         record.location, record.message);
+                send_event(tmp_msg);
+            }
+        } else {
+            msg[OS_MAXSTR] = '\0';
+            send_event(msg);
+        }
 
         run_notify();
     }
 
+    /* The queue is empty: send the batch if it waited long enough */
+    if (events_timeout() == 0) {
+        flush_events();
+    }
+
     return (NULL);
 }
 
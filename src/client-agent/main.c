@@ -129,6 +129,14 @@ int main(int argc, char **argv)
         }
     }
 
+    /* Get how the events are batched */
+    agt->batch_size = getDefine_Int("agent", "batch_size", 0, SECMSG_BATCH_MAXSIZE);
+    agt->batch_latency = getDefine_Int("agent", "batch_latency", 0, 5000);
+
+    /* Get the size and rate of the event spool */
+    agt->spool_size = getDefine_Int("agent", "spool_size", 0, 4194304);
+    agt->spool_eps = getDefine_Int("agent", "spool_eps", 1, 100000);
+
     /* Read config */
     if (ClientConf(cfg) < 0) {
         ErrorExit(CLIENT_ERROR, ARGV0);
@@ -15,6 +15,7 @@
 
 #ifndef WIN32
 static time_t g_saved_time = 0;
+static int reconnecting = 0;
 static char *rand_keepalive_str2(char *dst, int size);
 
 static char *rand_keepalive_str2(char *dst, int size)
@@ -71,18 +72,44 @@ void run_notify()
     keep_alive_random[0] = '\0';
     curr_time = time(0);
 
+    /* Called again from the events received while reconnecting */
+    if (reconnecting) {
+        return;
+    }
+
 #ifndef ONEWAY_ENABLED
-    /* Check if the server has responded */
-    if ((curr_time - available_server) > agt->max_time_reconnect_try) {
-        /* If response is not available, set lock and wait for it */
-        verbose(SERVER_UNAV, ARGV0);
-        os_setwait();
+    /* Check if the server has responded (or a message failed) */
+    if ((curr_time - available_server) > agt->max_time_reconnect_try ||
+            spool_server_down()) {
+        reconnecting = 1;
+
+        /* If response is not available, spool the events or set lock
+         * and wait for it
+         */
+        if (agt->spool_size > 0) {
+            verbose(SERVER_UNAV_SPOOL, ARGV0);
+            spool_server(0);
+        } else {
+            verbose(SERVER_UNAV, ARGV0);
+            os_setwait();
+        }
 
         /* Send sync message */
         start_agent(0);
 
         verbose(SERVER_UP, ARGV0);
-        os_delwait();
+        if (agt->spool_size > 0) {
+            spool_server(1);
+        } else {
+            os_delwait();
+        }
+
+        reconnecting = 0;
+    }
+#else
+    /* No reply to wait for: try to send the spool again */
+    if (spool_server_down()) {
+        spool_server(1);
     }
 #endif
 
@@ -11,6 +11,11 @@
 #include "agentd.h"
 #include "os_net/os_net.h"
 
+/* Events waiting to be sent in a batch */
+static char batch_msg[SECMSG_BATCH_MAXSIZE + 1];
+static size_t batch_used = 0;
+static struct timeval batch_time;
+
 
 /* Send a message to the server */
 int send_msg(int agentid, const char *msg)
@@ -34,3 +39,117 @@ int send_msg(int agentid, const char *msg)
     return (0);
 }
 
+
+/* Spool the events batched, when they could not be sent */
+static void spool_events()
+{
+    char event[OS_MAXSTR + 1];
+    size_t pos = 0;
+
+    while (ReadSecMSGBatch(batch_msg, &pos, event) == 1) {
+        spool_write(event);
+    }
+
+    batch_used = 0;
+}
+
+/* Send an event on its own, spooling it if the server is not available */
+static int send_event_now(const char *msg)
+{
+    if (send_msg(0, msg) == 0) {
+        return (0);
+    }
+
+    if (agt->spool_size <= 0) {
+        return (-1);
+    }
+
+    spool_server(0);
+    return (spool_write(msg));
+}
+
+/* Send an event to the server, in a batch if they are enabled */
+int send_event(const char *msg)
+{
+    /* Spooled after the ones already in the spool */
+    if (spool_active()) {
+        if (batch_used > 0) {
+            spool_events();
+        }
+        return (spool_write(msg));
+    }
+
+    if (agt->batch_size <= 0) {
+        return (send_event_now(msg));
+    }
+
+    if (batch_used == 0) {
+        gettimeofday(&batch_time, NULL);
+    }
+
+    if (AddSecMSGBatch(batch_msg, &batch_used, (size_t)agt->batch_size, msg) == 0) {
+        return (0);
+    }
+
+    /* Full: send it and start another */
+    flush_events();
+    if (spool_active()) {
+        return (spool_write(msg));
+    }
+    gettimeofday(&batch_time, NULL);
+
+    if (AddSecMSGBatch(batch_msg, &batch_used, (size_t)agt->batch_size, msg) == 0) {
+        return (0);
+    }
+
+    /* Too large for a batch */
+    return (send_event_now(msg));
+}
+
+/* Send the events batched */
+int flush_events()
+{
+    if (batch_used == 0) {
+        return (0);
+    }
+
+    if (spool_active()) {
+        spool_events();
+        return (0);
+    }
+
+    if (send_msg(0, batch_msg) < 0) {
+        if (agt->spool_size > 0) {
+            spool_server(0);
+            spool_events();
+            return (0);
+        }
+
+        batch_used = 0;
+        return (-1);
+    }
+
+    batch_used = 0;
+    return (0);
+}
+
+/* Milliseconds until the batch must be sent, or -1 if it is empty */
+long events_timeout()
+{
+    struct timeval now;
+    long elapsed;
+
+    if (batch_used == 0) {
+        return (-1);
+    }
+
+    gettimeofday(&now, NULL);
+    elapsed = (now.tv_sec - batch_time.tv_sec) * 1000 +
+              (now.tv_usec - batch_time.tv_usec) / 1000;
+
+    if (elapsed >= agt->batch_latency) {
+        return (0);
+    }
+
+    return (agt->batch_latency - elapsed);
+}
@@ -0,0 +1,270 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Segments of the event spool
+ *
+ * The events are appended to the segment files of a directory as
+ * "<size>:<event>\n". The segments are named by their sequence number,
+ * and the index file has the first and last ones and the offset sent
+ * from the first one.
+ */
+
+#include "shared.h"
+#include "agentd.h"
+
+static void spool_segment(const spool_queue *q, unsigned int seq, char *path) __attribute__((nonnull));
+
+
+/* Path of a segment (of OS_FLSIZE + 1 bytes) */
+static void spool_segment(const spool_queue *q, unsigned int seq, char *path)
+{
+    snprintf(path, OS_FLSIZE + 1, "%s/%08u", q->dir, seq);
+}
+
+/* Write the index, at the beginning of the file */
+void spool_queue_save(spool_queue *q)
+{
+    if (!q->index_fp) {
+        return;
+    }
+
+    fseek(q->index_fp, 0, SEEK_SET);
+    fprintf(q->index_fp, "%010u %010u %020ld\n", q->head, q->tail,
+            q->head_offset);
+    fflush(q->index_fp);
+}
+
+/* Open the spool of dir left by the last run. dir must be kept until
+ * the spool is closed.
+ * Returns 0 on success or -1 if the index cannot be opened.
+ */
+int spool_queue_open(spool_queue *q, const char *dir, long segment_size)
+{
+    char path[OS_FLSIZE + 1];
+    unsigned int seq;
+    struct stat st;
+
+    memset(q, 0, sizeof(spool_queue));
+    q->dir = dir;
+    q->segment_size = segment_size;
+
+    snprintf(path, OS_FLSIZE + 1, "%s/%s", dir, SPOOL_INDEX);
+
+    q->head = 1;
+    q->tail = 0;
+
+    if ((q->index_fp = fopen(path, "r+")) != NULL) {
+        if (fscanf(q->index_fp, "%u %u %ld", &q->head, &q->tail,
+                   &q->head_offset) != 3 || q->head_offset < 0) {
+            merror("%s: ERROR: Invalid spool index '%s'. Discarding it.",
+                   ARGV0, path);
+            q->head = 1;
+            q->tail = 0;
+            q->head_offset = 0;
+        }
+    } else if ((q->index_fp = fopen(path, "w")) == NULL) {
+        merror(FOPEN_ERROR, ARGV0, path, errno, strerror(errno));
+        return (-1);
+    }
+
+    /* Events left to be sent */
+    for (seq = q->head; seq <= q->tail && seq != 0; seq++) {
+        spool_segment(q, seq, path);
+        if (stat(path, &st) == 0) {
+            q->size += (unsigned long)st.st_size;
+        }
+    }
+
+    if (q->size > (unsigned long)q->head_offset) {
+        q->size -= (unsigned long)q->head_offset;
+    } else {
+        spool_queue_clear(q);
+    }
+
+    /* The last segment is never appended to again: a record may have
+     * been cut there
+     */
+    q->tail_size = segment_size;
+    spool_queue_save(q);
+
+    return (0);
+}
+
+/* Close the files, keeping the spool for the next run */
+void spool_queue_close(spool_queue *q)
+{
+    if (q->head_fp) {
+        fclose(q->head_fp);
+        q->head_fp = NULL;
+    }
+    if (q->tail_fp) {
+        fclose(q->tail_fp);
+        q->tail_fp = NULL;
+    }
+    if (q->index_fp) {
+        fclose(q->index_fp);
+        q->index_fp = NULL;
+    }
+}
+
+/* Remove the segments once everything was sent */
+void spool_queue_clear(spool_queue *q)
+{
+    char path[OS_FLSIZE + 1];
+    unsigned int seq;
+
+    if (q->head_fp) {
+        fclose(q->head_fp);
+        q->head_fp = NULL;
+    }
+    if (q->tail_fp) {
+        fclose(q->tail_fp);
+        q->tail_fp = NULL;
+    }
+
+    for (seq = q->head; seq <= q->tail && seq != 0; seq++) {
+        spool_segment(q, seq, path);
+        unlink(path);
+    }
+
+    q->head = q->tail + 1;
+    q->head_offset = 0;
+    q->tail_size = q->segment_size;
+    q->size = 0;
+
+    spool_queue_save(q);
+}
+
+/* Append an event, starting a new segment when the last one is full.
+ * Returns the bytes written or -1 on error.
+ */
+int spool_queue_write(spool_queue *q, const char *msg)
+{
+    char path[OS_FLSIZE + 1];
+    int written;
+
+    /* Start a new segment */
+    if (!q->tail_fp || q->tail_size >= q->segment_size) {
+        if (q->tail_fp) {
+            fclose(q->tail_fp);
+        }
+
+        spool_segment(q, q->tail + 1, path);
+        if ((q->tail_fp = fopen(path, "w")) == NULL) {
+            merror(FOPEN_ERROR, ARGV0, path, errno, strerror(errno));
+            return (-1);
+        }
+
+        q->tail++;
+        q->tail_size = 0;
+        spool_queue_save(q);
+    }
+
+    written = fprintf(q->tail_fp, "%lu:%s\n", (unsigned long)strlen(msg), msg);
+    if (written < 0 || fflush(q->tail_fp) != 0) {
+        merror("%s: ERROR: Unable to write to the event spool: %s", ARGV0,
+               strerror(errno));
+        return (-1);
+    }
+
+    q->tail_size += written;
+    q->size += (unsigned long)written;
+
+    return (written);
+}
+
+/* Open the first segment, at the offset already sent.
+ * Returns 0 on success or -1 if it is missing.
+ */
+int spool_queue_open_head(spool_queue *q)
+{
+    char path[OS_FLSIZE + 1];
+
+    if (q->head_fp) {
+        return (0);
+    }
+
+    spool_segment(q, q->head, path);
+    if ((q->head_fp = fopen(path, "r")) == NULL) {
+        return (-1);
+    }
+
+    fseek(q->head_fp, q->head_offset, SEEK_SET);
+    return (0);
+}
+
+/* Read the next event of the first segment (of OS_MAXSTR + 1 bytes).
+ * Returns 1 if an event was read or 0 at the end of the segment.
+ */
+int spool_queue_read(spool_queue *q, char *event)
+{
+    unsigned long size;
+    long offset = ftell(q->head_fp);
+
+    if (fscanf(q->head_fp, "%lu:", &size) != 1 || size == 0 ||
+            size > OS_MAXSTR || fread(event, 1, size, q->head_fp) != size ||
+            fgetc(q->head_fp) != '\n') {
+        /* At the end (or at a cut record) */
+        clearerr(q->head_fp);
+        fseek(q->head_fp, offset, SEEK_SET);
+        return (0);
+    }
+
+    event[size] = '\0';
+    return (1);
+}
+
+/* Mark the events read from the first segment as sent */
+void spool_queue_sent(spool_queue *q)
+{
+    long offset = ftell(q->head_fp);
+
+    q->size -= (unsigned long)(offset - q->head_offset);
+    q->head_offset = offset;
+}
+
+/* Go back to the first event not sent */
+void spool_queue_rewind(spool_queue *q)
+{
+    if (q->head_fp) {
+        fseek(q->head_fp, q->head_offset, SEEK_SET);
+    }
+}
+
+/* Move to the next segment, removing the first one.
+ * Returns 1 on success or 0 if it is the last one.
+ */
+int spool_queue_next(spool_queue *q)
+{
+    char path[OS_FLSIZE + 1];
+    unsigned long rest;
+
+    if (q->head >= q->tail) {
+        return (0);
+    }
+
+    /* The rest of the segment is not sent */
+    spool_segment(q, q->head, path);
+
+    if (q->head_fp) {
+        fseek(q->head_fp, 0, SEEK_END);
+        rest = (unsigned long)(ftell(q->head_fp) - q->head_offset);
+        q->size = q->size > rest ? q->size - rest : 0;
+        fclose(q->head_fp);
+        q->head_fp = NULL;
+    }
+
+    unlink(path);
+
+    q->head++;
+    q->head_offset = 0;
+    spool_queue_save(q);
+
+    return (1);
+}
@@ -0,0 +1,251 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Disk spool of the events
+ *
+ * While the server is not available, and then until the spool is
+ * empty (to keep the order), the events are appended to the segments
+ * of SPOOL_DIR (spool-queue.c). Once the server is back, the spool is
+ * sent at up to spool_eps events per second.
+ */
+
+#include "shared.h"
+#include "agentd.h"
+
+/* Size of a segment */
+#define SPOOL_SEGMENT_SIZE  (1024 * 1024)
+
+/* How often the spool is sent, in milliseconds */
+#define SPOOL_TICK          100
+
+static struct {
+    spool_queue queue;
+    unsigned long dropped;
+    int down;               /* Server not available */
+    int locked;             /* Producers waiting for room */
+    double tokens;
+    struct timeval last;
+} spool;
+
+
+/* Open the spool left by the last run. Must be called in the chroot. */
+void spool_init()
+{
+    if (agt->spool_size <= 0) {
+        return;
+    }
+
+    if (spool_queue_open(&spool.queue, SPOOL_DIR, SPOOL_SEGMENT_SIZE) < 0) {
+        merror("%s: ERROR: Event spool disabled.", ARGV0);
+        agt->spool_size = 0;
+        return;
+    }
+
+    if (spool.queue.size > 0) {
+        verbose("%s: INFO: Sending %lu KB of events spooled.", ARGV0,
+                spool.queue.size / 1024);
+    }
+
+    gettimeofday(&spool.last, NULL);
+}
+
+/* Add an event to the spool.
+ * Returns 0 on success or -1 if the spool is full.
+ */
+int spool_write(const char *msg)
+{
+    /* Past the limit the producers are locked, but the events already
+     * queued are still taken for up to another segment
+     */
+    if (spool.queue.size >= (unsigned long)agt->spool_size * 1024 + SPOOL_SEGMENT_SIZE) {
+        if (spool.dropped++ % 1000 == 0) {
+            merror(SPOOL_DROP, ARGV0, spool.dropped);
+        }
+        return (-1);
+    }
+
+    if (spool_queue_write(&spool.queue, msg) < 0) {
+        return (-1);
+    }
+
+    /* Backpressure: make the producers wait for room */
+    if (!spool.locked && spool.queue.size >= (unsigned long)agt->spool_size * 1024) {
+        merror(SPOOL_FULL, ARGV0, agt->spool_size);
+        os_setwait();
+        spool.locked = 1;
+    }
+
+    return (0);
+}
+
+/* Send the events spooled, if the server is available, at up to
+ * spool_eps events per second
+ */
+void spool_send()
+{
+    char event[OS_MAXSTR + 1];
+    char batch[SECMSG_BATCH_MAXSIZE + 1];
+    spool_queue *q = &spool.queue;
+    struct timeval now;
+    double elapsed;
+
+    if (q->size == 0 || spool.down) {
+        return;
+    }
+
+    /* Refill the bucket (with up to a second of events) */
+    gettimeofday(&now, NULL);
+    elapsed = (double)(now.tv_sec - spool.last.tv_sec) +
+              (double)(now.tv_usec - spool.last.tv_usec) / 1000000;
+    spool.last = now;
+
+    spool.tokens += elapsed * agt->spool_eps;
+    if (spool.tokens > agt->spool_eps) {
+        spool.tokens = agt->spool_eps;
+    }
+
+    while (spool.tokens >= 1 && q->size > 0) {
+        const char *msg = event;
+        size_t used = 0;
+        int events = 0;
+        long offset;
+
+        if (spool_queue_open_head(q) < 0) {
+            /* Segment missing */
+            if (!spool_queue_next(q)) {
+                spool_queue_clear(q);
+            }
+            continue;
+        }
+
+        /* Take as many events as fit in a message */
+        offset = q->head_offset;
+        while (events < (int)spool.tokens && spool_queue_read(q, event)) {
+            events++;
+
+            if (agt->batch_size <= 0) {
+                break;
+            }
+
+            if (AddSecMSGBatch(batch, &used, (size_t)agt->batch_size, event) < 0) {
+                if (used > 0) {
+                    /* Left for the next message */
+                    fseek(q->head_fp, offset, SEEK_SET);
+                    events--;
+                    msg = batch;
+                }
+                break;
+            }
+
+            msg = batch;
+            offset = ftell(q->head_fp);
+        }
+
+        /* Nothing left in this segment */
+        if (events == 0) {
+            if (!spool_queue_next(q)) {
+                spool_queue_clear(q);
+            }
+            continue;
+        }
+
+        if (send_msg(0, msg) < 0) {
+            /* Try again once the server is back */
+            spool_queue_rewind(q);
+            spool.down = 1;
+            break;
+        }
+
+        spool_queue_sent(q);
+        spool.tokens -= events;
+    }
+
+    if (q->size == 0) {
+        spool_queue_clear(q);
+        verbose("%s: INFO: Event spool sent.", ARGV0);
+    } else {
+        spool_queue_save(q);
+    }
+
+    /* Release the producers once there is room again */
+    if (spool.locked && q->size < (unsigned long)agt->spool_size * 512) {
+        verbose(SPOOL_FREE, ARGV0);
+        os_delwait();
+        spool.locked = 0;
+    }
+}
+
+/* Check if events must be spooled (and not sent) */
+int spool_active()
+{
+    return (agt->spool_size > 0 && (spool.down || spool.queue.size > 0));
+}
+
+/* Milliseconds until the spool is sent again, or -1 if it is empty */
+long spool_timeout()
+{
+    if (spool.queue.size == 0 || spool.down) {
+        return (-1);
+    }
+
+    return (SPOOL_TICK);
+}
+
+/* Set if the server is available (the events are spooled while not) */
+void spool_server(int available)
+{
+    if (agt->spool_size <= 0) {
+        return;
+    }
+
+    spool.down = !available;
+    if (available) {
+        gettimeofday(&spool.last, NULL);
+        spool.tokens = 0;
+    }
+}
+
+/* Check if the server was found not available when sending */
+int spool_server_down()
+{
+    return (agt->spool_size > 0 && spool.down);
+}
+
+/* Wait for seconds, spooling the events received meanwhile if the
+ * server is not available
+ */
+void spool_wait(unsigned int seconds)
+{
+#ifndef WIN32
+    time_t end = time(NULL) + seconds;
+    time_t now;
+
+    if (!spool_active() || !spool.down) {
+        sleep(seconds);
+        return;
+    }
+
+    while ((now = time(NULL)) < end) {
+        struct timeval timeout;
+        fd_set fdset;
+
+        FD_ZERO(&fdset);
+        FD_SET(agt->m_queue, &fdset);
+
+        timeout.tv_sec = end - now;
+        timeout.tv_usec = 0;
+
+        if (select(agt->m_queue + 1, &fdset, NULL, NULL, &timeout) > 0) {
+            EventForward();
+        }
+    }
+#else
+    sleep(seconds);
+#endif
+}
@@ -162,7 +162,7 @@ void start_agent(int is_startup)
                  * the server again
                  */
                 attempts++;
-                sleep(attempts);
+                spool_wait(attempts);
 
                 /* Send message again (after three attempts) */
                 if (attempts >= 3) {
@@ -213,14 +213,14 @@ void start_agent(int is_startup)
 	    connect_server(agt->rip_id + 1);
 
             if (agt->rip_id == curr_rip) {
-                sleep(g_attempts);
+                spool_wait(g_attempts);
                 g_attempts += (attempts * 3);
             } else {
                 g_attempts += 5;
-                sleep(g_attempts);
+                spool_wait(g_attempts);
             }
         } else {
-            sleep(g_attempts);
+            spool_wait(g_attempts);
             g_attempts += (attempts * 3);
 
             connect_server(0);
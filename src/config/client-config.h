@@ -31,6 +31,18 @@ typedef struct _agent {
     int max_time_reconnect_try;
     char *profile;
 
+    /* Events sent in batches of up to batch_size bytes (0 to send
+     * each one on its own), batch_latency milliseconds after the first
+     */
+    int batch_size;
+    int batch_latency;
+
+    /* Events spooled to disk while the server is not available, up to
+     * spool_size KB (0 to disable), and then sent at spool_eps per second
+     */
+    int spool_size;
+    int spool_eps;
+
 #ifndef WIN32
     struct imsgbuf ibuf;
 #endif //WIN32
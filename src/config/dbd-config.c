@@ -58,6 +58,8 @@ int Read_DB(XML_NODE node, __attribute__((unused)) void *config1, void *config2)
                 db_config->db_type = MYSQLDB;
             } else if (strcmp(node[i]->content, "postgresql") == 0) {
                 db_config->db_type = POSTGDB;
+            } else if (strcmp(node[i]->content, "sqlite") == 0) {
+                db_config->db_type = SQLITEDB;
             } else {
                 merror(XML_VALUEERR, __local_name, node[i]->element, node[i]->content);
                 return (OS_INVALID);
@@ -19,6 +19,12 @@ typedef struct _DBConfig {
     unsigned int maxreconnect;
     unsigned int port;
 
+    /* Alerts inserted together (1 to insert each one on its own),
+     * at most batch_latency seconds after the first one
+     */
+    unsigned int batch_size;
+    unsigned int batch_latency;
+
     char *host;
     char *user;
     char *pass;
@@ -33,6 +39,7 @@ typedef struct _DBConfig {
 
 #define MYSQLDB 0x002
 #define POSTGDB 0x004
+#define SQLITEDB 0x008
 
 #endif /* _DBDCONFIG__H */
 
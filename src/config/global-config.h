@@ -27,6 +27,22 @@ typedef struct __Config {
     u_int8_t logfw;
     int decoder_order_size;
 
+    /* Decoding threads (0 to decode on the main thread) */
+    int decode_threads;
+    int decode_queue_size;
+
+    /* Thread writing the alerts and archives (0 to write them on
+     * the main thread)
+     */
+    int log_writer;
+    int log_flush_interval;     /* Milliseconds */
+    int log_durability;
+
+    /* Publish the alerts in a ring shared in memory with the daemons
+     * reading them (maild, csyslogd, dbd)
+     */
+    int alert_bus;
+    int alert_bus_size;         /* KiB */
 
     /* Prelude support */
     u_int8_t prelude;
@@ -28,9 +28,22 @@ typedef struct _remoted {
     os_ip **denyips;
 
     int m_queue;
-    int sock;
+    int sock;                   /* Reply socket for IPv4 agents */
+    int sock6;                  /* Reply socket for IPv6 agents */
     OSNetInfo *netinfo;
     socklen_t peer_size;
+
+    /* Receivers of the secure connection */
+    int recv_threads;
+    int recv_batch;
+    OSNetInfo **recv_netinfo;   /* Sockets of each receiver */
+
+    /* Threads decrypting the secure messages (0 for the receivers) */
+    int decrypt_threads;
+    int decrypt_queue_size;
+
+    /* Maximum size of the batches sent to analysisd (0 to disable) */
+    int queue_batch;
 } remoted;
 
 #endif /* __CLOGREMOTE_H */
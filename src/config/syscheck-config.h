@@ -47,6 +47,13 @@ typedef struct _config {
     int disabled;                   /* is syscheck disabled? */
     int scan_on_start;
     int realtime_count;
+    int rt_delay;                   /* ms for a file to be quiet before the realtime check */
+    int rt_workers;                 /* threads checking the realtime changes */
+    int scan_workers;               /* threads hashing the files of a scan */
+    int scan_kbytes;                /* KB/s read by a scan (0 for no limit) */
+    int scan_iops;                  /* reads/s of a scan (0 for no limit) */
+    int cache;                      /* keep the sums of the files not changed */
+    int cache_verify;               /* secs to hash the files again anyway */
     short skip_nfs;
 
     int time;                       /* frequency (secs) for syscheck to run */
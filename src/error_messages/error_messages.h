@@ -285,6 +285,10 @@
 #define WAITING_MSG     "%s: WARN: Process locked. Waiting for permission..."
 #define WAITING_FREE    "%s: INFO: Lock free. Continuing..."
 #define SERVER_UNAV     "%s: WARN: Server unavailable. Setting lock."
+#define SERVER_UNAV_SPOOL "%s: WARN: Server unavailable. Spooling the events."
+#define SPOOL_FULL      "%s: WARN: Event spool full (%d KB). Setting lock."
+#define SPOOL_FREE      "%s: INFO: Event spool below half. Releasing lock."
+#define SPOOL_DROP      "%s: ERROR: Event spool full. %lu events dropped."
 #define SERVER_UP       "%s: INFO: Server responded. Releasing lock."
 
 /* OSSEC alert messages */
@@ -0,0 +1,58 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Alert bus: the alerts of analysisd, already parsed, in a ring
+ * shared in memory with the daemons reading them
+ */
+
+#ifndef __ALERT_BUS_H
+#define __ALERT_BUS_H
+
+#include "read-alert.h"
+
+/* Flags of the alerts published */
+#define ALERTBUS_MAIL   0x001   /* To be e-mailed */
+
+/* Where an alert was written in the alerts log */
+typedef struct _alert_bus_pos {
+    int year;
+    int day;
+    char mon[4];
+    long offset;    /* Of the alert */
+    long end;       /* Past the alert */
+} alert_bus_pos;
+
+typedef struct _alert_bus alert_bus;
+
+/* Create the bus, with a ring of size bytes, replacing the one of a
+ * previous analysisd. Returns 0 on success or -1 on error.
+ */
+int AlertBus_Create(size_t size);
+
+/* Remove the bus of a previous analysisd (when it is disabled) */
+void AlertBus_Remove(void);
+
+/* Publish an alert, as read from the alerts log */
+void AlertBus_Publish(const alert_data *al_data, int flags, const alert_bus_pos *pos) __attribute__((nonnull));
+
+/* Open the bus to read the alerts published from now on.
+ * Returns NULL if there is no bus.
+ */
+alert_bus *AlertBus_Open(void);
+void AlertBus_Close(alert_bus *bus) __attribute__((nonnull));
+
+/* Wait up to wait seconds for the next alert. Returns 1 with the
+ * alert in al_data (NULL if it is not one of the flags, as with
+ * GetAlertData) and where it was written in pos, 0 if no alert came,
+ * or -1 if the bus is gone.
+ */
+int AlertBus_Read(alert_bus *bus, int flags, unsigned int wait,
+                  alert_data **al_data, alert_bus_pos *pos) __attribute__((nonnull));
+
+#endif /* __ALERT_BUS_H */
@@ -22,6 +22,7 @@
 #define OS_TEXT     1
 
 /* Size limit control */
+#define OS_SIZE_65536   65536
 #define OS_SIZE_8192    8192
 #define OS_SIZE_6144    6144
 #define OS_SIZE_4096    4096
@@ -112,6 +113,9 @@ http://www.ossec.net/main/license/\n"
 /* Active Response queue */
 #define ARQUEUE         "/queue/alerts/ar"
 
+/* Alerts published by analysisd */
+#define ALERTBUS        "/queue/alerts/alertbus"
+
 /* Decoder file */
 #define XML_DECODER     "/etc/decoder.xml"
 #define XML_LDECODER    "/etc/local_decoder.xml"
@@ -154,6 +158,24 @@ http://www.ossec.net/main/license/\n"
 #define AGENT_INFO_FILEP AGENT_INFO_FILE
 #endif
 
+/* Logcollector bookmarks */
+#ifndef WIN32
+#define LOGC_BOOKMARKS  "/queue/ossec/.logcollector_bookmarks"
+#define LOGC_BOOKMARKS_PATH DEFAULTDIR LOGC_BOOKMARKS
+#else
+#define LOGC_BOOKMARKS  ".logcollector_bookmarks"
+#define LOGC_BOOKMARKS_PATH LOGC_BOOKMARKS
+#endif
+
+/* Syscheck sums cache */
+#ifndef WIN32
+#define SYSCHECK_CACHE  "/queue/ossec/.syscheck_cache"
+#define SYSCHECK_CACHE_PATH DEFAULTDIR SYSCHECK_CACHE
+#else
+#define SYSCHECK_CACHE  ".syscheck_cache"
+#define SYSCHECK_CACHE_PATH SYSCHECK_CACHE
+#endif
+
 /* Syscheck restart */
 #ifndef WIN32
 #define SYSCHECK_RESTART        "/var/run/.syscheck_run"
@@ -242,6 +264,7 @@ http://www.ossec.net/main/license/\n"
 #define AGENTLESS_ENTRYDIRPATH  AGENTLESS_ENTRYDIR
 #endif
 #define EXECQUEUEPATH           DEFAULTDIR EXECQUEUE
+#define ALERTBUSPATH            DEFAULTDIR ALERTBUS
 
 #ifdef WIN32
 #define SHAREDCFG_DIRPATH   SHAREDCFG_DIR
@@ -13,6 +13,12 @@
 #define MAX_FQUEUE  256
 #define FQ_TIMEOUT  5
 
+/* Seconds to wait for the log to have the alerts the bus skipped */
+#define FQ_STALL_TIMEOUT    120
+
+#include "read-alert.h"
+#include "alert-bus.h"
+
 /* File queue */
 typedef struct _file_queue {
     time_t last_change;
@@ -25,12 +31,23 @@ typedef struct _file_queue {
 
     FILE *fp;
     struct stat f_status;
+
+    /* Alerts from the bus of analysisd (NULL to read the log) */
+    alert_bus *bus;
+    long offset;                /* In the log, past the alerts read */
+    time_t stalled;             /* Since when the log is behind the bus */
+    int pending;                /* Alert read from the bus, not returned */
+    alert_data *pending_data;
+    alert_bus_pos pending_pos;
 } file_queue;
 
-#include "read-alert.h"
 int Init_FileQueue(file_queue *fileq, const struct tm *p, int flags) __attribute__((nonnull));
 
+/* Read an alert, waiting up to timeout * FQ_TIMEOUT seconds */
 alert_data *Read_FileMon(file_queue *fileq, const struct tm *p, unsigned int timeout) __attribute__((nonnull));
 
+/* Read an alert, waiting up to timeout seconds */
+alert_data *Read_FileMonSeconds(file_queue *fileq, const struct tm *p, unsigned int timeout) __attribute__((nonnull));
+
 #endif /* __CFQUEUE_H */
 
@@ -22,9 +22,55 @@
 #define MYSQL_MQ        'a'
 #define POSTGRESQL_MQ   'b'
 
+/* Batched messages
+ *
+ * A message is normally sent as a text datagram: "id:location:message".
+ * A producer can instead pack several messages in a single datagram:
+ * MQ_BATCH_MAGIC followed by one record per message. Each record has a
+ * header (queue id, size of the location and size of the message, as
+ * 32 bit integers in host order) followed by the location and the
+ * message, both '\0' terminated. The readers accept both formats.
+ */
+#define MQ_BATCH_MAGIC          "\001MQB"
+#define MQ_BATCH_MAGIC_SIZE     4
+#define MQ_BATCH_RECORD_HEADER  9
+#define MQ_BATCH_MAXSIZE        OS_SIZE_65536
+
+/* Message read from a batch (or split from a text message) */
+typedef struct _mq_record {
+    char loc;
+    char *location;
+    size_t location_size;   /* Without the '\0' */
+    char *message;
+    size_t message_size;    /* Without the '\0' */
+} mq_record;
+
 int StartMQ(const char *key, short int type) __attribute__((nonnull));
 
 int SendMSG(int queue, const char *message, const char *locmsg, char loc) __attribute__((nonnull));
 
+/* Batch the messages sent by SendMSG() in datagrams of up to size bytes
+ * (0 to send each message on its own). The messages are sent when the
+ * batch is full, when it is one second old or when FlushMSG() is called:
+ * producers must call it when they run out of events.
+ * The batch is not locked: SendMSG() must not be called concurrently.
+ */
+void SetMQBatch(size_t size);
+
+/* Send the batched messages.
+ * Returns 0 on success, -1 on error (the messages are kept to be sent
+ * on the next call, possibly on a new queue)
+ */
+int FlushMSG(int queue);
+
+/* Check if a datagram is a batch */
+int IsMQBatch(const char *buffer, size_t size) __attribute__((nonnull));
+
+/* Get the next record of a batch. pos must be 0 for the first record.
+ * Returns 1 if a record was read, 0 at the end of the batch and -1 if
+ * the batch is malformed.
+ */
+int ReadMQBatch(char *buffer, size_t size, size_t *pos, mq_record *record) __attribute__((nonnull));
+
 #endif
 
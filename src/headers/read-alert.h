@@ -46,6 +46,7 @@ typedef struct _alert_data {
 } alert_data;
 
 alert_data *GetAlertData(int flag, FILE *fp) __attribute__((nonnull));
+alert_data *ParseAlertData(int flag, const char *text) __attribute__((nonnull));
 void        FreeAlertData(alert_data *al_data) __attribute__((nonnull));
 
 #endif
@@ -87,15 +87,56 @@ int OS_IsAllowedName(const keystore *keys, const char *name) __attribute((nonnul
 int OS_IsAllowedDynamicID(keystore *keys, const char *id, const char *srcip) __attribute((nonnull(1)));
 
 
+/* Counters of a received message (replay protection) */
+typedef struct _secmsg_counter {
+    unsigned int global;    /* Time on the old format */
+    unsigned int local;
+    int old_format;
+} secmsg_counter;
+
 /** Function prototypes -- send/recv messages **/
 
 /* Decrypt and decompress a remote message */
 char *ReadSecMSG(keystore *keys, char *buffer, char *cleartext,
                  int id, unsigned int buffer_size) __attribute((nonnull));
 
+/* ReadSecMSG() in two steps: OpenSecMSG() only needs the agent key and
+ * can run in parallel, CheckSecMSG() checks and updates the counters of
+ * the agent and must see its messages in order.
+ */
+char *OpenSecMSG(const char *key, const char *agent_ip, char *buffer,
+                 char *cleartext, unsigned int buffer_size,
+                 secmsg_counter *counter) __attribute((nonnull));
+int CheckSecMSG(keystore *keys, int id, const secmsg_counter *counter) __attribute((nonnull));
+
 /* Create an OSSEC message (encrypt and compress) */
 size_t CreateSecMSG(const keystore *keys, const char *msg, char *msg_encrypted, unsigned int id) __attribute((nonnull));
 
+/* Batched events
+ *
+ * An agent can pack several events in a single message, compressed
+ * together: SECMSG_BATCH_HEADER followed, for each event, by its size
+ * in decimal, ':' and the event.
+ */
+#define SECMSG_BATCH_HEADER         "#!b"
+#define SECMSG_BATCH_HEADER_SIZE    3
+#define SECMSG_BATCH_MAXSIZE        (OS_MAXSTR - OS_HEADER_SIZE)
+
+/* Add an event to a batch (of up to size bytes, used so far).
+ * Returns 0 on success or -1 if it does not fit.
+ */
+int AddSecMSGBatch(char *batch, size_t *used, size_t size, const char *msg) __attribute((nonnull));
+
+/* Check if a message is a batch */
+int IsSecMSGBatch(const char *msg) __attribute((nonnull));
+
+/* Copy the next event of a batch to event (of OS_MAXSTR + 1 bytes).
+ * pos must be 0 for the first event.
+ * Returns 1 if an event was read, 0 at the end of the batch and -1 if
+ * the batch is malformed.
+ */
+int ReadSecMSGBatch(const char *batch, size_t *pos, char *event) __attribute((nonnull));
+
 
 /** Remote IDs directories and internal definitions */
 #ifndef WIN32
@@ -105,6 +146,7 @@ size_t CreateSecMSG(const keystore *keys, const char *msg, char *msg_encrypted,
 #endif
 
 #define SENDER_COUNTER  "sender_counter"
+#define RIDS_TABLE      "counters"
 #define KEYSIZE         128
 
 #endif /* __SEC_H */
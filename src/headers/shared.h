@@ -207,6 +207,7 @@ extern const char *__local_name;
 #include "validate_op.h"
 #include "file-queue.h"
 #include "read-agents.h"
+#include "syscheck_op.h"
 #include "report_op.h"
 #include "string_op.h"
 #include "randombytes.h"
@@ -0,0 +1,109 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* Indexed syscheck integrity database
+ *
+ * The integrity database of each agent (SYSCHECK_DIR/<agent>) is an
+ * append-only log: every change adds a new line and comments out the
+ * previous one. The index lives next to it (SYSCHECK_DIR/.<agent>.idx)
+ * and maps each file name to its current checksum and to the position
+ * of its current line in the log. It is memory mapped and updated in
+ * place, so looking up a file no longer requires scanning the log.
+ *
+ * The index records the size of the log it describes. If they do not
+ * match (old text database, database cleared by syscheck_update, crash)
+ * it is rebuilt from the log.
+ */
+
+#ifndef _SYSCHECK_OP_H
+#define _SYSCHECK_OP_H
+
+#include <stdint.h>
+
+#define SK_IDX_EXT      ".idx"
+#define SK_IDX_MAGIC    "OSSKIDX"
+#define SK_IDX_VERSION  1
+
+/* Index header, at the beginning of the file */
+typedef struct _sk_idx_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t buckets;       /* Number of buckets after the header */
+    uint64_t entries;       /* Number of files in the index */
+    uint64_t end;           /* First free byte of the file */
+    uint64_t log_size;      /* Size of the log this index describes */
+} sk_idx_header;
+
+/* Index entry. The checksum and the file name follow it */
+typedef struct _sk_idx_entry {
+    uint64_t next;          /* Next entry in the bucket (0 if last) */
+    uint64_t log_pos;       /* Position of the current line in the log */
+    int64_t time;           /* Time of the last change */
+    uint32_t hash;
+    uint16_t name_size;     /* Including the '\0' */
+    uint16_t sum_size;      /* Room for the checksum, including the '\0' */
+    char marks[4];          /* Change counter: "+++", "!++", "!!+", ... */
+    char data[];
+} sk_idx_entry;
+
+#define sk_idx_sum(e)   ((e)->data)
+#define sk_idx_name(e)  ((e)->data + (e)->sum_size)
+
+/* Opened index */
+typedef struct _sk_idx {
+    int fd;
+    char *map;
+    size_t map_size;
+    char *path;
+    char *log_path;
+} sk_idx;
+
+/* Get the path of the index of a log */
+void sk_idx_path(const char *log_path, char *path, size_t size) __attribute__((nonnull));
+
+/* Open the index of a log, building it from the log if it is
+ * missing or out of date.
+ * Returns NULL on error
+ */
+sk_idx *sk_idx_open(const char *log_path) __attribute__((nonnull));
+void sk_idx_close(sk_idx *idx) __attribute__((nonnull));
+
+/* Rebuild the index if it does not describe a log of log_size bytes.
+ * Returns 0 on success, -1 on error
+ */
+int sk_idx_check(sk_idx *idx, uint64_t log_size) __attribute__((nonnull));
+
+/* Set the size of the log described by the index */
+void sk_idx_sync(sk_idx *idx, uint64_t log_size) __attribute__((nonnull));
+
+/* Look up a file. The entry can be changed in place and is valid
+ * until the next call to sk_idx_put() or sk_idx_check().
+ * Returns NULL if the file is not in the index
+ */
+sk_idx_entry *sk_idx_get(const sk_idx *idx, const char *name) __attribute__((nonnull));
+
+/* Add or update a file.
+ * Returns 0 on success, -1 on error
+ */
+int sk_idx_put(sk_idx *idx, const char *name, const char *marks,
+               const char *sum, time_t change_time, uint64_t log_pos) __attribute__((nonnull));
+
+/* Set the marks of a file in the index of a log, if there is one.
+ * The index is changed in place and never rebuilt, as analysisd may
+ * have it mapped.
+ * Returns 1 if the file was found, 0 if not
+ */
+int sk_idx_mark(const char *log_path, const char *name, const char *marks) __attribute__((nonnull));
+
+/* Build the index of a log from scratch.
+ * Returns 0 on success, -1 on error
+ */
+int sk_idx_import(const char *log_path) __attribute__((nonnull));
+
+#endif /* _SYSCHECK_OP_H */
@@ -0,0 +1,257 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Bookmarks of the files being read
+ *
+ * For each file, the inode, the offset read so far and a hash of
+ * the first bytes are saved on disk. When the file is opened again
+ * after a restart, reading goes on from the offset if the inode and
+ * the head of the file are still the same, instead of from the end.
+ */
+
+#include "shared.h"
+#include "logcollector.h"
+
+/* Bytes at the head of a file covered by the hash */
+#define BOOKMARK_HEAD   256
+
+typedef struct _LogBookmark {
+    char *file;
+    unsigned long inode;
+    long offset;
+    size_t head_len;
+    unsigned int head_hash;
+} LogBookmark;
+
+/* Bookmark of each entry of logff (offset -1 if none yet) */
+static LogBookmark *bm_current = NULL;
+static int bm_entries = 0;
+
+/* Bookmarks loaded from disk, not used yet (by file name) */
+static OSHash *bm_loaded = NULL;
+
+static int bm_dirty = 0;
+
+#ifndef WIN32
+
+/* FNV-1a of the first bytes of the file (up to BOOKMARK_HEAD) */
+static int bm_head(FILE *fp, size_t max, size_t *len, unsigned int *hash)
+{
+    unsigned char buf[BOOKMARK_HEAD];
+    unsigned int h = 2166136261U;
+    ssize_t n;
+    ssize_t j;
+
+    if (max > BOOKMARK_HEAD) {
+        max = BOOKMARK_HEAD;
+    }
+
+    n = pread(fileno(fp), buf, max, 0);
+    if (n < 0) {
+        return (-1);
+    }
+
+    for (j = 0; j < n; j++) {
+        h ^= buf[j];
+        h *= 16777619U;
+    }
+
+    *len = (size_t)n;
+    *hash = h;
+    return (0);
+}
+
+#endif
+
+/* Load the bookmarks saved by a previous run */
+void LogBookmarkInit(void)
+{
+    FILE *fp;
+    char line[OS_MAXSTR + 1];
+
+    for (bm_entries = 0; logff[bm_entries].file; bm_entries++);
+    os_calloc(bm_entries + 1, sizeof(LogBookmark), bm_current);
+
+    bm_loaded = OSHash_Create();
+    if (!bm_loaded) {
+        ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+    }
+
+    fp = fopen(LOGC_BOOKMARKS_PATH, "r");
+    if (!fp) {
+        return;
+    }
+
+    while (fgets(line, OS_MAXSTR, fp)) {
+        LogBookmark *bm;
+        unsigned long head_len;
+        int end = 0;
+        char *p;
+
+        if ((p = strchr(line, '\n'))) {
+            *p = '\0';
+        }
+
+        os_calloc(1, sizeof(LogBookmark), bm);
+
+        if (sscanf(line, "%lu %ld %lu %x %n", &bm->inode, &bm->offset,
+                   &head_len, &bm->head_hash, &end) != 4 || end == 0 ||
+                line[end] == '\0' || bm->offset < 0) {
+            merror("%s: WARN: Invalid bookmark: '%s'.", ARGV0, line);
+            free(bm);
+            continue;
+        }
+
+        bm->head_len = head_len;
+        os_strdup(line + end, bm->file);
+
+        if (OSHash_Add(bm_loaded, bm->file, bm) != 2) {
+            free(bm->file);
+            free(bm);
+        }
+    }
+
+    fclose(fp);
+}
+
+/* Seek an open file to its bookmark. Returns 0 on success, or -1
+ * if there is no bookmark for the file or it does not match.
+ */
+int LogBookmarkSeek(int i)
+{
+#ifndef WIN32
+    LogBookmark *bm;
+    size_t head_len;
+    unsigned int head_hash;
+    int ret = -1;
+
+    if (!bm_loaded || !logff[i].fp || !logff[i].file) {
+        return (-1);
+    }
+
+    if (!(bm = (LogBookmark *)OSHash_Delete(bm_loaded, logff[i].file))) {
+        return (-1);
+    }
+
+    if (bm->inode == (unsigned long)logff[i].fd &&
+            bm->offset <= (long)logff[i].size &&
+            bm_head(logff[i].fp, bm->head_len, &head_len, &head_hash) == 0 &&
+            head_len == bm->head_len && head_hash == bm->head_hash) {
+
+        if (fseek(logff[i].fp, bm->offset, SEEK_SET) < 0) {
+            merror(FSEEK_ERROR, ARGV0, logff[i].file, errno, strerror(errno));
+        } else {
+            debug1("%s: DEBUG: Reading '%s' from bookmark (offset %ld).",
+                   ARGV0, logff[i].file, bm->offset);
+            ret = 0;
+        }
+    } else {
+        debug1("%s: DEBUG: Bookmark of '%s' does not match the file.",
+               ARGV0, logff[i].file);
+    }
+
+    free(bm->file);
+    free(bm);
+    return (ret);
+#else
+    (void)i;
+    return (-1);
+#endif
+}
+
+/* Record the current offset of an open file */
+void LogBookmarkUpdate(int i)
+{
+#ifndef WIN32
+    LogBookmark *bm;
+    long offset;
+
+    if (!bm_current || i >= bm_entries || !logff[i].fp || !logff[i].file) {
+        return;
+    }
+
+    if ((offset = LogReaderTell(i)) < 0) {
+        return;
+    }
+
+    bm = &bm_current[i];
+
+    /* A new file (rotated or a new day) */
+    if (!bm->file || strcmp(bm->file, logff[i].file) != 0 ||
+            bm->inode != (unsigned long)logff[i].fd) {
+        if (!bm->file || strcmp(bm->file, logff[i].file) != 0) {
+            free(bm->file);
+            os_strdup(logff[i].file, bm->file);
+        }
+        bm->inode = (unsigned long)logff[i].fd;
+        bm->head_len = 0;
+        bm->head_hash = 0;
+        bm->offset = -1;
+    }
+
+    /* Hash the head until it is complete */
+    if (bm->head_len < BOOKMARK_HEAD && (size_t)offset > bm->head_len) {
+        if (bm_head(logff[i].fp, (size_t)offset, &bm->head_len,
+                    &bm->head_hash) < 0) {
+            return;
+        }
+    }
+
+    if (bm->offset != offset) {
+        bm->offset = offset;
+        bm_dirty = 1;
+    }
+#else
+    (void)i;
+#endif
+}
+
+/* Write the bookmarks to disk (if any changed) */
+void LogBookmarkSave(void)
+{
+    char tmp_path[OS_FLSIZE + 1];
+    FILE *fp;
+    int i;
+
+    if (!bm_current || !bm_dirty) {
+        return;
+    }
+
+    snprintf(tmp_path, OS_FLSIZE, "%s.tmp", LOGC_BOOKMARKS_PATH);
+
+    fp = fopen(tmp_path, "w");
+    if (!fp) {
+        merror(FOPEN_ERROR, ARGV0, tmp_path, errno, strerror(errno));
+        return;
+    }
+
+    for (i = 0; i < bm_entries; i++) {
+        LogBookmark *bm = &bm_current[i];
+
+        /* Keep the bookmark of a file not opened yet */
+        if (!bm->file || bm->offset < 0) {
+            if (!logff[i].file ||
+                    !(bm = (LogBookmark *)OSHash_Get(bm_loaded, logff[i].file))) {
+                continue;
+            }
+        }
+
+        fprintf(fp, "%lu %ld %lu %08x %s\n", bm->inode, bm->offset,
+                (unsigned long)bm->head_len, bm->head_hash, bm->file);
+    }
+
+    if (fclose(fp) != 0 || rename(tmp_path, LOGC_BOOKMARKS_PATH) < 0) {
+        merror(RENAME_ERROR, ARGV0, tmp_path, LOGC_BOOKMARKS_PATH,
+               errno, strerror(errno));
+        unlink(tmp_path);
+        return;
+    }
+
+    bm_dirty = 0;
+}
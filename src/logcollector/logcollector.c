@@ -49,7 +49,7 @@ void LogCollectorStart()
 
 #ifndef WIN32
     int int_error = 0;
-    struct timeval fp_timeout;
+    time_t last_pass = 0;
     /* To check for inode changes */
     struct stat tmp_stat;
 #else
@@ -243,12 +243,11 @@ void LogCollectorStart()
 
     /* Daemon loop */
     while (1) {
-#ifndef WIN32
-        fp_timeout.tv_sec = loop_timeout;
-        fp_timeout.tv_usec = 0;
+        int full_pass = 1;
 
-        /* Wait for the select timeout */
-        if ((r = select(0, NULL, NULL, NULL, &fp_timeout)) < 0) {
+#ifndef WIN32
+        /* Wait for a file change or the loop timeout */
+        if ((r = LogWatchWait(loop_timeout)) < 0) {
             merror(SELECT_ERROR, ARGV0, errno, strerror(errno));
             int_error++;
 
@@ -257,6 +256,16 @@ void LogCollectorStart()
             }
             continue;
         }
+
+        /* Woken up by a change: only read the files that changed,
+         * the rest of the pass runs every loop_timeout seconds.
+         */
+        curr_time = time(0);
+        if (r > 0 && (curr_time - last_pass) < loop_timeout) {
+            full_pass = 0;
+        } else {
+            last_pass = curr_time;
+        }
 #else
 
         /* Windows doesn't like select that way */
@@ -266,13 +275,15 @@ void LogCollectorStart()
         win_readel();
 #endif
 
-        f_check++;
+        if (full_pass) {
+            f_check++;
+        }
 
         /* Check which file is available */
         for (i = 0; i <= max_file; i++) {
             if (!logff[i].fp) {
                 /* Run the command */
-                if (logff[i].command && (f_check % 2)) {
+                if (logff[i].command && full_pass && (f_check % 2)) {
                     curr_time = time(0);
                     if ((curr_time - logff[i].size) >= logff[i].ign) {
                         logff[i].size = curr_time;
@@ -282,29 +293,20 @@ void LogCollectorStart()
                 continue;
             }
 
-            /* Windows with IIS logs is very strange.
-             * For some reason it always returns 0 (not EOF)
-             * the fgetc. To solve this problem, we always
-             * pass it to the function pointer directly.
-             */
-#ifndef WIN32
-            /* We check for the end of file. If is returns EOF,
-             * we don't attempt to read it.
-             */
-            if ((r = fgetc(logff[i].fp)) == EOF) {
-                clearerr(logff[i].fp);
+            /* Nothing written since the last read */
+            if (!LogWatchChanged(i)) {
                 continue;
             }
 
-            /* If it is not EOF, we need to return the read character */
-            ungetc(r, logff[i].fp);
-#endif
-
-            /* Finally, send to the function pointer to read it */
+            /* Finally, send to the function pointer to read it.
+             * At the end of the file, the reader gets nothing.
+             */
             logff[i].read(i, &r, 0);
 
+            LogBookmarkUpdate(i);
+
             /* Check for error */
-            if (!ferror(logff[i].fp)) {
+            if (!LogReaderError(i) && !ferror(logff[i].fp)) {
                 /* Clear EOF */
                 clearerr(logff[i].fp);
 
@@ -317,6 +319,7 @@ void LogCollectorStart()
             else {
                 merror(FREAD_ERROR, ARGV0, logff[i].file, errno, strerror(errno));
 #ifndef WIN32
+                LogReaderReset(i);
                 if (fseek(logff[i].fp, 0, SEEK_END) < 0)
 #else
                 if (1)
@@ -352,6 +355,24 @@ void LogCollectorStart()
             }
         }
 
+#ifndef WIN32
+        /* Send the events batched in this pass */
+        if (FlushMSG(logr_queue) < 0) {
+            merror(QUEUE_SEND, ARGV0);
+            if ((logr_queue = StartMQ(DEFAULTQPATH, WRITE)) < 0) {
+                ErrorExit(QUEUE_FATAL, ARGV0, DEFAULTQPATH);
+            }
+            FlushMSG(logr_queue);
+        }
+#endif
+
+        if (!full_pass) {
+            continue;
+        }
+
+        /* Save where each file was read up to */
+        LogBookmarkSave();
+
         /* Only check below if check > VCHECK_FILES */
         if (f_check <= VCHECK_FILES) {
             continue;
@@ -667,11 +688,13 @@ int handle_file(int i, int do_fseek, int do_log)
 
 #endif
 
-    /* Only seek the end of the file if set to */
+    /* Only seek the end of the file if set to (or to the bookmark) */
     if (do_fseek == 1 && S_ISREG(stat_fd.st_mode)) {
         /* Windows and fseek causes some weird issues */
 #ifndef WIN32
-        if (fseek(logff[i].fp, 0, SEEK_END) < 0) {
+        if (LogBookmarkSeek(i) == 0) {
+            /* Continue from the last run */
+        } else if (fseek(logff[i].fp, 0, SEEK_END) < 0) {
             merror(FSEEK_ERROR, ARGV0, logff[i].file, errno, strerror(errno));
             fclose(logff[i].fp);
             logff[i].fp = NULL;
@@ -680,6 +703,10 @@ int handle_file(int i, int do_fseek, int do_log)
 #endif
     }
 
+    LogReaderReset(i);
+    LogBookmarkUpdate(i);
+    LogWatchAdd(i);
+
     /* Set ignore to zero */
     logff[i].ign = 0;
     return (0);
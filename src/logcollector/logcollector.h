@@ -68,6 +68,26 @@ void *read_fullcommand(int pos, int *rc, int drop_it);
 /* Read auditd events */
 void *read_audit(int pos, int *rc, int drop_it);
 
+/* Line reader shared by the file formats */
+char *LogReaderGets(char *str, int size, int pos);
+void LogReaderMark(int pos);
+void LogReaderRewind(int pos);
+long LogReaderTell(int pos);
+int LogReaderError(int pos);
+void LogReaderReset(int pos);
+
+/* Bookmarks of the files being read */
+void LogBookmarkInit(void);
+int LogBookmarkSeek(int i);
+void LogBookmarkUpdate(int i);
+void LogBookmarkSave(void);
+
+/* Wait for changes on the files being read */
+void LogWatchInit(void);
+void LogWatchAdd(int i);
+int LogWatchWait(int timeout);
+int LogWatchChanged(int i);
+
 #ifdef WIN32
 void win_startel();
 void win_readel();
@@ -49,6 +49,9 @@ int main(int argc, char **argv)
     int debug_level = 0;
     int test_config = 0, run_foreground = 0;
     int accept_manager_commands = 0;
+    int queue_batch = 0;
+    int use_bookmarks = 0;
+    int use_inotify = 0;
     const char *cfg = DEFAULTCPATH;
 
     /* Setup random */
@@ -118,6 +121,12 @@ int main(int argc, char **argv)
     open_file_attempts = getDefine_Int("logcollector", "open_attempts",
                                        2, 998);
 
+    queue_batch = getDefine_Int("logcollector", "queue_batch", 0, 65536);
+
+    use_bookmarks = getDefine_Int("logcollector", "bookmarks", 0, 1);
+
+    use_inotify = getDefine_Int("logcollector", "inotify", 0, 1);
+
     /* Exit if test config */
     if (test_config) {
         exit(0);
@@ -159,6 +168,19 @@ int main(int argc, char **argv)
         ErrorExit(QUEUE_FATAL, ARGV0, DEFAULTQPATH);
     }
 
+    /* Batch the events sent on each pass */
+    SetMQBatch((size_t)queue_batch);
+
+    /* Continue reading the files from where the last run stopped */
+    if (use_bookmarks) {
+        LogBookmarkInit();
+    }
+
+    /* Wake up when the files change */
+    if (use_inotify) {
+        LogWatchInit();
+    }
+
     /* Main loop */
     LogCollectorStart();
 }
@@ -55,31 +55,15 @@ void *read_audit(int pos, int *rc, int drop_it) {
     char *id;
     char *p;
     size_t z;
-    long offset = ftell(logff[pos].fp);
-    
-    if (offset < 0) {
-        merror(FTELL_ERROR, ARGV0, logff[pos].file, errno, strerror(errno));
-        return NULL;
-    }
 
     *rc = 0;
 
-    while (fgets(buffer, OS_MAXSTR, logff[pos].fp)) {
+    while (LogReaderGets(buffer, OS_MAXSTR, pos)) {
         if ((p = strchr(buffer, '\n')))
             *p = '\0';
-        else {
-            if (strlen(buffer) == OS_MAXSTR - 1) {
-                // Message too large, discard line
-                while (fgets(buffer, OS_MAXSTR, logff[pos].fp) && !strchr(buffer, '\n'));
-            } else {
-                debug1("%s: Message not complete. Trying again: '%s'", ARGV0, buffer);
-                
-                if (fseek(logff[pos].fp, offset, SEEK_SET) < 0) {
-                    merror(FSEEK_ERROR, ARGV0, logff[pos].file, errno, strerror(errno));
-                    break;
-                }
-            }
-
+        else if (strlen(buffer) == OS_MAXSTR - 1) {
+            // Message too large, discard line
+            while (LogReaderGets(buffer, OS_MAXSTR, pos) && !strchr(buffer, '\n'));
             break;
         }
 
@@ -21,7 +21,6 @@ void *read_multiline(int pos, int *rc, int drop_it)
     char *p;
     char str[OS_MAXSTR + 1];
     char buffer[OS_MAXSTR + 1];
-    fpos_t fp_pos;
 
     buffer[0] = '\0';
     buffer[OS_MAXSTR] = '\0';
@@ -30,10 +29,10 @@ void *read_multiline(int pos, int *rc, int drop_it)
 
     linecount = atoi(logff[pos].logformat);
 
-    /* Get initial file location */
-    fgetpos(logff[pos].fp, &fp_pos);
+    /* Lines of an event not complete yet are read again next time */
+    LogReaderMark(pos);
 
-    while (fgets(str, OS_MAXSTR - OS_LOG_HEADER, logff[pos].fp) != NULL) {
+    while (LogReaderGets(str, OS_MAXSTR - OS_LOG_HEADER, pos) != NULL) {
         linesgot++;
 
         /* Get the last occurrence of \n */
@@ -47,11 +46,6 @@ void *read_multiline(int pos, int *rc, int drop_it)
         else if (strlen(str) >= (OS_MAXSTR - OS_LOG_HEADER - 2)) {
             /* Message size > maximum allowed */
             __ms = 1;
-        } else {
-            /* Message not complete. Return. */
-            debug1("%s: Message not complete. Trying again: '%s'", ARGV0, str);
-            fsetpos(logff[pos].fp, &fp_pos);
-            break;
         }
 
 #ifdef WIN32
@@ -62,14 +56,17 @@ void *read_multiline(int pos, int *rc, int drop_it)
 
         debug2("%s: DEBUG: Reading message: '%s'", ARGV0, str);
 
-        /* Add to buffer */
+        /* Add to buffer (while there is room) */
         buffer_size = strlen(buffer);
-        if (buffer[0] != '\0') {
-            buffer[buffer_size] = ' ';
-            buffer_size++;
-        }
+        if (buffer_size + 3 < OS_MAXSTR) {
+            if (buffer[0] != '\0') {
+                buffer[buffer_size] = ' ';
+                buffer_size++;
+            }
 
-        strncpy(buffer + buffer_size, str, OS_MAXSTR - buffer_size - 2);
+            strncpy(buffer + buffer_size, str, OS_MAXSTR - buffer_size - 2);
+            buffer[OS_MAXSTR - 2] = '\0';
+        }
 
         if (linesgot < linecount) {
             continue;
@@ -87,12 +84,12 @@ void *read_multiline(int pos, int *rc, int drop_it)
         }
 
         buffer[0] = '\0';
-
+        linesgot = 0;
 
         /* Incorrect message size */
         if (__ms) {
             merror("%s: Large message size: '%s'", ARGV0, str);
-            while (fgets(str, OS_MAXSTR - 2, logff[pos].fp) != NULL) {
+            while (LogReaderGets(str, OS_MAXSTR - 2, pos) != NULL) {
                 /* Get the last occurrence of \n */
                 if ((p = strrchr(str, '\n')) != NULL) {
                     break;
@@ -101,10 +98,12 @@ void *read_multiline(int pos, int *rc, int drop_it)
             __ms = 0;
         }
 
-        fgetpos(logff[pos].fp, &fp_pos);
+        LogReaderMark(pos);
         continue;
     }
 
+    LogReaderRewind(pos);
+
     return (NULL);
 }
 
@@ -144,7 +144,7 @@ void *read_nmapg(int pos, int *rc, int drop_it)
     port[16] = '\0';
     proto[16] = '\0';
 
-    while (fgets(str, OS_MAXSTR - OS_LOG_HEADER, logff[pos].fp) != NULL) {
+    while (LogReaderGets(str, OS_MAXSTR - OS_LOG_HEADER, pos) != NULL) {
         /* If need clear is set, we need to clear the line */
         if (need_clear) {
             if ((q = strchr(str, '\n')) != NULL) {
@@ -19,15 +19,11 @@ void *read_syslog(int pos, int *rc, int drop_it)
     int __ms = 0;
     char *p;
     char str[OS_MAXSTR + 1];
-    fpos_t fp_pos;
 
     str[OS_MAXSTR] = '\0';
     *rc = 0;
 
-    /* Get initial file location */
-    fgetpos(logff[pos].fp, &fp_pos);
-
-    while (fgets(str, OS_MAXSTR - OS_LOG_HEADER, logff[pos].fp) != NULL) {
+    while (LogReaderGets(str, OS_MAXSTR - OS_LOG_HEADER, pos) != NULL) {
         /* Get the last occurrence of \n */
         if ((p = strrchr(str, '\n')) != NULL) {
             *p = '\0';
@@ -43,11 +39,6 @@ void *read_syslog(int pos, int *rc, int drop_it)
         else if (strlen(str) >= (OS_MAXSTR - OS_LOG_HEADER - 2)) {
             /* Message size > maximum allowed */
             __ms = 1;
-        } else {
-            /* Message not complete. Return. */
-            debug1("%s: Message not complete. Trying again: '%s'", ARGV0, str);
-            fsetpos(logff[pos].fp, &fp_pos);
-            break;
         }
 
 #ifdef WIN32
@@ -57,13 +48,11 @@ void *read_syslog(int pos, int *rc, int drop_it)
 
         /* Look for empty string (only on Windows) */
         if (strlen(str) <= 2) {
-            fgetpos(logff[pos].fp, &fp_pos);
             continue;
         }
 
         /* Windows can have comment on their logs */
         if (str[0] == '#') {
-            fgetpos(logff[pos].fp, &fp_pos);
             continue;
         }
 #endif
@@ -90,7 +79,7 @@ void *read_syslog(int pos, int *rc, int drop_it)
             buf[OUTSIZE] = '\0';
             snprintf(buf, OUTSIZE, "%s", str);
             merror("%s: Large message size(length=%d): '%s...'", ARGV0, (int)strlen(str), buf);
-            while (fgets(str, OS_MAXSTR - 2, logff[pos].fp) != NULL) {
+            while (LogReaderGets(str, OS_MAXSTR - 2, pos) != NULL) {
                 /* Get the last occurrence of \n */
                 if (strrchr(str, '\n') != NULL) {
                     break;
@@ -99,7 +88,6 @@ void *read_syslog(int pos, int *rc, int drop_it)
             __ms = 0;
         }
 
-        fgetpos(logff[pos].fp, &fp_pos);
         continue;
     }
 
@@ -0,0 +1,245 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Line reader shared by the file formats
+ *
+ * The files are read in large blocks straight from the descriptor
+ * and split in lines with memchr. A line is only returned once its
+ * newline was written: the beginning of a line still being written
+ * stays in the buffer until the next read, so the readers never
+ * have to seek back. Lines longer than the size given are returned
+ * in pieces, as fgets does. A reader can also mark a position and
+ * return to it later (to read again an incomplete multi-line event),
+ * as long as the lines since the mark fit in the buffer.
+ */
+
+#include "shared.h"
+#include "logcollector.h"
+
+/* Size of the buffer of each file */
+#define LOGREADER_BUFFER    65536
+
+typedef struct _LogReadBuffer {
+    char *data;
+    size_t start;       /* First byte not returned yet */
+    size_t end;         /* End of the data read */
+    size_t scan;        /* Searched for a newline up to here */
+    size_t mark;        /* Position to return to (if marked) */
+    int marked;
+    int error;          /* errno of the last read error */
+} LogReadBuffer;
+
+static LogReadBuffer *lr_buffers = NULL;
+static int lr_entries = 0;
+
+static LogReadBuffer *lr_get(int pos)
+{
+    if (!lr_buffers) {
+        for (lr_entries = 0; logff[lr_entries].file ||
+                logff[lr_entries].logformat; lr_entries++);
+        os_calloc(lr_entries + 1, sizeof(LogReadBuffer), lr_buffers);
+    }
+
+    if (pos >= lr_entries) {
+        return (NULL);
+    }
+
+    if (!lr_buffers[pos].data) {
+        os_malloc(LOGREADER_BUFFER, lr_buffers[pos].data);
+    }
+
+    return (&lr_buffers[pos]);
+}
+
+/* Read more data at the end of the buffer.
+ * Returns the number of bytes read, 0 if none or -1 on error.
+ */
+static ssize_t lr_fill(LogReadBuffer *buf, FILE *fp)
+{
+    size_t keep;
+    ssize_t n;
+
+    /* No room for more lines after the mark: forget it */
+    if (buf->marked && buf->mark == 0 && buf->end >= LOGREADER_BUFFER) {
+        buf->marked = 0;
+    }
+
+    /* Move the pending data to the beginning */
+    keep = buf->marked ? buf->mark : buf->start;
+    if (keep > 0) {
+        memmove(buf->data, buf->data + keep, buf->end - keep);
+        buf->end -= keep;
+        buf->scan -= keep;
+        buf->start -= keep;
+
+        if (buf->marked) {
+            buf->mark = 0;
+        }
+    }
+
+    if (buf->end >= LOGREADER_BUFFER) {
+        return (0);
+    }
+
+#ifndef WIN32
+    do {
+        n = read(fileno(fp), buf->data + buf->end, LOGREADER_BUFFER - buf->end);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        if (errno == EAGAIN) {
+            return (0);
+        }
+
+        buf->error = errno;
+        return (-1);
+    }
+#else
+    n = (ssize_t)fread(buf->data + buf->end, 1, LOGREADER_BUFFER - buf->end, fp);
+    if (n == 0 && ferror(fp)) {
+        buf->error = errno;
+        return (-1);
+    }
+#endif
+
+    buf->end += (size_t)n;
+    return (n);
+}
+
+/* Get the next line of a file, as fgets would (with the newline,
+ * up to size - 1 bytes). Returns NULL if there is no complete line.
+ */
+char *LogReaderGets(char *str, int size, int pos)
+{
+    LogReadBuffer *buf;
+    const char *nl;
+    size_t max;
+    size_t len;
+
+    if (size < 2 || !logff[pos].fp || !(buf = lr_get(pos))) {
+        return (NULL);
+    }
+
+    max = (size_t)size - 1;
+
+    while (1) {
+        nl = (const char *)memchr(buf->data + buf->scan, '\n',
+                                  buf->end - buf->scan);
+
+        if (nl) {
+            len = (size_t)(nl - (buf->data + buf->start)) + 1;
+        } else {
+            buf->scan = buf->end;
+            len = buf->end - buf->start;
+        }
+
+        /* A complete line, or a piece of a long one */
+        if ((nl && len <= max) || len >= max) {
+            if (len > max) {
+                len = max;
+            }
+
+            memcpy(str, buf->data + buf->start, len);
+            str[len] = '\0';
+
+            buf->start += len;
+            buf->scan = buf->start;
+            return (str);
+        }
+
+        if (lr_fill(buf, logff[pos].fp) <= 0) {
+            return (NULL);
+        }
+    }
+}
+
+/* Mark the position of the next line */
+void LogReaderMark(int pos)
+{
+    LogReadBuffer *buf;
+
+    if ((buf = lr_get(pos))) {
+        buf->mark = buf->start;
+        buf->marked = 1;
+    }
+}
+
+/* Go back to the position marked (the lines after it will be
+ * returned again)
+ */
+void LogReaderRewind(int pos)
+{
+    LogReadBuffer *buf;
+
+    if ((buf = lr_get(pos)) && buf->marked) {
+        buf->start = buf->mark;
+        buf->scan = buf->start;
+    }
+}
+
+/* Offset of the next line to be returned */
+long LogReaderTell(int pos)
+{
+    long offset;
+
+    if (!logff[pos].fp) {
+        return (-1);
+    }
+
+    /* The data is read from the descriptor, so ftell() would only
+     * know of the last fseek()
+     */
+#ifndef WIN32
+    offset = (long)lseek(fileno(logff[pos].fp), 0, SEEK_CUR);
+#else
+    offset = ftell(logff[pos].fp);
+#endif
+    if (offset < 0) {
+        return (-1);
+    }
+
+    if (lr_buffers && pos < lr_entries) {
+        offset -= (long)(lr_buffers[pos].end - lr_buffers[pos].start);
+    }
+
+    return (offset);
+}
+
+/* Get (and clear) the last read error of a file. Returns 0 if none,
+ * or the errno of the error (also set in errno).
+ */
+int LogReaderError(int pos)
+{
+    int error;
+
+    if (!lr_buffers || pos >= lr_entries || !lr_buffers[pos].error) {
+        return (0);
+    }
+
+    error = lr_buffers[pos].error;
+    lr_buffers[pos].error = 0;
+    errno = error;
+
+    return (error);
+}
+
+/* Drop the data buffered (the file was reopened or moved) */
+void LogReaderReset(int pos)
+{
+    if (!lr_buffers || pos >= lr_entries) {
+        return;
+    }
+
+    lr_buffers[pos].start = 0;
+    lr_buffers[pos].end = 0;
+    lr_buffers[pos].scan = 0;
+    lr_buffers[pos].mark = 0;
+    lr_buffers[pos].marked = 0;
+    lr_buffers[pos].error = 0;
+}
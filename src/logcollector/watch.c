@@ -0,0 +1,231 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Wait for changes on the files being read
+ *
+ * With inotify, every open file is watched and the main loop wakes
+ * up as soon as one of them is written, reading only the files that
+ * changed. The files that can not be watched (or when inotify is not
+ * available) are read on every pass, every loop_timeout seconds.
+ */
+
+#include "shared.h"
+#include "logcollector.h"
+
+#ifdef INOTIFY_ENABLED
+#include <sys/inotify.h>
+
+#define LOGWATCH_FLAGS  IN_MODIFY|IN_ATTRIB|IN_MOVE_SELF|IN_DELETE_SELF
+#define LOGWATCH_BUFFER (512 * (sizeof(struct inotify_event) + 16))
+
+static int lw_fd = -1;
+
+/* Watch descriptor of each entry of logff (-1 if not watched) */
+static int *lw_wd = NULL;
+static char *lw_changed = NULL;
+static int lw_entries = 0;
+
+/* Entry of each watch descriptor (-1 if none, -2 if shared) */
+static int *lw_index = NULL;
+static int lw_index_size = 0;
+
+static void lw_set_index(int wd, int i)
+{
+    if (wd >= lw_index_size) {
+        int size = lw_index_size ? lw_index_size : 64;
+        int j;
+
+        while (wd >= size) {
+            size *= 2;
+        }
+
+        os_realloc(lw_index, (size_t)size * sizeof(int), lw_index);
+        for (j = lw_index_size; j < size; j++) {
+            lw_index[j] = -1;
+        }
+        lw_index_size = size;
+    }
+
+    /* Hard links to the same file */
+    if (i >= 0 && lw_index[wd] >= 0 && lw_index[wd] != i) {
+        i = -2;
+    }
+
+    lw_index[wd] = i;
+}
+
+/* Flag the entries of a watch descriptor as changed */
+static void lw_mark(int wd, int removed)
+{
+    int i;
+
+    if (wd < 0 || wd >= lw_index_size || lw_index[wd] == -1) {
+        return;
+    }
+
+    for (i = 0; i < lw_entries; i++) {
+        if (lw_index[wd] >= 0 && i != lw_index[wd]) {
+            continue;
+        }
+
+        if (lw_wd[i] == wd) {
+            lw_changed[i] = 1;
+            if (removed) {
+                lw_wd[i] = -1;
+            }
+        }
+    }
+
+    if (removed) {
+        lw_index[wd] = -1;
+    }
+}
+
+#endif /* INOTIFY_ENABLED */
+
+/* Start watching the files */
+void LogWatchInit(void)
+{
+#ifdef INOTIFY_ENABLED
+    int i;
+
+    for (lw_entries = 0; logff[lw_entries].file; lw_entries++);
+    os_calloc(lw_entries + 1, sizeof(int), lw_wd);
+    os_calloc(lw_entries + 1, sizeof(char), lw_changed);
+
+    for (i = 0; i < lw_entries; i++) {
+        lw_wd[i] = -1;
+    }
+
+    lw_fd = inotify_init();
+    if (lw_fd < 0) {
+        merror("%s: WARN: Unable to initialize inotify (%d): %s. "
+               "Polling the files.", ARGV0, errno, strerror(errno));
+        return;
+    }
+
+    fcntl(lw_fd, F_SETFD, FD_CLOEXEC);
+    debug1("%s: DEBUG: Watching the files with inotify.", ARGV0);
+#endif
+}
+
+/* Watch a file just opened */
+void LogWatchAdd(int i)
+{
+#ifdef INOTIFY_ENABLED
+    struct stat stat_fd;
+    int wd;
+
+    if (lw_fd < 0 || i >= lw_entries || !logff[i].fp) {
+        return;
+    }
+
+    lw_changed[i] = 1;
+
+    /* Only regular files report their writes */
+    if (fstat(fileno(logff[i].fp), &stat_fd) < 0 ||
+            !S_ISREG(stat_fd.st_mode)) {
+        lw_wd[i] = -1;
+        return;
+    }
+
+    wd = inotify_add_watch(lw_fd, logff[i].file, LOGWATCH_FLAGS);
+    if (wd < 0) {
+        merror("%s: WARN: Unable to watch '%s' (%d): %s. Polling it.",
+               ARGV0, logff[i].file, errno, strerror(errno));
+        lw_wd[i] = -1;
+        return;
+    }
+
+    /* Another file was watched before (rotated) */
+    if (lw_wd[i] >= 0 && lw_wd[i] != wd && lw_wd[i] < lw_index_size &&
+            lw_index[lw_wd[i]] == i) {
+        inotify_rm_watch(lw_fd, lw_wd[i]);
+        lw_index[lw_wd[i]] = -1;
+    }
+
+    lw_wd[i] = wd;
+    lw_set_index(wd, i);
+#else
+    (void)i;
+#endif
+}
+
+/* Wait up to timeout seconds for a change.
+ * Returns the number of changes, 0 on timeout or -1 on error.
+ */
+int LogWatchWait(int timeout)
+{
+    struct timeval fp_timeout;
+    int r;
+
+    fp_timeout.tv_sec = timeout;
+    fp_timeout.tv_usec = 0;
+
+#ifdef INOTIFY_ENABLED
+    if (lw_fd >= 0) {
+        char buf[LOGWATCH_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+        const struct inotify_event *event;
+        fd_set fdset;
+        ssize_t len;
+        ssize_t j;
+        int changes = 0;
+
+        FD_ZERO(&fdset);
+        FD_SET(lw_fd, &fdset);
+
+        if ((r = select(lw_fd + 1, &fdset, NULL, NULL, &fp_timeout)) <= 0) {
+            return (r);
+        }
+
+        len = read(lw_fd, buf, sizeof(buf));
+        if (len < 0) {
+            return (errno == EINTR || errno == EAGAIN ? 0 : -1);
+        }
+
+        for (j = 0; j < len; j += (ssize_t)(sizeof(struct inotify_event) + event->len)) {
+            event = (const struct inotify_event *)(buf + j);
+
+            /* Events were lost: read everything */
+            if (event->mask & IN_Q_OVERFLOW) {
+                memset(lw_changed, 1, (size_t)lw_entries);
+                changes++;
+                continue;
+            }
+
+            lw_mark(event->wd, event->mask & (IN_IGNORED | IN_DELETE_SELF) ? 1 : 0);
+            changes++;
+        }
+
+        return (changes);
+    }
+#endif
+
+    return (select(0, NULL, NULL, NULL, &fp_timeout));
+}
+
+/* Check (and clear) if a file may have new data.
+ * Files not watched always may.
+ */
+int LogWatchChanged(int i)
+{
+#ifdef INOTIFY_ENABLED
+    if (lw_fd >= 0 && i < lw_entries && lw_wd[i] >= 0) {
+        if (!lw_changed[i]) {
+            return (0);
+        }
+
+        lw_changed[i] = 0;
+    }
+#else
+    (void)i;
+#endif
+
+    return (1);
+}
@@ -15,12 +15,17 @@
 #include "../sha1/sha.h"
 #include "headers/defs.h"
 
+/* Size of each read (large enough for the reads to go
+ * straight from the file to the buffer)
+ */
+#define MD5_SHA1_READ_SIZE  65536
+
 
 int OS_MD5_SHA1_File(const char *fname, const char *prefilter_cmd, os_md5 md5output, os_sha1 sha1output, int mode)
 {
     size_t n;
     FILE *fp;
-    unsigned char buf[2048 + 2];
+    unsigned char buf[MD5_SHA1_READ_SIZE];
     unsigned char sha1_digest[SHA_DIGEST_LENGTH];
     unsigned char md5_digest[16];
 
@@ -30,7 +35,6 @@ int OS_MD5_SHA1_File(const char *fname, const char *prefilter_cmd, os_md5 md5out
     /* Clear the memory */
     md5output[0] = '\0';
     sha1output[0] = '\0';
-    buf[2048 + 1] = '\0';
 
     /* Use prefilter_cmd if set */
     if (prefilter_cmd == NULL) {
@@ -55,9 +59,8 @@ int OS_MD5_SHA1_File(const char *fname, const char *prefilter_cmd, os_md5 md5out
     MD5Init(&md5_ctx);
     SHA1_Init(&sha1_ctx);
 
-    /* Update for each one */
-    while ((n = fread(buf, 1, 2048, fp)) > 0) {
-        buf[n] = '\0';
+    /* Update both in the same pass */
+    while ((n = fread(buf, 1, MD5_SHA1_READ_SIZE, fp)) > 0) {
         SHA1_Update(&sha1_ctx, buf, n);
         MD5Update(&md5_ctx, buf, (unsigned)n);
     }
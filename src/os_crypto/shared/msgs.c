@@ -13,10 +13,21 @@
 #include "os_crypto/md5/md5_op.h"
 #include "os_crypto/blowfish/bf_op.h"
 
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
 /* Prototypes */
 static void StoreSenderCounter(const keystore *keys, unsigned int global, unsigned int local) __attribute((nonnull));
 static void StoreCounter(const keystore *keys, int id, unsigned int global, unsigned int local) __attribute((nonnull));
 static char *CheckSum(char *msg) __attribute((nonnull));
+#ifndef WIN32
+static void StartCounterTable(keystore *keys) __attribute((nonnull));
+static int GrowCounterTable(unsigned int size);
+static void ImportCounters(void);
+static void SyncCounters(void);
+static const char *RidsDir(void);
+#endif
 
 /* Sending counts */
 static unsigned int global_count = 0;
@@ -34,6 +45,62 @@ static unsigned int _s_recv_flush = 0;
 
 static int _s_verify_counter = 1;
 
+/* Table of the counters of the agents (on the server), in a single
+ * file mapped in memory and indexed by the agent ID
+ */
+#define RIDS_MAGIC      "OSSECRID"
+#define RIDS_GROW       1024
+
+typedef struct _rids_entry {
+    unsigned int global;
+    unsigned int local;
+} rids_entry;
+
+typedef struct _rids_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int size;      /* Entries in the table */
+    rids_entry sender;      /* Sender counter */
+} rids_header;
+
+static rids_header *rids = NULL;
+
+#ifndef WIN32
+static unsigned int _s_counter_sync = 0;
+static int rids_fd = -1;
+static time_t rids_synced = 0;
+
+#define RIDS_ENTRIES(h)     ((rids_entry *)((h) + 1))
+#define RIDS_MAPSIZE(n)     (sizeof(rids_header) + (size_t)(n) * sizeof(rids_entry))
+
+/* Index of an agent in the table (its numeric ID), or -1 if it has none */
+static int CounterIndex(const char *id)
+{
+    unsigned int index = 0;
+    size_t len = 0;
+
+    for (; isdigit((unsigned char)id[len]); len++) {
+        index = index * 10 + (unsigned int)(id[len] - '0');
+    }
+
+    if (len == 0 || len > 8 || id[len] != '\0') {
+        return (-1);
+    }
+
+    return ((int)index);
+}
+#endif
+
+
+/* Directory of the counters, from inside the chroot or not */
+static const char *RidsDir()
+{
+#ifndef WIN32
+    return (isChroot() ? RIDS_DIR : DEFAULTDIR RIDS_DIR);
+#else
+    return (RIDS_DIR);
+#endif
+}
 
 /* Read counters for each agent */
 void OS_StartCounter(keystore *keys)
@@ -45,16 +112,28 @@ void OS_StartCounter(keystore *keys)
 
     debug1("%s: OS_StartCounter: keysize: %u", __local_name, keys->keysize);
 
+#ifndef WIN32
+    /* The server keeps them in a single table (and skips the files) */
+    if (!isAgent) {
+        StartCounterTable(keys);
+        i = keys->keysize + 1;
+    } else {
+        i = 0;
+    }
+#else
+    i = 0;
+#endif
+
     /* Start receiving counter */
-    for (i = 0; i <= keys->keysize; i++) {
+    for (; i <= keys->keysize; i++) {
         /* On i == keysize, we deal with the sender counter */
         if (i == keys->keysize) {
             snprintf(rids_file, OS_FLSIZE, "%s/%s",
-                     RIDS_DIR,
+                     RidsDir(),
                      SENDER_COUNTER);
         } else {
             snprintf(rids_file, OS_FLSIZE, "%s/%s",
-                     RIDS_DIR,
+                     RidsDir(),
                      keys->keyentries[i]->id);
         }
 
@@ -133,15 +212,273 @@ void OS_StartCounter(keystore *keys)
 void OS_RemoveCounter(const char *id)
 {
     char rids_file[OS_FLSIZE + 1];
-    snprintf(rids_file, OS_FLSIZE, "%s/%s", RIDS_DIR, id);
-    if ((unlink(rids_file)) < 0) {
+    int in_table = 0;
+
+#ifndef WIN32
+    rids_header hdr;
+    rids_entry entry;
+    int index = CounterIndex(id);
+    int fd;
+
+    /* Clear it in the table, if the server has one */
+    snprintf(rids_file, OS_FLSIZE, "%s/%s", RidsDir(), RIDS_TABLE);
+    if ((fd = open(rids_file, O_RDWR)) >= 0) {
+        memset(&entry, 0, sizeof(rids_entry));
+
+        if (read(fd, &hdr, sizeof(rids_header)) == sizeof(rids_header) &&
+                memcmp(hdr.magic, RIDS_MAGIC, sizeof(hdr.magic)) == 0) {
+            in_table = 1;
+
+            if (index >= 0 && (unsigned int)index < hdr.size &&
+                    pwrite(fd, &entry, sizeof(rids_entry),
+                           (off_t)RIDS_MAPSIZE(index)) != sizeof(rids_entry)) {
+                merror("%s: ERROR: Cannot clear the counter of '%s' in %s: %s",
+                       __local_name, id, rids_file, strerror(errno));
+            }
+        }
+
+        close(fd);
+    }
+#endif
+
+    snprintf(rids_file, OS_FLSIZE, "%s/%s", RidsDir(), id);
+    if ((unlink(rids_file)) < 0 && !(in_table && errno == ENOENT)) {
         merror("%s: ERROR: Cannot unlink %s: %s", __local_name, rids_file, strerror(errno));
     }
 }
 
+#ifndef WIN32
+/* Open (or create) the table of counters and read them into the keys */
+static void StartCounterTable(keystore *keys)
+{
+    char rids_file[OS_FLSIZE + 1];
+    struct stat st;
+    unsigned int size = 0;
+    unsigned int i;
+    int index;
+    int created = 0;
+
+    if (_s_counter_sync == 0) {
+        _s_counter_sync = (unsigned int) getDefine_Int("remoted",
+                          "counter_sync",
+                          1, 3600);
+    }
+
+    /* Room for the highest ID */
+    for (i = 0; i < keys->keysize; i++) {
+        index = CounterIndex(keys->keyentries[i]->id);
+        if (index >= 0 && (unsigned int)index >= size) {
+            size = (unsigned int)index + 1;
+        }
+    }
+
+    if (rids_fd < 0) {
+        snprintf(rids_file, OS_FLSIZE, "%s/%s", RidsDir(), RIDS_TABLE);
+
+        rids_fd = open(rids_file, O_RDWR | O_CREAT, 0640);
+        if (rids_fd < 0 || fstat(rids_fd, &st) < 0) {
+            ErrorExit(FOPEN_ERROR, __local_name, rids_file, errno, strerror(errno));
+        }
+
+        if ((size_t)st.st_size >= sizeof(rids_header)) {
+            rids = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, rids_fd, 0);
+            if (rids == MAP_FAILED) {
+                ErrorExit("%s: ERROR: Unable to map '%s': %s", __local_name,
+                          rids_file, strerror(errno));
+            }
+
+            if (memcmp(rids->magic, RIDS_MAGIC, sizeof(rids->magic)) != 0 ||
+                    RIDS_MAPSIZE(rids->size) != (size_t)st.st_size) {
+                merror("%s: ERROR: Invalid counter table '%s'. Creating it again.",
+                       __local_name, rids_file);
+                munmap(rids, (size_t)st.st_size);
+                rids = NULL;
+            }
+        }
+
+        if (!rids) {
+            if (ftruncate(rids_fd, 0) < 0) {
+                ErrorExit("%s: ERROR: Could not size the counter table '%s': %s",
+                          __local_name, rids_file, strerror(errno));
+            }
+            created = 1;
+        }
+    }
+
+    if (GrowCounterTable(size) < 0) {
+        ErrorExit("%s: ERROR: Could not size the counter table '%s/%s': %s",
+                  __local_name, RidsDir(), RIDS_TABLE, strerror(errno));
+    }
+
+    /* The first time, take the counters of the files of each agent */
+    if (created) {
+        ImportCounters();
+    }
+
+    for (i = 0; i < keys->keysize; i++) {
+        index = CounterIndex(keys->keyentries[i]->id);
+        if (index < 0) {
+            merror("%s: ERROR: Agent ID '%s' is not numeric. Its counter "
+                   "is not stored.", __local_name, keys->keyentries[i]->id);
+            continue;
+        }
+
+        keys->keyentries[i]->global = RIDS_ENTRIES(rids)[index].global;
+        keys->keyentries[i]->local = RIDS_ENTRIES(rids)[index].local;
+
+        debug1("%s: DEBUG: Assigning counter for agent %s: '%u:%u'.",
+               __local_name, keys->keyentries[i]->name,
+               keys->keyentries[i]->global, keys->keyentries[i]->local);
+    }
+
+    global_count = rids->sender.global;
+    local_count = rids->sender.local;
+
+    verbose("%s: INFO: Read the counters of %u agents from '%s/%s'. "
+            "Sender counter: %u:%u", __local_name, keys->keysize, RidsDir(),
+            RIDS_TABLE, global_count, local_count);
+}
+
+/* Make room for size entries in the table (it never shrinks).
+ * Returns 0 on success or -1 on error.
+ */
+static int GrowCounterTable(unsigned int size)
+{
+    rids_header *map;
+    unsigned int old_size = rids ? rids->size : 0;
+
+    if (rids && size <= old_size) {
+        return (0);
+    }
+
+    /* Extended in steps, with holes in the file for the IDs not used */
+    size = (size + RIDS_GROW - 1) / RIDS_GROW * RIDS_GROW;
+    if (size == 0) {
+        size = RIDS_GROW;
+    }
+
+    if (rids) {
+        msync(rids, RIDS_MAPSIZE(old_size), MS_SYNC);
+        munmap(rids, RIDS_MAPSIZE(old_size));
+        rids = NULL;
+    }
+
+    if (ftruncate(rids_fd, (off_t)RIDS_MAPSIZE(size)) < 0) {
+        return (-1);
+    }
+
+    map = mmap(NULL, RIDS_MAPSIZE(size), PROT_READ | PROT_WRITE,
+               MAP_SHARED, rids_fd, 0);
+    if (map == MAP_FAILED) {
+        return (-1);
+    }
+
+    memcpy(map->magic, RIDS_MAGIC, sizeof(map->magic));
+    map->version = 1;
+    map->size = size;
+
+    msync(map, RIDS_MAPSIZE(size), MS_SYNC);
+    rids = map;
+    rids_synced = time(0);
+
+    return (0);
+}
+
+/* Import the counters of the files of the agents (and the sender
+ * counter), removing them
+ */
+static void ImportCounters()
+{
+    char rids_file[OS_FLSIZE + 1];
+    char name[KEYSIZE + 1];
+    struct dirent *entry;
+    unsigned int g_c, l_c;
+    unsigned int count = 0;
+    int index;
+    DIR *dir;
+    FILE *fp;
+
+    if ((dir = opendir(RidsDir())) == NULL) {
+        merror("%s: ERROR: Unable to open directory '%s': %s", __local_name,
+               RidsDir(), strerror(errno));
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        index = CounterIndex(entry->d_name);
+        if (index < 0 && strcmp(entry->d_name, SENDER_COUNTER) != 0) {
+            continue;
+        }
+
+        /* The name of an agent (or of the sender counter) */
+        strncpy(name, entry->d_name, KEYSIZE);
+        name[KEYSIZE] = '\0';
+
+        snprintf(rids_file, OS_FLSIZE, "%s/%s", RidsDir(), name);
+        if ((fp = fopen(rids_file, "r")) == NULL) {
+            merror(FOPEN_ERROR, __local_name, rids_file, errno, strerror(errno));
+            continue;
+        }
+
+        if (fscanf(fp, "%u:%u", &g_c, &l_c) != 2) {
+            g_c = 0;
+            l_c = 0;
+        }
+        fclose(fp);
+
+        if (index < 0) {
+            rids->sender.global = g_c;
+            rids->sender.local = l_c;
+        } else if (GrowCounterTable((unsigned int)index + 1) == 0) {
+            RIDS_ENTRIES(rids)[index].global = g_c;
+            RIDS_ENTRIES(rids)[index].local = l_c;
+        } else {
+            merror("%s: ERROR: Could not import the counter of '%s': %s",
+                   __local_name, name, strerror(errno));
+            continue;
+        }
+
+        unlink(rids_file);
+        count++;
+    }
+
+    closedir(dir);
+
+    msync(rids, RIDS_MAPSIZE(rids->size), MS_SYNC);
+    rids_synced = time(0);
+
+    if (count > 0) {
+        verbose("%s: INFO: Imported %u counters from '%s' into '%s'.",
+                __local_name, count, RidsDir(), RIDS_TABLE);
+    }
+}
+
+/* Write the table to disk, at most every counter_sync seconds */
+static void SyncCounters()
+{
+    time_t now = time(0);
+
+    if ((now - rids_synced) < (time_t)_s_counter_sync) {
+        return;
+    }
+
+    msync(rids, RIDS_MAPSIZE(rids->size), MS_SYNC);
+    rids_synced = now;
+}
+#endif
+
 /* Store sender counter */
 static void StoreSenderCounter(const keystore *keys, unsigned int global, unsigned int local)
 {
+#ifndef WIN32
+    if (rids) {
+        rids->sender.global = global;
+        rids->sender.local = local;
+        return;
+    }
+#endif
+
     /* Write to the beginning of the file */
     fseek(keys->keyentries[keys->keysize]->fp, 0, SEEK_SET);
     fprintf(keys->keyentries[keys->keysize]->fp, "%u:%u:", global, local);
@@ -150,6 +487,20 @@ static void StoreSenderCounter(const keystore *keys, unsigned int global, unsign
 /* Store the global and local count of events */
 static void StoreCounter(const keystore *keys, int id, unsigned int global, unsigned int local)
 {
+#ifndef WIN32
+    if (rids) {
+        int index = CounterIndex(keys->keyentries[id]->id);
+
+        if (index >= 0 && (unsigned int)index < rids->size) {
+            RIDS_ENTRIES(rids)[index].global = global;
+            RIDS_ENTRIES(rids)[index].local = local;
+        }
+
+        SyncCounters();
+        return;
+    }
+#endif
+
     /* Write to the beginning of the file */
     fseek(keys->keyentries[id]->fp, 0, SEEK_SET);
     fprintf(keys->keyentries[id]->fp, "%u:%u:", global, local);
@@ -177,24 +528,25 @@ static char *CheckSum(char *msg)
     return (msg);
 }
 
-char *ReadSecMSG(keystore *keys, char *buffer, char *cleartext,
-                 int id, unsigned int buffer_size)
+/* Decrypt and decompress a remote message, and verify its checksum.
+ * Only the key of the agent is used, so it can run in parallel.
+ * Returns NULL on error or the message on success
+ */
+char *OpenSecMSG(const char *key, const char *agent_ip, char *buffer,
+                 char *cleartext, unsigned int buffer_size, secmsg_counter *counter)
 {
-    unsigned int msg_global = 0;
-    unsigned int msg_local = 0;
     char *f_msg;
 
     if (*buffer == ':') {
         buffer++;
     } else {
-        merror(ENCFORMAT_ERROR, __local_name, keys->keyentries[id]->ip->ip);
+        merror(ENCFORMAT_ERROR, __local_name, agent_ip);
         return (NULL);
     }
 
     /* Decrypt message */
-    if (!OS_BF_Str(buffer, cleartext, keys->keyentries[id]->key,
-                   buffer_size, OS_DECRYPT)) {
-        merror(ENCKEY_ERROR, __local_name, keys->keyentries[id]->ip->ip);
+    if (!OS_BF_Str(buffer, cleartext, key, buffer_size, OS_DECRYPT)) {
+        merror(ENCKEY_ERROR, __local_name, agent_ip);
         return (NULL);
     }
 
@@ -219,77 +571,33 @@ char *ReadSecMSG(keystore *keys, char *buffer, char *cleartext,
         /* Check checksum */
         f_msg = CheckSum(buffer);
         if (f_msg == NULL) {
-            merror(ENCSUM_ERROR, __local_name, keys->keyentries[id]->ip->ip);
+            merror(ENCSUM_ERROR, __local_name, agent_ip);
             return (NULL);
         }
 
         /* Remove random */
         f_msg += 5;
 
-        /* Check count -- protect against replay attacks */
-        msg_global = (unsigned int) atoi(f_msg);
+        /* Get count -- protect against replay attacks */
+        counter->global = (unsigned int) atoi(f_msg);
         f_msg += 10;
 
         /* Check for the right message format */
         if (*f_msg != ':') {
-            merror(ENCFORMAT_ERROR, __local_name, keys->keyentries[id]->ip->ip);
+            merror(ENCFORMAT_ERROR, __local_name, agent_ip);
             return (NULL);
         }
         f_msg++;
 
-        msg_local = (unsigned int) atoi(f_msg);
+        counter->local = (unsigned int) atoi(f_msg);
         f_msg += 5;
 
-        /* Return the message if we don't need to verify the counter */
-        if (!_s_verify_counter) {
-            /* Update current counts */
-            keys->keyentries[id]->global = msg_global;
-            keys->keyentries[id]->local = msg_local;
-            if (rcv_count >= _s_recv_flush) {
-                StoreCounter(keys, id, msg_global, msg_local);
-                rcv_count = 0;
-            }
-            rcv_count++;
-            return (f_msg);
-        }
-
-
-        if ((msg_global > keys->keyentries[id]->global) ||
-                ((msg_global == keys->keyentries[id]->global) &&
-                 (msg_local > keys->keyentries[id]->local))) {
-            /* Update current counts */
-            keys->keyentries[id]->global = msg_global;
-            keys->keyentries[id]->local = msg_local;
-
-            if (rcv_count >= _s_recv_flush) {
-                StoreCounter(keys, id, msg_global, msg_local);
-                rcv_count = 0;
-            }
-            rcv_count++;
-            return (f_msg);
-        }
-
-        /* Check if it is a duplicated message */
-        if (msg_global == keys->keyentries[id]->global) {
-            /* Warn about duplicated messages */
-            merror("%s: WARN: Duplicate error:  global: %u, local: %u, "
-               "saved global: %u, saved local:%u",
-               __local_name,
-               msg_global,
-               msg_local,
-               keys->keyentries[id]->global,
-               keys->keyentries[id]->local);
-
-            merror(ENCTIME_ERROR, __local_name, keys->keyentries[id]->name);
-            return (NULL);
-        }
+        counter->old_format = 0;
+        return (f_msg);
     }
 
     /* Old format */
     else if (cleartext[0] == ':') {
-        unsigned int msg_count;
-        unsigned int msg_time;
-
         /* Close string */
         cleartext[buffer_size] = '\0';
 
@@ -297,73 +605,126 @@ char *ReadSecMSG(keystore *keys, char *buffer, char *cleartext,
         cleartext++;
         f_msg = CheckSum(cleartext);
         if (f_msg == NULL) {
-            merror(ENCSUM_ERROR, __local_name, keys->keyentries[id]->ip->ip);
+            merror(ENCSUM_ERROR, __local_name, agent_ip);
             return (NULL);
         }
 
-        /* Check time -- protect against replay attacks */
-        msg_time = (unsigned int) atoi(f_msg);
+        /* Get time and count -- protect against replay attacks */
+        counter->global = (unsigned int) atoi(f_msg);
         f_msg += 11;
 
-        msg_count = (unsigned int) atoi(f_msg);
+        counter->local = (unsigned int) atoi(f_msg);
         f_msg += 5;
 
+        f_msg = strchr(f_msg, ':');
+        if (!f_msg) {
+            merror(ENCFORMAT_ERROR, __local_name, agent_ip);
+            return (NULL);
+        }
 
-        /* Return the message if we don't need to verify the counter */
-        if (!_s_verify_counter) {
-            /* Update current counts */
-            keys->keyentries[id]->global = msg_time;
-            keys->keyentries[id]->local = msg_local;
+        counter->old_format = 1;
+        return (f_msg + 1);
+    }
 
-            f_msg = strchr(f_msg, ':');
-            if (f_msg) {
-                f_msg++;
-                return (f_msg);
-            } else {
-                merror(ENCFORMAT_ERROR, __local_name, keys->keyentries[id]->ip->ip);
-                return (NULL);
+    merror(ENCFORMAT_ERROR, __local_name, agent_ip);
+    return (NULL);
+}
+
+/* Check the counters of a message against the last ones received from
+ * the agent, and update them. The messages of an agent must be checked
+ * in the order they were received.
+ * Returns 1 if the message is valid, 0 if it must be discarded
+ */
+int CheckSecMSG(keystore *keys, int id, const secmsg_counter *counter)
+{
+    keyentry *agent = keys->keyentries[id];
+
+    /* Accept the message if we don't need to verify the counter */
+    if (!_s_verify_counter) {
+        /* Update current counts */
+        agent->global = counter->global;
+        agent->local = counter->local;
+
+        if (!counter->old_format) {
+            if (rids || rcv_count >= _s_recv_flush) {
+                StoreCounter(keys, id, counter->global, counter->local);
+                rcv_count = 0;
             }
+            rcv_count++;
         }
+        return (1);
+    }
 
+    if ((counter->global > agent->global) ||
+            ((counter->global == agent->global) &&
+             (counter->local > agent->local))) {
+        /* Update current counts */
+        agent->global = counter->global;
+        agent->local = counter->local;
 
-        if ((msg_time > keys->keyentries[id]->global) ||
-                ((msg_time == keys->keyentries[id]->global) &&
-                 (msg_count > keys->keyentries[id]->local))) {
-            /* Update current time and count */
-            keys->keyentries[id]->global = msg_time;
-            keys->keyentries[id]->local = msg_count;
-
-            f_msg = strchr(f_msg, ':');
-            if (f_msg) {
-                f_msg++;
-                return (f_msg);
-            } else {
-                merror(ENCFORMAT_ERROR, __local_name, keys->keyentries[id]->ip->ip);
-                return (NULL);
+        if (!counter->old_format) {
+            if (rids || rcv_count >= _s_recv_flush) {
+                StoreCounter(keys, id, counter->global, counter->local);
+                rcv_count = 0;
             }
+            rcv_count++;
         }
+        return (1);
+    }
 
+    if (!counter->old_format) {
         /* Check if it is a duplicated message */
-        if ((msg_count == keys->keyentries[id]->local) &&
-                (msg_time == keys->keyentries[id]->global)) {
-            return (NULL);
+        if (counter->global == agent->global) {
+            /* Warn about duplicated messages */
+            merror("%s: WARN: Duplicate error:  global: %u, local: %u, "
+                   "saved global: %u, saved local:%u",
+                   __local_name,
+                   counter->global,
+                   counter->local,
+                   agent->global,
+                   agent->local);
+
+            merror(ENCTIME_ERROR, __local_name, agent->name);
+            return (0);
         }
 
-        /* Warn about duplicated message */
-        merror("%s: WARN: Duplicate error:  msg_count: %u, time: %u, "
-               "saved count: %u, saved_time:%u",
-               __local_name,
-               msg_count,
-               msg_time,
-               keys->keyentries[id]->local,
-               keys->keyentries[id]->global);
+        merror(ENCFORMAT_ERROR, __local_name, agent->ip->ip);
+        return (0);
+    }
+
+    /* Check if it is a duplicated message */
+    if ((counter->local == agent->local) &&
+            (counter->global == agent->global)) {
+        return (0);
+    }
+
+    /* Warn about duplicated message */
+    merror("%s: WARN: Duplicate error:  msg_count: %u, time: %u, "
+           "saved count: %u, saved_time:%u",
+           __local_name,
+           counter->local,
+           counter->global,
+           agent->local,
+           agent->global);
+
+    merror(ENCTIME_ERROR, __local_name, agent->name);
+    return (0);
+}
+
+char *ReadSecMSG(keystore *keys, char *buffer, char *cleartext,
+                 int id, unsigned int buffer_size)
+{
+    secmsg_counter counter;
+    char *f_msg;
+
+    f_msg = OpenSecMSG(keys->keyentries[id]->key, keys->keyentries[id]->ip->ip,
+                       buffer, cleartext, buffer_size, &counter);
 
-        merror(ENCTIME_ERROR, __local_name, keys->keyentries[id]->name);
+    if (f_msg == NULL || !CheckSecMSG(keys, id, &counter)) {
         return (NULL);
     }
 
-    merror(ENCFORMAT_ERROR, __local_name, keys->keyentries[id]->ip->ip);
-    return (NULL);
+    return (f_msg);
 }
 
 /* Create an encrypted message
@@ -480,3 +841,86 @@ size_t CreateSecMSG(const keystore *keys, const char *msg, char *msg_encrypted,
     return (cmp_size + msg_size);
 }
 
+
+int AddSecMSGBatch(char *batch, size_t *used, size_t size, const char *msg)
+{
+    size_t msg_size = strlen(msg);
+    char header[16];
+    int header_size;
+
+    if (msg_size == 0) {
+        return (-1);
+    }
+
+    if (*used == 0) {
+        if (size < SECMSG_BATCH_HEADER_SIZE + 1) {
+            return (-1);
+        }
+
+        memcpy(batch, SECMSG_BATCH_HEADER, SECMSG_BATCH_HEADER_SIZE + 1);
+        *used = SECMSG_BATCH_HEADER_SIZE;
+    }
+
+    header_size = snprintf(header, sizeof(header), "%lu:", (unsigned long)msg_size);
+
+    /* Room for the terminator too */
+    if (*used + (size_t)header_size + msg_size >= size) {
+        return (-1);
+    }
+
+    memcpy(batch + *used, header, (size_t)header_size);
+    *used += (size_t)header_size;
+    memcpy(batch + *used, msg, msg_size + 1);
+    *used += msg_size;
+
+    return (0);
+}
+
+int IsSecMSGBatch(const char *msg)
+{
+    return (strncmp(msg, SECMSG_BATCH_HEADER, SECMSG_BATCH_HEADER_SIZE) == 0);
+}
+
+int ReadSecMSGBatch(const char *batch, size_t *pos, char *event)
+{
+    const char *pt;
+    size_t msg_size = 0;
+
+    if (*pos == 0) {
+        *pos = SECMSG_BATCH_HEADER_SIZE;
+    }
+
+    pt = batch + *pos;
+    if (*pt == '\0') {
+        return (0);
+    }
+
+    /* Size of the event */
+    if (!isdigit((unsigned char)*pt)) {
+        return (-1);
+    }
+
+    while (isdigit((unsigned char)*pt)) {
+        msg_size = msg_size * 10 + (size_t)(*pt - '0');
+        if (msg_size > OS_MAXSTR) {
+            return (-1);
+        }
+        pt++;
+    }
+
+    if (*pt != ':') {
+        return (-1);
+    }
+    pt++;
+
+    /* The whole event must be in the batch */
+    if (msg_size == 0 || strnlen(pt, msg_size) < msg_size) {
+        return (-1);
+    }
+
+    memcpy(event, pt, msg_size);
+    event[msg_size] = '\0';
+
+    *pos = (size_t)(pt + msg_size - batch);
+    return (1);
+}
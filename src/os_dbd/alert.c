@@ -12,9 +12,28 @@
 #include "config/dbd-config.h"
 #include "rules_op.h"
 
+/* Maximum size of the statement of a batch (the default
+ * max_allowed_packet of MySQL is larger)
+ */
+#define BATCH_SQL_MAX   (512 * 1024)
+
+/* Alerts waiting to be inserted */
+static char *batch_sql = NULL;
+static size_t batch_len = 0;
+static size_t batch_alloc = 0;
+static unsigned int batch_rows = 0;
+static time_t batch_time = 0;
+
+/* Where each row of the batch starts */
+static size_t *batch_starts = NULL;
+static unsigned int batch_starts_alloc = 0;
+
 /* Prototypes */
 static int __DBSelectLocation(const char *location, const DBConfig *db_config) __attribute__((nonnull));
 static int __DBInsertLocation(const char *location, const DBConfig *db_config) __attribute__((nonnull));
+static const char *__DBAlertInsert(const DBConfig *db_config) __attribute__((nonnull));
+static void __DBBatchAdd(const char *row, DBConfig *db_config) __attribute__((nonnull));
+static int __DBBatchRows(const DBConfig *db_config) __attribute__((nonnull));
 
 
 /* Select the maximum ID from the alert table
@@ -82,7 +101,157 @@ static int __DBInsertLocation(const char *location, const DBConfig *db_config)
     return (0);
 }
 
-/* Insert alert into to the db
+/* Start of the statement inserting the alerts */
+static const char *__DBAlertInsert(const DBConfig *db_config)
+{
+    if (db_config->db_type == MYSQLDB) {
+        return ("INSERT INTO "
+                "alert(server_id,rule_id,level,timestamp,location_id,src_ip,src_port,dst_ip,dst_port,alertid,user,full_log,tld) "
+                "VALUES ");
+    }
+
+    return ("INSERT INTO "
+            "alert(server_id,rule_id,level,timestamp,location_id,src_ip,src_port,dst_ip,dst_port,alertid,\"user\",full_log) "
+            "VALUES ");
+}
+
+/* Add the values of an alert to the batch */
+static void __DBBatchAdd(const char *row, DBConfig *db_config)
+{
+    size_t row_len = strlen(row);
+
+    /* Make room for the row */
+    if (batch_rows && batch_len + row_len + 2 > BATCH_SQL_MAX) {
+        OS_Alert_FlushDB(db_config);
+    }
+
+    if (!batch_rows) {
+        const char *insert = __DBAlertInsert(db_config);
+
+        batch_len = strlen(insert);
+        if (batch_alloc < batch_len + 1) {
+            batch_alloc = BATCH_SQL_MAX;
+            os_realloc(batch_sql, batch_alloc, batch_sql);
+        }
+        memcpy(batch_sql, insert, batch_len + 1);
+        batch_time = time(0);
+    }
+
+    if (batch_len + row_len + 2 > batch_alloc) {
+        batch_alloc = batch_len + row_len + 2;
+        os_realloc(batch_sql, batch_alloc, batch_sql);
+    }
+
+    if (batch_rows) {
+        batch_sql[batch_len++] = ',';
+    }
+
+    if (batch_rows >= batch_starts_alloc) {
+        batch_starts_alloc = batch_starts_alloc ? batch_starts_alloc * 2 : 128;
+        os_realloc(batch_starts, batch_starts_alloc * sizeof(size_t), batch_starts);
+    }
+    batch_starts[batch_rows] = batch_len;
+
+    memcpy(batch_sql + batch_len, row, row_len + 1);
+    batch_len += row_len;
+    batch_rows++;
+}
+
+/* Insert the alerts of the batch one by one, so only the rows that
+ * fail are lost. Returns 1 if all were inserted or 0 on error.
+ */
+static int __DBBatchRows(const DBConfig *db_config)
+{
+    const char *insert = __DBAlertInsert(db_config);
+    size_t insert_len = strlen(insert);
+    size_t row_len;
+    unsigned int failed = 0;
+    unsigned int i;
+    char *sql;
+
+    os_malloc(insert_len + batch_len + 1, sql);
+    memcpy(sql, insert, insert_len);
+
+    for (i = 0; i < batch_rows; i++) {
+        row_len = (i + 1 < batch_rows ? batch_starts[i + 1] - 1 : batch_len) -
+                  batch_starts[i];
+
+        memcpy(sql + insert_len, batch_sql + batch_starts[i], row_len);
+        sql[insert_len + row_len] = '\0';
+
+        if (!osdb_query_insert(db_config->conn, sql)) {
+            failed++;
+        }
+    }
+
+    free(sql);
+
+    if (failed) {
+        merror("%s: ERROR: %u of %u alerts could not be inserted.", ARGV0,
+               failed, batch_rows);
+        return (0);
+    }
+
+    return (1);
+}
+
+/* Insert the alerts of the batch with one statement (and so one
+ * transaction). If it fails, it is tried again (on the connection
+ * opened again after the error) and then row by row.
+ * Returns 1 on success or 0 on error.
+ */
+int OS_Alert_FlushDB(DBConfig *db_config)
+{
+    int result = 1;
+
+    if (!batch_rows) {
+        return (1);
+    }
+
+    debug1("%s: DEBUG: Inserting %u alerts.", ARGV0, batch_rows);
+
+    if (!osdb_query_insert(db_config->conn, batch_sql) &&
+            !osdb_query_insert(db_config->conn, batch_sql)) {
+        merror(DB_GENERROR, ARGV0);
+        result = __DBBatchRows(db_config);
+    }
+
+    batch_rows = 0;
+    batch_len = 0;
+
+    return (result);
+}
+
+/* Returns 1 if the batch has alerts to be inserted */
+int OS_Alert_PendingDB(void)
+{
+    return (batch_rows != 0);
+}
+
+/* Returns 1 if the batch must be inserted, having waited for
+ * batch_latency seconds
+ */
+int OS_Alert_ExpiredDB(const DBConfig *db_config)
+{
+    return (batch_rows && time(0) - batch_time >= (time_t)db_config->batch_latency);
+}
+
+/* Returns the seconds the batch can still wait to be inserted
+ * (0 if it must be inserted now)
+ */
+unsigned int OS_Alert_WaitDB(const DBConfig *db_config)
+{
+    time_t elapsed = time(0) - batch_time;
+
+    if (!batch_rows || elapsed >= (time_t)db_config->batch_latency) {
+        return (0);
+    }
+
+    return ((unsigned int)(db_config->batch_latency - elapsed));
+}
+
+/* Insert alert into to the db (or add it to the batch, inserted
+ * with batch_size alerts)
  * Returns 1 on success or 0 on error
  */
 int OS_Alert_InsertDB(const alert_data *al_data, DBConfig *db_config)
@@ -91,12 +260,12 @@ int OS_Alert_InsertDB(const alert_data *al_data, DBConfig *db_config)
     unsigned int location_id = 0;
     unsigned short s_port = 0, d_port = 0;
     int *loc_id;
-    char sql_query[OS_SIZE_8192 + 1];
+    char sql_row[OS_SIZE_8192 + 1];
     char *fulllog = NULL;
 
     /* Clear the memory before insert */
-    sql_query[0] = '\0';
-    sql_query[OS_SIZE_8192] = '\0';
+    sql_row[0] = '\0';
+    sql_row[OS_SIZE_8192] = '\0';
 
     /* Source Port */
     s_port = al_data->srcport;
@@ -157,13 +326,11 @@ int OS_Alert_InsertDB(const alert_data *al_data, DBConfig *db_config)
         fulllog[7456] = '\0';
     }
 
-    /* Generate final SQL */
+    /* Generate the values of the alert */
     switch (db_config->db_type) {
       case MYSQLDB:
-        snprintf(sql_query, OS_SIZE_8192,
-                 "INSERT INTO "
-                 "alert(server_id,rule_id,level,timestamp,location_id,src_ip,src_port,dst_ip,dst_port,alertid,user,full_log,tld) "
-                 "VALUES ('%u', '%u','%u','%u', '%u', '%s', '%u', '%s', '%u', '%s', '%s', '%s','%.2s')",
+        snprintf(sql_row, OS_SIZE_8192,
+                 "('%u', '%u','%u','%u', '%u', '%s', '%u', '%s', '%u', '%s', '%s', '%s','%.2s')",
                  db_config->server_id, al_data->rule,
                  al_data->level,
                  (unsigned int)time(0), *loc_id,
@@ -176,10 +343,9 @@ int OS_Alert_InsertDB(const alert_data *al_data, DBConfig *db_config)
 	break;
 
       case POSTGDB:
-        snprintf(sql_query, OS_SIZE_8192,
-                 "INSERT INTO "
-                 "alert(server_id,rule_id,level,timestamp,location_id,src_ip,src_port,dst_ip,dst_port,alertid,\"user\",full_log) "
-                 "VALUES ('%u', '%u','%u','%u', '%u', '%s', '%u', '%s', '%u', '%s', '%s', '%s')",
+      case SQLITEDB:
+        snprintf(sql_row, OS_SIZE_8192,
+                 "('%u', '%u','%u','%u', '%u', '%s', '%u', '%s', '%u', '%s', '%s', '%s')",
                  db_config->server_id, al_data->rule,
                  al_data->level,
                  (unsigned int)time(0), *loc_id,
@@ -196,9 +362,10 @@ int OS_Alert_InsertDB(const alert_data *al_data, DBConfig *db_config)
     free(fulllog);
     fulllog = NULL;
 
-    /* Insert into the db */
-    if (!osdb_query_insert(db_config->conn, sql_query)) {
-        merror(DB_GENERROR, ARGV0);
+    /* Insert into the db, with the batch when it is full */
+    __DBBatchAdd(sql_row, db_config);
+    if (batch_rows >= db_config->batch_size) {
+        OS_Alert_FlushDB(db_config);
     }
 
     db_config->alert_id++;
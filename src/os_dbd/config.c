@@ -36,6 +36,8 @@ int OS_ReadDBConf(__attribute__((unused)) int test_config, const char *cfgfile,
     db_config->sock = NULL;
     db_config->db_type = 0;
     db_config->maxreconnect = 0;
+    db_config->batch_size = 1;
+    db_config->batch_latency = 1;
 
     /* Read configuration */
     if (ReadConfig(modules, cfgfile, tmp_config, db_config) < 0) {
@@ -57,12 +59,11 @@ int OS_ReadDBConf(__attribute__((unused)) int test_config, const char *cfgfile,
         return (0);
     }
 
-    /* Check for a valid config */
-    if (!db_config->host ||
-            !db_config->user ||
-            !db_config->pass ||
-            !db_config->db ||
-            !db_config->db_type) {
+    /* Check for a valid config (SQLite only needs the file) */
+    if (!db_config->db ||
+            !db_config->db_type ||
+            (db_config->db_type != SQLITEDB &&
+             (!db_config->host || !db_config->user || !db_config->pass))) {
         merror(DB_MISS_CONFIG, ARGV0);
         return (OS_INVALID);
     }
@@ -89,6 +90,15 @@ int OS_ReadDBConf(__attribute__((unused)) int test_config, const char *cfgfile,
     }
 #endif
 
+#ifdef SQLITE_DATABASE_ENABLED
+    if (db_config->db_type == SQLITEDB) {
+        osdb_connect = sqlite_osdb_connect;
+        osdb_query_insert = sqlite_osdb_query_insert;
+        osdb_query_select = sqlite_osdb_query_select;
+        osdb_close = sqlite_osdb_close;
+    }
+#endif
+
     /* Check for config errors */
     if (db_config->db_type == MYSQLDB) {
 #ifndef MYSQL_DATABASE_ENABLED
@@ -99,6 +109,11 @@ int OS_ReadDBConf(__attribute__((unused)) int test_config, const char *cfgfile,
 #ifndef PGSQL_DATABASE_ENABLED
         merror(DB_COMPILED, ARGV0, "postgresql");
         return (OS_INVALID);
+#endif
+    } else if (db_config->db_type == SQLITEDB) {
+#ifndef SQLITE_DATABASE_ENABLED
+        merror(DB_COMPILED, ARGV0, "sqlite");
+        return (OS_INVALID);
 #endif
     }
 
@@ -59,7 +59,12 @@ const unsigned char insert_map[256] = {
 #include <libpq-fe.h>
 #endif
 
-#if defined(MYSQL_DATABASE_ENABLED) || defined(PGSQL_DATABASE_ENABLED)
+#ifdef SQLITE_DATABASE_ENABLED
+#include <sqlite3.h>
+#endif
+
+#if defined(MYSQL_DATABASE_ENABLED) || defined(PGSQL_DATABASE_ENABLED) || \
+    defined(SQLITE_DATABASE_ENABLED)
 static void osdb_checkerror(void);
 static void osdb_seterror(void);
 #endif
@@ -95,7 +100,8 @@ void osdb_escapestr(char *str)
     }
 }
 
-#if defined(MYSQL_DATABASE_ENABLED) || defined(PGSQL_DATABASE_ENABLED)
+#if defined(MYSQL_DATABASE_ENABLED) || defined(PGSQL_DATABASE_ENABLED) || \
+    defined(SQLITE_DATABASE_ENABLED)
 
 /* Check for errors and handle them appropriately */
 static void osdb_checkerror()
@@ -137,7 +143,8 @@ static void osdb_checkerror()
         }
 
         verbose("%s: Connected to database '%s' at '%s'.",
-                ARGV0, db_config_pt->db, db_config_pt->host);
+                ARGV0, db_config_pt->db,
+                db_config_pt->host != NULL ? db_config_pt->host : "localhost");
     }
 }
 
@@ -348,8 +355,89 @@ int postgresql_osdb_query_select(void *db_conn, const char *query)
 /** End of PostgreSQL calls **/
 #endif
 
+/** SQLite calls **/
+#ifdef SQLITE_DATABASE_ENABLED
+
+/* Open the SQLite database (db is the file of it)
+ * Returns NULL on error
+ */
+void *sqlite_osdb_connect(__attribute__((unused)) const char *host, __attribute__((unused)) const char *user,
+                          __attribute__((unused)) const char *pass, const char *db,
+                          __attribute__((unused)) unsigned int port, __attribute__((unused)) const char *sock)
+{
+    sqlite3 *conn;
+
+    if (sqlite3_open(db, &conn) != SQLITE_OK) {
+        merror(DBCONN_ERROR, ARGV0, "localhost", db, sqlite3_errmsg(conn));
+        sqlite3_close(conn);
+        return (NULL);
+    }
+
+    /* Wait for other writers instead of failing */
+    sqlite3_busy_timeout(conn, 5000);
+
+    return (conn);
+}
+
+/* Close the database */
+void *sqlite_osdb_close(void *db_conn)
+{
+    merror(DB_CLOSING, ARGV0);
+    sqlite3_close(db_conn);
+    return (NULL);
+}
+
+/* Send insert query to database */
+int sqlite_osdb_query_insert(void *db_conn, const char *query)
+{
+    char *error = NULL;
+
+    if (sqlite3_exec(db_conn, query, NULL, NULL, &error) != SQLITE_OK) {
+        merror(DBQUERY_ERROR, ARGV0, query, error ? error : sqlite3_errmsg(db_conn));
+        sqlite3_free(error);
+        osdb_seterror();
+        return (0);
+    }
+
+    return (1);
+}
+
+/* Send a select query to database. Returns the value of it.
+ * Returns 0 on error (not found).
+ */
+int sqlite_osdb_query_select(void *db_conn, const char *query)
+{
+    int result_int = 0;
+    sqlite3_stmt *stmt;
+    int result;
+
+    if (sqlite3_prepare_v2(db_conn, query, -1, &stmt, NULL) != SQLITE_OK) {
+        merror(DBQUERY_ERROR, ARGV0, query, sqlite3_errmsg(db_conn));
+        osdb_seterror();
+        return (0);
+    }
+
+    /* We only care about the first result */
+    result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW) {
+        result_int = sqlite3_column_int(stmt, 0);
+    } else if (result != SQLITE_DONE) {
+        merror(DBQUERY_ERROR, ARGV0, query, sqlite3_errmsg(db_conn));
+        sqlite3_finalize(stmt);
+        osdb_seterror();
+        return (0);
+    }
+
+    sqlite3_finalize(stmt);
+
+    return (result_int);
+}
+/** End of SQLite calls **/
+#endif
+
 /* Everything else when db is not defined */
-#if !defined(PGSQL_DATABASE_ENABLED) && !defined(MYSQL_DATABASE_ENABLED)
+#if !defined(PGSQL_DATABASE_ENABLED) && !defined(MYSQL_DATABASE_ENABLED) && \
+    !defined(SQLITE_DATABASE_ENABLED)
 
 void *none_osdb_connect(__attribute__((unused)) const char *host, __attribute__((unused)) const char *user,
                         __attribute__((unused)) const char *pass, __attribute__((unused)) const char *db,
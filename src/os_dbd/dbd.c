@@ -14,6 +14,33 @@
 #define ARGV0 "ossec-dbd"
 #endif
 
+static DBConfig *dbd_config = NULL;
+
+/* Set while the alerts are inserted (or added to the batch) */
+static volatile sig_atomic_t dbd_busy = 0;
+
+static void OS_DBD_Exit(void);
+
+
+/* Insert the alerts left in the batch when the daemon exits
+ * (HandleSIG calls exit() on SIGTERM)
+ */
+static void OS_DBD_Exit()
+{
+    if (!OS_Alert_PendingDB()) {
+        return;
+    }
+
+    /* The batch or the connection can be half changed */
+    if (dbd_busy) {
+        merror("%s: ERROR: Exiting while inserting the alerts. "
+               "The alerts in the batch are lost.", ARGV0);
+        return;
+    }
+
+    OS_Alert_FlushDB(dbd_config);
+}
+
 
 /* Monitor the alerts and insert them into the database
  * Only returns in case of error
@@ -43,22 +70,43 @@ void OS_DBD(DBConfig *db_config)
     db_config->alert_id = OS_SelectMaxID(db_config);
     db_config->alert_id++;
 
+    /* Do not lose the batch on exit */
+    dbd_config = db_config;
+    atexit(OS_DBD_Exit);
+
     /* Infinite loop reading the alerts and inserting them */
     while (1) {
         tm = time(NULL);
         p = localtime(&tm);
 
-        /* Get message if available (timeout of 5 seconds) */
-        al_data = Read_FileMon(fileq, p, 5);
+        /* Get message if available (timeout of 5 * FQ_TIMEOUT seconds,
+         * or until the batch must be inserted while alerts wait in it)
+         */
+        if (OS_Alert_PendingDB()) {
+            al_data = Read_FileMonSeconds(fileq, p, OS_Alert_WaitDB(db_config));
+        } else {
+            al_data = Read_FileMon(fileq, p, 5);
+        }
         if (!al_data) {
+            /* Nothing came in time, insert what was batched */
+            dbd_busy = 1;
+            OS_Alert_FlushDB(db_config);
+            dbd_busy = 0;
             continue;
         }
 
         /* Insert into the db */
+        dbd_busy = 1;
         OS_Alert_InsertDB(al_data, db_config);
 
         /* Clear the memory */
         FreeAlertData(al_data);
+
+        /* Do not hold the alerts for longer than batch_latency */
+        if (OS_Alert_ExpiredDB(db_config)) {
+            OS_Alert_FlushDB(db_config);
+        }
+        dbd_busy = 0;
     }
 }
 
@@ -31,6 +31,14 @@ int OS_SelectMaxID(const DBConfig *db_config) __attribute__((nonnull));
 /* Insert alerts in to the database */
 int OS_Alert_InsertDB(const alert_data *al_data, DBConfig *db_config) __attribute__((nonnull));
 
+/* Insert the alerts batched by OS_Alert_InsertDB */
+int OS_Alert_FlushDB(DBConfig *db_config) __attribute__((nonnull));
+
+/* Check if there are alerts batched (and waiting for too long) */
+int OS_Alert_PendingDB(void);
+int OS_Alert_ExpiredDB(const DBConfig *db_config) __attribute__((nonnull));
+unsigned int OS_Alert_WaitDB(const DBConfig *db_config) __attribute__((nonnull));
+
 /* Database inserting main function */
 void OS_DBD(DBConfig *db_config) __attribute__((nonnull)) __attribute__((noreturn));
 
@@ -20,7 +20,12 @@ void dbd_print_version()
     printf("** Compiled with PostgreSQL support\n");
 #endif
 
-#if !defined(MYSQL_DATABASE_ENABLED) && !defined(PGSQL_DATABASE_ENABLED)
+#ifdef SQLITE_DATABASE_ENABLED
+    printf("** Compiled with SQLite support\n");
+#endif
+
+#if !defined(MYSQL_DATABASE_ENABLED) && !defined(PGSQL_DATABASE_ENABLED) && \
+    !defined(SQLITE_DATABASE_ENABLED)
     printf("** Compiled without any database support\n");
 #endif
 
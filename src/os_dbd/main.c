@@ -17,6 +17,7 @@
 /* Prototypes */
 static void print_db_info(void);
 static void help_dbd(void) __attribute__((noreturn));
+static void connect_db(DBConfig *db_config, const char *cfg) __attribute__((nonnull));
 
 
 /* Print information regarding enabled databases */
@@ -30,7 +31,12 @@ static void print_db_info()
     print_out("    Compiled with PostgreSQL support");
 #endif
 
-#if !defined(MYSQL_DATABASE_ENABLED) && !defined(PGSQL_DATABASE_ENABLED)
+#ifdef SQLITE_DATABASE_ENABLED
+    print_out("    Compiled with SQLite support");
+#endif
+
+#if !defined(MYSQL_DATABASE_ENABLED) && !defined(PGSQL_DATABASE_ENABLED) && \
+    !defined(SQLITE_DATABASE_ENABLED)
     print_out("    Compiled without any database support");
 #endif
 }
@@ -58,12 +64,44 @@ static void help_dbd()
     exit(1);
 }
 
+/* Connect to the database, trying again for up to maxreconnect
+ * attempts. Exits on error.
+ */
+static void connect_db(DBConfig *db_config, const char *cfg)
+{
+    unsigned int d = 0;
+
+    while (d <= (db_config->maxreconnect * 10)) {
+        db_config->conn = osdb_connect(db_config->host, db_config->user,
+                                       db_config->pass, db_config->db,
+                                       db_config->port, db_config->sock);
+
+        /* If we are able to reconnect, keep going */
+        if (db_config->conn) {
+            break;
+        }
+
+        d++;
+        sleep(d * 60);
+
+    }
+
+    /* If after the maxreconnect attempts, it still didn't work, exit here */
+    if (!db_config->conn) {
+        merror(DB_CONFIGERR, ARGV0);
+        ErrorExit(CONFIG_ERROR, ARGV0, cfg);
+    }
+
+    /* We must notify that we connected -- easy debugging */
+    verbose("%s: Connected to database '%s' at '%s'.",
+            ARGV0, db_config->db, db_config->host != NULL ? db_config->host : "localhost");
+}
+
 int main(int argc, char **argv)
 {
     int c, test_config = 0, run_foreground = 0;
     uid_t uid;
     gid_t gid;
-    unsigned int d;
 
     /* Use MAILUSER (read only) */
     const char *dir  = DEFAULTDIR;
@@ -174,33 +212,19 @@ int main(int argc, char **argv)
     db_config.maxreconnect = (unsigned int) getDefine_Int("dbd",
                              "reconnect_attempts", 1, 9999);
 
-    /* Connect to the database */
-    d = 0;
-    while (d <= (db_config.maxreconnect * 10)) {
-        db_config.conn = osdb_connect(db_config.host, db_config.user,
-                                      db_config.pass, db_config.db,
-                                      db_config.port, db_config.sock);
-
-        /* If we are able to reconnect, keep going */
-        if (db_config.conn) {
-            break;
-        }
-
-        d++;
-        sleep(d * 60);
-
+    /* Get how the alerts are batched */
+    db_config.batch_size = (unsigned int) getDefine_Int("dbd",
+                           "batch_size", 1, 1000);
+    db_config.batch_latency = (unsigned int) getDefine_Int("dbd",
+                              "batch_latency", 1, 60);
+
+    /* Connect to the database. SQLite opens the database (and its
+     * journal) by path, so it is the one inside the chroot.
+     */
+    if (db_config.db_type != SQLITEDB) {
+        connect_db(&db_config, cfg);
     }
 
-    /* If after the maxreconnect attempts, it still didn't work, exit here */
-    if (!db_config.conn) {
-        merror(DB_CONFIGERR, ARGV0);
-        ErrorExit(CONFIG_ERROR, ARGV0, cfg);
-    }
-
-    /* We must notify that we connected -- easy debugging */
-    verbose("%s: Connected to database '%s' at '%s'.",
-            ARGV0, db_config.db, db_config.host);
-
     /* Privilege separation */
     if (Privsep_SetGroup(gid) < 0) {
         ErrorExit(SETGID_ERROR, ARGV0, group, errno, strerror(errno));
@@ -214,6 +238,10 @@ int main(int argc, char **argv)
     /* Now in chroot */
     nowChroot();
 
+    if (db_config.db_type == SQLITEDB) {
+        connect_db(&db_config, cfg);
+    }
+
     /* Insert server info into the db */
     db_config.server_id = OS_Server_ReadInsertDB(&db_config);
     if (db_config.server_id <= 0) {
@@ -17,7 +17,8 @@
 agent *agt;
 
 /* Prototypes */
-static OSNetInfo *OS_Bindport(char *_port, unsigned int _proto, const char *_ip);
+static OSNetInfo *OS_Bindport(char *_port, unsigned int _proto, const char *_ip,
+                              int reuseport);
 static int OS_Connect(char *_port, unsigned int protocol, const char *_ip);
 static int OS_DecodeAddrinfo (struct addrinfo *res);
 static char *OS_DecodeSockaddr (struct sockaddr *sa);
@@ -46,7 +47,8 @@ static socklen_t us_l = sizeof(n_us);
 
 
 /* Bind all relevant ports */
-OSNetInfo *OS_Bindport(char *_port, unsigned int _proto, const char *_ip)
+OSNetInfo *OS_Bindport(char *_port, unsigned int _proto, const char *_ip,
+                       int reuseport)
 {
     int ossock = 0, s;
     struct addrinfo hints, *result, *rp;
@@ -152,6 +154,20 @@ OSNetInfo *OS_Bindport(char *_port, unsigned int _proto, const char *_ip)
             }
         }
 
+#ifdef SO_REUSEPORT
+        /* Several sockets receiving on the same port */
+        if (reuseport) {
+            int flag = 1;
+            if (setsockopt(ossock, SOL_SOCKET, SO_REUSEPORT,
+                          (char *)&flag, sizeof(flag)) < 0) {
+                verbose ("setsockopt error: SO_REUSEPORT %d: %s",
+                         errno, strerror(errno));
+                close (ossock);
+                continue;
+            }
+        }
+#endif
+
         if (bind(ossock, rp->ai_addr, rp->ai_addrlen) == -1) {
            /*
             * Don't issue an error message if the address and port is already
@@ -211,13 +227,22 @@ OSNetInfo *OS_Bindport(char *_port, unsigned int _proto, const char *_ip)
 /* Bind a TCP port, using the OS_Bindport */
 OSNetInfo *OS_Bindporttcp(char *_port, const char *_ip)
 {
-    return (OS_Bindport(_port, IPPROTO_TCP, _ip));
+    return (OS_Bindport(_port, IPPROTO_TCP, _ip, 0));
 }
 
 /* Bind a UDP port, using the OS_Bindport */
 OSNetInfo *OS_Bindportudp(char *_port, const char *_ip)
 {
-    return (OS_Bindport(_port, IPPROTO_UDP, _ip));
+    return (OS_Bindport(_port, IPPROTO_UDP, _ip, 0));
+}
+
+/* Bind a UDP port that other sockets can bind too (SO_REUSEPORT), the
+ * kernel spreads the datagrams between them. Where SO_REUSEPORT is not
+ * available, only the first one succeeds.
+ */
+OSNetInfo *OS_BindportudpReuse(char *_port, const char *_ip)
+{
+    return (OS_Bindport(_port, IPPROTO_UDP, _ip, 1));
 }
 
 #ifndef WIN32
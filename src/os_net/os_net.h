@@ -57,11 +57,14 @@ typedef struct _OSNetInfo {
  * OS_Bindport*
  * Bind a specific port (protocol and a ip).
  * If the IP is not set, it is going to use ADDR_ANY
+ * OS_BindportudpReuse sets SO_REUSEPORT, so it can be called again to
+ * get more sockets receiving on the same port.
  * Return a pointer to the OSNetInfo struct.
  */
 
 OSNetInfo *OS_Bindporttcp(char *_port, const char *_ip);
 OSNetInfo *OS_Bindportudp(char *_port, const char *_ip);
+OSNetInfo *OS_BindportudpReuse(char *_port, const char *_ip);
 
 /* OS_BindUnixDomain
  * Bind to a specific file, using the "mode" permissions in
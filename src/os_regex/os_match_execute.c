@@ -12,6 +12,7 @@
 #include <stdlib.h>
 
 #include "os_regex.h"
+#include "os_regex_internal.h"
 
 /* Compare an already compiled pattern with a not NULL string.
  * Returns 1 on success or 0 on error.
@@ -19,65 +20,83 @@
  */
 int OSMatch_Execute(const char *str, size_t str_len, OSMatch *reg)
 {
-    return reg->exec_function(str, str_len, reg);
+    return reg->exec_function(str, str_len, reg, NULL);
 }
 
-int OSMatch_Execute_true(const char *subject, size_t len, OSMatch *match)
+/* Thread safe version of OSMatch_Execute */
+int OSMatch_Execute_ex(const char *str, size_t str_len, OSMatch *reg, OSRegexCtx *ctx)
+{
+    return reg->exec_function(str, str_len, reg, ctx);
+}
+
+int OSMatch_Execute_true(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx)
 {
     (void)subject;
     (void)len;
     (void)match;
+    (void)ctx;
     return (1);
 }
 
-int OSMatch_Execute_pcre2_match(const char *str, size_t str_len, OSMatch * reg)
+int OSMatch_Execute_pcre2_match(const char *str, size_t str_len, OSMatch * reg, OSRegexCtx *ctx)
 {
     int rc = 0;
+    pcre2_match_data *match_data = reg->match_data;
+
+    if (ctx && (match_data = _os_ctx_match_data(ctx, reg->regex)) == NULL) {
+        return (0);
+    }
 
 #ifdef USE_PCRE2_JIT
-    rc = pcre2_jit_match(reg->regex, (PCRE2_SPTR)str, str_len, 0, 0, reg->match_data, NULL);
+    rc = pcre2_jit_match(reg->regex, (PCRE2_SPTR)str, str_len, 0, 0, match_data, NULL);
 #else
-    rc = pcre2_match(reg->regex, (PCRE2_SPTR)str, str_len, 0, 0, reg->match_data, NULL);
+    rc = pcre2_match(reg->regex, (PCRE2_SPTR)str, str_len, 0, 0, match_data, NULL);
 #endif
 
     return (rc >= 0);
 }
 
-int OSMatch_Execute_strcmp(const char *subject, size_t len, OSMatch *match)
+int OSMatch_Execute_strcmp(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx)
 {
     //^literal$
     (void)len;
+    (void)ctx;
     return !strcmp(match->pattern, subject);
 }
 
-int OSMatch_Execute_strncmp(const char *subject, size_t len, OSMatch *match)
+int OSMatch_Execute_strncmp(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx)
 {
     //^literal
     (void)len;
+    (void)ctx;
     return !strncmp(match->pattern, subject, match->pattern_len);
 }
 
-int OSMatch_Execute_strrcmp(const char *subject, size_t len, OSMatch *match)
+int OSMatch_Execute_strrcmp(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx)
 {
     // literal$
+    (void)ctx;
     if (len >= match->pattern_len) {
         return !strcmp(match->pattern, &subject[len - match->pattern_len]);
     }
     return (0);
 }
 
-int OSMatch_Execute_strcasecmp(const char *subject, size_t len, OSMatch *match)
+int OSMatch_Execute_strcasecmp(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx)
 {
+    (void)ctx;
     return (len == match->pattern_len && !strcasecmp(match->pattern, subject));
 }
 
-int OSMatch_Execute_strncasecmp(const char *subject, size_t len, OSMatch *match)
+int OSMatch_Execute_strncasecmp(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx)
 {
     (void)len;
+    (void)ctx;
     return !strncasecmp(match->pattern, subject, match->pattern_len);
 }
 
-int OSMatch_Execute_strrcasecmp(const char *subject, size_t len, OSMatch *match) {
+int OSMatch_Execute_strrcasecmp(const char *subject, size_t len, OSMatch *match, OSRegexCtx *ctx) {
+    (void)ctx;
     if (len >= match->pattern_len) {
         return !strcasecmp(match->pattern, &subject[len - match->pattern_len]);
     }
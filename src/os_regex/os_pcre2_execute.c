@@ -9,6 +9,7 @@
 
 #include "defs.h"
 #include "os_regex.h"
+#include "os_regex_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,19 +22,65 @@ const char *OSPcre2_Execute(const char *str, OSPcre2 *reg)
         return (NULL);
     }
 
-    return reg->exec_function(str, reg);
+    return reg->exec_function(str, reg, NULL);
 }
 
-const char *OSPcre2_Execute_pcre2_match(const char *str, OSPcre2 *reg)
+/* Thread safe version of OSPcre2_Execute.
+ * reg->error is not touched, as reg is shared.
+ */
+const char *OSPcre2_Execute_ex(const char *str, OSPcre2 *reg, OSRegexCtx *ctx)
+{
+    if (str == NULL) {
+        return (NULL);
+    }
+
+    return reg->exec_function(str, reg, ctx);
+}
+
+/* Execute through the same dispatch, asking the PCRE2 matcher for the
+ * position of the sub strings. The literal fast paths have none.
+ */
+const char *OSPcre2_Execute_spans(const char *str, OSPcre2 *reg, OSRegexCtx *ctx)
+{
+    const char *ret;
+
+    ctx->nspans = 0;
+    if (str == NULL) {
+        return (NULL);
+    }
+
+    ctx->want_spans = 1;
+    ret = reg->exec_function(str, reg, ctx);
+    ctx->want_spans = 0;
+
+    return (ret);
+}
+
+const char *OSPcre2_Execute_pcre2_match(const char *str, OSPcre2 *reg, OSRegexCtx *ctx)
 {
     int rc = 0, nbs = 0, i = 0;
     PCRE2_SIZE *ov = NULL;
+    pcre2_match_data *match_data = reg->match_data;
+    char **sub_strings = reg->sub_strings;
+
+    /* Keep the execution state out of reg when running from a context */
+    if (ctx) {
+        if ((match_data = _os_ctx_match_data(ctx, reg->regex)) == NULL) {
+            return NULL;
+        }
+        if (ctx->want_spans) {
+            /* Only the position of the sub strings is kept */
+            sub_strings = NULL;
+        } else if ((sub_strings = _os_ctx_sub_strings(ctx, ctx->match_data_size)) == NULL) {
+            return NULL;
+        }
+    }
 
     /* Execute the reg */
 #ifdef USE_PCRE2_JIT
-    rc = pcre2_jit_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, reg->match_data, NULL);
+    rc = pcre2_jit_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, match_data, NULL);
 #else
-    rc = pcre2_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, reg->match_data, NULL);
+    rc = pcre2_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, match_data, NULL);
 #endif
 
     /* Check execution result */
@@ -42,7 +89,14 @@ const char *OSPcre2_Execute_pcre2_match(const char *str, OSPcre2 *reg)
     }
 
     /* get the offsets informations for the match */
-    ov = pcre2_get_ovector_pointer(reg->match_data);
+    ov = pcre2_get_ovector_pointer(match_data);
+
+    if (ctx && ctx->want_spans) {
+        if (_os_ctx_set_spans(ctx, ov, rc) < 0) {
+            return NULL;
+        }
+        return &str[ov[1]];
+    }
 
     /* get the substrings if required */
     for (i = 1; i < rc; i++) {
@@ -50,34 +104,37 @@ const char *OSPcre2_Execute_pcre2_match(const char *str, OSPcre2 *reg)
         PCRE2_SIZE sub_string_end = ov[2 * i + 1];
         PCRE2_SIZE sub_string_len = sub_string_end - sub_string_start;
         if (sub_string_start != -1) {
-            reg->sub_strings[nbs] = (char *)calloc(sub_string_len + 1, sizeof(char));
-            strncpy(reg->sub_strings[nbs], &str[sub_string_start], sub_string_len);
+            sub_strings[nbs] = (char *)calloc(sub_string_len + 1, sizeof(char));
+            strncpy(sub_strings[nbs], &str[sub_string_start], sub_string_len);
             nbs++;
         }
     }
-    reg->sub_strings[nbs] = NULL;
+    sub_strings[nbs] = NULL;
 
     return &str[ov[1]];
 }
 
-const char *OSPcre2_Execute_strcmp(const char *subject, OSPcre2 *reg)
+const char *OSPcre2_Execute_strcmp(const char *subject, OSPcre2 *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strcmp(reg->pattern, subject)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSPcre2_Execute_strncmp(const char *subject, OSPcre2 *reg)
+const char *OSPcre2_Execute_strncmp(const char *subject, OSPcre2 *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strncmp(reg->pattern, subject, reg->pattern_len)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSPcre2_Execute_strrcmp(const char *subject, OSPcre2 *reg)
+const char *OSPcre2_Execute_strrcmp(const char *subject, OSPcre2 *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     size_t len = strlen(subject);
     if (len >= reg->pattern_len && !strcmp(reg->pattern, &subject[len - reg->pattern_len])) {
         return &subject[len];
@@ -85,24 +142,27 @@ const char *OSPcre2_Execute_strrcmp(const char *subject, OSPcre2 *reg)
     return NULL;
 }
 
-const char *OSPcre2_Execute_strcasecmp(const char *subject, OSPcre2 *reg)
+const char *OSPcre2_Execute_strcasecmp(const char *subject, OSPcre2 *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strcasecmp(reg->pattern, subject)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSPcre2_Execute_strncasecmp(const char *subject, OSPcre2 *reg)
+const char *OSPcre2_Execute_strncasecmp(const char *subject, OSPcre2 *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strncasecmp(reg->pattern, subject, reg->pattern_len)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSPcre2_Execute_strrcasecmp(const char *subject, OSPcre2 *reg)
+const char *OSPcre2_Execute_strrcasecmp(const char *subject, OSPcre2 *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     size_t len = strlen(subject);
     if (len >= reg->pattern_len &&
         !strcasecmp(reg->pattern, &subject[len - reg->pattern_len])) {
@@ -39,6 +39,28 @@
 #define OS_CONVERT_REGEX        1
 #define OS_CONVERT_MATCH        2
 
+/* Execution context structure.
+ * Holds the match data and the sub strings of an execution, so the
+ * same compiled pattern can be executed from several threads at once
+ * (one context per thread). Must be zeroed before the first use.
+ */
+/* Position of a sub string in the subject */
+typedef struct _OSRegexSpan {
+    size_t offset;
+    size_t length;
+} OSRegexSpan;
+
+typedef struct _OSRegexCtx {
+    pcre2_match_data *match_data;
+    uint32_t match_data_size;
+    char **sub_strings;
+    size_t sub_strings_size;
+    OSRegexSpan *spans;
+    size_t spans_size;
+    size_t nspans;
+    int want_spans;
+} OSRegexCtx;
+
 /* OSRegex structure */
 typedef struct _OSRegex {
     int error;
@@ -47,7 +69,7 @@ typedef struct _OSRegex {
     pcre2_match_data *match_data;
     size_t pattern_len;
     char *pattern;
-    const char *(*exec_function)(const char *, struct _OSRegex *);
+    const char *(*exec_function)(const char *, struct _OSRegex *, OSRegexCtx *);
 } OSRegex;
 
 /* OSmatch structure */
@@ -57,7 +79,7 @@ typedef struct _OSMatch {
     pcre2_match_data *match_data;
     size_t pattern_len;
     char *pattern;
-    int (*exec_function)(const char *, size_t, struct _OSMatch *);
+    int (*exec_function)(const char *, size_t, struct _OSMatch *, OSRegexCtx *);
 } OSMatch;
 
 /* OSPcre2 structure */
@@ -68,7 +90,7 @@ typedef struct _OSPcre2 {
     pcre2_match_data *match_data;
     size_t pattern_len;
     char *pattern;
-    const char *(*exec_function)(const char *, struct _OSPcre2 *);
+    const char *(*exec_function)(const char *, struct _OSPcre2 *, OSRegexCtx *);
 } OSPcre2;
 
 /*** Prototypes ***/
@@ -98,6 +120,22 @@ int OSRegex_Compile(const char *pattern, OSRegex *reg, int flags);
  */
 const char *OSRegex_Execute(const char *str, OSRegex *reg) __attribute__((nonnull(2)));
 
+/* Same as OSRegex_Execute, but the match data and the sub strings
+ * are kept in ctx instead of reg, so it can be called from several
+ * threads at the same time (each one with its own ctx).
+ * The sub strings are left in ctx->sub_strings (NULL terminated) when
+ * the regex was compiled with OS_RETURN_SUBSTRING.
+ * With a NULL ctx it behaves as OSRegex_Execute (but reg->error is
+ * never set).
+ */
+const char *OSRegex_Execute_ex(const char *str, OSRegex *reg, OSRegexCtx *ctx) __attribute__((nonnull(2)));
+
+/* Same as OSRegex_Execute_ex, but the sub strings are not copied:
+ * their position in str is left in ctx->spans (ctx->nspans entries,
+ * in the same order as ctx->sub_strings).
+ */
+const char *OSRegex_Execute_spans(const char *str, OSRegex *reg, OSRegexCtx *ctx) __attribute__((nonnull(2, 3)));
+
 /* Release all the memory created by the compilation/execution phases */
 void OSRegex_FreePattern(OSRegex *reg) __attribute__((nonnull));
 
@@ -105,6 +143,9 @@ void OSRegex_FreePattern(OSRegex *reg) __attribute__((nonnull));
 /* Release all the memory created to store the sub strings */
 void OSRegex_FreeSubStrings(OSRegex *reg) __attribute__((nonnull));
 
+/* Release all the memory held by an execution context */
+void OSRegex_FreeCtx(OSRegexCtx *ctx) __attribute__((nonnull));
+
 /* This function is a wrapper around the compile/execute
  * functions. It should only be used when the pattern is
  * only going to be used once.
@@ -126,6 +167,9 @@ int OSMatch_Compile(const char *pattern, OSMatch *reg, int flags);
  */
 int OSMatch_Execute(const char *str, size_t str_len, OSMatch *reg)  __attribute__((nonnull(3)));
 
+/* Same as OSMatch_Execute, using the match data from ctx */
+int OSMatch_Execute_ex(const char *str, size_t str_len, OSMatch *reg, OSRegexCtx *ctx) __attribute__((nonnull(3)));
+
 /* Release all the memory created by the compilation/execution phases */
 void OSMatch_FreePattern(OSMatch *reg) __attribute__((nonnull));
 
@@ -149,6 +193,16 @@ int OSPcre2_Compile(const char *pattern, OSPcre2 *reg, int flags);
  */
 const char *OSPcre2_Execute(const char *str, OSPcre2 *reg);
 
+/* Same as OSPcre2_Execute, but the match data and the sub strings
+ * are kept in ctx (see OSRegex_Execute_ex).
+ */
+const char *OSPcre2_Execute_ex(const char *str, OSPcre2 *reg, OSRegexCtx *ctx);
+
+/* Same as OSPcre2_Execute_ex, leaving the position of the sub
+ * strings in ctx->spans (see OSRegex_Execute_spans).
+ */
+const char *OSPcre2_Execute_spans(const char *str, OSPcre2 *reg, OSRegexCtx *ctx);
+
 /* Release all the memory created by the compilation/execution phases */
 void OSPcre2_FreePattern(OSPcre2 *reg);
 
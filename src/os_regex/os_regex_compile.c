@@ -13,13 +13,13 @@
 
 #include "os_regex.h"
 
-const char *OSRegex_Execute_pcre2_match(const char *str, OSRegex *reg);
-const char *OSRegex_Execute_strncmp(const char *subject, OSRegex *reg);
-const char *OSRegex_Execute_strrcmp(const char *subject, OSRegex *reg);
-const char *OSRegex_Execute_strcasecmp(const char *subject, OSRegex *reg);
-const char *OSRegex_Execute_strncasecmp(const char *subject, OSRegex *reg);
-const char *OSRegex_Execute_strrcasecmp(const char *subject, OSRegex *reg);
-const char *OSRegex_Execute_strcmp(const char *subject, OSRegex *reg);
+const char *OSRegex_Execute_pcre2_match(const char *str, OSRegex *reg, OSRegexCtx *ctx);
+const char *OSRegex_Execute_strncmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx);
+const char *OSRegex_Execute_strrcmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx);
+const char *OSRegex_Execute_strcasecmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx);
+const char *OSRegex_Execute_strncasecmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx);
+const char *OSRegex_Execute_strrcasecmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx);
+const char *OSRegex_Execute_strcmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx);
 int OSRegex_CouldBeOptimized(const char *pattern2check);
 
 /* Compile a regular expression to be used later
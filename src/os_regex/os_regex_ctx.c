@@ -0,0 +1,124 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "os_regex.h"
+#include "os_regex_internal.h"
+
+
+/* Get the match data of the context, growing it if the regex
+ * has more capture groups than the current one can hold.
+ * Returns NULL on error.
+ */
+pcre2_match_data *_os_ctx_match_data(OSRegexCtx *ctx, const pcre2_code *regex)
+{
+    uint32_t count = 0;
+
+    pcre2_pattern_info(regex, PCRE2_INFO_CAPTURECOUNT, (void *)&count);
+    count++; // the whole match is on the first pair
+
+    if (ctx->match_data == NULL || ctx->match_data_size < count) {
+        if (ctx->match_data) {
+            pcre2_match_data_free(ctx->match_data);
+        }
+
+        ctx->match_data = pcre2_match_data_create(count, NULL);
+        ctx->match_data_size = ctx->match_data ? count : 0;
+    }
+
+    return ctx->match_data;
+}
+
+/* Get the sub strings array of the context, with room for at
+ * least size entries (including the NULL at the end).
+ * Returns NULL on error.
+ */
+char **_os_ctx_sub_strings(OSRegexCtx *ctx, size_t size)
+{
+    char **sub_strings;
+    size_t i;
+
+    if (ctx->sub_strings_size < size) {
+        sub_strings = (char **)realloc(ctx->sub_strings, size * sizeof(char *));
+        if (sub_strings == NULL) {
+            return (NULL);
+        }
+
+        for (i = ctx->sub_strings_size; i < size; i++) {
+            sub_strings[i] = NULL;
+        }
+
+        ctx->sub_strings = sub_strings;
+        ctx->sub_strings_size = size;
+    }
+
+    return ctx->sub_strings;
+}
+
+/* Keep the position of the sub strings of a match (the
+ * groups that took part in it) in the context.
+ * Returns 0 on success or -1 on error.
+ */
+int _os_ctx_set_spans(OSRegexCtx *ctx, const PCRE2_SIZE *ov, int rc)
+{
+    size_t nspans = 0;
+    int i;
+
+    if (ctx->spans_size < (size_t)rc) {
+        OSRegexSpan *spans = (OSRegexSpan *)realloc(ctx->spans, (size_t)rc * sizeof(OSRegexSpan));
+        if (spans == NULL) {
+            return (-1);
+        }
+
+        ctx->spans = spans;
+        ctx->spans_size = (size_t)rc;
+    }
+
+    for (i = 1; i < rc; i++) {
+        if (ov[2 * i] != (PCRE2_SIZE)-1) {
+            ctx->spans[nspans].offset = ov[2 * i];
+            ctx->spans[nspans].length = ov[2 * i + 1] - ov[2 * i];
+            nspans++;
+        }
+    }
+    ctx->nspans = nspans;
+
+    return (0);
+}
+
+/* Release all the memory held by an execution context */
+void OSRegex_FreeCtx(OSRegexCtx *ctx)
+{
+    size_t i;
+
+    if (ctx->match_data) {
+        pcre2_match_data_free(ctx->match_data);
+        ctx->match_data = NULL;
+    }
+    ctx->match_data_size = 0;
+
+    if (ctx->sub_strings) {
+        for (i = 0; i < ctx->sub_strings_size && ctx->sub_strings[i]; i++) {
+            free(ctx->sub_strings[i]);
+        }
+        free(ctx->sub_strings);
+        ctx->sub_strings = NULL;
+    }
+    ctx->sub_strings_size = 0;
+
+    free(ctx->spans);
+    ctx->spans = NULL;
+    ctx->spans_size = 0;
+    ctx->nspans = 0;
+
+    return;
+}
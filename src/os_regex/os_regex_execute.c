@@ -12,6 +12,7 @@
 #include <stdlib.h>
 
 #include "os_regex.h"
+#include "os_regex_internal.h"
 
 /* Compare an already compiled regular expression with
  * a not NULL string.
@@ -25,19 +26,67 @@ const char *OSRegex_Execute(const char *str, OSRegex *reg)
         reg->error = OS_REGEX_STR_NULL;
         return (NULL);
     }
-    return reg->exec_function(str, reg);
+    return reg->exec_function(str, reg, NULL);
 }
 
-const char *OSRegex_Execute_pcre2_match(const char *str, OSRegex *reg)
+/* Thread safe version of OSRegex_Execute.
+ * reg->error is not touched, as reg is shared.
+ */
+const char *OSRegex_Execute_ex(const char *str, OSRegex *reg, OSRegexCtx *ctx)
+{
+    if (str == NULL) {
+        return (NULL);
+    }
+    return reg->exec_function(str, reg, ctx);
+}
+
+/* Execute through the same dispatch, asking the PCRE2 matcher for the
+ * position of the sub strings. The literal fast paths have none.
+ */
+const char *OSRegex_Execute_spans(const char *str, OSRegex *reg, OSRegexCtx *ctx)
+{
+    const char *ret;
+
+    ctx->nspans = 0;
+    if (str == NULL) {
+        return (NULL);
+    }
+
+    ctx->want_spans = 1;
+    ret = reg->exec_function(str, reg, ctx);
+    ctx->want_spans = 0;
+
+    return (ret);
+}
+
+const char *OSRegex_Execute_pcre2_match(const char *str, OSRegex *reg, OSRegexCtx *ctx)
 {
     int rc = 0, nbs = 0, i = 0;
+    int spans = 0;
     PCRE2_SIZE *ov = NULL;
+    pcre2_match_data *match_data = reg->match_data;
+    char **sub_strings = reg->sub_strings;
+
+    /* Keep the execution state out of reg when running from a context */
+    if (ctx) {
+        if ((match_data = _os_ctx_match_data(ctx, reg->regex)) == NULL) {
+            return NULL;
+        }
+        if (ctx->want_spans) {
+            /* Only the position of the sub strings is kept */
+            spans = (sub_strings != NULL);
+            sub_strings = NULL;
+        } else if (sub_strings &&
+                (sub_strings = _os_ctx_sub_strings(ctx, ctx->match_data_size)) == NULL) {
+            return NULL;
+        }
+    }
 
     /* Execute the reg */
 #ifdef USE_PCRE2_JIT
-    rc = pcre2_jit_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, reg->match_data, NULL);
+    rc = pcre2_jit_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, match_data, NULL);
 #else
-    rc = pcre2_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, reg->match_data, NULL);
+    rc = pcre2_match(reg->regex, (PCRE2_SPTR)str, strlen(str), 0, 0, match_data, NULL);
 #endif
 
     /* Check execution result */
@@ -46,44 +95,51 @@ const char *OSRegex_Execute_pcre2_match(const char *str, OSRegex *reg)
     }
 
     /* get the offsets informations for the match */
-    ov = pcre2_get_ovector_pointer(reg->match_data);
+    ov = pcre2_get_ovector_pointer(match_data);
+
+    if (spans && _os_ctx_set_spans(ctx, ov, rc) < 0) {
+        return NULL;
+    }
 
-    if (reg->sub_strings) {
+    if (sub_strings) {
         /* get the substrings if required */
         for (i = 1; i < rc; i++) {
             PCRE2_SIZE sub_string_start = ov[2 * i];
             PCRE2_SIZE sub_string_end = ov[2 * i + 1];
             PCRE2_SIZE sub_string_len = sub_string_end - sub_string_start;
             if (sub_string_start != -1) {
-                reg->sub_strings[nbs] = (char *)calloc(sub_string_len + 1, sizeof(char));
-                strncpy(reg->sub_strings[nbs], &str[sub_string_start], sub_string_len);
+                sub_strings[nbs] = (char *)calloc(sub_string_len + 1, sizeof(char));
+                strncpy(sub_strings[nbs], &str[sub_string_start], sub_string_len);
                 nbs++;
             }
         }
-        reg->sub_strings[nbs] = NULL;
+        sub_strings[nbs] = NULL;
     }
 
     return &str[ov[1]];
 }
 
-const char *OSRegex_Execute_strcmp(const char *subject, OSRegex *reg)
+const char *OSRegex_Execute_strcmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strcmp(reg->pattern, subject)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSRegex_Execute_strncmp(const char *subject, OSRegex *reg)
+const char *OSRegex_Execute_strncmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strncmp(reg->pattern, subject, reg->pattern_len)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSRegex_Execute_strrcmp(const char *subject, OSRegex *reg)
+const char *OSRegex_Execute_strrcmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     size_t len = strlen(subject);
     if (len >= reg->pattern_len && !strcmp(reg->pattern, &subject[len - reg->pattern_len])) {
         return &subject[len];
@@ -91,24 +147,27 @@ const char *OSRegex_Execute_strrcmp(const char *subject, OSRegex *reg)
     return NULL;
 }
 
-const char *OSRegex_Execute_strcasecmp(const char *subject, OSRegex *reg)
+const char *OSRegex_Execute_strcasecmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strcasecmp(reg->pattern, subject)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSRegex_Execute_strncasecmp(const char *subject, OSRegex *reg)
+const char *OSRegex_Execute_strncasecmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     if (!strncasecmp(reg->pattern, subject, reg->pattern_len)) {
         return &subject[reg->pattern_len];
     }
     return NULL;
 }
 
-const char *OSRegex_Execute_strrcasecmp(const char *subject, OSRegex *reg)
+const char *OSRegex_Execute_strrcasecmp(const char *subject, OSRegex *reg, OSRegexCtx *ctx)
 {
+    (void)ctx;
     size_t len = strlen(subject);
     if (len >= reg->pattern_len && !strcasecmp(reg->pattern, &subject[len - reg->pattern_len])) {
         return &subject[len];
@@ -108,5 +108,10 @@ extern const uchar charmap[256];
  */
 extern const uchar regexmap[][256];
 
+/* Execution context helpers (os_regex_ctx.c) */
+pcre2_match_data *_os_ctx_match_data(OSRegexCtx *ctx, const pcre2_code *regex) __attribute__((nonnull));
+char **_os_ctx_sub_strings(OSRegexCtx *ctx, size_t size) __attribute__((nonnull));
+int _os_ctx_set_spans(OSRegexCtx *ctx, const PCRE2_SIZE *ov, int rc) __attribute__((nonnull));
+
 #endif /* __OS_INTERNAL_H */
 
@@ -132,6 +132,17 @@ int main(int argc, char **argv)
         OS_PassEmptyKeyfile();
     }
 
+    /* Threads receiving the secure messages and datagrams read per call */
+    logr.recv_threads = getDefine_Int("remoted", "receive_threads", 1, 64);
+    logr.recv_batch = getDefine_Int("remoted", "receive_batch", 1, 1024);
+
+    /* Threads decrypting the secure messages and messages waiting for them */
+    logr.decrypt_threads = getDefine_Int("remoted", "decrypt_threads", 0, 64);
+    logr.decrypt_queue_size = getDefine_Int("remoted", "decrypt_queue_size",
+                                            16, 65536);
+
+    /* Batches of secure messages sent to analysisd */
+    logr.queue_batch = getDefine_Int("remoted", "queue_batch", 0, 65536);
 
     /* Check if the user and group given are valid */
     uid = Privsep_GetUser(user);
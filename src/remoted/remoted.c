@@ -42,13 +42,42 @@ void HandleRemote(int position, int uid)
     /* Bind TCP */
     if (logr.proto[position] == IPPROTO_TCP) {
         logr.sock    = 0;
+        logr.sock6   = 0;
+        logr.recv_threads = 1;
         logr.netinfo = OS_Bindporttcp(logr.port[position], logr.lip[position]);
         if (logr.netinfo->status < 0) {
             ErrorExit(BIND_ERROR, ARGV0, logr.port[position]);
         }
+    } else if (logr.conn[position] == SECURE_CONN && logr.recv_threads > 1) {
+        /* One set of sockets per receiver, sharing the port */
+        int i;
+
+        logr.sock    = 0;
+        logr.sock6   = 0;
+        os_calloc(logr.recv_threads, sizeof(OSNetInfo *), logr.recv_netinfo);
+
+        for (i = 0; i < logr.recv_threads; i++) {
+            logr.recv_netinfo[i] = OS_BindportudpReuse(logr.port[position],
+                                                       logr.lip[position]);
+            if (logr.recv_netinfo[i]->status < 0) {
+                if (i == 0) {
+                    ErrorExit(BIND_ERROR, ARGV0, logr.port[position]);
+                }
+
+                merror("%s: ERROR: Unable to share port '%s' between receivers. "
+                       "Using %d receiver(s).", ARGV0, logr.port[position], i);
+                free(logr.recv_netinfo[i]);
+                logr.recv_threads = i;
+                break;
+            }
+        }
+
+        logr.netinfo = logr.recv_netinfo[0];
     } else {
         /* Using UDP. Fast, unreliable... perfect */
         logr.sock    = 0;
+        logr.sock6   = 0;
+        logr.recv_threads = 1;
         logr.netinfo = OS_Bindportudp(logr.port[position], logr.lip[position]);
         if (logr.netinfo->status < 0) {
             ErrorExit(BIND_ERROR, ARGV0, logr.port[position]);
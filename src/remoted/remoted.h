@@ -52,6 +52,9 @@ int send_msg(unsigned int agentid, const char *msg);
 /* Initializing send_msg */
 void send_msg_init(void);
 
+/* Set the socket used by send_msg for the agents of a family */
+void send_msg_sock(int sock, int family);
+
 int check_keyupdate(void);
 
 void key_lock(void);
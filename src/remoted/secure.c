@@ -7,26 +7,108 @@
  * Foundation
  */
 
+/* recvmmsg() is Linux specific and is only picked up with _GNU_SOURCE */
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#endif
+#include <pthread.h>
+
 #include "shared.h"
 #include "os_net/os_net.h"
 #include "remoted.h"
 
-
-/* Handle secure connections */
-void HandleSecure()
-{
-    int agentid;
-    char buffer[OS_MAXSTR + 1];
+/* Maximum number of sockets reported by a single epoll_wait() */
+#define SECURE_EVENTS   16
+
+/* Datagrams read by a receiver in a single call */
+typedef struct _secure_batch {
+    unsigned int size;
+    char *buffers;                      /* size * (OS_MAXSTR + 1) bytes */
+    ssize_t *lengths;
+    struct sockaddr_storage *peers;
+    socklen_t *peer_sizes;
+#ifdef __linux__
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+#endif
+} secure_batch;
+
+/* A receiver, with its sockets and working buffers */
+typedef struct _secure_receiver {
+    OSNetInfo *netinfo;
+    secure_batch batch;
     char cleartext_msg[OS_MAXSTR + 1];
-    char srcip[IPSIZE + 1];
-    char *tmp_msg;
     char srcmsg[OS_FLSIZE + 1];
-    ssize_t recv_b;
+} secure_receiver;
+
+/* Message decrypted by the decryption threads */
+#define SSLOT_FREE          0
+#define SSLOT_FILLING       1   /* Being filled by a receiver */
+#define SSLOT_RECEIVED      2   /* Waiting for a decryption thread */
+#define SSLOT_DECRYPTING    3   /* Owned by a decryption thread */
+#define SSLOT_READY         4   /* Waiting for the forwarding thread */
+
+typedef struct _secure_slot {
+    int status;
+    int agentid;
+    char id[KEYSIZE + 1];
+    char key[KEYSIZE + 1];
+    char agent_ip[KEYSIZE + 1];
     struct sockaddr_storage peer_info;
     socklen_t peer_size;
-    fd_set fdsave, fdwork;			/* select() work areas */
-    int fdmax;					/* max socket number + 1 */
-    int sock;					/* active socket */
+    unsigned int size;
+    char buffer[OS_MAXSTR + 1];
+    char cleartext[OS_MAXSTR + 1];
+    char *msg;                  /* NULL if it could not be decrypted */
+    secmsg_counter counter;
+} secure_slot;
+
+/* Access to the keys and to the queue by the receivers and the
+ * forwarding thread
+ */
+static pthread_mutex_t secure_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Queue of the decryption threads. The messages are taken in order by
+ * the forwarding thread, so the counters of each agent are checked in
+ * the order its messages were received.
+ */
+static secure_slot *sslots;
+static unsigned int sslots_size;
+static unsigned long recv_seq;      /* Next slot to receive into */
+static unsigned long decrypt_seq;   /* Next slot to decrypt */
+static unsigned long done_seq;      /* Next slot to forward */
+
+static pthread_mutex_t sslots_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sslots_received = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sslots_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sslots_free = PTHREAD_COND_INITIALIZER;
+
+static secure_receiver *secure_receiver_init(OSNetInfo *netinfo);
+static void *secure_receiver_thread(void *arg);
+static void secure_loop(secure_receiver *r) __attribute__((noreturn));
+static int secure_recv(int sock, secure_batch *batch);
+static void HandleSecureMessage(secure_receiver *r, unsigned int i, int sock);
+static secure_slot *secure_slot_get(void);
+static void secure_slot_received(secure_slot *slot);
+static void *secure_decrypt_thread(void *arg);
+static void *secure_forward_thread(void *arg);
+static void secure_forward(int agentid, char *tmp_msg,
+                           const struct sockaddr_storage *peer_info,
+                           socklen_t peer_size, char *srcmsg);
+static void secure_forward_event(int agentid, char *tmp_msg,
+                                 const struct sockaddr_storage *peer_info,
+                                 socklen_t peer_size, char *srcmsg);
+static void secure_flush(void);
+static void secure_lock(void);
+static void secure_unlock(void);
+
+
+/* Handle secure connections */
+void HandleSecure()
+{
+    int i;
 
     /* Send msg init */
     send_msg_init();
@@ -55,6 +137,9 @@ void HandleSecure()
         ErrorExit(QUEUE_FATAL, ARGV0, DEFAULTQUEUE);
     }
 
+    /* Batch the messages forwarded to analysisd */
+    SetMQBatch((size_t)logr.queue_batch);
+
     verbose(AG_AX_AGENTS, ARGV0, MAX_AGENTS);
 
     /* Read authentication keys */
@@ -67,18 +152,188 @@ void HandleSecure()
     debug1("%s: DEBUG: OS_StartCounter completed.", ARGV0);
 
     /* Set up peer size */
-    peer_size = sizeof(peer_info);
-    logr.peer_size = sizeof(peer_info);
+    logr.peer_size = sizeof(struct sockaddr_storage);
 
-    /* Initialize some variables */
-    memset(buffer, '\0', OS_MAXSTR + 1);
-    memset(cleartext_msg, '\0', OS_MAXSTR + 1);
-    memset(srcmsg, '\0', OS_FLSIZE + 1);
-    tmp_msg = NULL;
+    /* Decryption threads */
+    if (logr.decrypt_threads > 0) {
+        sslots_size = (unsigned int)logr.decrypt_queue_size;
+        os_calloc(sslots_size, sizeof(secure_slot), sslots);
+
+        for (i = 0; i < logr.decrypt_threads; i++) {
+            if (CreateThread(secure_decrypt_thread, (void *)NULL) != 0) {
+                ErrorExit(THREAD_ERROR, ARGV0);
+            }
+        }
+
+        if (CreateThread(secure_forward_thread, (void *)NULL) != 0) {
+            ErrorExit(THREAD_ERROR, ARGV0);
+        }
+
+        verbose("%s: INFO: Decrypting on %d threads (queue size: %u).",
+                ARGV0, logr.decrypt_threads, sslots_size);
+    }
+
+    /* Each additional receiver has its own sockets on the same port */
+    for (i = 1; i < logr.recv_threads; i++) {
+        if (CreateThread(secure_receiver_thread,
+                         secure_receiver_init(logr.recv_netinfo[i])) != 0) {
+            ErrorExit(THREAD_ERROR, ARGV0);
+        }
+    }
+
+    if (logr.recv_threads > 1) {
+        verbose("%s: INFO: Receiving on %d threads.", ARGV0, logr.recv_threads);
+    }
+
+    secure_loop(secure_receiver_init(logr.netinfo));
+}
+
+/* Allocate a receiver */
+static secure_receiver *secure_receiver_init(OSNetInfo *netinfo)
+{
+    secure_receiver *r;
+    secure_batch *batch;
+    unsigned int i;
+
+    os_calloc(1, sizeof(secure_receiver), r);
+    r->netinfo = netinfo;
+
+    batch = &r->batch;
+    batch->size = (unsigned int)logr.recv_batch;
+
+#ifndef __linux__
+    /* One datagram per call without recvmmsg() */
+    batch->size = 1;
+#endif
+
+    os_calloc(batch->size, OS_MAXSTR + 1, batch->buffers);
+    os_calloc(batch->size, sizeof(ssize_t), batch->lengths);
+    os_calloc(batch->size, sizeof(struct sockaddr_storage), batch->peers);
+    os_calloc(batch->size, sizeof(socklen_t), batch->peer_sizes);
+
+#ifdef __linux__
+    os_calloc(batch->size, sizeof(struct mmsghdr), batch->msgs);
+    os_calloc(batch->size, sizeof(struct iovec), batch->iovs);
+
+    for (i = 0; i < batch->size; i++) {
+        batch->iovs[i].iov_base = batch->buffers + i * (OS_MAXSTR + 1);
+        batch->iovs[i].iov_len = OS_MAXSTR;
+        batch->msgs[i].msg_hdr.msg_name = &batch->peers[i];
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#else
+    (void)i;
+#endif
+
+    return (r);
+}
+
+static void *secure_receiver_thread(void *arg)
+{
+    secure_loop((secure_receiver *)arg);
+}
+
+#ifdef __linux__
+
+/* Wait for datagrams on the sockets of a receiver and drain them */
+static void secure_loop(secure_receiver *r)
+{
+    struct epoll_event events[SECURE_EVENTS];
+    int epfd;
+    int i;
+
+    if ((epfd = epoll_create(r->netinfo->fdcnt)) < 0) {
+        ErrorExit("%s: ERROR: Call to epoll_create() failed, errno %d - %s",
+                  ARGV0, errno, strerror(errno));
+    }
+
+    for (i = 0; i < r->netinfo->fdcnt; i++) {
+        struct epoll_event event;
+
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = r->netinfo->fds[i];
+
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, r->netinfo->fds[i], &event) < 0) {
+            ErrorExit("%s: ERROR: Call to epoll_ctl() failed, errno %d - %s",
+                      ARGV0, errno, strerror(errno));
+        }
+    }
+
+    while (1) {
+        int nevents = epoll_wait(epfd, events, SECURE_EVENTS, -1);
+
+        if (nevents < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            ErrorExit("%s: ERROR: Call to epoll_wait() failed, errno %d - %s",
+                      ARGV0, errno, strerror(errno));
+        }
+
+        for (i = 0; i < nevents; i++) {
+            int sock = events[i].data.fd;
+            int count;
+
+            /* Read until the socket is empty */
+            do {
+                int j;
+
+                count = secure_recv(sock, &r->batch);
+                for (j = 0; j < count; j++) {
+                    HandleSecureMessage(r, (unsigned int)j, sock);
+                }
+            } while (count == (int)r->batch.size);
+        }
+
+        /* Everything read was forwarded: send the batch */
+        if (logr.queue_batch && !sslots) {
+            secure_lock();
+            secure_flush();
+            secure_unlock();
+        }
+    }
+}
+
+/* Receive the datagrams waiting on a socket, up to the batch size.
+ * Returns the number of datagrams received.
+ */
+static int secure_recv(int sock, secure_batch *batch)
+{
+    unsigned int i;
+    int count;
+
+    for (i = 0; i < batch->size; i++) {
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+
+    count = recvmmsg(sock, batch->msgs, batch->size, MSG_DONTWAIT, NULL);
+    if (count <= 0) {
+        return (0);
+    }
+
+    for (i = 0; i < (unsigned int)count; i++) {
+        batch->lengths[i] = (ssize_t)batch->msgs[i].msg_len;
+        batch->peer_sizes[i] = batch->msgs[i].msg_hdr.msg_namelen;
+    }
+
+    return (count);
+}
+
+#else
+
+/* Wait for datagrams on the sockets of a receiver, using select() */
+static void secure_loop(secure_receiver *r)
+{
+    fd_set fdsave, fdwork;			/* select() work areas */
+    int fdmax;					/* max socket number + 1 */
+    int sock;					/* active socket */
 
     /* initialize select() save area */
-    fdsave = logr.netinfo->fdset;
-    fdmax  = logr.netinfo->fdmax;	/* value preset to max fd + 1 */
+    fdsave = r->netinfo->fdset;
+    fdmax  = r->netinfo->fdmax;	/* value preset to max fd + 1 */
 
     while (1) {
         /* process connections through select() for multiple sockets */
@@ -91,118 +346,421 @@ void HandleSecure()
         /* read through socket list for active socket */
         for (sock = 0; sock <= fdmax; sock++) {
             if (FD_ISSET (sock, &fdwork)) {
+                if (secure_recv(sock, &r->batch) > 0) {
+                    HandleSecureMessage(r, 0, sock);
+                }
+            }
+        }
 
-                /* Receive message  */
-                recv_b = recvfrom(sock, buffer, OS_MAXSTR, 0,
-                                  (struct sockaddr *)&peer_info, &peer_size);
+        /* Everything read was forwarded: send the batch */
+        if (logr.queue_batch && !sslots) {
+            secure_lock();
+            secure_flush();
+            secure_unlock();
+        }
+    }
+}
 
-                /* Nothing received */
-                if (recv_b <= 0) {
-                    continue;
-                }
+/* Receive a datagram. Returns the number of datagrams received */
+static int secure_recv(int sock, secure_batch *batch)
+{
+    batch->peer_sizes[0] = sizeof(struct sockaddr_storage);
+    batch->lengths[0] = recvfrom(sock, batch->buffers, OS_MAXSTR, 0,
+                                 (struct sockaddr *)&batch->peers[0],
+                                 &batch->peer_sizes[0]);
 
-               /*
-                * send_msg() needs a socket, but we don't know which
-                * socket is active until we receive our first packet.
-                * This sets the socket for send_msg().
-                */
-
-                logr.sock = sock;
-
-                /* Set the source IP */
-                satop((struct sockaddr *) &peer_info, srcip, IPSIZE);
-                srcip[IPSIZE] = '\0';
-
-                /* Get a valid agent id */
-                if (buffer[0] == '!') {
-                    tmp_msg = buffer;
-                    tmp_msg++;
-
-                   /*
-                    * We need to make sure that we have a valid id
-                    * and that we reduce the recv buffer size
-                    */
-                    while (isdigit((int)*tmp_msg)) {
-                        tmp_msg++;
-                        recv_b--;
-                    }
-
-                    if (*tmp_msg != '!') {
-                        merror(ENCFORMAT_ERROR, __local_name, srcip);
-                        continue;
-                    }
-
-                    *tmp_msg = '\0';
-                    tmp_msg++;
-                    recv_b -= 2;
-
-                    agentid = OS_IsAllowedDynamicID(&keys, buffer + 1, srcip);
-                    if (agentid == -1) {
-                        if (check_keyupdate()) {
-                            agentid = OS_IsAllowedDynamicID(&keys, buffer + 1, srcip);
-                            if (agentid == -1) {
-                                merror(ENC_IP_ERROR, ARGV0, buffer + 1, srcip);
-                                continue;
-                            }
-                        } else {
-                            merror(ENC_IP_ERROR, ARGV0, buffer + 1, srcip);
-                            continue;
-                        }
-                    }
-                } else {
-                    agentid = OS_IsAllowedIP(&keys, srcip);
-                    if (agentid < 0) {
-                        if (check_keyupdate()) {
-                            agentid = OS_IsAllowedIP(&keys, srcip);
-                            if (agentid == -1) {
-                                merror(DENYIP_WARN, ARGV0, srcip);
-                                continue;
-                            }
-                        } else {
-                            merror(DENYIP_WARN, ARGV0, srcip);
-                            continue;
-                        }
-                    }
-                    tmp_msg = buffer;
-                }
+    return (batch->lengths[0] > 0);
+}
+
+#endif /* __linux__ */
+
+/* Get the agent a message comes from, and the start of its encrypted
+ * part. Must be called with secure_mutex held.
+ * Returns the agent id or -1 if it is not allowed.
+ */
+static int secure_agent(char *buffer, ssize_t *recv_b, const char *srcip,
+                        char **tmp_msg)
+{
+    int agentid;
+
+    /* Get a valid agent id */
+    if (buffer[0] == '!') {
+        *tmp_msg = buffer;
+        (*tmp_msg)++;
+
+       /*
+        * We need to make sure that we have a valid id
+        * and that we reduce the recv buffer size
+        */
+        while (isdigit((int)**tmp_msg)) {
+            (*tmp_msg)++;
+            (*recv_b)--;
+        }
+
+        if (**tmp_msg != '!') {
+            merror(ENCFORMAT_ERROR, __local_name, srcip);
+            return (-1);
+        }
 
-                /* Decrypt the message */
-                tmp_msg = ReadSecMSG(&keys, tmp_msg, cleartext_msg,
-                                     agentid, recv_b - 1);
-                if (tmp_msg == NULL) {
-                    /* If duplicated, a warning was already generated */
-                    continue;
+        **tmp_msg = '\0';
+        (*tmp_msg)++;
+        *recv_b -= 2;
+
+        agentid = OS_IsAllowedDynamicID(&keys, buffer + 1, srcip);
+        if (agentid == -1) {
+            if (check_keyupdate()) {
+                agentid = OS_IsAllowedDynamicID(&keys, buffer + 1, srcip);
+                if (agentid == -1) {
+                    merror(ENC_IP_ERROR, ARGV0, buffer + 1, srcip);
+                    return (-1);
+                }
+            } else {
+                merror(ENC_IP_ERROR, ARGV0, buffer + 1, srcip);
+                return (-1);
+            }
+        }
+    } else {
+        agentid = OS_IsAllowedIP(&keys, srcip);
+        if (agentid < 0) {
+            if (check_keyupdate()) {
+                agentid = OS_IsAllowedIP(&keys, srcip);
+                if (agentid == -1) {
+                    merror(DENYIP_WARN, ARGV0, srcip);
+                    return (-1);
                 }
+            } else {
+                merror(DENYIP_WARN, ARGV0, srcip);
+                return (-1);
+            }
+        }
+        *tmp_msg = buffer;
+    }
+
+    return (agentid);
+}
 
-                /* Check if it is a control message */
-                if (IsValidHeader(tmp_msg)) {
-                    /* We need to save the peerinfo if it is a control msg */
-                    memcpy(&keys.keyentries[agentid]->peer_info,
-                           &peer_info, peer_size);
-                    keys.keyentries[agentid]->rcvd = time(0);
-                    save_controlmsg((unsigned)agentid, tmp_msg);
-                    continue;
+/* Forward a decrypted message to the manager or to analysisd, each
+ * of its events on its own if it is a batch.
+ * Must be called with secure_mutex held.
+ */
+static void secure_forward(int agentid, char *tmp_msg,
+                           const struct sockaddr_storage *peer_info,
+                           socklen_t peer_size, char *srcmsg)
+{
+    static char event[OS_MAXSTR + 1];
+    size_t pos = 0;
+    int rc;
+
+    if (!IsSecMSGBatch(tmp_msg)) {
+        secure_forward_event(agentid, tmp_msg, peer_info, peer_size, srcmsg);
+        return;
+    }
+
+    while ((rc = ReadSecMSGBatch(tmp_msg, &pos, event)) > 0) {
+        secure_forward_event(agentid, event, peer_info, peer_size, srcmsg);
+    }
+
+    if (rc < 0) {
+        merror(ENCFORMAT_ERROR, ARGV0, keys.keyentries[agentid]->ip->ip);
+    }
+}
+
+/* Forward a single message (or event of a batch).
+ * Must be called with secure_mutex held.
+ */
+static void secure_forward_event(int agentid, char *tmp_msg,
+                                 const struct sockaddr_storage *peer_info,
+                                 socklen_t peer_size, char *srcmsg)
+{
+    /* Check if it is a control message */
+    if (IsValidHeader(tmp_msg)) {
+        /* We need to save the peerinfo if it is a control msg */
+        memcpy(&keys.keyentries[agentid]->peer_info,
+               peer_info, peer_size);
+        keys.keyentries[agentid]->rcvd = time(0);
+        save_controlmsg((unsigned)agentid, tmp_msg);
+        return;
+    }
+
+    /* Generate srcmsg */
+    snprintf(srcmsg, OS_FLSIZE, "(%s) %s",
+             keys.keyentries[agentid]->name,
+             keys.keyentries[agentid]->ip->ip);
+
+   /*
+    * If we can't send the message, try to connect to the
+    * socket again. If it fails exit.
+    */
+    if (SendMSG(logr.m_queue, tmp_msg, srcmsg,
+                SECURE_MQ) < 0) {
+        merror(QUEUE_ERROR, ARGV0, DEFAULTQUEUE, strerror(errno));
+
+        if ((logr.m_queue = StartMQ(DEFAULTQUEUE, WRITE)) < 0) {
+            ErrorExit(QUEUE_FATAL, ARGV0, DEFAULTQUEUE);
+        }
+    }
+}
+
+/* Send the messages batched for analysisd.
+ * Must be called with secure_mutex held.
+ */
+static void secure_flush()
+{
+    if (FlushMSG(logr.m_queue) < 0) {
+        merror(QUEUE_ERROR, ARGV0, DEFAULTQUEUE, strerror(errno));
+
+        if ((logr.m_queue = StartMQ(DEFAULTQUEUE, WRITE)) < 0) {
+            ErrorExit(QUEUE_FATAL, ARGV0, DEFAULTQUEUE);
+        }
+
+        FlushMSG(logr.m_queue);
+    }
+}
+
+static void secure_lock()
+{
+    if (pthread_mutex_lock(&secure_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+}
+
+static void secure_unlock()
+{
+    if (pthread_mutex_unlock(&secure_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+}
+
+/* Handle the i-th datagram of the last batch of a receiver */
+static void HandleSecureMessage(secure_receiver *r, unsigned int i, int sock)
+{
+    int agentid;
+    char *buffer = r->batch.buffers + i * (OS_MAXSTR + 1);
+    char srcip[IPSIZE + 1];
+    char id[KEYSIZE + 1];
+    char key[KEYSIZE + 1];
+    char agent_ip[KEYSIZE + 1];
+    char *tmp_msg = NULL;
+    ssize_t recv_b = r->batch.lengths[i];
+    secure_slot *slot;
+
+    /* Nothing received */
+    if (recv_b <= 0) {
+        return;
+    }
+    buffer[recv_b] = '\0';
+
+    /* Set the source IP */
+    satop((struct sockaddr *) &r->batch.peers[i], srcip, IPSIZE);
+    srcip[IPSIZE] = '\0';
+
+    secure_lock();
+
+   /*
+    * send_msg() needs a socket, but we don't know which
+    * socket is active until we receive our first packet.
+    * This sets the socket for send_msg(), for the agents
+    * of the family of the peer (IPv4 and IPv6 can have
+    * sockets of their own).
+    */
+    send_msg_sock(sock, r->batch.peers[i].ss_family);
+
+    if ((agentid = secure_agent(buffer, &recv_b, srcip, &tmp_msg)) < 0) {
+        secure_unlock();
+        return;
+    }
+
+    /* Decrypt and forward the message right away */
+    if (!sslots) {
+        tmp_msg = ReadSecMSG(&keys, tmp_msg, r->cleartext_msg,
+                             agentid, (unsigned int)(recv_b - 1));
+
+        /* If duplicated, a warning was already generated */
+        if (tmp_msg) {
+            secure_forward(agentid, tmp_msg, &r->batch.peers[i],
+                           r->batch.peer_sizes[i], r->srcmsg);
+        }
+
+        secure_unlock();
+        return;
+    }
+
+    /* Or leave it to the decryption threads. The keys can be reloaded
+     * before the message is decrypted, so the agent key is copied.
+     */
+    strncpy(id, keys.keyentries[agentid]->id, KEYSIZE);
+    strncpy(key, keys.keyentries[agentid]->key, KEYSIZE);
+    strncpy(agent_ip, keys.keyentries[agentid]->ip->ip, KEYSIZE);
+
+    secure_unlock();
+
+    slot = secure_slot_get();
+
+    slot->agentid = agentid;
+    memcpy(slot->id, id, KEYSIZE + 1);
+    memcpy(slot->key, key, KEYSIZE + 1);
+    memcpy(slot->agent_ip, agent_ip, KEYSIZE + 1);
+
+    slot->size = (unsigned int)(recv_b - 1);
+    memcpy(slot->buffer, tmp_msg, (size_t)recv_b);
+    slot->buffer[recv_b] = '\0';
+    memcpy(&slot->peer_info, &r->batch.peers[i], r->batch.peer_sizes[i]);
+    slot->peer_size = r->batch.peer_sizes[i];
+
+    secure_slot_received(slot);
+}
+
+/* Reserve the next slot of the queue, waiting for one to be free */
+static secure_slot *secure_slot_get()
+{
+    secure_slot *slot;
+
+    if (pthread_mutex_lock(&sslots_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+
+    while (recv_seq - done_seq >= sslots_size) {
+        pthread_cond_wait(&sslots_free, &sslots_mutex);
+    }
+
+    slot = &sslots[recv_seq % sslots_size];
+    slot->status = SSLOT_FILLING;
+    recv_seq++;
+
+    if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+
+    return (slot);
+}
+
+/* Hand a filled slot to the decryption threads */
+static void secure_slot_received(secure_slot *slot)
+{
+    if (pthread_mutex_lock(&sslots_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+
+    slot->status = SSLOT_RECEIVED;
+    pthread_cond_broadcast(&sslots_received);
+
+    if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+        ErrorExit(MUTEX_ERROR, ARGV0);
+    }
+}
+
+/* Decryption thread: decrypt, decompress and verify the checksum of the
+ * messages, in any order
+ */
+static void *secure_decrypt_thread(__attribute__((unused)) void *arg)
+{
+    secure_slot *slot;
+
+    while (1) {
+        if (pthread_mutex_lock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        while (decrypt_seq == recv_seq ||
+                sslots[decrypt_seq % sslots_size].status != SSLOT_RECEIVED) {
+            pthread_cond_wait(&sslots_received, &sslots_mutex);
+        }
+
+        slot = &sslots[decrypt_seq % sslots_size];
+        slot->status = SSLOT_DECRYPTING;
+        decrypt_seq++;
+
+        if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        slot->msg = OpenSecMSG(slot->key, slot->agent_ip, slot->buffer,
+                               slot->cleartext, slot->size, &slot->counter);
+
+        if (pthread_mutex_lock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        slot->status = SSLOT_READY;
+        pthread_cond_signal(&sslots_ready);
+
+        if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+    }
+
+    return (NULL);
+}
+
+/* Forwarding thread: check the counters and forward the decrypted
+ * messages, in the order they were received
+ */
+static void *secure_forward_thread(__attribute__((unused)) void *arg)
+{
+    secure_slot *slot;
+    char srcmsg[OS_FLSIZE + 1];
+    int pending = 0;
+
+    memset(srcmsg, '\0', OS_FLSIZE + 1);
+
+    while (1) {
+        if (pthread_mutex_lock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        while (done_seq == recv_seq ||
+                sslots[done_seq % sslots_size].status != SSLOT_READY) {
+            /* Nothing else to forward for now: send the batch */
+            if (pending) {
+                if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+                    ErrorExit(MUTEX_ERROR, ARGV0);
                 }
 
-                /* Generate srcmsg */
-                snprintf(srcmsg, OS_FLSIZE, "(%s) %s",
-                         keys.keyentries[agentid]->name,
-                         keys.keyentries[agentid]->ip->ip);
-
-               /*
-                * If we can't send the message, try to connect to the
-                * socket again. If it fails exit.
-                */
-                if (SendMSG(logr.m_queue, tmp_msg, srcmsg,
-                            SECURE_MQ) < 0) {
-                    merror(QUEUE_ERROR, ARGV0, DEFAULTQUEUE, strerror(errno));
-
-                    if ((logr.m_queue = StartMQ(DEFAULTQUEUE, WRITE)) < 0) {
-                        ErrorExit(QUEUE_FATAL, ARGV0, DEFAULTQUEUE);
-                    }
+                secure_lock();
+                secure_flush();
+                secure_unlock();
+                pending = 0;
+
+                if (pthread_mutex_lock(&sslots_mutex) != 0) {
+                    ErrorExit(MUTEX_ERROR, ARGV0);
                 }
-            } /* if socket active */
-        } /* for() loop on sockets */
-    } /* while(1) loop for messages */
-}
+                continue;
+            }
+
+            pthread_cond_wait(&sslots_ready, &sslots_mutex);
+        }
 
+        slot = &sslots[done_seq % sslots_size];
+
+        if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        secure_lock();
+
+        /* Skip the messages of agents removed by a keys reload */
+        if (slot->msg && (unsigned int)slot->agentid < keys.keysize &&
+                strcmp(keys.keyentries[slot->agentid]->id, slot->id) == 0 &&
+                CheckSecMSG(&keys, slot->agentid, &slot->counter)) {
+            secure_forward(slot->agentid, slot->msg, &slot->peer_info,
+                           slot->peer_size, srcmsg);
+            pending = logr.queue_batch;
+        }
+
+        secure_unlock();
+
+        if (pthread_mutex_lock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+
+        slot->status = SSLOT_FREE;
+        done_seq++;
+        pthread_cond_broadcast(&sslots_free);
+
+        if (pthread_mutex_unlock(&sslots_mutex) != 0) {
+            ErrorExit(MUTEX_ERROR, ARGV0);
+        }
+    }
+
+    return (NULL);
+}
@@ -81,6 +81,30 @@ void send_msg_init()
     pthread_mutex_init(&sendmsg_mutex, NULL);
 }
 
+/* Set the socket used by send_msg for the agents of a family.
+ * The receivers call it with secure_mutex held, so only send_msg
+ * can read the socket while it changes.
+ */
+void send_msg_sock(int sock, int family)
+{
+    int *reply_sock = (family == AF_INET) ? &logr.sock : &logr.sock6;
+
+    if (*reply_sock == sock) {
+        return;
+    }
+
+    if (pthread_mutex_lock(&sendmsg_mutex) != 0) {
+        merror(MUTEX_ERROR, ARGV0);
+        return;
+    }
+
+    *reply_sock = sock;
+
+    if (pthread_mutex_unlock(&sendmsg_mutex) != 0) {
+        merror(MUTEX_ERROR, ARGV0);
+    }
+}
+
 
 /*
  * Send message to an agent
@@ -90,6 +114,7 @@ void send_msg_init()
 int send_msg(unsigned int agentid, const char *msg)
 {
     size_t msg_size, sa_size;
+    int sock;
     char crypt_msg[OS_MAXSTR + 1];
     struct sockaddr * dest_sa;
 
@@ -115,6 +140,9 @@ int send_msg(unsigned int agentid, const char *msg)
     sa_size = (dest_sa->sa_family == AF_INET) ?
               sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
 
+    /* Reply on a socket of the family of the agent */
+    sock = (dest_sa->sa_family == AF_INET) ? logr.sock : logr.sock6;
+
    /*
     * Because we handle multiple IP addresses, we won't know what interfaces
     * are active for network communication until we receive something on one
@@ -122,7 +150,7 @@ int send_msg(unsigned int agentid, const char *msg)
     * we have identified the working interface in secure.c. (dgs - 2/26/18)
     */
 
-    if (logr.sock == 0) {
+    if (sock == 0) {
         int i, ok = 0;
 
         /* socket not established - try current sockets */
@@ -142,7 +170,7 @@ int send_msg(unsigned int agentid, const char *msg)
         }
     } else {
         /* working socket identified in secure.c */
-        if (sendto(logr.sock, crypt_msg, msg_size, 0, dest_sa, sa_size) < 0) {
+        if (sendto(sock, crypt_msg, msg_size, 0, dest_sa, sa_size) < 0) {
             merror(SEND_ERROR, ARGV0, keys.keyentries[agentid]->id);
         }
     }
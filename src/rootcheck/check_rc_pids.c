@@ -15,11 +15,21 @@
 static int  proc_read(int pid);
 static int  proc_chdir(int pid);
 static int  proc_stat(int pid);
+static int  proc_listed(int pid);
+static int  ps_listed(const char *ps, int pid);
+static void load_proc_pids(pid_t max_pid);
+static void load_ps_pids(const char *ps, pid_t max_pid);
 static void loop_all_pids(const char *ps, pid_t max_pid, int *_errors, int *_total);
 
 /* Global variables */
 static int noproc;
 
+/* Pids listed by /proc and by ps(1) when the loop started (NULL if
+ * they could not be read)
+ */
+static char *proc_pids;
+static char *ps_pids;
+
 
 /* If /proc is mounted, check to see if the pid is present */
 static int proc_read(int pid)
@@ -85,6 +95,105 @@ static int proc_stat(int pid)
     return (0);
 }
 
+/* Read the pids present in /proc, all of them at once */
+static void load_proc_pids(pid_t max_pid)
+{
+    DIR *dp;
+    struct dirent *entry;
+
+    proc_pids = NULL;
+
+    if (noproc) {
+        return;
+    }
+
+    dp = opendir("/proc");
+    if (!dp) {
+        return;
+    }
+
+    os_calloc((size_t)max_pid + 1, sizeof(char), proc_pids);
+
+    while ((entry = readdir(dp)) != NULL) {
+        char *end;
+        long pid = strtol(entry->d_name, &end, 10);
+
+        if (*end == '\0' && pid > 0 && pid <= max_pid) {
+            proc_pids[pid] = 1;
+        }
+    }
+
+    closedir(dp);
+}
+
+/* Read the pids listed by ps(1), running it only once */
+static void load_ps_pids(const char *ps, pid_t max_pid)
+{
+    FILE *fp;
+    int found = 0;
+    char command[OS_SIZE_1024 + 1];
+    char line[OS_SIZE_1024 + 1];
+
+    ps_pids = NULL;
+
+    if (!*ps) {
+        return;
+    }
+
+    snprintf(command, OS_SIZE_1024, "%s -A -o pid= 2>/dev/null", ps);
+
+    fp = popen(command, "r");
+    if (!fp) {
+        return;
+    }
+
+    os_calloc((size_t)max_pid + 1, sizeof(char), ps_pids);
+
+    while (fgets(line, OS_SIZE_1024, fp)) {
+        long pid = strtol(line, NULL, 10);
+
+        if (pid > 0 && pid <= max_pid) {
+            ps_pids[pid] = 1;
+            found++;
+        }
+    }
+
+    /* Not supported by this ps: run it for each pid */
+    if (pclose(fp) != 0 || !found) {
+        free(ps_pids);
+        ps_pids = NULL;
+    }
+}
+
+/* Check if the pid was in /proc when the loop started */
+static int proc_listed(int pid)
+{
+    if (!proc_pids) {
+        return (proc_read(pid));
+    }
+
+    return (proc_pids[pid]);
+}
+
+/* Check if the process appears in ps(1) output. Only the pids not
+ * listed when the loop started are looked for again.
+ */
+static int ps_listed(const char *ps, int pid)
+{
+    char command[OS_SIZE_1024 + 1];
+
+    if (ps_pids && ps_pids[pid]) {
+        return (1);
+    }
+
+    snprintf(command, OS_SIZE_1024, "%s -p %d > /dev/null 2>&1", ps, pid);
+    if (system(command) == 0) {
+        return (1);
+    }
+
+    return (0);
+}
+
 /* Check all the available PIDs for hidden stuff */
 static void loop_all_pids(const char *ps, pid_t max_pid, int *_errors, int *_total)
 {
@@ -102,8 +211,6 @@ static void loop_all_pids(const char *ps, pid_t max_pid, int *_errors, int *_tot
     pid_t i = 1;
     pid_t my_pid;
 
-    char command[OS_SIZE_1024 + 1];
-
     my_pid = getpid();
 
     for (;; i++) {
@@ -138,7 +245,7 @@ static void loop_all_pids(const char *ps, pid_t max_pid, int *_errors, int *_tot
 
         /* /proc test */
         _proc_stat = proc_stat(i);
-        _proc_read = proc_read(i);
+        _proc_read = proc_listed(i);
         _proc_chdir = proc_chdir(i);
 
         /* If PID does not exist, move on */
@@ -164,11 +271,7 @@ static void loop_all_pids(const char *ps, pid_t max_pid, int *_errors, int *_tot
 
         /* Check if the process appears in ps(1) output */
         if (*ps) {
-            snprintf(command, OS_SIZE_1024, "%s -p %d > /dev/null 2>&1", ps, (int)i);
-            _ps0 = 0;
-            if (system(command) == 0) {
-                _ps0 = 1;
-            }
+            _ps0 = ps_listed(ps, (int)i);
         }
 
         /* If we are run in the context of OSSEC-HIDS, sleep here (no rush) */
@@ -307,8 +410,16 @@ void check_rc_pids()
         noproc = 0;
     }
 
+    load_proc_pids(max_pid);
+    load_ps_pids(ps, max_pid);
+
     loop_all_pids(ps, max_pid, &_errors, &_total);
 
+    free(proc_pids);
+    proc_pids = NULL;
+    free(ps_pids);
+    ps_pids = NULL;
+
     if (_errors == 0) {
         char op_msg[OS_SIZE_1024 + 1];
         snprintf(op_msg, OS_SIZE_1024, "No hidden process by Kernel-level "
@@ -20,11 +20,22 @@
                         "grep \"[^0-9]%d \" > /dev/null 2>&1"
 #endif
 
+/* Socket tables of the kernel (Linux) */
+#define PROC_NET_DIR    "/proc/net"
+
 /* Prototypes */
 static int  run_netstat(int proto, int port);
+static int  read_proc_net(const char *table, char *ports);
+static void load_proc_net(void);
+static int  port_listed(int proto, int port);
 static int  conn_port(int proto, int port);
 static void test_ports(int proto, int *_errors, int *_total);
 
+/* Global variables */
+static int  proc_net;
+static char proc_ports_tcp[65535 + 1];
+static char proc_ports_udp[65535 + 1];
+
 
 static int run_netstat(int proto, int port)
 {
@@ -51,6 +62,69 @@ static int run_netstat(int proto, int port)
     return (1);
 }
 
+/* Flag the local ports of a socket table of /proc/net */
+static int read_proc_net(const char *table, char *ports)
+{
+    FILE *fp;
+    unsigned int port;
+    char file[OS_SIZE_1024 + 1];
+    char line[OS_SIZE_1024 + 1];
+
+    snprintf(file, OS_SIZE_1024, "%s/%s", PROC_NET_DIR, table);
+
+    fp = fopen(file, "r");
+    if (!fp) {
+        return (-1);
+    }
+
+    /* sl: local_address:port rem_address:port st ... (the header
+     * line does not match)
+     */
+    while (fgets(line, OS_SIZE_1024, fp)) {
+        if (sscanf(line, " %*d: %*[0-9A-Fa-f]:%x", &port) == 1 &&
+                port <= 65535) {
+            ports[port] = 1;
+        }
+    }
+
+    fclose(fp);
+    return (0);
+}
+
+/* Read the ports in use from /proc/net, all of them at once. If it
+ * is not available, netstat is run for each port instead.
+ */
+static void load_proc_net()
+{
+    memset(proc_ports_tcp, 0, sizeof(proc_ports_tcp));
+    memset(proc_ports_udp, 0, sizeof(proc_ports_udp));
+
+    proc_net = 0;
+
+    if (read_proc_net("tcp", proc_ports_tcp) == 0 &&
+            read_proc_net("udp", proc_ports_udp) == 0) {
+        proc_net = 1;
+
+        /* Not present without IPv6 */
+        read_proc_net("tcp6", proc_ports_tcp);
+        read_proc_net("udp6", proc_ports_udp);
+    }
+}
+
+/* Check if the port is listed by the system as being used */
+static int port_listed(int proto, int port)
+{
+    if (!proc_net) {
+        return (run_netstat(proto, port));
+    }
+
+    if (proto == IPPROTO_TCP) {
+        return (proc_ports_tcp[port]);
+    }
+
+    return (proc_ports_udp[port]);
+}
+
 static int conn_port(int proto, int port)
 {
     int rc = 0;
@@ -131,10 +205,10 @@ static void test_ports(int proto, int *_errors, int *_total)
     for (i = 0; i <= 65535; i++) {
         (*_total)++;
         if (conn_port(proto, i)) {
-            /* Check if we can find it using netstat. If not,
-             * check again to see if the port is still being used.
+            /* Check if we can find it using /proc/net or netstat.
+             * If not, check again to see if the port is still being used.
              */
-            if (run_netstat(proto, i)) {
+            if (port_listed(proto, i)) {
                 continue;
             }
 
@@ -144,15 +218,27 @@ static void test_ports(int proto, int *_errors, int *_total)
             sleep(rootcheck.tsleep);
 #endif
 
-            if (!run_netstat(proto, i) && conn_port(proto, i)) {
+            /* The port may have been taken after the tables were read */
+            if (proc_net) {
+                load_proc_net();
+            }
+
+            if (!port_listed(proto, i) && conn_port(proto, i)) {
                 char op_msg[OS_SIZE_1024 + 1];
 
                 (*_errors)++;
 
-                snprintf(op_msg, OS_SIZE_1024, "Port '%d'(%s) hidden. "
-                         "Kernel-level rootkit or trojaned "
-                         "version of netstat.", i,
-                         (proto == IPPROTO_UDP) ? "udp" : "tcp");
+                if (proc_net) {
+                    snprintf(op_msg, OS_SIZE_1024, "Port '%d'(%s) hidden "
+                             "from %s. Possible kernel-level rootkit.", i,
+                             (proto == IPPROTO_UDP) ? "udp" : "tcp",
+                             PROC_NET_DIR);
+                } else {
+                    snprintf(op_msg, OS_SIZE_1024, "Port '%d'(%s) hidden. "
+                             "Kernel-level rootkit or trojaned "
+                             "version of netstat.", i,
+                             (proto == IPPROTO_UDP) ? "udp" : "tcp");
+                }
 
                 notify_rk(ALERT_ROOTKIT_FOUND, op_msg);
             }
@@ -185,6 +271,8 @@ void check_rc_ports()
         i++;
     }
 
+    load_proc_net();
+
     /* Test both TCP and UDP ports */
     test_ports(IPPROTO_TCP, &_errors, &_total);
     test_ports(IPPROTO_UDP, &_errors, &_total);
@@ -193,8 +281,9 @@ void check_rc_ports()
         char op_msg[OS_SIZE_1024 + 1];
 
         snprintf(op_msg, OS_SIZE_1024, "No kernel-level rootkit hiding any port."
-                 "\n      Netstat is acting correctly."
-                 " Analyzed %d ports.", _total);
+                 "\n      %s is acting correctly."
+                 " Analyzed %d ports.", proc_net ? PROC_NET_DIR : "Netstat",
+                 _total);
         notify_rk(ALERT_OK, op_msg);
     }
 
@@ -0,0 +1,694 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Alert bus
+ *
+ * analysisd publishes every alert it writes to the alerts log in a
+ * ring of records mapped from ALERTBUS. Each record has the alert
+ * already parsed (the alert_data GetAlertData would read from the
+ * log) and where the alert was written in the log. Each reader has
+ * its own cursor in the ring, and sleeps on a condition shared in the
+ * mapping until there are new records, instead of polling the log.
+ *
+ * There is a single writer, and it never waits for the readers: a
+ * reader more than a ring behind loses the records overwritten and
+ * goes on from the oldest record left. Where the records were written
+ * in the log tells the readers what they missed (file-queue.c reads
+ * it from the log). The writer sets write_begin before overwriting
+ * anything, so a reader knows that a record it copied was not being
+ * overwritten if write_begin is still within a ring of it.
+ */
+
+#include "shared.h"
+
+#ifndef WIN32
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#define ALERTBUS_MAGIC      0x4f534142
+#define ALERTBUS_VERSION    1
+
+/* Offset of the ring in the file */
+#define ALERTBUS_DATA       4096
+
+/* Record only filling the end of the ring */
+#define ALERTBUS_PAD        0x100
+
+#ifdef __linux__
+#define ALERTBUS_ROBUST
+#endif
+
+typedef struct _alert_bus_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;          /* Bytes of the ring */
+    uint64_t tail;          /* Oldest record */
+    uint64_t write_begin;   /* End of the record being written */
+    uint64_t write_end;     /* End of the records published */
+    uint32_t waiters;       /* Readers sleeping */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} alert_bus_header;
+
+typedef struct _alert_bus_record {
+    uint32_t size;      /* With this header, a multiple of 8 */
+    uint32_t flags;
+    int64_t offset;
+    int64_t end;
+    int32_t year;
+    int32_t day;
+    char mon[4];
+    uint32_t len;       /* Of the alert data after the header */
+} alert_bus_record;
+
+struct _alert_bus {
+    alert_bus_header *hdr;
+    char *ring;
+    size_t map_size;
+    uint64_t size;
+    uint64_t cursor;
+    dev_t dev;
+    ino_t ino;
+
+    /* Record being read (or written) */
+    char *buf;
+    size_t buf_len;
+    size_t buf_size;
+};
+
+/* Strings of the alert_data, in the order they are in the records */
+static const size_t ab_strings[] = {
+    offsetof(alert_data, alertid),
+    offsetof(alert_data, date),
+    offsetof(alert_data, location),
+    offsetof(alert_data, comment),
+    offsetof(alert_data, group),
+    offsetof(alert_data, srcip),
+    offsetof(alert_data, dstip),
+    offsetof(alert_data, user),
+    offsetof(alert_data, filename),
+    offsetof(alert_data, old_md5),
+    offsetof(alert_data, new_md5),
+    offsetof(alert_data, old_sha1),
+    offsetof(alert_data, new_sha1),
+    offsetof(alert_data, file_size),
+    offsetof(alert_data, owner_chg),
+    offsetof(alert_data, group_chg),
+    offsetof(alert_data, perm_chg),
+#ifdef LIBGEOIP_ENABLED
+    offsetof(alert_data, srcgeoip),
+    offsetof(alert_data, dstgeoip),
+#endif
+};
+
+#define AB_STRINGS  (sizeof(ab_strings) / sizeof(ab_strings[0]))
+#define AB_FIELD(al, i) ((char **)((char *)(al) + ab_strings[i]))
+
+/* Bus of analysisd */
+static alert_bus *ab_writer = NULL;
+
+
+static const char *ab_path(void)
+{
+    return (isChroot() ? ALERTBUS : ALERTBUSPATH);
+}
+
+static void ab_lock(alert_bus_header *hdr)
+{
+#ifdef ALERTBUS_ROBUST
+    /* A reader died holding it */
+    if (pthread_mutex_lock(&hdr->mutex) == EOWNERDEAD) {
+        pthread_mutex_consistent(&hdr->mutex);
+    }
+#else
+    pthread_mutex_lock(&hdr->mutex);
+#endif
+}
+
+/* Encoding of the alert_data */
+static void ab_put(alert_bus *bus, const void *data, size_t len)
+{
+    if (bus->buf_len + len > bus->buf_size) {
+        bus->buf_size = (bus->buf_len + len) * 2;
+        os_realloc(bus->buf, bus->buf_size, bus->buf);
+    }
+
+    memcpy(bus->buf + bus->buf_len, data, len);
+    bus->buf_len += len;
+}
+
+static void ab_put_int(alert_bus *bus, uint32_t value)
+{
+    ab_put(bus, &value, sizeof(value));
+}
+
+/* Strings go with their length plus one (0 for NULL) */
+static void ab_put_str(alert_bus *bus, const char *str)
+{
+    uint32_t len = str ? (uint32_t)strlen(str) : 0;
+
+    ab_put_int(bus, str ? len + 1 : 0);
+    if (len) {
+        ab_put(bus, str, len);
+    }
+}
+
+static void ab_encode(alert_bus *bus, const alert_data *al_data)
+{
+    uint32_t lines = 0;
+    size_t i;
+
+    bus->buf_len = 0;
+
+    ab_put_int(bus, al_data->rule);
+    ab_put_int(bus, al_data->level);
+    ab_put_int(bus, (uint32_t)al_data->srcport);
+    ab_put_int(bus, (uint32_t)al_data->dstport);
+
+    for (i = 0; i < AB_STRINGS; i++) {
+        ab_put_str(bus, *AB_FIELD(al_data, i));
+    }
+
+    while (al_data->log && al_data->log[lines]) {
+        lines++;
+    }
+
+    ab_put_int(bus, lines);
+    for (i = 0; i < lines; i++) {
+        ab_put_str(bus, al_data->log[i]);
+    }
+}
+
+static int ab_get_int(const char **p, const char *end, uint32_t *value)
+{
+    if ((size_t)(end - *p) < sizeof(*value)) {
+        return (-1);
+    }
+
+    memcpy(value, *p, sizeof(*value));
+    *p += sizeof(*value);
+    return (0);
+}
+
+static int ab_get_str(const char **p, const char *end, char **str)
+{
+    uint32_t len;
+
+    *str = NULL;
+
+    if (ab_get_int(p, end, &len) < 0) {
+        return (-1);
+    }
+
+    if (len-- == 0) {
+        return (0);
+    }
+
+    if ((size_t)(end - *p) < len) {
+        return (-1);
+    }
+
+    os_malloc(len + 1, *str);
+    memcpy(*str, *p, len);
+    (*str)[len] = '\0';
+    *p += len;
+    return (0);
+}
+
+static alert_data *ab_decode(const char *data, size_t len)
+{
+    const char *p = data;
+    const char *end = data + len;
+    alert_data *al_data;
+    uint32_t value;
+    uint32_t lines;
+    uint32_t i;
+
+    os_calloc(1, sizeof(alert_data), al_data);
+
+    if (ab_get_int(&p, end, &al_data->rule) < 0 ||
+            ab_get_int(&p, end, &al_data->level) < 0 ||
+            ab_get_int(&p, end, &value) < 0) {
+        goto error;
+    }
+    al_data->srcport = (int)value;
+
+    if (ab_get_int(&p, end, &value) < 0) {
+        goto error;
+    }
+    al_data->dstport = (int)value;
+
+    for (i = 0; i < AB_STRINGS; i++) {
+        if (ab_get_str(&p, end, AB_FIELD(al_data, i)) < 0) {
+            goto error;
+        }
+    }
+
+    /* A line takes at least its length */
+    if (ab_get_int(&p, end, &lines) < 0 ||
+            lines > (size_t)(end - p) / sizeof(uint32_t)) {
+        goto error;
+    }
+
+    os_calloc(lines + 1, sizeof(char *), al_data->log);
+    for (i = 0; i < lines; i++) {
+        if (ab_get_str(&p, end, &al_data->log[i]) < 0 || !al_data->log[i]) {
+            goto error;
+        }
+    }
+
+    return (al_data);
+
+error:
+    FreeAlertData(al_data);
+    return (NULL);
+}
+
+/* Map the bus file. Returns 0 on success or -1 on error. */
+static int ab_map(alert_bus *bus)
+{
+    const char *path = ab_path();
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return (-1);
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < ALERTBUS_DATA + 4096) {
+        close(fd);
+        return (-1);
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        merror("%s: ERROR: Unable to map '%s': %s", __local_name, path, strerror(errno));
+        return (-1);
+    }
+
+    bus->hdr = (alert_bus_header *)map;
+    bus->ring = (char *)map + ALERTBUS_DATA;
+    bus->map_size = (size_t)st.st_size;
+    bus->size = bus->hdr->size;
+    bus->dev = st.st_dev;
+    bus->ino = st.st_ino;
+
+    if (bus->hdr->magic != ALERTBUS_MAGIC || bus->hdr->version != ALERTBUS_VERSION ||
+            bus->size + ALERTBUS_DATA != (uint64_t)st.st_size) {
+        merror("%s: ERROR: Invalid alert bus '%s'.", __local_name, path);
+        munmap(map, bus->map_size);
+        bus->hdr = NULL;
+        return (-1);
+    }
+
+    return (0);
+}
+
+static void ab_unmap(alert_bus *bus)
+{
+    if (bus->hdr) {
+        munmap(bus->hdr, bus->map_size);
+        bus->hdr = NULL;
+    }
+}
+
+int AlertBus_Create(size_t size)
+{
+    const char *path = ab_path();
+    char tmp_path[OS_FLSIZE + 1];
+    pthread_mutexattr_t mattr;
+    pthread_condattr_t cattr;
+    alert_bus_header *hdr;
+    int error;
+    int fd;
+
+    size -= size % 8;
+
+    snprintf(tmp_path, OS_FLSIZE, "%s.tmp", path);
+    unlink(tmp_path);
+
+    fd = open(tmp_path, O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0) {
+        merror(FOPEN_ERROR, __local_name, tmp_path, errno, strerror(errno));
+        return (-1);
+    }
+
+    if (fchmod(fd, 0660) < 0 || ftruncate(fd, (off_t)(ALERTBUS_DATA + size)) < 0) {
+        merror("%s: ERROR: Could not size the alert bus '%s': %s",
+               __local_name, tmp_path, strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return (-1);
+    }
+
+    os_calloc(1, sizeof(alert_bus), ab_writer);
+
+    hdr = mmap(NULL, ALERTBUS_DATA + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (hdr == MAP_FAILED) {
+        merror("%s: ERROR: Unable to map '%s': %s", __local_name, tmp_path, strerror(errno));
+        unlink(tmp_path);
+        free(ab_writer);
+        ab_writer = NULL;
+        return (-1);
+    }
+
+    /* Shared with the readers */
+    error = pthread_mutexattr_init(&mattr);
+    if (!error) {
+        error = pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    }
+#ifdef ALERTBUS_ROBUST
+    if (!error) {
+        error = pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    }
+#endif
+    if (!error) {
+        error = pthread_mutex_init(&hdr->mutex, &mattr);
+    }
+    if (!error) {
+        error = pthread_condattr_init(&cattr);
+    }
+    if (!error) {
+        error = pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    }
+    if (!error) {
+        error = pthread_cond_init(&hdr->cond, &cattr);
+    }
+
+    if (error) {
+        merror("%s: ERROR: Could not share the alert bus lock: %s",
+               __local_name, strerror(error));
+        munmap(hdr, ALERTBUS_DATA + size);
+        unlink(tmp_path);
+        free(ab_writer);
+        ab_writer = NULL;
+        return (-1);
+    }
+
+    hdr->size = size;
+    hdr->version = ALERTBUS_VERSION;
+    hdr->magic = ALERTBUS_MAGIC;
+
+    /* The readers of the previous bus move to this one */
+    if (rename(tmp_path, path) < 0) {
+        merror(RENAME_ERROR, __local_name, tmp_path, path, errno, strerror(errno));
+        munmap(hdr, ALERTBUS_DATA + size);
+        unlink(tmp_path);
+        free(ab_writer);
+        ab_writer = NULL;
+        return (-1);
+    }
+
+    ab_writer->hdr = hdr;
+    ab_writer->ring = (char *)hdr + ALERTBUS_DATA;
+    ab_writer->map_size = ALERTBUS_DATA + size;
+    ab_writer->size = size;
+
+    return (0);
+}
+
+void AlertBus_Remove()
+{
+    if (unlink(ab_path()) < 0 && errno != ENOENT) {
+        merror(UNLINK_ERROR, __local_name, ab_path());
+    }
+}
+
+/* Move the tail past the records overwritten up to end */
+static void ab_drop(alert_bus *bus, uint64_t end)
+{
+    uint64_t tail = bus->hdr->tail;
+    alert_bus_record rec;
+
+    while (end - tail > bus->size) {
+        uint64_t room = bus->size - tail % bus->size;
+
+        if (room < sizeof(rec)) {
+            tail += room;
+            continue;
+        }
+
+        memcpy(&rec, bus->ring + tail % bus->size, sizeof(rec));
+        tail += rec.size && rec.size <= room ? rec.size : room;
+    }
+
+    __atomic_store_n(&bus->hdr->tail, tail, __ATOMIC_RELEASE);
+}
+
+void AlertBus_Publish(const alert_data *al_data, int flags, const alert_bus_pos *pos)
+{
+    alert_bus *bus = ab_writer;
+    alert_bus_header *hdr;
+    alert_bus_record rec;
+    uint64_t begin;
+    uint64_t start;
+    uint64_t room;
+
+    if (!bus) {
+        return;
+    }
+
+    ab_encode(bus, al_data);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.size = (uint32_t)((sizeof(rec) + bus->buf_len + 7) & ~(size_t)7);
+    rec.flags = (uint32_t)flags & ~ALERTBUS_PAD;
+    rec.offset = pos->offset;
+    rec.end = pos->end;
+    rec.year = pos->year;
+    rec.day = pos->day;
+    memcpy(rec.mon, pos->mon, sizeof(rec.mon) - 1);
+    rec.len = (uint32_t)bus->buf_len;
+
+    /* Left for the readers to find in the log */
+    if (rec.size > bus->size / 4) {
+        return;
+    }
+
+    hdr = bus->hdr;
+    begin = hdr->write_end;
+    room = bus->size - begin % bus->size;
+    start = room < rec.size ? begin + room : begin;
+
+    ab_drop(bus, start + rec.size);
+
+    __atomic_store_n(&hdr->write_begin, start + rec.size, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (start != begin && room >= sizeof(rec)) {
+        alert_bus_record pad;
+
+        memset(&pad, 0, sizeof(pad));
+        pad.size = (uint32_t)room;
+        pad.flags = ALERTBUS_PAD;
+        memcpy(bus->ring + begin % bus->size, &pad, sizeof(pad));
+    }
+
+    memcpy(bus->ring + start % bus->size, &rec, sizeof(rec));
+    memcpy(bus->ring + start % bus->size + sizeof(rec), bus->buf, bus->buf_len);
+
+    __atomic_store_n(&hdr->write_end, start + rec.size, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&hdr->waiters, __ATOMIC_SEQ_CST)) {
+        ab_lock(hdr);
+        pthread_cond_broadcast(&hdr->cond);
+        pthread_mutex_unlock(&hdr->mutex);
+    }
+}
+
+alert_bus *AlertBus_Open()
+{
+    alert_bus *bus;
+
+    os_calloc(1, sizeof(alert_bus), bus);
+
+    if (ab_map(bus) < 0) {
+        free(bus);
+        return (NULL);
+    }
+
+    bus->cursor = __atomic_load_n(&bus->hdr->write_end, __ATOMIC_ACQUIRE);
+    return (bus);
+}
+
+void AlertBus_Close(alert_bus *bus)
+{
+    ab_unmap(bus);
+    free(bus->buf);
+    free(bus);
+}
+
+/* Copy the next record to rec and bus->buf.
+ * Returns 1 if there was one, or 0.
+ */
+static int ab_next(alert_bus *bus, alert_bus_record *rec)
+{
+    alert_bus_header *hdr = bus->hdr;
+
+    while (1) {
+        uint64_t end = __atomic_load_n(&hdr->write_end, __ATOMIC_ACQUIRE);
+        uint64_t cursor = bus->cursor;
+        uint64_t room;
+        int valid;
+
+        if (cursor == end) {
+            return (0);
+        }
+
+        /* Overrun: go on from the oldest record */
+        if (end - cursor > bus->size) {
+            bus->cursor = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+            continue;
+        }
+
+        room = bus->size - cursor % bus->size;
+        if (room < sizeof(*rec)) {
+            bus->cursor += room;
+            continue;
+        }
+
+        memcpy(rec, bus->ring + cursor % bus->size, sizeof(*rec));
+        valid = rec->size >= sizeof(*rec) && rec->size <= room && rec->size % 8 == 0 &&
+                rec->len <= rec->size - sizeof(*rec);
+
+        if (valid && !(rec->flags & ALERTBUS_PAD)) {
+            bus->buf_len = 0;
+            ab_put(bus, bus->ring + cursor % bus->size + sizeof(*rec), rec->len);
+        }
+
+        /* Overwritten while it was copied */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&hdr->write_begin, __ATOMIC_RELAXED) - cursor > bus->size) {
+            bus->cursor = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+            continue;
+        }
+
+        if (!valid) {
+            merror("%s: ERROR: Invalid record in the alert bus, skipping to the last one.",
+                   __local_name);
+            bus->cursor = end;
+            return (0);
+        }
+
+        bus->cursor = cursor + rec->size;
+        if (!(rec->flags & ALERTBUS_PAD)) {
+            return (1);
+        }
+    }
+}
+
+/* Sleep until there are new records, or up to seconds */
+static void ab_wait(alert_bus *bus, unsigned int seconds)
+{
+    alert_bus_header *hdr = bus->hdr;
+    struct timespec ts;
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    ts.tv_sec = now.tv_sec + (time_t)seconds;
+    ts.tv_nsec = now.tv_usec * 1000;
+
+    ab_lock(hdr);
+    __atomic_add_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+
+    while (__atomic_load_n(&hdr->write_end, __ATOMIC_SEQ_CST) == bus->cursor) {
+        int error = pthread_cond_timedwait(&hdr->cond, &hdr->mutex, &ts);
+
+#ifdef ALERTBUS_ROBUST
+        if (error == EOWNERDEAD) {
+            pthread_mutex_consistent(&hdr->mutex);
+        } else
+#endif
+        if (error) {
+            break;
+        }
+    }
+
+    __atomic_sub_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&hdr->mutex);
+}
+
+/* Check that the bus is still the one of analysisd. Returns 0 if it
+ * is (or the new one was mapped), or -1 if it is gone.
+ */
+static int ab_check(alert_bus *bus)
+{
+    struct stat st;
+
+    if (stat(ab_path(), &st) < 0) {
+        return (-1);
+    }
+
+    if (st.st_dev == bus->dev && st.st_ino == bus->ino) {
+        return (0);
+    }
+
+    /* analysisd restarted: everything in the new bus is new */
+    ab_unmap(bus);
+    if (ab_map(bus) < 0) {
+        return (-1);
+    }
+
+    bus->cursor = __atomic_load_n(&bus->hdr->tail, __ATOMIC_ACQUIRE);
+    return (0);
+}
+
+int AlertBus_Read(alert_bus *bus, int flags, unsigned int wait,
+                  alert_data **al_data, alert_bus_pos *pos)
+{
+    time_t deadline = time(NULL) + (time_t)wait;
+    alert_bus_record rec;
+
+    *al_data = NULL;
+
+    while (1) {
+        time_t now;
+
+        if (ab_next(bus, &rec)) {
+            pos->year = rec.year;
+            pos->day = rec.day;
+            memcpy(pos->mon, rec.mon, sizeof(pos->mon) - 1);
+            pos->mon[sizeof(pos->mon) - 1] = '\0';
+            pos->offset = (long)rec.offset;
+            pos->end = (long)rec.end;
+
+            if (!(flags & CRALERT_MAIL_SET) || (rec.flags & ALERTBUS_MAIL)) {
+                *al_data = ab_decode(bus->buf, rec.len);
+                if (!*al_data) {
+                    merror("%s: ERROR: Invalid alert in the alert bus.", __local_name);
+                }
+            }
+
+            return (1);
+        }
+
+        now = time(NULL);
+        if (now >= deadline) {
+            return (ab_check(bus) < 0 ? -1 : 0);
+        }
+
+        /* Wake up every second to see if analysisd restarted */
+        ab_wait(bus, 1);
+
+        if (__atomic_load_n(&bus->hdr->write_end, __ATOMIC_ACQUIRE) == bus->cursor &&
+                ab_check(bus) < 0) {
+            return (-1);
+        }
+    }
+}
+
+#endif /* !WIN32 */
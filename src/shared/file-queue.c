@@ -12,21 +12,26 @@
 #include "shared.h"
 #include "file-queue.h"
 
-static void file_sleep(void);
+static void file_sleep(unsigned int seconds);
 static void GetFile_Queue(file_queue *fileq) __attribute__((nonnull));
 static int Handle_Queue(file_queue *fileq, int flags) __attribute__((nonnull));
+#ifndef WIN32
+static int Open_Bus(file_queue *fileq, long offset) __attribute__((nonnull));
+static alert_data *Read_Bus(file_queue *fileq, unsigned int timeout) __attribute__((nonnull));
+#endif
 /* To translate between month (int) to month (char) */
 static const char *(s_month[]) = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
                                   "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
                                  };
 
 
-static void file_sleep()
+/* Wait for FQ_TIMEOUT seconds, or less if seconds is lower */
+static void file_sleep(unsigned int seconds)
 {
 #ifndef WIN32
     struct timeval fp_timeout;
 
-    fp_timeout.tv_sec = FQ_TIMEOUT;
+    fp_timeout.tv_sec = seconds < FQ_TIMEOUT ? seconds : FQ_TIMEOUT;
     fp_timeout.tv_usec = 0;
 
     /* Wait for the select timeout */
@@ -34,7 +39,7 @@ static void file_sleep()
 
 #else
     /* Windows does not like select that way */
-    Sleep((FQ_TIMEOUT + 2) * 1000);
+    Sleep((seconds < FQ_TIMEOUT ? seconds : FQ_TIMEOUT + 2) * 1000);
 #endif
 
     return;
@@ -105,6 +110,214 @@ static int Handle_Queue(file_queue *fileq, int flags)
     return (1);
 }
 
+#ifndef WIN32
+/* Follow the alert bus of analysisd (when it has one) instead of the
+ * log, from offset of the current log on. The log is still read when
+ * the alerts of the bus do not follow the ones read (the bus started
+ * later, or it went around before they were read).
+ */
+static int Open_Bus(file_queue *fileq, long offset)
+{
+    if (fileq->flags & (CRALERT_FP_SET | CRALERT_READ_ALL)) {
+        return (0);
+    }
+
+    fileq->bus = AlertBus_Open();
+    if (!fileq->bus) {
+        return (0);
+    }
+
+    fileq->offset = offset;
+    fileq->stalled = 0;
+    fileq->pending = 0;
+    fileq->pending_data = NULL;
+
+    debug1("%s: DEBUG: Reading the alerts from the alert bus.", __local_name);
+    return (1);
+}
+
+/* Go back to the log, from where the bus was */
+static void Close_Bus(file_queue *fileq)
+{
+    AlertBus_Close(fileq->bus);
+    fileq->bus = NULL;
+
+    if (fileq->pending_data) {
+        FreeAlertData(fileq->pending_data);
+        fileq->pending_data = NULL;
+    }
+    fileq->pending = 0;
+
+    if (fileq->fp) {
+        fclose(fileq->fp);
+    }
+
+    GetFile_Queue(fileq);
+    fileq->fp = fopen(fileq->file_name, "r");
+    if (fileq->fp) {
+        fseek(fileq->fp, fileq->offset, SEEK_SET);
+        if (fstat(fileno(fileq->fp), &fileq->f_status) == 0) {
+            fileq->last_change = fileq->f_status.st_mtime;
+        }
+    }
+
+    debug1("%s: DEBUG: Alert bus closed, reading the alerts from the log.", __local_name);
+}
+
+/* Move on to the log of the alert pending */
+static void Next_Log(file_queue *fileq)
+{
+    if (fileq->fp) {
+        fclose(fileq->fp);
+        fileq->fp = NULL;
+    }
+
+    fileq->year = fileq->pending_pos.year;
+    fileq->day = fileq->pending_pos.day;
+    strncpy(fileq->mon, fileq->pending_pos.mon, 3);
+    fileq->offset = 0;
+
+    GetFile_Queue(fileq);
+}
+
+/* Read from the log the next alert before the one pending.
+ * Returns NULL with done set when there are no more, or with done
+ * unset when the log does not have them yet.
+ */
+static alert_data *Read_Missed(file_queue *fileq, int *done)
+{
+    const alert_bus_pos *pos = &fileq->pending_pos;
+    alert_data *al_data;
+    int same_log;
+
+    *done = 0;
+
+    while (1) {
+        same_log = fileq->year == pos->year && fileq->day == pos->day &&
+                   strncmp(fileq->mon, pos->mon, 3) == 0;
+
+        if (same_log && fileq->offset >= pos->offset) {
+            *done = 1;
+            return (NULL);
+        }
+
+        if (!fileq->fp) {
+            GetFile_Queue(fileq);
+            fileq->fp = fopen(fileq->file_name, "r");
+        }
+
+        if (!fileq->fp || fseek(fileq->fp, fileq->offset, SEEK_SET) < 0) {
+            if (same_log) {
+                merror(FOPEN_ERROR, __local_name, fileq->file_name, errno, strerror(errno));
+                fileq->offset = pos->offset;
+                continue;
+            }
+
+            /* Gone (or compressed) */
+            Next_Log(fileq);
+            continue;
+        }
+
+        al_data = GetAlertData(fileq->flags, fileq->fp);
+        if (al_data) {
+            fileq->offset = ftell(fileq->fp);
+            fileq->stalled = 0;
+            return (al_data);
+        }
+
+        /* The older logs are complete */
+        if (!same_log) {
+            Next_Log(fileq);
+            continue;
+        }
+
+        /* Only alerts without the flags up to the one pending */
+        if (ftell(fileq->fp) >= pos->offset) {
+            fileq->offset = pos->offset;
+            continue;
+        }
+
+        /* analysisd did not flush them yet */
+        if (!fileq->stalled) {
+            fileq->stalled = time(NULL);
+        } else if (time(NULL) - fileq->stalled > FQ_STALL_TIMEOUT) {
+            merror("%s: WARN: Alerts of '%s' from %ld to %ld not found.",
+                   __local_name, fileq->file_name, fileq->offset, pos->offset);
+            fileq->offset = pos->offset;
+            fileq->stalled = 0;
+            continue;
+        }
+
+        return (NULL);
+    }
+}
+
+/* Read from the alert bus, waiting up to timeout seconds */
+static alert_data *Read_Bus(file_queue *fileq, unsigned int timeout)
+{
+    time_t deadline = time(NULL) + (time_t)timeout;
+    alert_data *al_data;
+    int done;
+
+    while (1) {
+        if (!fileq->pending) {
+            time_t now = time(NULL);
+            int ret = AlertBus_Read(fileq->bus, fileq->flags,
+                                    now < deadline ? (unsigned int)(deadline - now) : 0,
+                                    &fileq->pending_data, &fileq->pending_pos);
+            if (ret < 0) {
+                Close_Bus(fileq);
+                return (NULL);
+            }
+
+            if (ret == 0) {
+                return (NULL);
+            }
+
+            fileq->pending = 1;
+        }
+
+        /* First the alerts the bus did not have */
+        al_data = Read_Missed(fileq, &done);
+        if (al_data) {
+            return (al_data);
+        }
+
+        if (!done) {
+            struct timeval fp_timeout;
+
+            if (time(NULL) >= deadline) {
+                return (NULL);
+            }
+
+            fp_timeout.tv_sec = 0;
+            fp_timeout.tv_usec = 100000;
+            select(0, NULL, NULL, NULL, &fp_timeout);
+            continue;
+        }
+
+        fileq->pending = 0;
+        al_data = fileq->pending_data;
+        fileq->pending_data = NULL;
+
+        /* Read from the log already */
+        if (fileq->offset > fileq->pending_pos.offset) {
+            if (al_data) {
+                FreeAlertData(al_data);
+            }
+            continue;
+        }
+
+        fileq->offset = fileq->pending_pos.end;
+
+        /* The ones without the flags wanted are skipped */
+        if (al_data) {
+            return (al_data);
+        }
+    }
+}
+#endif /* !WIN32 */
+
 /* Initiates the file monitoring */
 int Init_FileQueue(file_queue *fileq, const struct tm *p, int flags)
 {
@@ -114,6 +327,7 @@ int Init_FileQueue(file_queue *fileq, const struct tm *p, int flags)
     }
     fileq->last_change = 0;
     fileq->flags = 0;
+    fileq->bus = NULL;
 
     fileq->day = p->tm_mday;
     fileq->year = p->tm_year + 1900;
@@ -132,19 +346,43 @@ int Init_FileQueue(file_queue *fileq, const struct tm *p, int flags)
         return (-1);
     }
 
+#ifndef WIN32
+    Open_Bus(fileq, fileq->fp ? ftell(fileq->fp) : 0);
+#endif
+
     return (0);
 }
 
-/* Reads from the monitored file */
+/* Reads from the monitored file, waiting up to timeout * FQ_TIMEOUT
+ * seconds for an alert
+ */
 alert_data *Read_FileMon(file_queue *fileq, const struct tm *p, unsigned int timeout)
 {
-    unsigned int i = 0;
+    return (Read_FileMonSeconds(fileq, p, timeout * FQ_TIMEOUT));
+}
+
+/* Reads from the monitored file, waiting up to timeout seconds */
+alert_data *Read_FileMonSeconds(file_queue *fileq, const struct tm *p, unsigned int timeout)
+{
+    time_t deadline = time(NULL) + (time_t)timeout;
+    time_t now;
     alert_data *al_data;
 
+#ifndef WIN32
+    if (fileq->bus) {
+        return (Read_Bus(fileq, timeout));
+    }
+#endif
+
     /* If the file queue is not available, try to access it */
     if (!fileq->fp) {
         if (Handle_Queue(fileq, 0) != 1) {
-            file_sleep();
+#ifndef WIN32
+            if (Open_Bus(fileq, 0)) {
+                return (Read_Bus(fileq, timeout));
+            }
+#endif
+            file_sleep(timeout);
             return (NULL);
         }
     }
@@ -162,7 +400,7 @@ alert_data *Read_FileMon(file_queue *fileq, const struct tm *p, unsigned int tim
             GetFile_Queue(fileq);
 
             if (Handle_Queue(fileq, 0) != 1) {
-                file_sleep();
+                file_sleep(timeout);
                 return (NULL);
             }
         } else {
@@ -170,15 +408,28 @@ alert_data *Read_FileMon(file_queue *fileq, const struct tm *p, unsigned int tim
         }
     }
 
-    /* Try up to timeout times to get an event */
-    while (i < timeout) {
+    /* Try until the timeout expires to get an event */
+    while (1) {
+        long offset = ftell(fileq->fp);
+
         al_data = GetAlertData(fileq->flags, fileq->fp);
         if (al_data) {
             return (al_data);
         }
 
-        i++;
-        file_sleep();
+#ifndef WIN32
+        /* At the end of the log: wait on the bus from here */
+        if (offset >= 0 && Open_Bus(fileq, offset)) {
+            now = time(NULL);
+            return (Read_Bus(fileq, now < deadline ? (unsigned int)(deadline - now) : 0));
+        }
+#endif
+
+        now = time(NULL);
+        if (now >= deadline) {
+            break;
+        }
+        file_sleep((unsigned int)(deadline - now));
     }
 
     /* Return NULL if timeout expires */
@@ -17,7 +17,7 @@
 int StartMQ(const char *path, short int type)
 {
     if (type == READ) {
-        return (OS_BindUnixDomain(path, 0660, OS_MAXSTR + 512));
+        return (OS_BindUnixDomain(path, 0660, MQ_BATCH_MAXSIZE + 512));
     }
 
     /* We give up to 21 seconds for the other end to start */
@@ -40,11 +40,11 @@ int StartMQ(const char *path, short int type)
         /* Wait up to 3 seconds to connect to the unix domain.
          * After three errors, exit.
          */
-        if ((rc = OS_ConnectUnixDomain(path, OS_MAXSTR + 256)) < 0) {
+        if ((rc = OS_ConnectUnixDomain(path, MQ_BATCH_MAXSIZE + 256)) < 0) {
             sleep(1);
-            if ((rc = OS_ConnectUnixDomain(path, OS_MAXSTR + 256)) < 0) {
+            if ((rc = OS_ConnectUnixDomain(path, MQ_BATCH_MAXSIZE + 256)) < 0) {
                 sleep(2);
-                if ((rc = OS_ConnectUnixDomain(path, OS_MAXSTR + 256)) < 0) {
+                if ((rc = OS_ConnectUnixDomain(path, MQ_BATCH_MAXSIZE + 256)) < 0) {
                     merror(QUEUE_ERROR, __local_name, path,
                            strerror(errno));
                     return (-1);
@@ -57,10 +57,23 @@ int StartMQ(const char *path, short int type)
     }
 }
 
+/* Messages waiting to be sent in a batch */
+static struct {
+    char *buffer;
+    size_t size;            /* Maximum size of a batch (0 if disabled) */
+    size_t used;
+    time_t time;            /* Time of the first message */
+} mq_batch;
+
+static int mq_send(int queue, const char *buffer, int size);
+static int mq_batch_add(int queue, char loc, const char *locmsg,
+                        const char *location, size_t location_size,
+                        const char *message);
+
+
 /* Send a message to the queue */
 int SendMSG(int queue, const char *message, const char *locmsg, char loc)
 {
-    int __mq_rcode;
     char tmpstr[OS_MAXSTR + 1];
 
     tmpstr[OS_MAXSTR] = '\0';
@@ -82,8 +95,27 @@ int SendMSG(int queue, const char *message, const char *locmsg, char loc)
             return (0);
         }
 
+        if (mq_batch.size) {
+            const char *pieces;
+
+            /* The location ends at the first ':' of the message */
+            if ((pieces = strchr(message, ':')) != NULL) {
+                return (mq_batch_add(queue, loc, locmsg, message,
+                                     (size_t)(pieces - message), pieces + 1));
+            }
+
+            /* Not a valid location: let analysisd report it */
+            if (FlushMSG(queue) < 0) {
+                return (-1);
+            }
+        }
+
         snprintf(tmpstr, OS_MAXSTR, "%c:%s->%s", loc, locmsg, message);
     } else {
+        if (mq_batch.size) {
+            return (mq_batch_add(queue, loc, locmsg, NULL, 0, message));
+        }
+
         snprintf(tmpstr, OS_MAXSTR, "%c:%s:%s", loc, locmsg, message);
     }
 
@@ -92,6 +124,14 @@ int SendMSG(int queue, const char *message, const char *locmsg, char loc)
         return (-1);
     }
 
+    return (mq_send(queue, tmpstr, 0));
+}
+
+/* Send a datagram to the queue (size 0 for a string) */
+static int mq_send(int queue, const char *buffer, int size)
+{
+    int __mq_rcode;
+
     /* We attempt 5 times to send the message if
      * the receiver socket is busy.
      * After the first error, we wait 1 second.
@@ -101,7 +141,7 @@ int SendMSG(int queue, const char *message, const char *locmsg, char loc)
      * If we failed again, the message is not going
      * to be delivered and an error is sent back.
      */
-    if ((__mq_rcode = OS_SendUnix(queue, tmpstr, 0)) < 0) {
+    if ((__mq_rcode = OS_SendUnix(queue, buffer, size)) < 0) {
         /* Error on the socket */
         if (__mq_rcode == OS_SOCKTERR) {
             merror("%s: socketerr (not available).", __local_name);
@@ -111,20 +151,20 @@ int SendMSG(int queue, const char *message, const char *locmsg, char loc)
 
         /* Unable to send. Socket busy */
         sleep(1);
-        if (OS_SendUnix(queue, tmpstr, 0) < 0) {
+        if (OS_SendUnix(queue, buffer, size) < 0) {
             /* When the socket is to busy, we may get some
              * error here. Just sleep 2 second and try
              * again.
              */
             sleep(3);
             /* merror("%s: socket busy", __local_name); */
-            if (OS_SendUnix(queue, tmpstr, 0) < 0) {
+            if (OS_SendUnix(queue, buffer, size) < 0) {
                 sleep(5);
                 merror("%s: socket busy ..", __local_name);
-                if (OS_SendUnix(queue, tmpstr, 0) < 0) {
+                if (OS_SendUnix(queue, buffer, size) < 0) {
                     sleep(10);
                     merror("%s: socket busy ..", __local_name);
-                    if (OS_SendUnix(queue, tmpstr, 0) < 0) {
+                    if (OS_SendUnix(queue, buffer, size) < 0) {
                         /* Message is going to be lost
                          * if the application does not care
                          * about checking the error
@@ -140,4 +180,150 @@ int SendMSG(int queue, const char *message, const char *locmsg, char loc)
     return (0);
 }
 
+/* Add a message to the batch. The location is locmsg, followed by
+ * "->" and the given location for the messages of the agents.
+ * The batch is sent first if the message does not fit or if it is
+ * too old, so a message is never added if an error is returned.
+ */
+static int mq_batch_add(int queue, char loc, const char *locmsg,
+                        const char *location, size_t location_size,
+                        const char *message)
+{
+    size_t locmsg_size = strlen(locmsg);
+    size_t loc_size = locmsg_size;
+    size_t msg_size = strlen(message);
+    uint32_t header[2];
+    char *pt;
+
+    if (location) {
+        loc_size += 2 + location_size;
+    }
+
+    /* Same limits as a text message: "id:location:message" */
+    if (loc_size > OS_MAXSTR - 4) {
+        loc_size = OS_MAXSTR - 4;
+    }
+    if (3 + loc_size + msg_size > OS_MAXSTR - 1) {
+        msg_size = OS_MAXSTR - 1 - 3 - loc_size;
+    }
+
+    /* Queue not available */
+    if (queue < 0) {
+        return (-1);
+    }
+
+    if (mq_batch.used > 0 &&
+            (mq_batch.used + MQ_BATCH_RECORD_HEADER + loc_size + msg_size + 2 > mq_batch.size ||
+             time(NULL) - mq_batch.time > 0)) {
+        if (FlushMSG(queue) < 0) {
+            return (-1);
+        }
+    }
+
+    if (mq_batch.used == 0) {
+        memcpy(mq_batch.buffer, MQ_BATCH_MAGIC, MQ_BATCH_MAGIC_SIZE);
+        mq_batch.used = MQ_BATCH_MAGIC_SIZE;
+        mq_batch.time = time(NULL);
+    }
+
+    pt = mq_batch.buffer + mq_batch.used;
+
+    header[0] = (uint32_t)loc_size;
+    header[1] = (uint32_t)msg_size;
+    *pt++ = loc;
+    memcpy(pt, header, sizeof(header));
+    pt += sizeof(header);
+
+    if (location) {
+        snprintf(pt, loc_size + 1, "%s->%.*s", locmsg, (int)location_size, location);
+    } else {
+        memcpy(pt, locmsg, loc_size);
+    }
+    pt[loc_size] = '\0';
+    pt += loc_size + 1;
+
+    memcpy(pt, message, msg_size);
+    pt[msg_size] = '\0';
+    pt += msg_size + 1;
+
+    mq_batch.used = (size_t)(pt - mq_batch.buffer);
+    return (0);
+}
+
+void SetMQBatch(size_t size)
+{
+    if (size > MQ_BATCH_MAXSIZE) {
+        size = MQ_BATCH_MAXSIZE;
+    }
+
+    if (size && !mq_batch.buffer) {
+        os_malloc(MQ_BATCH_MAXSIZE, mq_batch.buffer);
+    }
+
+    mq_batch.size = size;
+}
+
+int FlushMSG(int queue)
+{
+    if (mq_batch.used == 0) {
+        return (0);
+    }
+
+    /* Queue not available */
+    if (queue < 0) {
+        return (-1);
+    }
+
+    if (mq_send(queue, mq_batch.buffer, (int)mq_batch.used) < 0) {
+        return (-1);
+    }
+
+    mq_batch.used = 0;
+    return (0);
+}
+
 #endif /* !WIN32 */
+
+int IsMQBatch(const char *buffer, size_t size)
+{
+    return (size >= MQ_BATCH_MAGIC_SIZE &&
+            memcmp(buffer, MQ_BATCH_MAGIC, MQ_BATCH_MAGIC_SIZE) == 0);
+}
+
+int ReadMQBatch(char *buffer, size_t size, size_t *pos, mq_record *record)
+{
+    uint32_t header[2];
+    char *pt;
+
+    if (*pos == 0) {
+        *pos = MQ_BATCH_MAGIC_SIZE;
+    }
+
+    if (*pos >= size) {
+        return (0);
+    }
+
+    if (size - *pos < MQ_BATCH_RECORD_HEADER + 2) {
+        return (-1);
+    }
+
+    pt = buffer + *pos;
+    record->loc = *pt++;
+    memcpy(header, pt, sizeof(header));
+    pt += sizeof(header);
+
+    /* Both strings and their terminators must be in the batch */
+    if (header[0] > size - *pos - MQ_BATCH_RECORD_HEADER - 2 ||
+            header[1] > size - *pos - MQ_BATCH_RECORD_HEADER - 2 - header[0] ||
+            pt[header[0]] != '\0' || pt[header[0] + 1 + header[1]] != '\0') {
+        return (-1);
+    }
+
+    record->location = pt;
+    record->location_size = header[0];
+    record->message = pt + header[0] + 1;
+    record->message_size = header[1];
+
+    *pos += MQ_BATCH_RECORD_HEADER + header[0] + header[1] + 2;
+    return (1);
+}
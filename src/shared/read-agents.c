@@ -14,8 +14,8 @@
 #ifndef WIN32
 static int _do_print_attrs_syscheck(const char *prev_attrs, const char *attrs, int csv_output, cJSON *json_output,
                                     int is_win, int number_of_changes) __attribute__((nonnull(2)));
-static int _do_print_file_syscheck(FILE *fp, const char *fname, int update_counter,
-                                   int csv_output, cJSON *json_output) __attribute__((nonnull(1)));
+static int _do_print_file_syscheck(FILE *fp, const char *db_path, const char *fname, int update_counter,
+                                   int csv_output, cJSON *json_output) __attribute__((nonnull(1, 2)));
 static int _do_print_syscheck(FILE *fp, int all_files, int csv_output, cJSON *json_output) __attribute__((nonnull(1)));
 static int _do_get_rootcheckscan(FILE *fp) __attribute__((nonnull));
 static int _do_print_rootcheck(FILE *fp, int resolved, time_t time_last_scan,
@@ -173,7 +173,7 @@ static int _do_print_attrs_syscheck(const char *prev_attrs, const char *attrs, _
 }
 
 /* Print information about a specific file */
-static int _do_print_file_syscheck(FILE *fp, const char *fname, int update_counter,
+static int _do_print_file_syscheck(FILE *fp, const char *db_path, const char *fname, int update_counter,
                                    int csv_output, cJSON *json_output)
 {
     int f_found = 0;
@@ -298,6 +298,11 @@ static int _do_print_file_syscheck(FILE *fp, const char *fname, int update_count
                     }
                 }
 
+                /* Keep the index of the database in sync */
+                fflush(fp);
+                sk_idx_mark(db_path, changed_file_name,
+                            update_counter == 2 ? "!!?" : "!++");
+
                 if (!(csv_output || json_output))
                     printf("\n**Counter updated for file '%s'\n\n",
                            changed_file_name);
@@ -505,7 +510,7 @@ int print_syscheck(const char *sk_name, const char *sk_ip, const char *fname,
         if (!fname) {
             _do_print_syscheck(fp, all_files, csv_output, json_output);
         } else {
-            _do_print_file_syscheck(fp, fname, update_counter, csv_output, json_output);
+            _do_print_file_syscheck(fp, tmp_file, fname, update_counter, csv_output, json_output);
         }
         fclose(fp);
     }
@@ -741,8 +746,10 @@ int delete_syscheck(const char *sk_name, const char *sk_ip, int full_delete)
 {
     FILE *fp;
     char tmp_file[513];
+    char idx_file[513];
 
     tmp_file[512] = '\0';
+    idx_file[512] = '\0';
 
     /* Delete related files */
     snprintf(tmp_file, 512, "%s/(%s) %s->syscheck",
@@ -761,6 +768,12 @@ int delete_syscheck(const char *sk_name, const char *sk_ip, int full_delete)
         }
     }
 
+    /* Delete the index. Never truncate it, as analysisd may have it mapped */
+    sk_idx_path(tmp_file, idx_file, 512);
+    if ((unlink(idx_file)) < 0 && errno != ENOENT) {
+        merror("%s: ERROR: Cannot unlink %s: %s", __local_name, idx_file, strerror(errno));
+    }
+
     /* Delete cpt files */
     snprintf(tmp_file, 512, "%s/.(%s) %s->syscheck.cpt",
              SYSCHECK_DIR,
@@ -791,6 +804,12 @@ int delete_syscheck(const char *sk_name, const char *sk_ip, int full_delete)
         }
     }
 
+    /* Delete the index. Never truncate it, as analysisd may have it mapped */
+    sk_idx_path(tmp_file, idx_file, 512);
+    if ((unlink(idx_file)) < 0 && errno != ENOENT) {
+        merror("%s: ERROR: Cannot unlink %s: %s", __local_name, idx_file, strerror(errno));
+    }
+
     /* Delete cpt files */
     snprintf(tmp_file, 512, "%s/.(%s) %s->syscheck-registry.cpt",
              SYSCHECK_DIR,
@@ -161,8 +161,61 @@ void FreeAlertData(alert_data *al_data)
     al_data = NULL;
 }
 
+/* Source of the lines of the alerts */
+typedef char *(*alert_gets)(char *str, int size, void *src);
+
+static char *alert_fgets(char *str, int size, void *src)
+{
+    return (fgets(str, size, (FILE *)src));
+}
+
+/* As fgets, from a string (src points to the text left) */
+static char *alert_sgets(char *str, int size, void *src)
+{
+    const char **text = (const char **)src;
+    const char *nl;
+    size_t len;
+
+    if (**text == '\0' || size < 2) {
+        return (NULL);
+    }
+
+    nl = strchr(*text, '\n');
+    len = nl ? (size_t)(nl - *text) + 1 : strlen(*text);
+    if (len > (size_t)size - 1) {
+        len = (size_t)size - 1;
+    }
+
+    memcpy(str, *text, len);
+    str[len] = '\0';
+    *text += len;
+    return (str);
+}
+
+static alert_data *ReadAlertData(int flag, alert_gets next_line, void *src);
+
 /* Return alert data for the file specified */
 alert_data *GetAlertData(int flag, FILE *fp)
+{
+    alert_data *al_data = ReadAlertData(flag, alert_fgets, fp);
+
+    /* We need to clean end of file before returning */
+    if (!al_data) {
+        clearerr(fp);
+    }
+
+    return (al_data);
+}
+
+/* Return the alert data of the first alert in a text, as written
+ * in the alerts log
+ */
+alert_data *ParseAlertData(int flag, const char *text)
+{
+    return (ReadAlertData(flag, alert_sgets, &text));
+}
+
+static alert_data *ReadAlertData(int flag, alert_gets next_line, void *src)
 {
     int _r = 0, issyscheck = 0;
     size_t log_size = 0;
@@ -197,7 +250,7 @@ alert_data *GetAlertData(int flag, FILE *fp)
     char str[OS_BUFFER_SIZE + 1];
     str[OS_BUFFER_SIZE] = '\0';
 
-    while (fgets(str, OS_BUFFER_SIZE, fp) != NULL) {
+    while (next_line(str, OS_BUFFER_SIZE, src) != NULL) {
         /* End of alert */
         if (strcmp(str, "\n") == 0 && log_size > 0) {
             /* Found in here */
@@ -657,7 +710,5 @@ l_error:
     free(dstgeoip);
 #endif
 
-    /* We need to clean end of file before returning */
-    clearerr(fp);
     return (NULL);
 }
@@ -0,0 +1,545 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* Indexed syscheck integrity database */
+
+#include "shared.h"
+
+/* Get the path of the index of a log */
+void sk_idx_path(const char *log_path, char *path, size_t size)
+{
+    const char *base;
+
+    base = strrchr(log_path, '/');
+    if (base) {
+        snprintf(path, size, "%.*s/.%s%s", (int)(base - log_path), log_path,
+                 base + 1, SK_IDX_EXT);
+    } else {
+        snprintf(path, size, ".%s%s", log_path, SK_IDX_EXT);
+    }
+}
+
+#ifndef WIN32
+
+#include <sys/mman.h>
+
+#define SK_IDX_MIN_BUCKETS  1024
+#define SK_IDX_MIN_DATA     65536
+#define SK_IDX_SUM_ROOM     64
+
+#define _sk_align(x)        (((x) + 7) & ~((size_t)7))
+#define _sk_hdr(idx)        ((sk_idx_header *)(idx)->map)
+#define _sk_buckets(idx)    ((uint64_t *)((idx)->map + sizeof(sk_idx_header)))
+#define _sk_entry(idx, off) ((sk_idx_entry *)((idx)->map + (off)))
+
+static uint32_t _sk_idx_hash(const char *name) __attribute__((nonnull));
+static int _sk_idx_resize(sk_idx *idx, size_t size) __attribute__((nonnull));
+static sk_idx *_sk_idx_new(const char *path, const char *log_path, uint32_t buckets) __attribute__((nonnull));
+static sk_idx *_sk_idx_load(const char *path, const char *log_path) __attribute__((nonnull));
+static sk_idx *_sk_idx_build(const char *log_path, const char *path) __attribute__((nonnull));
+static void _sk_idx_replace(sk_idx *idx, sk_idx *new_idx) __attribute__((nonnull));
+static int _sk_idx_add(sk_idx *idx, uint32_t hash, const char *name, const char *marks,
+                       const char *sum, int64_t change_time, uint64_t log_pos, uint64_t old) __attribute__((nonnull));
+static int _sk_idx_rehash(sk_idx *idx) __attribute__((nonnull));
+
+
+/* FNV-1a hash of a file name */
+static uint32_t _sk_idx_hash(const char *name)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*name) {
+        hash ^= (unsigned char) * name++;
+        hash *= 16777619U;
+    }
+
+    return (hash);
+}
+
+/* Grow the file to size bytes and map it again */
+static int _sk_idx_resize(sk_idx *idx, size_t size)
+{
+    char *map;
+
+    if (ftruncate(idx->fd, (off_t)size) < 0) {
+        merror("%s: ERROR: Unable to resize '%s': %s", __local_name, idx->path, strerror(errno));
+        return (-1);
+    }
+
+    map = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, idx->fd, 0);
+    if (map == MAP_FAILED) {
+        merror("%s: ERROR: Unable to map '%s': %s", __local_name, idx->path, strerror(errno));
+        return (-1);
+    }
+
+    if (idx->map) {
+        munmap(idx->map, idx->map_size);
+    }
+
+    idx->map = map;
+    idx->map_size = size;
+
+    return (0);
+}
+
+/* Create an empty index */
+static sk_idx *_sk_idx_new(const char *path, const char *log_path, uint32_t buckets)
+{
+    sk_idx *idx;
+    size_t size;
+
+    os_calloc(1, sizeof(sk_idx), idx);
+    os_strdup(path, idx->path);
+    os_strdup(log_path, idx->log_path);
+
+    idx->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0660);
+    if (idx->fd < 0) {
+        merror(FOPEN_ERROR, __local_name, path, errno, strerror(errno));
+        free(idx->path);
+        free(idx->log_path);
+        free(idx);
+        return (NULL);
+    }
+
+    size = sizeof(sk_idx_header) + buckets * sizeof(uint64_t);
+    if (_sk_idx_resize(idx, size + SK_IDX_MIN_DATA) < 0) {
+        sk_idx_close(idx);
+        return (NULL);
+    }
+
+    /* A new file reads as zeros, so all buckets are empty */
+    memcpy(_sk_hdr(idx)->magic, SK_IDX_MAGIC, sizeof(SK_IDX_MAGIC));
+    _sk_hdr(idx)->version = SK_IDX_VERSION;
+    _sk_hdr(idx)->buckets = buckets;
+    _sk_hdr(idx)->entries = 0;
+    _sk_hdr(idx)->end = size;
+    _sk_hdr(idx)->log_size = 0;
+
+    return (idx);
+}
+
+/* Map an existing index, checking its header */
+static sk_idx *_sk_idx_load(const char *path, const char *log_path)
+{
+    sk_idx *idx;
+    struct stat st;
+    const sk_idx_header *hdr;
+    int fd;
+
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return (NULL);
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(sk_idx_header)) {
+        close(fd);
+        return (NULL);
+    }
+
+    os_calloc(1, sizeof(sk_idx), idx);
+    os_strdup(path, idx->path);
+    os_strdup(log_path, idx->log_path);
+    idx->fd = fd;
+
+    idx->map = (char *) mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (idx->map == MAP_FAILED) {
+        idx->map = NULL;
+        sk_idx_close(idx);
+        return (NULL);
+    }
+    idx->map_size = (size_t)st.st_size;
+
+    hdr = _sk_hdr(idx);
+    if (memcmp(hdr->magic, SK_IDX_MAGIC, sizeof(SK_IDX_MAGIC)) != 0 ||
+            hdr->version != SK_IDX_VERSION || hdr->buckets == 0 ||
+            hdr->end < sizeof(sk_idx_header) + hdr->buckets * sizeof(uint64_t) ||
+            hdr->end > idx->map_size) {
+        merror("%s: WARN: Invalid syscheck index '%s'. Rebuilding it.", __local_name, path);
+        sk_idx_close(idx);
+        return (NULL);
+    }
+
+    return (idx);
+}
+
+/* Build the index of a log into path */
+static sk_idx *_sk_idx_build(const char *log_path, const char *path)
+{
+    char tmp_path[PATH_MAX + 1];
+    char buf[OS_MAXSTR + 1];
+    uint32_t buckets = SK_IDX_MIN_BUCKETS;
+    struct stat st;
+    sk_idx *idx;
+    FILE *fp;
+    long pos;
+
+    fp = fopen(log_path, "r");
+    if (!fp && errno != ENOENT) {
+        merror(FOPEN_ERROR, __local_name, log_path, errno, strerror(errno));
+        return (NULL);
+    }
+
+    /* Most lines are about 100 to 200 bytes long */
+    if (fp && fstat(fileno(fp), &st) == 0) {
+        while (buckets < (uint64_t)st.st_size / 256 && buckets < 0x40000000) {
+            buckets <<= 1;
+        }
+    }
+
+    snprintf(tmp_path, PATH_MAX, "%s.tmp", path);
+    idx = _sk_idx_new(tmp_path, log_path, buckets);
+    if (!idx) {
+        if (fp) {
+            fclose(fp);
+        }
+        return (NULL);
+    }
+
+    buf[OS_MAXSTR] = '\0';
+
+    while (fp && (pos = ftell(fp)) >= 0 && fgets(buf, OS_MAXSTR, fp) != NULL) {
+        char *name;
+        size_t len;
+        time_t change_time = 0;
+
+        /* Commented lines are the history of the changes */
+        if (buf[0] != '+' && buf[0] != '!') {
+            continue;
+        }
+
+        len = strlen(buf);
+        if (buf[len - 1] == '\n') {
+            buf[len - 1] = '\0';
+        }
+
+        name = strchr(buf, ' ');
+        if (name == NULL || name < buf + 3) {
+            continue;
+        }
+        *name = '\0';
+        name++;
+
+        /* New format - with a timestamp */
+        if (*name == '!') {
+            change_time = (time_t)atol(name + 1);
+            name = strchr(name, ' ');
+            if (name == NULL) {
+                continue;
+            }
+            name++;
+        }
+
+        if (sk_idx_put(idx, name, buf, buf + 3, change_time, (uint64_t)pos) < 0) {
+            goto error;
+        }
+    }
+
+    if (fp) {
+        pos = ftell(fp);
+        if (pos < 0) {
+            goto error;
+        }
+        fclose(fp);
+        fp = NULL;
+        sk_idx_sync(idx, (uint64_t)pos);
+    }
+
+    if (rename(tmp_path, path) < 0) {
+        merror(RENAME_ERROR, __local_name, tmp_path, path, errno, strerror(errno));
+        goto error;
+    }
+
+    free(idx->path);
+    os_strdup(path, idx->path);
+
+    return (idx);
+
+error:
+    if (fp) {
+        fclose(fp);
+    }
+    sk_idx_close(idx);
+    unlink(tmp_path);
+    return (NULL);
+}
+
+/* Move new_idx into idx */
+static void _sk_idx_replace(sk_idx *idx, sk_idx *new_idx)
+{
+    if (idx->map) {
+        munmap(idx->map, idx->map_size);
+    }
+    if (idx->fd >= 0) {
+        close(idx->fd);
+    }
+
+    idx->fd = new_idx->fd;
+    idx->map = new_idx->map;
+    idx->map_size = new_idx->map_size;
+
+    free(new_idx->path);
+    free(new_idx->log_path);
+    free(new_idx);
+}
+
+/* Write a new entry. If old is set, the new entry takes its place */
+static int _sk_idx_add(sk_idx *idx, uint32_t hash, const char *name, const char *marks,
+                       const char *sum, int64_t change_time, uint64_t log_pos, uint64_t old)
+{
+    size_t name_size = strlen(name) + 1;
+    size_t sum_size = strlen(sum) + 1;
+    size_t size;
+    uint64_t off;
+    uint64_t *link;
+    sk_idx_entry *entry;
+
+    if (name_size > 0xffff || sum_size > 0xffff - SK_IDX_SUM_ROOM) {
+        merror("%s: ERROR: Syscheck entry too long for the index: '%.256s'", __local_name, name);
+        return (-1);
+    }
+
+    /* Leave room for the checksum to grow in place */
+    sum_size = (sum_size + SK_IDX_SUM_ROOM - 1) & ~((size_t)SK_IDX_SUM_ROOM - 1);
+    size = _sk_align(sizeof(sk_idx_entry) + sum_size + name_size);
+
+    off = _sk_hdr(idx)->end;
+    if (off + size > idx->map_size) {
+        size_t map_size = idx->map_size * 2;
+
+        while (map_size < off + size) {
+            map_size *= 2;
+        }
+        if (_sk_idx_resize(idx, map_size) < 0) {
+            return (-1);
+        }
+    }
+
+    entry = _sk_entry(idx, off);
+    entry->log_pos = log_pos;
+    entry->time = change_time;
+    entry->hash = hash;
+    entry->name_size = (uint16_t)name_size;
+    entry->sum_size = (uint16_t)sum_size;
+    strncpy(entry->marks, marks, 3);
+    entry->marks[3] = '\0';
+    strncpy(sk_idx_sum(entry), sum, sum_size);
+    memcpy(sk_idx_name(entry), name, name_size);
+
+    /* Link it after the map is in its final place */
+    link = &_sk_buckets(idx)[hash % _sk_hdr(idx)->buckets];
+    if (old) {
+        while (*link && *link != old) {
+            link = &_sk_entry(idx, *link)->next;
+        }
+        entry->next = _sk_entry(idx, old)->next;
+    } else {
+        entry->next = *link;
+        _sk_hdr(idx)->entries++;
+    }
+    *link = off;
+
+    _sk_hdr(idx)->end = off + size;
+
+    return (0);
+}
+
+/* Rebuild the index with four times the buckets */
+static int _sk_idx_rehash(sk_idx *idx)
+{
+    char tmp_path[PATH_MAX + 1];
+    sk_idx *new_idx;
+    uint32_t i;
+
+    snprintf(tmp_path, PATH_MAX, "%s.tmp", idx->path);
+    new_idx = _sk_idx_new(tmp_path, idx->log_path, _sk_hdr(idx)->buckets * 4);
+    if (!new_idx) {
+        return (-1);
+    }
+
+    for (i = 0; i < _sk_hdr(idx)->buckets; i++) {
+        uint64_t off = _sk_buckets(idx)[i];
+
+        while (off) {
+            sk_idx_entry *entry = _sk_entry(idx, off);
+
+            if (_sk_idx_add(new_idx, entry->hash, sk_idx_name(entry), entry->marks,
+                            sk_idx_sum(entry), entry->time, entry->log_pos, 0) < 0) {
+                sk_idx_close(new_idx);
+                unlink(tmp_path);
+                return (-1);
+            }
+            off = entry->next;
+        }
+    }
+    _sk_hdr(new_idx)->log_size = _sk_hdr(idx)->log_size;
+
+    if (rename(tmp_path, idx->path) < 0) {
+        merror(RENAME_ERROR, __local_name, tmp_path, idx->path, errno, strerror(errno));
+        sk_idx_close(new_idx);
+        unlink(tmp_path);
+        return (-1);
+    }
+
+    _sk_idx_replace(idx, new_idx);
+    return (0);
+}
+
+/* Open the index of a log */
+sk_idx *sk_idx_open(const char *log_path)
+{
+    char path[PATH_MAX + 1];
+    uint64_t log_size = 0;
+    struct stat st;
+    sk_idx *idx;
+
+    sk_idx_path(log_path, path, PATH_MAX);
+
+    if (stat(log_path, &st) == 0) {
+        log_size = (uint64_t)st.st_size;
+    }
+
+    idx = _sk_idx_load(path, log_path);
+    if (idx) {
+        if (_sk_hdr(idx)->log_size == log_size) {
+            return (idx);
+        }
+        sk_idx_close(idx);
+    }
+
+    return (_sk_idx_build(log_path, path));
+}
+
+void sk_idx_close(sk_idx *idx)
+{
+    if (idx->map) {
+        munmap(idx->map, idx->map_size);
+    }
+    if (idx->fd >= 0) {
+        close(idx->fd);
+    }
+
+    free(idx->path);
+    free(idx->log_path);
+    free(idx);
+}
+
+/* Rebuild the index if it does not match the log */
+int sk_idx_check(sk_idx *idx, uint64_t log_size)
+{
+    sk_idx *new_idx;
+
+    if (_sk_hdr(idx)->log_size == log_size) {
+        return (0);
+    }
+
+    debug1("%s: Syscheck index '%s' is out of date. Rebuilding it.", __local_name, idx->path);
+
+    new_idx = _sk_idx_build(idx->log_path, idx->path);
+    if (!new_idx) {
+        return (-1);
+    }
+
+    _sk_idx_replace(idx, new_idx);
+    return (0);
+}
+
+void sk_idx_sync(sk_idx *idx, uint64_t log_size)
+{
+    _sk_hdr(idx)->log_size = log_size;
+}
+
+/* Look up a file */
+sk_idx_entry *sk_idx_get(const sk_idx *idx, const char *name)
+{
+    uint32_t hash = _sk_idx_hash(name);
+    uint64_t off = _sk_buckets(idx)[hash % _sk_hdr(idx)->buckets];
+
+    while (off) {
+        sk_idx_entry *entry = _sk_entry(idx, off);
+
+        if (entry->hash == hash && strcmp(sk_idx_name(entry), name) == 0) {
+            return (entry);
+        }
+        off = entry->next;
+    }
+
+    return (NULL);
+}
+
+/* Add or update a file */
+int sk_idx_put(sk_idx *idx, const char *name, const char *marks,
+               const char *sum, time_t change_time, uint64_t log_pos)
+{
+    sk_idx_entry *entry;
+
+    entry = sk_idx_get(idx, name);
+
+    /* Update in place if the checksum fits */
+    if (entry && strlen(sum) < entry->sum_size) {
+        strncpy(entry->marks, marks, 3);
+        strncpy(sk_idx_sum(entry), sum, entry->sum_size);
+        entry->time = (int64_t)change_time;
+        entry->log_pos = log_pos;
+        return (0);
+    }
+
+    if (_sk_idx_add(idx, _sk_idx_hash(name), name, marks, sum, (int64_t)change_time, log_pos,
+                    entry ? (uint64_t)((char *)entry - idx->map) : 0) < 0) {
+        return (-1);
+    }
+
+    if (_sk_hdr(idx)->entries > (uint64_t)_sk_hdr(idx)->buckets * 2) {
+        return (_sk_idx_rehash(idx));
+    }
+
+    return (0);
+}
+
+/* Build the index of a log from scratch */
+int sk_idx_import(const char *log_path)
+{
+    char path[PATH_MAX + 1];
+    sk_idx *idx;
+
+    sk_idx_path(log_path, path, PATH_MAX);
+
+    idx = _sk_idx_build(log_path, path);
+    if (!idx) {
+        return (-1);
+    }
+
+    sk_idx_close(idx);
+    return (0);
+}
+
+/* Set the marks of a file in the index there is, in place */
+int sk_idx_mark(const char *log_path, const char *name, const char *marks)
+{
+    char path[PATH_MAX + 1];
+    sk_idx *idx;
+    sk_idx_entry *entry;
+
+    sk_idx_path(log_path, path, PATH_MAX);
+
+    /* Without an index, it is built from the log when opened */
+    idx = _sk_idx_load(path, log_path);
+    if (!idx) {
+        return (0);
+    }
+
+    entry = sk_idx_get(idx, name);
+    if (entry) {
+        strncpy(entry->marks, marks, 3);
+    }
+
+    sk_idx_close(idx);
+    return (entry ? 1 : 0);
+}
+
+#endif /* !WIN32 */
@@ -27,8 +27,6 @@ static int __counter = 0;
 /* Read and generate the integrity data of a file */
 static int read_file(const char *file_name, int opts, OSMatch *restriction)
 {
-    char *buf;
-    char sha1s = '+';
     struct stat statbuf;
 
     /* Check if the file should be ignored */
@@ -105,17 +103,54 @@ static int read_file(const char *file_name, int opts, OSMatch *restriction)
     if (S_ISREG(statbuf.st_mode) || S_ISLNK(statbuf.st_mode))
 #endif
     {
-        os_md5 mf_sum;
-        os_sha1 sf_sum;
-        os_sha1 sf_sum2;
-        os_sha1 sf_sum3;
+        scan_file(file_name, opts, &statbuf);
+
+        /* Sleep here too (unless the reads are limited) */
+        if (!syscheck.scan_kbytes && !syscheck.scan_iops) {
+            if (__counter >= (syscheck.sleep_after)) {
+                sleep(syscheck.tsleep);
+                __counter = 0;
+            }
+            __counter++;
+        }
 
-        /* Clean sums */
-        strncpy(mf_sum,  "xxx", 4);
-        strncpy(sf_sum,  "xxx", 4);
-        strncpy(sf_sum2, "xxx", 4);
-        strncpy(sf_sum3, "xxx", 4);
+#ifdef DEBUG
+        verbose("%s: file '%s'", ARGV0, file_name);
+#endif
+    } else {
+#ifdef DEBUG
+        verbose("%s: *** IRREG file: '%s'\n", ARGV0, file_name);
+#endif
+    }
+
+    return (0);
+}
 
+/* Check a file against the database (adding it if new) */
+int c_check_file(const char *file_name, int opts, const struct stat *file_stat)
+{
+    char *buf;
+    char sha1s = '+';
+    struct stat statbuf = *file_stat;
+    os_md5 mf_sum;
+    os_sha1 sf_sum;
+    os_sha1 sf_sum2;
+    os_sha1 sf_sum3;
+
+    /* Clean sums */
+    strncpy(mf_sum,  "xxx", 4);
+    strncpy(sf_sum,  "xxx", 4);
+    strncpy(sf_sum2, "xxx", 4);
+    strncpy(sf_sum3, "xxx", 4);
+
+    /* The stat of the walk */
+    scan_throttle(0);
+
+    syscheck_db_lock();
+    buf = (char *) OSHash_Get(syscheck.fp, file_name);
+    syscheck_db_unlock();
+
+    if (!buf) {
         /* Generate checksums */
         if ((opts & CHECK_MD5SUM) || (opts & CHECK_SHA1SUM)) {
             /* If it is a link, check if dest is valid */
@@ -124,15 +159,15 @@ static int read_file(const char *file_name, int opts, OSMatch *restriction)
                 struct stat statbuf_lnk;
                 if (stat(file_name, &statbuf_lnk) == 0) {
                     if (S_ISREG(statbuf_lnk.st_mode)) {
-                        if (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, mf_sum, sf_sum, OS_BINARY) < 0) {
+                        if (c_file_sums(file_name, &statbuf_lnk, mf_sum, sf_sum) < 0) {
                             strncpy(mf_sum, "xxx", 4);
                             strncpy(sf_sum, "xxx", 4);
                         }
                     }
                 }
-            } else if (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, mf_sum, sf_sum, OS_BINARY) < 0)
+            } else if (c_file_sums(file_name, &statbuf, mf_sum, sf_sum) < 0)
 #else
-            if (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, mf_sum, sf_sum, OS_BINARY) < 0)
+            if (c_file_sums(file_name, &statbuf, mf_sum, sf_sum) < 0)
 #endif
             {
                 strncpy(mf_sum, "xxx", 4);
@@ -150,149 +185,137 @@ static int read_file(const char *file_name, int opts, OSMatch *restriction)
             }
         }
 
-        buf = (char *) OSHash_Get(syscheck.fp, file_name);
-        if (!buf) {
-            char alert_msg[916 + 1];    /* to accommodate a long */
-            alert_msg[916] = '\0';
+        char alert_msg[916 + 1];    /* to accommodate a long */
+        alert_msg[916] = '\0';
+
+        syscheck_db_lock();
 
 #ifndef WIN32
-            if (opts & CHECK_SEECHANGES) {
-                char *alertdump = seechanges_addfile(file_name);
-                if (alertdump) {
-                    free(alertdump);
-                    alertdump = NULL;
-                }
+        if (opts & CHECK_SEECHANGES) {
+            char *alertdump = seechanges_addfile(file_name);
+            if (alertdump) {
+                free(alertdump);
+                alertdump = NULL;
             }
+        }
 #endif
 
-            snprintf(alert_msg, 916, "%c%c%c%c%c%c%ld:%d:%d:%d:%s:%s",
-                     opts & CHECK_SIZE ? '+' : '-',
-                     opts & CHECK_PERM ? '+' : '-',
-                     opts & CHECK_OWNER ? '+' : '-',
-                     opts & CHECK_GROUP ? '+' : '-',
-                     opts & CHECK_MD5SUM ? '+' : '-',
-                     sha1s,
-                     opts & CHECK_SIZE ? (long)statbuf.st_size : 0,
-                     opts & CHECK_PERM ? (int)statbuf.st_mode : 0,
-                     opts & CHECK_OWNER ? (int)statbuf.st_uid : 0,
-                     opts & CHECK_GROUP ? (int)statbuf.st_gid : 0,
-                     opts & CHECK_MD5SUM ? mf_sum : "xxx",
-                     opts & CHECK_SHA1SUM ? sf_sum : "xxx");
-
-            if (OSHash_Add(syscheck.fp, file_name, strdup(alert_msg)) <= 0) {
-                merror("%s: ERROR: Unable to add file to db: %s", ARGV0, file_name);
-            }
+        snprintf(alert_msg, 916, "%c%c%c%c%c%c%ld:%d:%d:%d:%s:%s",
+                 opts & CHECK_SIZE ? '+' : '-',
+                 opts & CHECK_PERM ? '+' : '-',
+                 opts & CHECK_OWNER ? '+' : '-',
+                 opts & CHECK_GROUP ? '+' : '-',
+                 opts & CHECK_MD5SUM ? '+' : '-',
+                 sha1s,
+                 opts & CHECK_SIZE ? (long)statbuf.st_size : 0,
+                 opts & CHECK_PERM ? (int)statbuf.st_mode : 0,
+                 opts & CHECK_OWNER ? (int)statbuf.st_uid : 0,
+                 opts & CHECK_GROUP ? (int)statbuf.st_gid : 0,
+                 opts & CHECK_MD5SUM ? mf_sum : "xxx",
+                 opts & CHECK_SHA1SUM ? sf_sum : "xxx");
+
+        if (OSHash_Add(syscheck.fp, file_name, strdup(alert_msg)) <= 0) {
+            merror("%s: ERROR: Unable to add file to db: %s", ARGV0, file_name);
+        }
 
-            /* Send the new checksum to the analysis server */
-            alert_msg[916] = '\0';
+        syscheck_db_unlock();
+
+        /* Send the new checksum to the analysis server */
+        alert_msg[916] = '\0';
 
 #ifndef WIN32
-            snprintf(alert_msg, 916, "%ld:%d:%d:%d:%s:%s %s",
-                     opts & CHECK_SIZE ? (long)statbuf.st_size : 0,
-                     opts & CHECK_PERM ? (int)statbuf.st_mode : 0,
-                     opts & CHECK_OWNER ? (int)statbuf.st_uid : 0,
-                     opts & CHECK_GROUP ? (int)statbuf.st_gid : 0,
-                     opts & CHECK_MD5SUM ? mf_sum : "xxx",
-                     opts & CHECK_SHA1SUM ? sf_sum : "xxx",
-                     file_name);
+        snprintf(alert_msg, 916, "%ld:%d:%d:%d:%s:%s %s",
+                 opts & CHECK_SIZE ? (long)statbuf.st_size : 0,
+                 opts & CHECK_PERM ? (int)statbuf.st_mode : 0,
+                 opts & CHECK_OWNER ? (int)statbuf.st_uid : 0,
+                 opts & CHECK_GROUP ? (int)statbuf.st_gid : 0,
+                 opts & CHECK_MD5SUM ? mf_sum : "xxx",
+                 opts & CHECK_SHA1SUM ? sf_sum : "xxx",
+                 file_name);
 #else
 
-            HANDLE hFile = CreateFile(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-            if (hFile == INVALID_HANDLE_VALUE) {
-                DWORD dwErrorCode = GetLastError();
-                char alert_msg[PATH_MAX+4];
-                alert_msg[PATH_MAX + 3] = '\0';
-                snprintf(alert_msg, PATH_MAX + 4, "CreateFile=%ld %s", dwErrorCode, file_name);
-                send_syscheck_msg(alert_msg);
-                return -1;
-            }
-
-            PSID pSidOwner = NULL;
-            PSECURITY_DESCRIPTOR pSD = NULL;
-            DWORD dwRtnCode = GetSecurityInfo(hFile, SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION, &pSidOwner, NULL, NULL, NULL, &pSD);
-            if (dwRtnCode != ERROR_SUCCESS) {
-                DWORD dwErrorCode = GetLastError();
-                CloseHandle(hFile);
-                char alert_msg[PATH_MAX+4];
-                alert_msg[PATH_MAX + 3] = '\0';
-                snprintf(alert_msg, PATH_MAX + 4, "GetSecurityInfo=%ld %s", dwErrorCode, file_name);
-                send_syscheck_msg(alert_msg);
-                return -1;
-            }
+        HANDLE hFile = CreateFile(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            DWORD dwErrorCode = GetLastError();
+            char alert_msg[PATH_MAX+4];
+            alert_msg[PATH_MAX + 3] = '\0';
+            snprintf(alert_msg, PATH_MAX + 4, "CreateFile=%ld %s", dwErrorCode, file_name);
+            send_syscheck_msg(alert_msg);
+            return -1;
+        }
 
-            LPSTR szSID = NULL;
-            ConvertSidToStringSid(pSidOwner, &szSID);
-            char* st_uid = NULL;
-            if(szSID) {
-              st_uid = (char *) calloc(strlen(szSID) + 1, 1);
-              memcpy(st_uid, szSID, strlen(szSID));
-            }
-            LocalFree(szSID);
+        PSID pSidOwner = NULL;
+        PSECURITY_DESCRIPTOR pSD = NULL;
+        DWORD dwRtnCode = GetSecurityInfo(hFile, SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION, &pSidOwner, NULL, NULL, NULL, &pSD);
+        if (dwRtnCode != ERROR_SUCCESS) {
+            DWORD dwErrorCode = GetLastError();
             CloseHandle(hFile);
-    
-            snprintf(alert_msg, 916, "%ld:%d:%s:%d:%s:%s %s",
-                     opts & CHECK_SIZE ? (long)statbuf.st_size : 0,
-                     opts & CHECK_PERM ? (int)statbuf.st_mode : 0,
-                     (opts & CHECK_OWNER) ? st_uid : "0",
-                     opts & CHECK_GROUP ? (int)statbuf.st_gid : 0,
-                     opts & CHECK_MD5SUM ? mf_sum : "xxx",
-                     opts & CHECK_SHA1SUM ? sf_sum : "xxx",
-                     file_name);
-            free(st_uid);
-#endif
+            char alert_msg[PATH_MAX+4];
+            alert_msg[PATH_MAX + 3] = '\0';
+            snprintf(alert_msg, PATH_MAX + 4, "GetSecurityInfo=%ld %s", dwErrorCode, file_name);
             send_syscheck_msg(alert_msg);
-        } else {
-            char alert_msg[OS_MAXSTR + 1];
-            char c_sum[256 + 2];
+            return -1;
+        }
 
-            c_sum[0] = '\0';
-            c_sum[256] = '\0';
-            alert_msg[0] = '\0';
-            alert_msg[OS_MAXSTR] = '\0';
+        LPSTR szSID = NULL;
+        ConvertSidToStringSid(pSidOwner, &szSID);
+        char* st_uid = NULL;
+        if(szSID) {
+          st_uid = (char *) calloc(strlen(szSID) + 1, 1);
+          memcpy(st_uid, szSID, strlen(szSID));
+        }
+        LocalFree(szSID);
+        CloseHandle(hFile);
+
+        snprintf(alert_msg, 916, "%ld:%d:%s:%d:%s:%s %s",
+                 opts & CHECK_SIZE ? (long)statbuf.st_size : 0,
+                 opts & CHECK_PERM ? (int)statbuf.st_mode : 0,
+                 (opts & CHECK_OWNER) ? st_uid : "0",
+                 opts & CHECK_GROUP ? (int)statbuf.st_gid : 0,
+                 opts & CHECK_MD5SUM ? mf_sum : "xxx",
+                 opts & CHECK_SHA1SUM ? sf_sum : "xxx",
+                 file_name);
+        free(st_uid);
+#endif
+        send_syscheck_msg(alert_msg);
+    } else {
+        char alert_msg[OS_MAXSTR + 1];
+        char c_sum[256 + 2];
 
-            /* If it returns < 0, we have already alerted */
-            if (c_read_file(file_name, buf, c_sum) < 0) {
-                return (0);
-            }
+        c_sum[0] = '\0';
+        c_sum[256] = '\0';
+        alert_msg[0] = '\0';
+        alert_msg[OS_MAXSTR] = '\0';
 
-            if (strcmp(c_sum, buf + 6) != 0) {
-                /* Send the new checksum to the analysis server */
-                alert_msg[OS_MAXSTR] = '\0';
-                #ifdef WIN32
-                snprintf(alert_msg, 916, "%s %s", c_sum, file_name);
-                #else
-                char *fullalert = NULL;
-                if (buf[5] == 's' || buf[5] == 'n') {
-                    fullalert = seechanges_addfile(file_name);
-                    if (fullalert) {
-                        snprintf(alert_msg, OS_MAXSTR, "%s %s\n%s", c_sum, file_name, fullalert);
-                        free(fullalert);
-                        fullalert = NULL;
-                    } else {
-                        snprintf(alert_msg, 916, "%s %s", c_sum, file_name);
-                    }
+        /* If it returns < 0, we have already alerted */
+        if (c_read_file(file_name, buf, c_sum) < 0) {
+            return (0);
+        }
+
+        if (strcmp(c_sum, buf + 6) != 0) {
+            /* Send the new checksum to the analysis server */
+            alert_msg[OS_MAXSTR] = '\0';
+            #ifdef WIN32
+            snprintf(alert_msg, 916, "%s %s", c_sum, file_name);
+            #else
+            char *fullalert = NULL;
+            if (buf[5] == 's' || buf[5] == 'n') {
+                syscheck_db_lock();
+                fullalert = seechanges_addfile(file_name);
+                syscheck_db_unlock();
+                if (fullalert) {
+                    snprintf(alert_msg, OS_MAXSTR, "%s %s\n%s", c_sum, file_name, fullalert);
+                    free(fullalert);
+                    fullalert = NULL;
                 } else {
                     snprintf(alert_msg, 916, "%s %s", c_sum, file_name);
                 }
-                #endif
-                send_syscheck_msg(alert_msg);
+            } else {
+                snprintf(alert_msg, 916, "%s %s", c_sum, file_name);
             }
+            #endif
+            send_syscheck_msg(alert_msg);
         }
-
-        /* Sleep here too */
-        if (__counter >= (syscheck.sleep_after)) {
-            sleep(syscheck.tsleep);
-            __counter = 0;
-        }
-        __counter++;
-
-#ifdef DEBUG
-        verbose("%s: file '%s %s'", ARGV0, file_name, mf_sum);
-#endif
-    } else {
-#ifdef DEBUG
-        verbose("%s: *** IRREG file: '%s'\n", ARGV0, file_name);
-#endif
     }
 
     return (0);
@@ -428,10 +451,13 @@ int run_dbcheck()
     int i = 0;
 
     __counter = 0;
+    scan_begin();
     while (syscheck.dir[i] != NULL) {
         read_dir(syscheck.dir[i], syscheck.opts[i], syscheck.filerestrict[i]);
         i++;
     }
+    scan_end();
+    sum_cache_save();
 
     return (0);
 }
@@ -461,12 +487,15 @@ int create_db()
 
     /* Read all available directories */
     __counter = 0;
+    scan_begin();
     do {
         if (read_dir(syscheck.dir[i], syscheck.opts[i], syscheck.filerestrict[i]) == 0) {
             debug2("%s: Directory loaded from syscheck db: %s", ARGV0, syscheck.dir[i]);
         }
         i++;
     } while (syscheck.dir[i] != NULL);
+    scan_end();
+    sum_cache_save();
 
 #if defined (INOTIFY_ENABLED) || defined (WIN32)
     if (syscheck.realtime && (syscheck.realtime->fd >= 0)) {
@@ -12,6 +12,9 @@
 #define _GNU_SOURCE
 #include <sched.h>
 #endif
+#ifndef WIN32
+#include <pthread.h>
+#endif
 #ifdef WIN32
 #include <winsock2.h>
 #include <aclapi.h>
@@ -28,10 +31,19 @@
 /* Prototypes */
 static void send_sk_db(void);
 
+/* The scan and realtime workers send messages too */
+#ifndef WIN32
+static pthread_mutex_t send_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 
 /* Send a message related to syscheck change/addition */
 int send_syscheck_msg(const char *msg)
 {
+#ifndef WIN32
+    pthread_mutex_lock(&send_mutex);
+#endif
+
     if (SendMSG(syscheck.queue, msg, SYSCHECK, SYSCHECK_MQ) < 0) {
         merror(QUEUE_SEND, ARGV0);
 
@@ -42,12 +54,20 @@ int send_syscheck_msg(const char *msg)
         /* Try to send it again */
         SendMSG(syscheck.queue, msg, SYSCHECK, SYSCHECK_MQ);
     }
+
+#ifndef WIN32
+    pthread_mutex_unlock(&send_mutex);
+#endif
     return (0);
 }
 
 /* Send a message related to rootcheck change/addition */
 int send_rootcheck_msg(const char *msg)
 {
+#ifndef WIN32
+    pthread_mutex_lock(&send_mutex);
+#endif
+
     if (SendMSG(syscheck.queue, msg, ROOTCHECK, ROOTCHECK_MQ) < 0) {
         merror(QUEUE_SEND, ARGV0);
 
@@ -58,6 +78,10 @@ int send_rootcheck_msg(const char *msg)
         /* Try to send it again */
         SendMSG(syscheck.queue, msg, ROOTCHECK, ROOTCHECK_MQ);
     }
+
+#ifndef WIN32
+    pthread_mutex_unlock(&send_mutex);
+#endif
     return (0);
 }
 
@@ -241,6 +265,12 @@ void start_daemon()
 
         /* If time elapsed is higher than the syscheck time, run syscheck time */
         if (((curr_time - prev_time_sk) > syscheck.time) || run_now) {
+#ifdef INOTIFY_ENABLED
+            /* The scan uses the database without the realtime lock */
+            if (syscheck.realtime && (syscheck.realtime->fd >= 0)) {
+                realtime_drain();
+            }
+#endif
             if (syscheck.scan_on_start == 0) {
                 /* Need to create the db if scan on start is not set */
                 sleep(syscheck.tsleep * 10);
@@ -278,8 +308,16 @@ void start_daemon()
 
 #ifdef INOTIFY_ENABLED
         if (syscheck.realtime && (syscheck.realtime->fd >= 0)) {
-            selecttime.tv_sec = SYSCHECK_WAIT;
-            selecttime.tv_usec = 0;
+            int next = realtime_dispatch();
+
+            /* Wake up when the next change is due */
+            if (next >= 0 && next < SYSCHECK_WAIT * 1000) {
+                selecttime.tv_sec = next / 1000;
+                selecttime.tv_usec = (next % 1000) * 1000;
+            } else {
+                selecttime.tv_sec = SYSCHECK_WAIT;
+                selecttime.tv_usec = 0;
+            }
 
             /* zero-out the fd_set */
             FD_ZERO (&rfds);
@@ -386,7 +424,7 @@ int c_read_file(const char *file_name, const char *oldsum, char *newsum)
     {
         if (sha1sum || md5sum) {
             /* Generate checksums of the file */
-            if (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, mf_sum, sf_sum, OS_BINARY) < 0) {
+            if (c_file_sums(file_name, &statbuf, mf_sum, sf_sum) < 0) {
                 strncpy(sf_sum, "xxx", 4);
                 strncpy(mf_sum, "xxx", 4);
             }
@@ -400,7 +438,7 @@ int c_read_file(const char *file_name, const char *oldsum, char *newsum)
             if (S_ISREG(statbuf_lnk.st_mode)) {
                 if (sha1sum || md5sum) {
                     /* Generate checksums of the file */
-                    if (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, mf_sum, sf_sum, OS_BINARY) < 0) {
+                    if (c_file_sums(file_name, &statbuf_lnk, mf_sum, sf_sum) < 0) {
                         strncpy(sf_sum, "xxx", 4);
                         strncpy(mf_sum, "xxx", 4);
                     }
@@ -21,6 +21,9 @@
 
 #ifdef INOTIFY_ENABLED
 #include <sys/inotify.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include "pthreads_op.h"
 #define OS_SIZE_6144    6144
 #define OS_MAXSTR       OS_SIZE_6144    /* Size for logs, sockets, etc */
 #else
@@ -42,7 +45,11 @@ int realtime_checksumfile(const char *file_name)
 {
     char *buf;
 
+    syscheck_db_lock();
     buf = (char *) OSHash_Get(syscheck.fp, file_name);
+    syscheck_db_unlock();
+
+    /* The entries are never changed once added */
     if (buf != NULL) {
         char c_sum[256 + 2];
 
@@ -59,6 +66,8 @@ int realtime_checksumfile(const char *file_name)
 
             alert_msg[OS_MAXSTR] = '\0';
 
+            syscheck_db_lock();
+
             #ifdef WIN32
             snprintf(alert_msg, 912, "%s %s", c_sum, file_name);
             #else
@@ -79,6 +88,7 @@ int realtime_checksumfile(const char *file_name)
             #endif
             send_syscheck_msg(alert_msg);
 
+            syscheck_db_unlock();
             return (1);
         }
         return (0);
@@ -119,9 +129,174 @@ int realtime_checksumfile(const char *file_name)
 #define REALTIME_EVENT_SIZE     (sizeof (struct inotify_event))
 #define REALTIME_EVENT_BUFFER   (2048 * (REALTIME_EVENT_SIZE + 16))
 
+/* Changes waiting for the files to be quiet, oldest event first
+ * (by path). Only used by the main thread.
+ */
+typedef struct _rt_pending {
+    char *path;                     /* NULL to rescan the realtime dirs */
+    long last;                      /* Time of the last event (ms) */
+    struct _rt_pending *prev;
+    struct _rt_pending *next;
+} rt_pending;
+
+static OSHash *rt_pendtb = NULL;
+static rt_pending *rt_pend_first = NULL;
+static rt_pending *rt_pend_last = NULL;
+
+/* Changes ready to be checked by the workers */
+static rt_pending *rt_queue_first = NULL;
+static rt_pending *rt_queue_last = NULL;
+static int rt_busy = 0;
+static int rt_rescan_queued = 0;
+static pthread_mutex_t rt_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rt_queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t rt_idle_cond = PTHREAD_COND_INITIALIZER;
+
+static long rt_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long)tv.tv_sec * 1000 + (long)tv.tv_usec / 1000);
+}
+
+/* Rescan the realtime directories (events were lost) */
+static void rt_rescan(void)
+{
+    int i;
+
+    for (i = 0; syscheck.dir[i]; i++) {
+        if (syscheck.opts[i] & CHECK_REALTIME) {
+            debug1("%s: DEBUG: Rescanning '%s' (real time events lost).",
+                   ARGV0, syscheck.dir[i]);
+            read_dir(syscheck.dir[i], syscheck.opts[i], syscheck.filerestrict[i]);
+        }
+    }
+}
+
+/* Add a change to the queue of the workers */
+static void rt_enqueue(rt_pending *entry)
+{
+    pthread_mutex_lock(&rt_queue_mutex);
+
+    if (!entry->path) {
+        /* A rescan is already waiting */
+        if (rt_rescan_queued) {
+            pthread_mutex_unlock(&rt_queue_mutex);
+            free(entry);
+            return;
+        }
+        rt_rescan_queued = 1;
+    }
+
+    entry->next = NULL;
+    entry->prev = rt_queue_last;
+    if (rt_queue_last) {
+        rt_queue_last->next = entry;
+    } else {
+        rt_queue_first = entry;
+    }
+    rt_queue_last = entry;
+
+    pthread_cond_signal(&rt_queue_cond);
+    pthread_mutex_unlock(&rt_queue_mutex);
+}
+
+/* Worker checking the files changed */
+static void *rt_worker(__attribute__((unused)) void *arg)
+{
+    rt_pending *entry;
+
+    while (1) {
+        pthread_mutex_lock(&rt_queue_mutex);
+
+        while (!rt_queue_first) {
+            pthread_cond_wait(&rt_queue_cond, &rt_queue_mutex);
+        }
+
+        entry = rt_queue_first;
+        rt_queue_first = entry->next;
+        if (!rt_queue_first) {
+            rt_queue_last = NULL;
+        }
+
+        if (!entry->path) {
+            rt_rescan_queued = 0;
+        }
+
+        rt_busy++;
+        pthread_mutex_unlock(&rt_queue_mutex);
+
+        if (entry->path) {
+            realtime_checksumfile(entry->path);
+            free(entry->path);
+        } else {
+            rt_rescan();
+        }
+        free(entry);
+
+        pthread_mutex_lock(&rt_queue_mutex);
+        rt_busy--;
+        if (!rt_busy && !rt_queue_first) {
+            pthread_cond_broadcast(&rt_idle_cond);
+        }
+        pthread_mutex_unlock(&rt_queue_mutex);
+    }
+
+    return (NULL);
+}
+
+/* Record an event of a file. Repeated events of the same file are
+ * coalesced, and the file is only checked once quiet.
+ */
+static void rt_schedule(const char *path)
+{
+    rt_pending *entry;
+
+    entry = (rt_pending *) OSHash_Get(rt_pendtb, path);
+    if (entry) {
+        /* Move it to the end */
+        if (entry->prev) {
+            entry->prev->next = entry->next;
+        } else {
+            rt_pend_first = entry->next;
+        }
+        if (entry->next) {
+            entry->next->prev = entry->prev;
+        } else {
+            rt_pend_last = entry->prev;
+        }
+    } else {
+        entry = (rt_pending *) calloc(1, sizeof(rt_pending));
+        if (!entry || !(entry->path = strdup(path))) {
+            ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+        }
+
+        if (OSHash_Add(rt_pendtb, entry->path, entry) != 2) {
+            merror("%s: ERROR: Unable to add file to the real time queue: %s",
+                   ARGV0, path);
+            free(entry->path);
+            free(entry);
+            return;
+        }
+    }
+
+    entry->last = rt_now();
+    entry->next = NULL;
+    entry->prev = rt_pend_last;
+    if (rt_pend_last) {
+        rt_pend_last->next = entry;
+    } else {
+        rt_pend_first = entry;
+    }
+    rt_pend_last = entry;
+}
+
 /* Start real time monitoring using inotify */
 int realtime_start()
 {
+    int i;
+
     verbose("%s: INFO: Initializing real time file monitoring (not started).", ARGV0);
 
     syscheck.realtime = (rtfim *) calloc(1, sizeof(rtfim));
@@ -139,6 +314,17 @@ int realtime_start()
     }
 #endif
 
+    rt_pendtb = OSHash_Create();
+    if (!rt_pendtb) {
+        ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+    }
+
+    for (i = 0; i < syscheck.rt_workers; i++) {
+        if (CreateThread(rt_worker, NULL) != 0) {
+            ErrorExit(THREAD_ERROR, ARGV0);
+        }
+    }
+
     return (1);
 }
 
@@ -178,6 +364,7 @@ int realtime_adddir(const char *dir)
             snprintf(wdchar, 32, "%d", wd);
 
             /* Entry not present */
+            syscheck_db_lock();
             if (!OSHash_Get(syscheck.realtime->dirtb, wdchar)) {
                 char *ndir;
 
@@ -190,6 +377,7 @@ int realtime_adddir(const char *dir)
                 debug1("%s: DEBUG: Directory added for real time monitoring: "
                        "'%s'.", ARGV0, ndir);
             }
+            syscheck_db_unlock();
         }
     }
 
@@ -214,24 +402,40 @@ int realtime_process()
         while (i < (size_t) len) {
             event = (struct inotify_event *) (void *) &buf[i];
 
-            if (event->len) {
+            if (event->mask & IN_Q_OVERFLOW) {
+                rt_pending *entry;
+
+                merror("%s: WARN: Real time event queue overflow. "
+                       "Rescanning the real time directories.", ARGV0);
+
+                entry = (rt_pending *) calloc(1, sizeof(rt_pending));
+                if (!entry) {
+                    ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+                }
+                rt_enqueue(entry);
+            } else if (event->len) {
                 char wdchar[32 + 1];
                 char final_name[MAX_LINE + 1];
+                const char *dir;
 
                 wdchar[32] = '\0';
                 final_name[MAX_LINE] = '\0';
 
                 snprintf(wdchar, 32, "%d", event->wd);
 
-                snprintf(final_name, MAX_LINE, "%s/%s",
-                         (char *)OSHash_Get(syscheck.realtime->dirtb, wdchar),
-                         event->name);
-		/* Need a sleep here to avoid triggering on vim edits
-  		 * (and finding the file removed)
-  		 */
-		sleep(1);
+                syscheck_db_lock();
+                dir = (const char *)OSHash_Get(syscheck.realtime->dirtb, wdchar);
+                if (dir) {
+                    snprintf(final_name, MAX_LINE, "%s/%s", dir, event->name);
+                }
+                syscheck_db_unlock();
 
-                realtime_checksumfile(final_name);
+                /* Checked once the file is quiet, to avoid triggering
+                 * on vim edits (and finding the file removed)
+                 */
+                if (dir) {
+                    rt_schedule(final_name);
+                }
             }
 
             i += REALTIME_EVENT_SIZE + event->len;
@@ -241,6 +445,54 @@ int realtime_process()
     return (0);
 }
 
+/* Hand the files quiet for rt_delay ms to the workers.
+ * Returns the ms until the next file is due, or -1 if none.
+ */
+int realtime_dispatch()
+{
+    rt_pending *entry;
+    long now;
+
+    if (!rt_pendtb) {
+        return (-1);
+    }
+
+    now = rt_now();
+
+    while ((entry = rt_pend_first)) {
+        long due = entry->last + syscheck.rt_delay;
+
+        /* The clock went back: do not wait any longer */
+        if (due > now && entry->last <= now) {
+            return ((int)(due - now));
+        }
+
+        rt_pend_first = entry->next;
+        if (rt_pend_first) {
+            rt_pend_first->prev = NULL;
+        } else {
+            rt_pend_last = NULL;
+        }
+
+        OSHash_Delete(rt_pendtb, entry->path);
+        rt_enqueue(entry);
+    }
+
+    return (-1);
+}
+
+/* Wait for the workers to check all the files handed to them */
+void realtime_drain()
+{
+    pthread_mutex_lock(&rt_queue_mutex);
+
+    while (rt_busy || rt_queue_first) {
+        pthread_cond_wait(&rt_idle_cond, &rt_queue_mutex);
+    }
+
+    pthread_mutex_unlock(&rt_queue_mutex);
+}
+
 #elif defined(WIN32)
 typedef struct _win32rtfim {
     HANDLE h;
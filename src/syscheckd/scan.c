@@ -0,0 +1,249 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Scan engine
+ *
+ * During a scan, the thread walking the directories hands each file to
+ * a pool of syscheck.scan_workers threads, which hash it and check it
+ * against the database. The reads of the scan can be limited in bytes
+ * (syscheck.scan_kbytes) and operations (syscheck.scan_iops) per second,
+ * instead of sleeping every sleep_after files.
+ *
+ * The database, the diffs and the realtime directories are shared with
+ * the realtime workers: they are only used with syscheck_db_lock() held.
+ */
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#include "shared.h"
+#include "syscheck.h"
+
+/* Files waiting for the workers (the walk waits above it) */
+#define SCAN_QUEUE_MAX  1024
+
+/* Bytes of each read of the hashing (an operation for the limit) */
+#define SCAN_READ_SIZE  65536
+
+/* Reads allowed in advance by the limit (seconds) */
+#define SCAN_BURST      1.0
+
+typedef struct _scan_job {
+    char *file;
+    int opts;
+    struct stat statbuf;
+    struct _scan_job *next;
+} scan_job;
+
+/* Time the reads are allowed until (by the limit of each kind) */
+static double scan_bytes_next = 0;
+static double scan_ops_next = 0;
+
+#ifndef WIN32
+static pthread_mutex_t db_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t throttle_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t scan_room_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t scan_idle_cond = PTHREAD_COND_INITIALIZER;
+
+static scan_job *scan_first = NULL;
+static scan_job *scan_last = NULL;
+static int scan_queued = 0;
+static int scan_busy = 0;
+static int scan_workers = 0;
+static int scan_active = 0;
+
+/* Worker hashing the files of the scan */
+static void *scan_worker(__attribute__((unused)) void *arg)
+{
+    scan_job *job;
+
+    while (1) {
+        pthread_mutex_lock(&scan_mutex);
+
+        while (!scan_first) {
+            pthread_cond_wait(&scan_work_cond, &scan_mutex);
+        }
+
+        job = scan_first;
+        scan_first = job->next;
+        if (!scan_first) {
+            scan_last = NULL;
+        }
+        scan_queued--;
+        scan_busy++;
+
+        pthread_cond_signal(&scan_room_cond);
+        pthread_mutex_unlock(&scan_mutex);
+
+        c_check_file(job->file, job->opts, &job->statbuf);
+        free(job->file);
+        free(job);
+
+        pthread_mutex_lock(&scan_mutex);
+        scan_busy--;
+        if (!scan_busy && !scan_first) {
+            pthread_cond_broadcast(&scan_idle_cond);
+        }
+        pthread_mutex_unlock(&scan_mutex);
+    }
+
+    return (NULL);
+}
+#endif
+
+static double scan_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((double)tv.tv_sec + (double)tv.tv_usec / 1000000.0);
+}
+
+/* Lock the database and the diffs */
+void syscheck_db_lock(void)
+{
+#ifndef WIN32
+    pthread_mutex_lock(&db_mutex);
+#endif
+}
+
+void syscheck_db_unlock(void)
+{
+#ifndef WIN32
+    pthread_mutex_unlock(&db_mutex);
+#endif
+}
+
+/* Start handing the files to the workers */
+void scan_begin(void)
+{
+#ifndef WIN32
+    while (scan_workers < syscheck.scan_workers) {
+        if (CreateThread(scan_worker, NULL) != 0) {
+            merror(THREAD_ERROR, ARGV0);
+            break;
+        }
+        scan_workers++;
+    }
+
+    scan_active = scan_workers > 0;
+#endif
+}
+
+/* Wait for the workers to check all the files of the scan */
+void scan_end(void)
+{
+#ifndef WIN32
+    pthread_mutex_lock(&scan_mutex);
+
+    while (scan_busy || scan_first) {
+        pthread_cond_wait(&scan_idle_cond, &scan_mutex);
+    }
+
+    pthread_mutex_unlock(&scan_mutex);
+    scan_active = 0;
+#endif
+}
+
+/* Check a file of the scan (by a worker, or right away if none) */
+int scan_file(const char *file_name, int opts, const struct stat *statbuf)
+{
+#ifndef WIN32
+    scan_job *job;
+
+    if (scan_active) {
+        os_calloc(1, sizeof(scan_job), job);
+        os_strdup(file_name, job->file);
+        job->opts = opts;
+        job->statbuf = *statbuf;
+
+        pthread_mutex_lock(&scan_mutex);
+
+        while (scan_queued >= SCAN_QUEUE_MAX) {
+            pthread_cond_wait(&scan_room_cond, &scan_mutex);
+        }
+
+        if (scan_last) {
+            scan_last->next = job;
+        } else {
+            scan_first = job;
+        }
+        scan_last = job;
+        scan_queued++;
+
+        pthread_cond_signal(&scan_work_cond);
+        pthread_mutex_unlock(&scan_mutex);
+        return (0);
+    }
+#endif
+
+    return (c_check_file(file_name, opts, statbuf));
+}
+
+/* Wait for the limits before reading a file (bytes is 0 if the file
+ * is only stat'ed: one operation)
+ */
+void scan_throttle(size_t bytes)
+{
+    double now;
+    double wait = 0;
+
+    if (!syscheck.scan_kbytes && !syscheck.scan_iops) {
+        return;
+    }
+
+#ifndef WIN32
+    pthread_mutex_lock(&throttle_mutex);
+#endif
+
+    now = scan_now();
+
+    if (syscheck.scan_kbytes) {
+        if (scan_bytes_next < now - SCAN_BURST) {
+            scan_bytes_next = now - SCAN_BURST;
+        }
+        scan_bytes_next += (double)bytes / (syscheck.scan_kbytes * 1024.0);
+
+        if (scan_bytes_next - now > wait) {
+            wait = scan_bytes_next - now;
+        }
+    }
+
+    if (syscheck.scan_iops) {
+        if (scan_ops_next < now - SCAN_BURST) {
+            scan_ops_next = now - SCAN_BURST;
+        }
+        scan_ops_next += (double)(bytes ? (bytes + SCAN_READ_SIZE - 1) / SCAN_READ_SIZE : 1) /
+                         syscheck.scan_iops;
+
+        if (scan_ops_next - now > wait) {
+            wait = scan_ops_next - now;
+        }
+    }
+
+#ifndef WIN32
+    pthread_mutex_unlock(&throttle_mutex);
+#endif
+
+    if (wait > 0) {
+#ifndef WIN32
+        struct timespec ts;
+
+        ts.tv_sec = (time_t)wait;
+        ts.tv_nsec = (long)((wait - (double)ts.tv_sec) * 1000000000.0);
+        nanosleep(&ts, NULL);
+#else
+        Sleep((DWORD)(wait * 1000));
+#endif
+    }
+}
@@ -0,0 +1,233 @@
+/* Copyright (C) 2009 Trend Micro Inc.
+ * All right reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation
+ */
+
+/* Cache of the sums of the files
+ *
+ * The MD5 and SHA1 of each file are kept with the device, inode, size,
+ * mtime and ctime of the file when it was hashed. While these do not
+ * change, the sums are taken from the cache instead of reading the file
+ * again, up to syscheck.cache_verify seconds. The cache is saved after
+ * each scan, so the first scan after a restart only reads the files
+ * changed meanwhile.
+ */
+
+#include "shared.h"
+#include "syscheck.h"
+#include "os_crypto/md5_sha1/md5_sha1_op.h"
+
+/* Rows of the cache table */
+#define SUM_CACHE_ROWS  65536
+
+typedef struct _sum_entry {
+    unsigned long long dev;
+    unsigned long long ino;
+    long long size;
+    long mtime;
+    long ctime;
+    long verified;              /* When the file was hashed */
+    unsigned int gen;           /* Last scan the file was seen in (0 if loaded) */
+    os_md5 md5;
+    os_sha1 sha1;
+} sum_entry;
+
+static OSHash *sum_cache = NULL;
+static unsigned int sum_gen = 1;
+
+/* Check if the sums of an entry are still valid for a file */
+static int sum_cache_valid(const sum_entry *entry, const struct stat *statbuf, time_t now)
+{
+    if (entry->dev != (unsigned long long)statbuf->st_dev ||
+            entry->ino != (unsigned long long)statbuf->st_ino ||
+            entry->size != (long long)statbuf->st_size ||
+            entry->mtime != (long)statbuf->st_mtime ||
+            entry->ctime != (long)statbuf->st_ctime) {
+        return (0);
+    }
+
+    /* Changed in the second it was hashed: the sums may be of the
+     * content before the change
+     */
+    if (entry->mtime >= entry->verified || entry->ctime >= entry->verified) {
+        return (0);
+    }
+
+    if (syscheck.cache_verify && now - entry->verified >= syscheck.cache_verify) {
+        return (0);
+    }
+
+    return (1);
+}
+
+/* Load the cache saved by a previous run */
+void sum_cache_init(void)
+{
+    FILE *fp;
+    char line[OS_MAXSTR + 1];
+
+    if (!syscheck.cache) {
+        return;
+    }
+
+    sum_cache = OSHash_Create();
+    if (!sum_cache || !OSHash_setSize(sum_cache, SUM_CACHE_ROWS)) {
+        ErrorExit(MEM_ERROR, ARGV0, errno, strerror(errno));
+    }
+
+    fp = fopen(SYSCHECK_CACHE_PATH, "r");
+    if (!fp) {
+        return;
+    }
+
+    while (fgets(line, OS_MAXSTR, fp)) {
+        sum_entry *entry;
+        int end = 0;
+        char *p;
+
+        if ((p = strchr(line, '\n'))) {
+            *p = '\0';
+        }
+
+        os_calloc(1, sizeof(sum_entry), entry);
+
+        if (sscanf(line, "%llu %llu %lld %ld %ld %ld %32s %40s %n",
+                   &entry->dev, &entry->ino, &entry->size, &entry->mtime,
+                   &entry->ctime, &entry->verified, entry->md5,
+                   entry->sha1, &end) != 8 || end == 0 || line[end] == '\0') {
+            merror("%s: WARN: Invalid entry in the sums cache: '%s'.", ARGV0, line);
+            free(entry);
+            continue;
+        }
+
+        if (OSHash_Add(sum_cache, line + end, entry) != 2) {
+            free(entry);
+        }
+    }
+
+    fclose(fp);
+}
+
+/* Write the cache to disk, without the files not seen since the
+ * last time (after a full scan)
+ */
+void sum_cache_save(void)
+{
+    char tmp_path[OS_FLSIZE + 1];
+    unsigned int i;
+    FILE *fp;
+
+    if (!sum_cache) {
+        return;
+    }
+
+    snprintf(tmp_path, OS_FLSIZE, "%s.tmp", SYSCHECK_CACHE_PATH);
+
+    fp = fopen(tmp_path, "w");
+    if (!fp) {
+        merror(FOPEN_ERROR, ARGV0, tmp_path, errno, strerror(errno));
+        return;
+    }
+
+    syscheck_db_lock();
+
+    for (i = 0; i < sum_cache->rows; i++) {
+        OSHashNode *node = sum_cache->table[i];
+
+        while (node) {
+            sum_entry *entry = (sum_entry *)node->data;
+            OSHashNode *next = node->next;
+
+            if (entry->gen != sum_gen) {
+                free(OSHash_Delete(sum_cache, node->key));
+            } else if (!strchr(node->key, '\n')) {
+                fprintf(fp, "%llu %llu %lld %ld %ld %ld %s %s %s\n",
+                        entry->dev, entry->ino, entry->size, entry->mtime,
+                        entry->ctime, entry->verified, entry->md5,
+                        entry->sha1, node->key);
+            }
+
+            node = next;
+        }
+    }
+
+    sum_gen++;
+
+    syscheck_db_unlock();
+
+    if (fclose(fp) != 0 || rename(tmp_path, SYSCHECK_CACHE_PATH) < 0) {
+        merror(RENAME_ERROR, ARGV0, tmp_path, SYSCHECK_CACHE_PATH,
+               errno, strerror(errno));
+        unlink(tmp_path);
+    }
+}
+
+/* Get the sums of a file (statbuf is the stat of its content),
+ * from the cache if the file did not change. Returns 0 on success
+ * or -1 on error, as OS_MD5_SHA1_File.
+ */
+int c_file_sums(const char *file_name, const struct stat *statbuf,
+                os_md5 md5output, os_sha1 sha1output)
+{
+    sum_entry *entry;
+    time_t now;
+
+    if (!sum_cache) {
+        scan_throttle((size_t)statbuf->st_size);
+        return (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, md5output,
+                                 sha1output, OS_BINARY));
+    }
+
+    now = time(0);
+
+    syscheck_db_lock();
+
+    entry = (sum_entry *)OSHash_Get(sum_cache, file_name);
+    if (entry && sum_cache_valid(entry, statbuf, now)) {
+        strncpy(md5output, entry->md5, sizeof(os_md5));
+        strncpy(sha1output, entry->sha1, sizeof(os_sha1));
+        entry->gen = sum_gen;
+
+        syscheck_db_unlock();
+        return (0);
+    }
+
+    syscheck_db_unlock();
+
+    scan_throttle((size_t)statbuf->st_size);
+    if (OS_MD5_SHA1_File(file_name, syscheck.prefilter_cmd, md5output,
+                         sha1output, OS_BINARY) < 0) {
+        return (-1);
+    }
+
+    syscheck_db_lock();
+
+    entry = (sum_entry *)OSHash_Get(sum_cache, file_name);
+    if (!entry) {
+        os_calloc(1, sizeof(sum_entry), entry);
+        if (OSHash_Add(sum_cache, file_name, entry) != 2) {
+            merror("%s: ERROR: Unable to add file to the sums cache: %s",
+                   ARGV0, file_name);
+            free(entry);
+            syscheck_db_unlock();
+            return (0);
+        }
+    }
+
+    entry->dev = (unsigned long long)statbuf->st_dev;
+    entry->ino = (unsigned long long)statbuf->st_ino;
+    entry->size = (long long)statbuf->st_size;
+    entry->mtime = (long)statbuf->st_mtime;
+    entry->ctime = (long)statbuf->st_ctime;
+    entry->verified = (long)now;
+    entry->gen = sum_gen;
+    strncpy(entry->md5, md5output, sizeof(os_md5));
+    strncpy(entry->sha1, sha1output, sizeof(os_sha1));
+
+    syscheck_db_unlock();
+    return (0);
+}
@@ -53,6 +53,17 @@ static void read_internal(int debug_level)
 {
     syscheck.tsleep = (unsigned int) getDefine_Int("syscheck", "sleep", 0, 64);
     syscheck.sleep_after = getDefine_Int("syscheck", "sleep_after", 1, 9999);
+    syscheck.scan_kbytes = getDefine_Int("syscheck", "scan_kbytes", 0, 4194304);
+    syscheck.scan_iops = getDefine_Int("syscheck", "scan_iops", 0, 1000000);
+    syscheck.cache = getDefine_Int("syscheck", "cache", 0, 1);
+    syscheck.cache_verify = getDefine_Int("syscheck", "cache_verify", 0, 2592000);
+#ifndef WIN32
+    syscheck.scan_workers = getDefine_Int("syscheck", "scan_workers", 0, 32);
+#endif
+#ifdef INOTIFY_ENABLED
+    syscheck.rt_delay = getDefine_Int("syscheck", "rt_delay", 0, 60000);
+    syscheck.rt_workers = getDefine_Int("syscheck", "rt_workers", 1, 32);
+#endif
 
     /* Check current debug_level
      * Command line setting takes precedence
@@ -153,6 +164,9 @@ int Start_win32_Syscheck()
     /* Start up message */
     verbose(STARTUP_MSG, ARGV0, getpid());
 
+    /* Sums of the files from the last run */
+    sum_cache_init();
+
     /* Some sync time */
     sleep(syscheck.tsleep + 10);
 
@@ -354,6 +368,9 @@ int main(int argc, char **argv)
         r++;
     }
 
+    /* Sums of the files from the last run */
+    sum_cache_init();
+
     /* Some sync time */
     sleep(syscheck.tsleep + 10);
 
@@ -10,7 +10,10 @@
 #ifndef __SYSCHECK_H
 #define __SYSCHECK_H
 
+#include <sys/stat.h>
 #include "config/syscheck-config.h"
+#include "os_crypto/md5/md5_op.h"
+#include "os_crypto/sha1/sha1_op.h"
 #define MAX_LINE PATH_MAX+256
 
 /* Notify list size */
@@ -39,6 +42,35 @@ int run_dbcheck(void);
 /* Scan directory */
 int read_dir(const char *dir_name, int opts, OSMatch *restriction);
 
+/* Check a file against the database (adding it if new) */
+int c_check_file(const char *file_name, int opts, const struct stat *file_stat) __attribute__((nonnull));
+
+/* Hand the files of a scan to the workers, until scan_end() */
+void scan_begin(void);
+
+/* Wait for the workers to check the files of the scan */
+void scan_end(void);
+
+/* Check a file of a scan */
+int scan_file(const char *file_name, int opts, const struct stat *statbuf) __attribute__((nonnull));
+
+/* Wait for the read limits of the scan */
+void scan_throttle(size_t bytes);
+
+/* Load the sums cache */
+void sum_cache_init(void);
+
+/* Save the sums cache (after a full scan) */
+void sum_cache_save(void);
+
+/* Get the sums of a file, from the cache if it did not change */
+int c_file_sums(const char *file_name, const struct stat *statbuf,
+                os_md5 md5output, os_sha1 sha1output) __attribute__((nonnull));
+
+/* Lock of the database, the diffs and the realtime directories */
+void syscheck_db_lock(void);
+void syscheck_db_unlock(void);
+
 
 /* Check the registry for changes */
 void os_winreg_check(void);
@@ -52,6 +84,12 @@ int realtime_adddir(const char *dir) __attribute__((nonnull));
 /* Process real time queue */
 int realtime_process(void);
 
+/* Check the real time changes that are due */
+int realtime_dispatch(void);
+
+/* Wait for the real time changes being checked */
+void realtime_drain(void);
+
 /* Process the content of the file changes */
 char *seechanges_addfile(const char *filename) __attribute__((nonnull));
 
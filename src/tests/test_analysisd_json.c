@@ -0,0 +1,306 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* JSON output of the alerts and archives, compared with the golden
+ * files in tests/json (the output of the previous cJSON serializer)
+ */
+
+#include <check.h>
+#include <stdlib.h>
+
+#include "../headers/shared.h"
+#include "../analysisd/eventinfo.h"
+#include "../analysisd/config.h"
+#include "../analysisd/format/to_json.h"
+
+#define JSON_GOLDEN_DIR "tests/json"
+
+/* Globals of analysisd used by the serializer */
+_Config Config;
+long int __crt_ftell;
+
+Suite *test_suite(void);
+
+static char *last_events[] = { "", "Sep 20 10:10:05 srv sshd[12]: Failed password for root", NULL };
+static char *sshd_fields[] = { "session", "key_type", NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+static char *sshd_values[] = { "5", "RSA \"SHA256\"", NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+static char *no_values[] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+
+static RuleInfo rule_sshd;
+static RuleInfo rule_syscheck;
+static RuleInfo rule_rootcheck;
+static RuleInfo rule_compliance;
+static RuleInfo rule_empty;
+static OSDecoderInfo dec_sshd;
+static OSDecoderInfo dec_plain;
+
+static void setup_rules(void)
+{
+    memset(&rule_sshd, 0, sizeof(RuleInfo));
+    rule_sshd.sigid = 5715;
+    rule_sshd.level = 3;
+    rule_sshd.comment = "SSHD authentication \"success\".";
+    rule_sshd.group = "syslog,sshd,authentication_success,";
+    rule_sshd.firedtimes = 7;
+    rule_sshd.last_events = last_events;
+
+    memset(&rule_syscheck, 0, sizeof(RuleInfo));
+    rule_syscheck.sigid = 550;
+    rule_syscheck.level = 7;
+    rule_syscheck.comment = "Integrity checksum changed.";
+    rule_syscheck.group = "ossec,syscheck,";
+    rule_syscheck.cve = "CVE-2016-0001";
+    rule_syscheck.info = "http://example.com/info?a=1&b=\\2";
+    rule_syscheck.frequency = 4;
+    rule_syscheck.firedtimes = 1;
+
+    memset(&rule_rootcheck, 0, sizeof(RuleInfo));
+    rule_rootcheck.sigid = 516;
+    rule_rootcheck.level = 3;
+    rule_rootcheck.comment = "System Audit event.";
+    rule_rootcheck.group = "ossec,rootcheck,";
+
+    /* The requirements follow the groups, in the order they first appear */
+    memset(&rule_compliance, 0, sizeof(RuleInfo));
+    rule_compliance.sigid = 100001;
+    rule_compliance.level = 10;
+    rule_compliance.group = "ossec,cis_1.2.3,pci_dss_10.2.4,rootcheck,pci_dss_11.5,";
+
+    memset(&rule_empty, 0, sizeof(RuleInfo));
+
+    memset(&dec_sshd, 0, sizeof(OSDecoderInfo));
+    dec_sshd.name = "sshd";
+    dec_sshd.parent = "sshd";
+    dec_sshd.fts = 1792;
+    dec_sshd.ftscomment = "First time user logged in.";
+    dec_sshd.fields = sshd_fields;
+
+    memset(&dec_plain, 0, sizeof(OSDecoderInfo));
+    dec_plain.name = "rootcheck";
+    dec_plain.accumulate = 1;
+}
+
+static void setup_event(Eventinfo *lf)
+{
+    memset(lf, 0, sizeof(Eventinfo));
+    lf->decoder_info = &dec_plain;
+    lf->fields = no_values;
+}
+
+/* Agent event decoded by a child decoder, with dynamic fields and
+ * characters to escape
+ */
+static void event_sshd(Eventinfo *lf)
+{
+    setup_event(lf);
+    lf->location = "(agent1) 10.0.0.1->/var/log/secure";
+    lf->hostname = lf->location;
+    lf->program_name = "sshd";
+    lf->log = "Accepted publickey for \"root\" from 10.0.0.9\tport 22\x01 ssh2 caf\xc3\xa9";
+    lf->full_log = "Sep 20 10:10:10 srv sshd[12]: Accepted publickey for \"root\" from 10.0.0.9\tport 22\x01 ssh2 caf\xc3\xa9";
+    lf->srcip = "10.0.0.9";
+    lf->srcport = "22";
+    lf->srcuser = "root";
+    lf->dstuser = "root\\admin";
+    lf->decoder_info = &dec_sshd;
+    lf->fields = sshd_values;
+    lf->time = 1474366210;
+    lf->year = 2016;
+    lf->day = 20;
+    strncpy(lf->mon, "Sep", sizeof(lf->mon));
+    strncpy(lf->hour, "10:10:10", 9);
+}
+
+/* Local event with the syscheck and the other decoded fields */
+static void event_syscheck(Eventinfo *lf)
+{
+    setup_event(lf);
+    lf->location = "syscheck";
+    lf->hostname = "srv";
+    lf->log = "Integrity checksum changed for: '/etc/passwd'";
+    lf->full_log = "Integrity checksum changed for: '/etc/passwd'\nSize changed from '10' to '12'\r";
+    lf->action = "modified";
+    lf->protocol = "tcp";
+    lf->dstip = "10.0.0.2";
+    lf->dstport = "443";
+    lf->id = "0x1f";
+    lf->status = "ok";
+    lf->command = "cat /etc/passwd";
+    lf->url = "/index.html?q=\"x\"";
+    lf->data = "\b\f/";
+    lf->systemname = "linux";
+    lf->filename = "/etc/passwd";
+    lf->md5_before = "d41d8cd98f00b204e9800998ecf8427e";
+    lf->md5_after = "0cc175b9c0f1b6a831c399e269772661";
+    lf->sha1_before = "da39a3ee5e6b4b0d3255bfef95601890afd80709";
+    lf->sha1_after = "da39a3ee5e6b4b0d3255bfef95601890afd80709";
+    lf->owner_before = "0";
+    lf->owner_after = "1000";
+    lf->gowner_before = "0";
+    lf->gowner_after = "0";
+    lf->perm_before = 0644;
+    lf->perm_after = 0600;
+    lf->time = 1474366211;
+    lf->year = 2016;
+    lf->day = 5;
+    strncpy(lf->mon, "Oct", sizeof(lf->mon));
+    strncpy(lf->hour, "01:02:03", 9);
+}
+
+/* Rootcheck event from an agent, with compliance requirements */
+static void event_rootcheck(Eventinfo *lf)
+{
+    setup_event(lf);
+    lf->location = "(agent2) 192.168.0.5->rootcheck";
+    lf->hostname = lf->location;
+    lf->log = "System Audit: CIS - RHEL7 - 1.4 - SELinux not enabled";
+    lf->full_log = "System Audit: CIS - RHEL7 - 1.4 - SELinux not enabled "
+                   "{CIS: 1.4.1 RHEL7, 1.4.2 RHEL7} {PCI_DSS: 2.2.4}. File: /etc/selinux/config.";
+    lf->time = 1474366212;
+    lf->year = 2016;
+    lf->day = 20;
+    strncpy(lf->mon, "Sep", sizeof(lf->mon));
+    strncpy(lf->hour, "10:10:12", 9);
+}
+
+/* Event with nothing but the location */
+static void event_minimal(Eventinfo *lf)
+{
+    setup_event(lf);
+    lf->location = "/var/log/messages";
+    lf->hostname = "(broken";
+    lf->full_log = "";
+}
+
+/* Compare a JSON string with a golden file */
+static void check_golden(const char *json, const char *name)
+{
+    char path[OS_FLSIZE + 1];
+    char golden[OS_MAXSTR];
+    size_t len;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s.json", JSON_GOLDEN_DIR, name);
+    fp = fopen(path, "r");
+    ck_assert_msg(fp != NULL, "Unable to open '%s'", path);
+
+    len = fread(golden, 1, sizeof(golden) - 1, fp);
+    fclose(fp);
+    golden[len] = '\0';
+
+    /* One line, with its newline */
+    ck_assert_int_gt(len, 0);
+    ck_assert_int_eq(golden[len - 1], '\n');
+    golden[len - 1] = '\0';
+
+    ck_assert_str_eq(json, golden);
+}
+
+static void check_alert(Eventinfo *lf, const char *name)
+{
+    char *json = Eventinfo_to_jsonstr(lf);
+
+    ck_assert_ptr_ne(json, NULL);
+    check_golden(json, name);
+    free(json);
+}
+
+static void check_archive(Eventinfo *lf, const char *name)
+{
+    char *json = Archiveinfo_to_jsonstr(lf);
+
+    ck_assert_ptr_ne(json, NULL);
+    check_golden(json, name);
+    free(json);
+}
+
+START_TEST(test_alert_json)
+{
+    Eventinfo lf;
+
+    setup_rules();
+    Config.decoder_order_size = 10;
+    __crt_ftell = 123456;
+
+    event_sshd(&lf);
+    lf.generated_rule = &rule_sshd;
+    check_alert(&lf, "alert-sshd");
+
+    event_syscheck(&lf);
+    lf.generated_rule = &rule_syscheck;
+    check_alert(&lf, "alert-syscheck");
+
+    event_rootcheck(&lf);
+    lf.generated_rule = &rule_rootcheck;
+    check_alert(&lf, "alert-rootcheck");
+
+    event_rootcheck(&lf);
+    lf.generated_rule = &rule_compliance;
+    check_alert(&lf, "alert-compliance");
+
+    event_minimal(&lf);
+    lf.generated_rule = &rule_empty;
+    check_alert(&lf, "alert-minimal");
+}
+END_TEST
+
+START_TEST(test_archive_json)
+{
+    Eventinfo lf;
+
+    setup_rules();
+    Config.decoder_order_size = 10;
+
+    event_sshd(&lf);
+    check_archive(&lf, "archive-sshd");
+
+    event_sshd(&lf);
+    lf.generated_rule = &rule_sshd;
+    check_archive(&lf, "archive-sshd-alert");
+
+    event_syscheck(&lf);
+    lf.generated_rule = &rule_syscheck;
+    check_archive(&lf, "archive-syscheck");
+
+    event_rootcheck(&lf);
+    lf.generated_rule = &rule_rootcheck;
+    check_archive(&lf, "archive-rootcheck");
+
+    event_minimal(&lf);
+    lf.decoder_info = NULL;
+    check_archive(&lf, "archive-minimal");
+}
+END_TEST
+
+Suite *test_suite(void)
+{
+    Suite *s = suite_create("analysisd_json");
+
+    TCase *tc_alert = tcase_create("alert");
+    tcase_add_test(tc_alert, test_alert_json);
+
+    TCase *tc_archive = tcase_create("archive");
+    tcase_add_test(tc_archive, test_archive_json);
+
+    suite_add_tcase(s, tc_alert);
+    suite_add_tcase(s, tc_archive);
+
+    return (s);
+}
+
+int main(void)
+{
+    Suite *s = test_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return ((number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
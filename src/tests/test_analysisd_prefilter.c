@@ -0,0 +1,281 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* Rule prefilters: the literals taken from the match and pcre2
+ * patterns of the rules must never filter out a rule whose pattern
+ * matches the event
+ */
+
+#include <check.h>
+#include <stdlib.h>
+
+#include "../headers/shared.h"
+#include "../analysisd/eventinfo.h"
+#include "../analysisd/rules.h"
+#include "../analysisd/rules_prefilter.h"
+
+Suite *test_suite(void);
+
+#define RP_NONE     0
+#define RP_MATCH    1
+#define RP_PCRE2    2
+
+static const struct {
+    int type;
+    const char *pattern;
+} patterns[] = {
+    /* Alternation: either literal */
+    { RP_PCRE2, "foo|bar" },
+    /* Optional groups and quantifiers */
+    { RP_PCRE2, "(foo)?bar" },
+    { RP_PCRE2, "sshx*d: " },
+    { RP_PCRE2, "colou?r" },
+    /* Escaped metacharacters */
+    { RP_PCRE2, "\\(root\\) \\[sudo\\]" },
+    { RP_PCRE2, "1\\.2\\.3" },
+    /* Caseless, as the rules are compiled */
+    { RP_PCRE2, "Failed Password" },
+    { RP_PCRE2, "(?i)ACCEPTED key" },
+    { RP_MATCH, "^Invalid user|illegal user" },
+    /* No literal */
+    { RP_PCRE2, "x*" },
+    { RP_PCRE2, "\\d+" },
+    { RP_MATCH, "error|" },
+    { RP_NONE, NULL },
+};
+
+#define RP_RULES (int)(sizeof(patterns) / sizeof(patterns[0]))
+
+/* First rule without any literal */
+#define RP_NO_LITERALS  9
+
+static const char *logs[] = {
+    "only bar here",
+    "only foo here",
+    "nothing to see",
+    "sshd: x",
+    "sshxxxd: x",
+    "color",
+    "colour",
+    "user (root) [sudo] ok",
+    "user root sudo",
+    "1.2.3",
+    "1x2x3",
+    "FAILED PASSWORD for root",
+    "accepted KEY for bob",
+    "ILLEGAL USER bob",
+    "Invalid user bob",
+    "42",
+    "error",
+    "",
+    NULL
+};
+
+static RuleInfo rules[RP_RULES];
+static RuleNode nodes[RP_RULES];
+static OSMatch matches[RP_RULES];
+static OSPcre2 pcre2s[RP_RULES];
+static RulePrefilter *prefilter;
+
+/* The top level rules, for OS_BuildRulePrefilters */
+RuleNode *OS_GetFirstRule()
+{
+    return (nodes);
+}
+
+static void setup_rules(void)
+{
+    int i;
+
+    if (prefilter) {
+        return;
+    }
+
+    for (i = 0; i < RP_RULES; i++) {
+        memset(&rules[i], 0, sizeof(RuleInfo));
+        rules[i].sigid = 100 + i;
+
+        if (patterns[i].type == RP_MATCH) {
+            ck_assert_int_eq(OSMatch_Compile(patterns[i].pattern, &matches[i], 0), 1);
+            rules[i].match = &matches[i];
+            os_strdup(patterns[i].pattern, rules[i].match_pattern);
+        } else if (patterns[i].type == RP_PCRE2) {
+            ck_assert_int_eq(OSPcre2_Compile(patterns[i].pattern, &pcre2s[i], PCRE2_CASELESS), 1);
+            rules[i].pcre2 = &pcre2s[i];
+            os_strdup(patterns[i].pattern, rules[i].pcre2_pattern);
+        }
+
+        nodes[i].ruleinfo = &rules[i];
+        nodes[i].next = i + 1 < RP_RULES ? &nodes[i + 1] : NULL;
+    }
+
+    OS_BuildRulePrefilters();
+    prefilter = OS_GetFirstRulePrefilter();
+    ck_assert_ptr_ne(prefilter, NULL);
+}
+
+/* Whether the pattern of a rule matches a log */
+static int rule_matches(int i, const char *log)
+{
+    switch (patterns[i].type) {
+        case RP_MATCH:
+            return (OSMatch_Execute(log, strlen(log), &matches[i]));
+        case RP_PCRE2:
+            return (OSPcre2_Execute(log, &pcre2s[i]) != NULL);
+        default:
+            return (1);
+    }
+}
+
+/* Whether a rule is a candidate for a log (in list order) */
+static int is_candidate(int rule, const char *log)
+{
+    Eventinfo lf;
+    RuleCandidates it;
+    RuleNode *node;
+    int found = 0;
+    int last = -1;
+
+    memset(&lf, 0, sizeof(Eventinfo));
+    os_strdup(log, lf.log);
+
+    for (node = OS_FirstRuleCandidate(prefilter, nodes, &lf, &it); node;
+            node = OS_NextRuleCandidate(node, &it)) {
+        int i = (int)(node - nodes);
+
+        ck_assert_int_gt(i, last);
+        last = i;
+        if (i == rule) {
+            found = 1;
+        }
+    }
+
+    free(lf.log);
+    return (found);
+}
+
+START_TEST(test_prefilter_alternation)
+{
+    setup_rules();
+
+    /* foo|bar needs either literal, not both */
+    ck_assert_int_eq(is_candidate(0, "only bar here"), 1);
+    ck_assert_int_eq(is_candidate(0, "only foo here"), 1);
+    ck_assert_int_eq(is_candidate(0, "nothing to see"), 0);
+
+    /* One literal for each alternative */
+    ck_assert_int_eq(is_candidate(8, "ILLEGAL USER bob"), 1);
+    ck_assert_int_eq(is_candidate(8, "Invalid user bob"), 1);
+    ck_assert_int_eq(is_candidate(8, "nothing to see"), 0);
+}
+END_TEST
+
+START_TEST(test_prefilter_quantifiers)
+{
+    setup_rules();
+
+    /* The optional group is not needed */
+    ck_assert_int_eq(is_candidate(1, "only bar here"), 1);
+    ck_assert_int_eq(is_candidate(1, "only foo here"), 0);
+
+    /* Nor the characters under * and ? */
+    ck_assert_int_eq(is_candidate(2, "sshd: x"), 1);
+    ck_assert_int_eq(is_candidate(2, "sshxxxd: x"), 1);
+    ck_assert_int_eq(is_candidate(3, "color"), 1);
+    ck_assert_int_eq(is_candidate(3, "colour"), 1);
+    ck_assert_int_eq(is_candidate(3, "nothing to see"), 0);
+}
+END_TEST
+
+START_TEST(test_prefilter_escaped)
+{
+    setup_rules();
+
+    ck_assert_int_eq(is_candidate(4, "user (root) [sudo] ok"), 1);
+    ck_assert_int_eq(is_candidate(4, "user root sudo"), 0);
+    ck_assert_int_eq(is_candidate(5, "1.2.3"), 1);
+    ck_assert_int_eq(is_candidate(5, "1x2x3"), 0);
+}
+END_TEST
+
+START_TEST(test_prefilter_caseless)
+{
+    setup_rules();
+
+    ck_assert_int_eq(is_candidate(6, "FAILED PASSWORD for root"), 1);
+    ck_assert_int_eq(is_candidate(6, "nothing to see"), 0);
+    ck_assert_int_eq(is_candidate(7, "accepted KEY for bob"), 1);
+    ck_assert_int_eq(is_candidate(7, "nothing to see"), 0);
+}
+END_TEST
+
+START_TEST(test_prefilter_no_literals)
+{
+    int i;
+    int j;
+
+    setup_rules();
+
+    /* Never filtered out */
+    for (i = RP_NO_LITERALS; i < RP_RULES; i++) {
+        for (j = 0; logs[j]; j++) {
+            ck_assert_int_eq(is_candidate(i, logs[j]), 1);
+        }
+    }
+}
+END_TEST
+
+START_TEST(test_prefilter_matches)
+{
+    int i;
+    int j;
+
+    setup_rules();
+
+    /* Every rule matching a log is tried */
+    for (i = 0; i < RP_RULES; i++) {
+        for (j = 0; logs[j]; j++) {
+            if (rule_matches(i, logs[j])) {
+                ck_assert_int_eq(is_candidate(i, logs[j]), 1);
+            }
+        }
+    }
+}
+END_TEST
+
+Suite *test_suite(void)
+{
+    Suite *s = suite_create("analysisd_prefilter");
+
+    TCase *tc_literals = tcase_create("literals");
+    tcase_add_test(tc_literals, test_prefilter_alternation);
+    tcase_add_test(tc_literals, test_prefilter_quantifiers);
+    tcase_add_test(tc_literals, test_prefilter_escaped);
+    tcase_add_test(tc_literals, test_prefilter_caseless);
+    tcase_add_test(tc_literals, test_prefilter_no_literals);
+
+    TCase *tc_matches = tcase_create("matches");
+    tcase_add_test(tc_matches, test_prefilter_matches);
+
+    suite_add_tcase(s, tc_literals);
+    suite_add_tcase(s, tc_matches);
+
+    return (s);
+}
+
+int main(void)
+{
+    Suite *s = test_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return ((number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
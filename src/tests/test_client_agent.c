@@ -0,0 +1,275 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* Segments of the event spool of the agent */
+
+#include <check.h>
+#include <stdlib.h>
+
+#include "../headers/shared.h"
+#include "../client-agent/agentd.h"
+
+/* Small segments, of a few events each */
+#define SPOOL_TEST_SEGMENT  64
+#define SPOOL_TEST_EVENTS   20
+
+Suite *test_suite(void);
+
+static char spool_dir[] = "/tmp/test_client_agent.XXXXXX";
+
+/* Each test has a spool directory of its own */
+static void setup(void)
+{
+    strcpy(spool_dir, "/tmp/test_client_agent.XXXXXX");
+    ck_assert_ptr_ne(mkdtemp(spool_dir), NULL);
+}
+
+static void teardown(void)
+{
+    char path[PATH_MAX + 1];
+    DIR *dir;
+    struct dirent *entry;
+
+    if ((dir = opendir(spool_dir)) != NULL) {
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                snprintf(path, PATH_MAX, "%s/%s", spool_dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(spool_dir);
+}
+
+/* Size of a segment file */
+static long segment_size(unsigned int seq)
+{
+    char path[OS_FLSIZE + 1];
+    struct stat st;
+
+    snprintf(path, OS_FLSIZE, "%s/%08u", spool_dir, seq);
+    if (stat(path, &st) < 0) {
+        return (-1);
+    }
+
+    return ((long)st.st_size);
+}
+
+/* Spool the events from first to last, as "event <n>".
+ * Returns the bytes written.
+ */
+static unsigned long write_events(spool_queue *q, int first, int last)
+{
+    char event[64];
+    unsigned long total = 0;
+    int written;
+    int i;
+
+    for (i = first; i < last; i++) {
+        snprintf(event, sizeof(event), "event %d", i);
+        written = spool_queue_write(q, event);
+        ck_assert_int_gt(written, 0);
+        total += (unsigned long)written;
+    }
+
+    return (total);
+}
+
+/* Read the next event, which must be the n-th one, from the segment
+ * it is in
+ */
+static void read_event(spool_queue *q, int n)
+{
+    char event[OS_MAXSTR + 1];
+    char expected[64];
+
+    ck_assert_int_eq(spool_queue_open_head(q), 0);
+    while (!spool_queue_read(q, event)) {
+        ck_assert_int_eq(spool_queue_next(q), 1);
+        ck_assert_int_eq(spool_queue_open_head(q), 0);
+    }
+
+    snprintf(expected, sizeof(expected), "event %d", n);
+    ck_assert_str_eq(event, expected);
+}
+
+START_TEST(test_spool_resume)
+{
+    spool_queue q;
+    unsigned long total;
+    long offset;
+    int i;
+
+    setup();
+
+    ck_assert_int_eq(spool_queue_open(&q, spool_dir, SPOOL_TEST_SEGMENT), 0);
+    ck_assert_int_eq((int)q.size, 0);
+
+    total = write_events(&q, 0, SPOOL_TEST_EVENTS);
+    ck_assert_int_eq((int)q.size, (int)total);
+    ck_assert_int_ge((int)q.tail, 3);
+
+    /* Some are sent before the agent stops */
+    for (i = 0; i < 3; i++) {
+        read_event(&q, i);
+    }
+    spool_queue_sent(&q);
+    spool_queue_save(&q);
+    offset = q.head_offset;
+    ck_assert_int_eq((int)offset, (int)(strlen("7:event 0\n") * 3));
+    ck_assert_int_eq((int)q.size, (int)(total - (unsigned long)offset));
+    spool_queue_close(&q);
+
+    /* After a restart, sending goes on from the offset saved */
+    ck_assert_int_eq(spool_queue_open(&q, spool_dir, SPOOL_TEST_SEGMENT), 0);
+    ck_assert_int_eq((int)q.head, 1);
+    ck_assert_int_eq((int)q.head_offset, (int)offset);
+    ck_assert_int_eq((int)q.size, (int)(total - (unsigned long)offset));
+
+    /* New events go to a segment of their own */
+    total += write_events(&q, SPOOL_TEST_EVENTS, SPOOL_TEST_EVENTS + 1);
+    ck_assert_int_eq(segment_size(q.tail), (int)strlen("8:event 20\n"));
+
+    for (i = 3; i <= SPOOL_TEST_EVENTS; i++) {
+        read_event(&q, i);
+        spool_queue_sent(&q);
+    }
+    ck_assert_int_eq((int)q.size, 0);
+    ck_assert_int_eq(spool_queue_next(&q), 0);
+
+    spool_queue_clear(&q);
+    ck_assert_int_eq(segment_size(1), -1);
+    spool_queue_close(&q);
+
+    /* Nothing is left to send */
+    ck_assert_int_eq(spool_queue_open(&q, spool_dir, SPOOL_TEST_SEGMENT), 0);
+    ck_assert_int_eq((int)q.size, 0);
+    ck_assert_int_eq(q.head, q.tail + 1);
+    spool_queue_close(&q);
+
+    teardown();
+}
+END_TEST
+
+START_TEST(test_spool_truncated)
+{
+    char path[OS_FLSIZE + 1];
+    char event[OS_MAXSTR + 1];
+    spool_queue q;
+    unsigned long total;
+    FILE *fp;
+    int i;
+
+    setup();
+
+    ck_assert_int_eq(spool_queue_open(&q, spool_dir, SPOOL_TEST_SEGMENT), 0);
+    write_events(&q, 0, 3);
+    ck_assert_int_eq((int)q.tail, 1);
+    spool_queue_close(&q);
+
+    /* The agent stopped while writing an event */
+    snprintf(path, OS_FLSIZE, "%s/%08u", spool_dir, 1);
+    fp = fopen(path, "a");
+    ck_assert_ptr_ne(fp, NULL);
+    fputs("20:event cut", fp);
+    fclose(fp);
+
+    ck_assert_int_eq(spool_queue_open(&q, spool_dir, SPOOL_TEST_SEGMENT), 0);
+    ck_assert_int_eq((int)q.size, (int)segment_size(1));
+    total = write_events(&q, 3, 4);
+    ck_assert_int_eq((int)q.tail, 2);
+
+    for (i = 0; i < 3; i++) {
+        read_event(&q, i);
+        spool_queue_sent(&q);
+    }
+
+    /* The event cut is not read, and not counted once skipped */
+    ck_assert_int_eq(spool_queue_read(&q, event), 0);
+    ck_assert_int_eq((int)q.size, (int)(strlen("20:event cut") + total));
+    ck_assert_int_eq(spool_queue_next(&q), 1);
+    ck_assert_int_eq((int)q.size, (int)total);
+
+    read_event(&q, 3);
+    spool_queue_sent(&q);
+    ck_assert_int_eq((int)q.size, 0);
+
+    spool_queue_clear(&q);
+    spool_queue_close(&q);
+
+    teardown();
+}
+END_TEST
+
+START_TEST(test_spool_next_segment)
+{
+    spool_queue q;
+    unsigned long total;
+    long first;
+    int i;
+
+    setup();
+
+    ck_assert_int_eq(spool_queue_open(&q, spool_dir, SPOOL_TEST_SEGMENT), 0);
+    total = write_events(&q, 0, SPOOL_TEST_EVENTS);
+    first = segment_size(1);
+
+    /* Two events sent, and a third one read but not sent */
+    for (i = 0; i < 3; i++) {
+        read_event(&q, i);
+        if (i == 1) {
+            spool_queue_sent(&q);
+        }
+    }
+
+    /* The rest of the segment is not counted any more */
+    ck_assert_int_eq(spool_queue_next(&q), 1);
+    ck_assert_int_eq((int)q.size, (int)(total - (unsigned long)first));
+    ck_assert_int_eq((int)q.head, 2);
+    ck_assert_int_eq((int)q.head_offset, 0);
+    ck_assert_int_eq(segment_size(1), -1);
+
+    /* Going back to the first event not sent */
+    ck_assert_int_eq(spool_queue_open_head(&q), 0);
+    read_event(&q, (int)(first / (long)strlen("7:event 0\n")));
+    spool_queue_rewind(&q);
+    read_event(&q, (int)(first / (long)strlen("7:event 0\n")));
+
+    spool_queue_clear(&q);
+    spool_queue_close(&q);
+
+    teardown();
+}
+END_TEST
+
+Suite *test_suite(void)
+{
+    Suite *s = suite_create("client_agent");
+
+    TCase *tc_spool = tcase_create("spool");
+    tcase_add_test(tc_spool, test_spool_resume);
+    tcase_add_test(tc_spool, test_spool_truncated);
+    tcase_add_test(tc_spool, test_spool_next_segment);
+
+    suite_add_tcase(s, tc_spool);
+
+    return (s);
+}
+
+int main(void)
+{
+    Suite *s = test_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return ((number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,178 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* Line reader and bookmarks of logcollector. Built with DEFAULTDIR
+ * set to a directory of its own, where the bookmarks are written.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+
+#include "../headers/shared.h"
+#include "../logcollector/logcollector.h"
+
+#define LOGC_TEST_LOG   DEFAULTDIR "/test.log"
+#define LOGC_TEST_LINES 2000
+
+Suite *test_suite(void);
+
+/* Used by the reader and the bookmarks */
+logreader *logff;
+
+static logreader test_logff[2];
+
+/* Write the lines from first to last, as "line <n>\n" */
+static void write_lines(int first, int last)
+{
+    FILE *fp;
+    int i;
+
+    fp = fopen(LOGC_TEST_LOG, first == 0 ? "w" : "a");
+    ck_assert_ptr_ne(fp, NULL);
+    for (i = first; i < last; i++) {
+        fprintf(fp, "line %d\n", i);
+    }
+    fclose(fp);
+}
+
+/* Open the log as logcollector does, at the offset given (or at the
+ * bookmark if offset is -1)
+ */
+static int open_log(long offset)
+{
+    struct stat st;
+    int rc = 0;
+
+    logff[0].fp = fopen(LOGC_TEST_LOG, "r");
+    ck_assert_ptr_ne(logff[0].fp, NULL);
+    ck_assert_int_eq(fstat(fileno(logff[0].fp), &st), 0);
+    logff[0].fd = st.st_ino;
+    logff[0].size = st.st_size;
+
+    if (offset < 0) {
+        rc = LogBookmarkSeek(0);
+    } else {
+        ck_assert_int_eq(fseek(logff[0].fp, offset, SEEK_SET), 0);
+    }
+
+    LogReaderReset(0);
+    LogBookmarkUpdate(0);
+    return (rc);
+}
+
+/* Offset saved in the bookmarks */
+static long saved_offset(void)
+{
+    char line[OS_MAXSTR + 1];
+    unsigned long inode, head_len;
+    unsigned int hash;
+    long offset = -1;
+    FILE *fp;
+
+    fp = fopen(LOGC_BOOKMARKS_PATH, "r");
+    ck_assert_ptr_ne(fp, NULL);
+    ck_assert_ptr_ne(fgets(line, OS_MAXSTR, fp), NULL);
+    ck_assert_int_eq(sscanf(line, "%lu %ld %lu %x", &inode, &offset,
+                            &head_len, &hash), 4);
+    fclose(fp);
+
+    return (offset);
+}
+
+START_TEST(test_bookmark_offset)
+{
+    char line[OS_MAXSTR + 1];
+    char expected[64];
+    long start;
+    long offset;
+    int i;
+
+    mkdir(DEFAULTDIR, 0700);
+    mkdir(DEFAULTDIR "/queue", 0700);
+    mkdir(DEFAULTDIR "/queue/ossec", 0700);
+    unlink(LOGC_BOOKMARKS_PATH);
+
+    memset(test_logff, 0, sizeof(test_logff));
+    test_logff[0].file = LOGC_TEST_LOG;
+    test_logff[0].logformat = "syslog";
+    logff = test_logff;
+
+    write_lines(0, LOGC_TEST_LINES);
+    LogBookmarkInit();
+
+    /* Start past the beginning, as after seeking to the end */
+    start = 10 * (long)strlen("line 0\n");
+    open_log(start);
+    ck_assert_int_eq(LogReaderTell(0), start);
+
+    /* Read more than a buffer, leaving some lines buffered */
+    for (i = 10; i < 1500; i++) {
+        ck_assert_ptr_ne(LogReaderGets(line, OS_MAXSTR, 0), NULL);
+        snprintf(expected, sizeof(expected), "line %d\n", i);
+        ck_assert_str_eq(line, expected);
+    }
+
+    offset = LogReaderTell(0);
+
+    /* The offset is the one of the next line in the file */
+    ck_assert_int_eq(pread(fileno(logff[0].fp), line, 10, offset), 10);
+    line[10] = '\0';
+    ck_assert_str_eq(line, "line 1500\n");
+
+    LogBookmarkUpdate(0);
+    LogBookmarkSave();
+    ck_assert_int_eq(saved_offset(), offset);
+    fclose(logff[0].fp);
+
+    /* After a restart, reading goes on from the bookmark */
+    write_lines(LOGC_TEST_LINES, LOGC_TEST_LINES + 10);
+    LogBookmarkInit();
+    ck_assert_int_eq(open_log(-1), 0);
+    ck_assert_int_eq(LogReaderTell(0), offset);
+
+    for (i = 1500; i < LOGC_TEST_LINES + 10; i++) {
+        ck_assert_ptr_ne(LogReaderGets(line, OS_MAXSTR, 0), NULL);
+        snprintf(expected, sizeof(expected), "line %d\n", i);
+        ck_assert_str_eq(line, expected);
+    }
+    ck_assert_ptr_eq(LogReaderGets(line, OS_MAXSTR, 0), NULL);
+
+    /* Everything read */
+    LogBookmarkUpdate(0);
+    LogBookmarkSave();
+    ck_assert_int_eq(saved_offset(), (long)logff[0].size);
+    fclose(logff[0].fp);
+
+    unlink(LOGC_BOOKMARKS_PATH);
+    unlink(LOGC_TEST_LOG);
+}
+END_TEST
+
+Suite *test_suite(void)
+{
+    Suite *s = suite_create("logcollector");
+
+    TCase *tc_bookmark = tcase_create("bookmark");
+    tcase_add_test(tc_bookmark, test_bookmark_offset);
+
+    suite_add_tcase(s, tc_bookmark);
+
+    return (s);
+}
+
+int main(void)
+{
+    Suite *s = test_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return ((number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -10,12 +10,15 @@
 #include <check.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/wait.h>
 
 #include "headers/defs.h"
 #include "../os_crypto/blowfish/bf_op.h"
 #include "../os_crypto/md5/md5_op.h"
 #include "../os_crypto/sha1/sha1_op.h"
 #include "../os_crypto/md5_sha1/md5_sha1_op.h"
+#include "headers/shared.h"
+#include "headers/sec.h"
 
 Suite *test_suite(void);
 
@@ -125,6 +128,35 @@ START_TEST(test_md5sha1file)
 }
 END_TEST
 
+START_TEST(test_md5sha1largefile)
+{
+    /* Larger than a single read */
+    const char *string_md5 = "bf113c5fcc7232e9f62db38bebff4ed7";
+    const char *string_sha1 = "3e1ec99e5f0d64f90341089208a1728a7651560b";
+    char line[32];
+    int i;
+
+    /* create tmp file */
+    char file_name[256];
+    strncpy(file_name, "/tmp/tmp_file-XXXXXX", 256);
+    int fd = mkstemp(file_name);
+
+    for (i = 0; i < 10000; i++) {
+        snprintf(line, sizeof(line), "%06d teststring\n", i);
+        write(fd, line, strlen(line));
+    }
+    close(fd);
+
+    os_md5 md5buffer;
+    os_sha1 sha1buffer;
+
+    ck_assert_int_eq(OS_MD5_SHA1_File(file_name, NULL, md5buffer, sha1buffer, OS_BINARY), 0);
+
+    ck_assert_str_eq(md5buffer, string_md5);
+    ck_assert_str_eq(sha1buffer, string_sha1);
+}
+END_TEST
+
 START_TEST(test_md5sha1cmdfile)
 {
     const char *string = "teststring";
@@ -158,6 +190,211 @@ START_TEST(test_md5sha1cmdfile_fail)
 }
 END_TEST
 
+START_TEST(test_secmsg_batch)
+{
+    char batch[SECMSG_BATCH_MAXSIZE + 1];
+    char event[OS_MAXSTR + 1];
+    char large[OS_MAXSTR];
+    size_t used = 0;
+    size_t pos = 0;
+
+    ck_assert_int_eq(AddSecMSGBatch(batch, &used, sizeof(batch), "1:/var/log/messages:first"), 0);
+    ck_assert_int_eq(AddSecMSGBatch(batch, &used, sizeof(batch), "1:/var/log/messages:second: with 12:3 in it"), 0);
+    ck_assert_int_eq(AddSecMSGBatch(batch, &used, sizeof(batch), ""), -1);
+    ck_assert_str_eq(batch, "#!b25:1:/var/log/messages:first"
+                     "43:1:/var/log/messages:second: with 12:3 in it");
+    ck_assert_int_eq(used, strlen(batch));
+    ck_assert_int_eq(IsSecMSGBatch(batch), 1);
+    ck_assert_int_eq(IsSecMSGBatch("1:/var/log/messages:first"), 0);
+    ck_assert_int_eq(IsSecMSGBatch("#!-agent startup "), 0);
+
+    ck_assert_int_eq(ReadSecMSGBatch(batch, &pos, event), 1);
+    ck_assert_str_eq(event, "1:/var/log/messages:first");
+    ck_assert_int_eq(ReadSecMSGBatch(batch, &pos, event), 1);
+    ck_assert_str_eq(event, "1:/var/log/messages:second: with 12:3 in it");
+    ck_assert_int_eq(ReadSecMSGBatch(batch, &pos, event), 0);
+
+    /* Full */
+    memset(large, 'a', sizeof(large) - 1);
+    large[sizeof(large) - 1] = '\0';
+    ck_assert_int_eq(AddSecMSGBatch(batch, &used, sizeof(batch), large), -1);
+    ck_assert_int_eq(used, strlen(batch));
+    used = 0;
+    ck_assert_int_eq(AddSecMSGBatch(batch, &used, 32, "1:/var/log/messages:first"), 0);
+    ck_assert_int_eq(AddSecMSGBatch(batch, &used, 32, "x"), -1);
+
+    /* Malformed */
+    pos = 0;
+    ck_assert_int_eq(ReadSecMSGBatch("#!b26:1:/var/log/messages:first", &pos, event), -1);
+    pos = 0;
+    ck_assert_int_eq(ReadSecMSGBatch("#!b0:", &pos, event), -1);
+    pos = 0;
+    ck_assert_int_eq(ReadSecMSGBatch("#!b25", &pos, event), -1);
+    pos = 0;
+    ck_assert_int_eq(ReadSecMSGBatch("#!b99999999999999999999:x", &pos, event), -1);
+    pos = 0;
+    ck_assert_int_eq(ReadSecMSGBatch("#!b1:x:", &pos, event), 1);
+    ck_assert_int_eq(ReadSecMSGBatch("#!b1:x:", &pos, event), -1);
+}
+END_TEST
+
+/* Counters table of the server, under DEFAULTDIR */
+static void setup_counters(void)
+{
+    FILE *fp;
+
+    mkdir(DEFAULTDIR, 0700);
+    mkdir(DEFAULTDIR "/etc", 0700);
+    mkdir(DEFAULTDIR "/queue", 0700);
+    mkdir(DEFAULTDIR RIDS_DIR, 0700);
+    unlink(DEFAULTDIR RIDS_DIR "/" RIDS_TABLE);
+
+    fp = fopen(DEFAULTDIR OSSEC_DEFINES, "w");
+    ck_assert_ptr_ne(fp, NULL);
+    fprintf(fp, "remoted.counter_sync=1\n"
+            "remoted.recv_counter_flush=128\n"
+            "remoted.comp_average_printout=19999\n"
+            "remoted.verify_msg_id=1\n");
+    fclose(fp);
+}
+
+/* Open the counters of the agents in a new process, as remoted does
+ * when it starts, and read them into got. Then receive a message of
+ * each agent with the counters in set (if not NULL).
+ */
+static void open_counters(const char **ids, const unsigned int *set, unsigned int *got)
+{
+    unsigned int n = 0;
+    size_t len = 0;
+    int fds[2];
+    int status;
+    pid_t pid;
+
+    while (ids[n]) {
+        n++;
+    }
+
+    ck_assert_int_eq(pipe(fds), 0);
+    pid = fork();
+    ck_assert_int_ge(pid, 0);
+
+    if (pid == 0) {
+        keystore keys;
+        unsigned int i;
+
+        memset(&keys, 0, sizeof(keys));
+        keys.keysize = n;
+        os_calloc(n + 1, sizeof(keyentry *), keys.keyentries);
+        for (i = 0; i <= n; i++) {
+            os_calloc(1, sizeof(keyentry), keys.keyentries[i]);
+            keys.keyentries[i]->id = (char *)(i < n ? ids[i] : "sender");
+            keys.keyentries[i]->name = keys.keyentries[i]->id;
+        }
+
+        OS_StartCounter(&keys);
+
+        for (i = 0; i < n; i++) {
+            unsigned int c[2] = { keys.keyentries[i]->global, keys.keyentries[i]->local };
+
+            if (write(fds[1], c, sizeof(c)) != sizeof(c)) {
+                _exit(1);
+            }
+        }
+
+        for (i = 0; set && i < n; i++) {
+            secmsg_counter counter = { set[2 * i], set[2 * i + 1], 0 };
+
+            if (!CheckSecMSG(&keys, (int)i, &counter)) {
+                _exit(1);
+            }
+        }
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+    while (len < n * 2 * sizeof(unsigned int)) {
+        ssize_t r = read(fds[0], (char *)got + len, n * 2 * sizeof(unsigned int) - len);
+
+        ck_assert_int_gt(r, 0);
+        len += (size_t)r;
+    }
+    close(fds[0]);
+
+    ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+    ck_assert_int_eq(WIFEXITED(status) && WEXITSTATUS(status) == 0, 1);
+}
+
+START_TEST(test_counters_reopen)
+{
+    const char *ids[] = { "001", "002", NULL };
+    const unsigned int set[] = { 5, 7, 9, 1 };
+    unsigned int got[4];
+
+    setup_counters();
+
+    /* A new table */
+    open_counters(ids, set, got);
+    ck_assert_int_eq(got[0], 0);
+    ck_assert_int_eq(got[1], 0);
+    ck_assert_int_eq(got[2], 0);
+    ck_assert_int_eq(got[3], 0);
+
+    /* Kept by the next remoted */
+    open_counters(ids, NULL, got);
+    ck_assert_int_eq(got[0], 5);
+    ck_assert_int_eq(got[1], 7);
+    ck_assert_int_eq(got[2], 9);
+    ck_assert_int_eq(got[3], 1);
+}
+END_TEST
+
+START_TEST(test_counters_new_agent)
+{
+    const char *ids[] = { "001", NULL };
+    const char *more_ids[] = { "001", "1500", NULL };
+    const unsigned int set[] = { 5, 7 };
+    const unsigned int more_set[] = { 6, 1, 3, 4 };
+    unsigned int got[4];
+
+    setup_counters();
+    open_counters(ids, set, got);
+
+    /* Past the end of the table, which grows */
+    open_counters(more_ids, more_set, got);
+    ck_assert_int_eq(got[0], 5);
+    ck_assert_int_eq(got[1], 7);
+    ck_assert_int_eq(got[2], 0);
+    ck_assert_int_eq(got[3], 0);
+
+    open_counters(more_ids, NULL, got);
+    ck_assert_int_eq(got[0], 6);
+    ck_assert_int_eq(got[1], 1);
+    ck_assert_int_eq(got[2], 3);
+    ck_assert_int_eq(got[3], 4);
+}
+END_TEST
+
+START_TEST(test_counters_removed_agent)
+{
+    const char *ids[] = { "001", "002", NULL };
+    const unsigned int set[] = { 5, 7, 9, 1 };
+    unsigned int got[4];
+
+    setup_counters();
+    open_counters(ids, set, got);
+
+    /* The ID is reused by a new agent, which starts from zero */
+    OS_RemoveCounter("002");
+
+    open_counters(ids, NULL, got);
+    ck_assert_int_eq(got[0], 5);
+    ck_assert_int_eq(got[1], 7);
+    ck_assert_int_eq(got[2], 0);
+    ck_assert_int_eq(got[3], 0);
+}
+END_TEST
+
 Suite *test_suite(void)
 {
     Suite *s = suite_create("os_crypto");
@@ -176,14 +413,22 @@ Suite *test_suite(void)
 
     TCase *tc_md5sha1 = tcase_create("md5_sha1");
     tcase_add_test(tc_md5sha1, test_md5sha1file);
+    tcase_add_test(tc_md5sha1, test_md5sha1largefile);
     tcase_add_test(tc_md5sha1, test_md5sha1cmdfile);
     tcase_add_test(tc_md5sha1, test_md5sha1cmdfile_fail);
     tcase_set_timeout(tc_md5sha1, 7);
 
+    TCase *tc_secmsg = tcase_create("secmsg");
+    tcase_add_test(tc_secmsg, test_secmsg_batch);
+    tcase_add_test(tc_secmsg, test_counters_reopen);
+    tcase_add_test(tc_secmsg, test_counters_new_agent);
+    tcase_add_test(tc_secmsg, test_counters_removed_agent);
+
     suite_add_tcase(s, tc_blowfish);
     suite_add_tcase(s, tc_md5);
     suite_add_tcase(s, tc_sha1);
     suite_add_tcase(s, tc_md5sha1);
+    suite_add_tcase(s, tc_secmsg);
 
     return (s);
 }
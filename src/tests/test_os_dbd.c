@@ -0,0 +1,222 @@
+/* Copyright (C) 2015 Trend Micro Inc.
+ * All rights reserved.
+ *
+ * This program is a free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License (version 2) as published by the FSF - Free Software
+ * Foundation.
+ */
+
+/* Alerts inserted by ossec-dbd, in batches, in a SQLite database */
+
+#include <check.h>
+#include <stdlib.h>
+#include <sqlite3.h>
+
+#include "../headers/shared.h"
+#include "../os_dbd/dbd.h"
+
+#define DBD_TEST_DB "/tmp/test_os_dbd.db"
+
+Suite *test_suite(void);
+
+static const char *test_alert =
+    "** Alert 1792209955.0: - syslog,errors,\n"
+    "2026 Oct 17 04:05:55 triumph->/var/log/messages\n"
+    "Rule: 1001 (level 2) -> 'File missing. Root access unrestricted.'\n"
+    "Src IP: 10.0.0.2\n"
+    "Feb 15 16:08:14 triumph PAM-securetty[741]: Couldn't open /etc/securetty\n"
+    "\n";
+
+/* Same alert, from the address refused by the trigger of the tests */
+static const char *test_alert_bad =
+    "** Alert 1792209956.0: - syslog,errors,\n"
+    "2026 Oct 17 04:05:56 triumph->/var/log/messages\n"
+    "Rule: 1001 (level 2) -> 'File missing. Root access unrestricted.'\n"
+    "Src IP: 10.0.0.66\n"
+    "Feb 15 16:08:14 triumph PAM-securetty[741]: Couldn't open /etc/securetty\n"
+    "\n";
+
+/* Count the rows of a table, read with a connection of its own */
+static int count_rows(const char *query)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int count = -1;
+
+    ck_assert_int_eq(sqlite3_open(DBD_TEST_DB, &db), SQLITE_OK);
+    ck_assert_int_eq(sqlite3_prepare_v2(db, query, -1, &stmt, NULL), SQLITE_OK);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return (count);
+}
+
+/* Create the database and connect to it, as ossec-dbd does */
+static void setup_db(DBConfig *db_config)
+{
+    unlink(DBD_TEST_DB);
+
+    memset(db_config, 0, sizeof(DBConfig));
+    db_config->db_type = SQLITEDB;
+    db_config->db = DBD_TEST_DB;
+    db_config->server_id = 1;
+    db_config->batch_size = 3;
+    db_config->batch_latency = 60;
+
+    osdb_connect = sqlite_osdb_connect;
+    osdb_query_insert = sqlite_osdb_query_insert;
+    osdb_query_select = sqlite_osdb_query_select;
+    osdb_close = sqlite_osdb_close;
+    osdb_setconfig(db_config);
+
+    db_config->conn = osdb_connect(NULL, NULL, NULL, db_config->db, 0, NULL);
+    ck_assert_ptr_ne(db_config->conn, NULL);
+    db_config->location_hash = OSHash_Create();
+    ck_assert_ptr_ne(db_config->location_hash, NULL);
+
+    ck_assert_int_eq(osdb_query_insert(db_config->conn,
+                     "CREATE TABLE location (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                     "server_id INTEGER NOT NULL, name VARCHAR(128) NOT NULL)"), 1);
+    ck_assert_int_eq(osdb_query_insert(db_config->conn,
+                     "CREATE TABLE alert (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                     "server_id INTEGER NOT NULL, rule_id INTEGER NOT NULL, level INTEGER, "
+                     "timestamp INTEGER NOT NULL, location_id INTEGER NOT NULL, "
+                     "src_ip VARCHAR(46), dst_ip VARCHAR(46), src_port INTEGER, dst_port INTEGER, "
+                     "alertid TEXT DEFAULT NULL, \"user\" TEXT, full_log TEXT NOT NULL, "
+                     "is_hidden INTEGER NOT NULL DEFAULT '0', tld VARCHAR(32) NOT NULL DEFAULT '')"), 1);
+}
+
+/* Insert one alert */
+static int insert_alert(const char *alert, DBConfig *db_config)
+{
+    alert_data *al_data;
+    int result;
+
+    al_data = ParseAlertData(0, alert);
+    ck_assert_ptr_ne(al_data, NULL);
+    result = OS_Alert_InsertDB(al_data, db_config);
+    FreeAlertData(al_data);
+
+    return (result);
+}
+
+START_TEST(test_alert_batch)
+{
+    DBConfig db_config;
+    alert_data *al_data;
+    int i;
+
+    setup_db(&db_config);
+
+    /* Nothing is inserted until the batch is full */
+    for (i = 0; i < 5; i++) {
+        al_data = ParseAlertData(0, test_alert);
+        ck_assert_ptr_ne(al_data, NULL);
+        ck_assert_int_eq(OS_Alert_InsertDB(al_data, &db_config), 1);
+        FreeAlertData(al_data);
+
+        ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert"), i < 2 ? 0 : 3);
+    }
+
+    ck_assert_int_eq(OS_Alert_PendingDB(), 1);
+    ck_assert_int_eq(OS_Alert_ExpiredDB(&db_config), 0);
+    ck_assert_int_le(OS_Alert_WaitDB(&db_config), 60);
+    ck_assert_int_ge(OS_Alert_WaitDB(&db_config), 59);
+
+    /* Due once batch_latency has gone by */
+    db_config.batch_latency = 0;
+    ck_assert_int_eq(OS_Alert_ExpiredDB(&db_config), 1);
+    ck_assert_int_eq(OS_Alert_WaitDB(&db_config), 0);
+    db_config.batch_latency = 60;
+
+    /* The rest are inserted when flushed */
+    ck_assert_int_eq(OS_Alert_FlushDB(&db_config), 1);
+    ck_assert_int_eq(OS_Alert_PendingDB(), 0);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert"), 5);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert WHERE rule_id = 1001 "
+                                "AND level = 2 AND src_ip = '10.0.0.2' "
+                                "AND alertid = '1792209955.0' AND location_id = 1"), 5);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM location"), 1);
+
+    /* Escaped on the way in */
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert WHERE full_log = "
+                                "'Feb 15 16:08:14 triumph PAM-securetty[741]: Couldn`t open /etc/securetty'"), 5);
+
+    /* One at a time, with a batch of 1 */
+    db_config.batch_size = 1;
+    al_data = ParseAlertData(0, test_alert);
+    ck_assert_ptr_ne(al_data, NULL);
+    ck_assert_int_eq(OS_Alert_InsertDB(al_data, &db_config), 1);
+    FreeAlertData(al_data);
+    ck_assert_int_eq(OS_Alert_PendingDB(), 0);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert"), 6);
+
+    osdb_close(db_config.conn);
+    unlink(DBD_TEST_DB);
+}
+END_TEST
+
+START_TEST(test_alert_batch_error)
+{
+    DBConfig db_config;
+
+    setup_db(&db_config);
+
+    /* Refuse the alerts of one address */
+    ck_assert_int_eq(osdb_query_insert(db_config.conn,
+                     "CREATE TRIGGER alert_bad BEFORE INSERT ON alert "
+                     "WHEN NEW.src_ip = '10.0.0.66' "
+                     "BEGIN SELECT RAISE(ABORT, 'bad alert'); END"), 1);
+
+    /* Only the bad row of the batch is lost */
+    db_config.batch_size = 10;
+    ck_assert_int_eq(insert_alert(test_alert, &db_config), 1);
+    ck_assert_int_eq(insert_alert(test_alert_bad, &db_config), 1);
+    ck_assert_int_eq(insert_alert(test_alert, &db_config), 1);
+    ck_assert_int_eq(OS_Alert_FlushDB(&db_config), 0);
+    ck_assert_int_eq(OS_Alert_PendingDB(), 0);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert"), 2);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert "
+                                "WHERE src_ip = '10.0.0.66'"), 0);
+
+    /* The connection opened again is used for the next batches */
+    ck_assert_ptr_ne(db_config.conn, NULL);
+    ck_assert_int_eq(insert_alert(test_alert, &db_config), 1);
+    ck_assert_int_eq(insert_alert(test_alert, &db_config), 1);
+    ck_assert_int_eq(OS_Alert_FlushDB(&db_config), 1);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert"), 4);
+    ck_assert_int_eq(count_rows("SELECT COUNT(*) FROM alert WHERE full_log = "
+                                "'Feb 15 16:08:14 triumph PAM-securetty[741]: Couldn`t open /etc/securetty'"), 4);
+
+    osdb_close(db_config.conn);
+    unlink(DBD_TEST_DB);
+}
+END_TEST
+
+Suite *test_suite(void)
+{
+    Suite *s = suite_create("os_dbd");
+
+    TCase *tc_alert_batch = tcase_create("alert_batch");
+    tcase_add_test(tc_alert_batch, test_alert_batch);
+    tcase_add_test(tc_alert_batch, test_alert_batch_error);
+
+    suite_add_tcase(s, tc_alert_batch);
+
+    return (s);
+}
+
+int main(void)
+{
+    Suite *s = test_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return ((number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
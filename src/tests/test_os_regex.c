@@ -9,6 +9,7 @@
 
 #include <check.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../os_regex/os_regex.h"
 #include "../os_regex/os_regex_internal.h"
@@ -406,6 +407,94 @@ START_TEST(test_regexextraction)
 }
 END_TEST
 
+START_TEST(test_regexextraction_ctx)
+{
+    OSRegex reg;
+    OSPcre2 pcre2;
+    OSMatch match;
+    OSRegexCtx ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    /* Substrings land in the caller context, not in the pattern */
+    ck_assert_int_eq(OSRegex_Compile("^sshd[\\d+]: Accepted \\S+ for (\\S+) from (\\S+) port ", &reg, OS_RETURN_SUBSTRING), 1);
+    ck_assert_ptr_ne((void *)OSRegex_Execute_ex("sshd[21405]: Accepted password for root from 192.1.1.1 port 6023", &reg, &ctx), NULL);
+    ck_assert_str_eq(ctx.sub_strings[0], "root");
+    ck_assert_str_eq(ctx.sub_strings[1], "192.1.1.1");
+    ck_assert_ptr_eq(ctx.sub_strings[2], NULL);
+    ck_assert_ptr_eq(reg.sub_strings[0], NULL);
+    OSRegex_FreePattern(&reg);
+    OSRegex_FreeCtx(&ctx);
+
+    ck_assert_int_eq(OSPcre2_Compile("for (\\S+) from (\\S+) port", &pcre2, 0), 1);
+    ck_assert_ptr_ne((void *)OSPcre2_Execute_ex("Accepted password for admin from 10.0.0.1 port 22", &pcre2, &ctx), NULL);
+    ck_assert_str_eq(ctx.sub_strings[0], "admin");
+    ck_assert_str_eq(ctx.sub_strings[1], "10.0.0.1");
+    ck_assert_ptr_eq(ctx.sub_strings[2], NULL);
+    ck_assert_ptr_eq(pcre2.sub_strings[0], NULL);
+    OSPcre2_FreePattern(&pcre2);
+    OSRegex_FreeCtx(&ctx);
+
+    ck_assert_int_eq(OSMatch_Compile("accepted|failed", &match, 0), 1);
+    ck_assert_int_eq(OSMatch_Execute_ex("sshd: Accepted password", 23, &match, &ctx), 1);
+    ck_assert_int_eq(OSMatch_Execute_ex("sshd: session opened", 20, &match, &ctx), 0);
+    OSMatch_FreePattern(&match);
+    OSRegex_FreeCtx(&ctx);
+}
+END_TEST
+
+START_TEST(test_regexextraction_spans)
+{
+    OSRegex reg;
+    OSPcre2 pcre2;
+    OSRegexCtx ctx;
+    const char *str = "sshd[21405]: Accepted password for root from 192.1.1.1 port 6023";
+    const char *end;
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    /* Positions in the subject, nothing is copied */
+    ck_assert_int_eq(OSRegex_Compile("^sshd[\\d+]: Accepted \\S+ for (\\S+) from (\\S+) port ", &reg, OS_RETURN_SUBSTRING), 1);
+    end = OSRegex_Execute_spans(str, &reg, &ctx);
+    ck_assert_ptr_eq(end, str + 60);
+    ck_assert_int_eq(ctx.nspans, 2);
+    ck_assert_int_eq(ctx.spans[0].offset, 35);
+    ck_assert_int_eq(ctx.spans[0].length, 4);
+    ck_assert_int_eq(ctx.spans[1].offset, 45);
+    ck_assert_int_eq(ctx.spans[1].length, 9);
+    ck_assert_ptr_eq(ctx.sub_strings, NULL);
+    ck_assert_ptr_eq(reg.sub_strings[0], NULL);
+
+    /* Failed matches leave no spans */
+    ck_assert_ptr_eq(OSRegex_Execute_spans("sshd[1]: Failed password", &reg, &ctx), NULL);
+    ck_assert_int_eq(ctx.nspans, 0);
+    OSRegex_FreePattern(&reg);
+
+    /* Literal patterns keep their fast path */
+    ck_assert_int_eq(OSRegex_Compile("^sshd[", &reg, OS_RETURN_SUBSTRING), 1);
+    ck_assert_ptr_eq(OSRegex_Execute_spans(str, &reg, &ctx), str + 5);
+    ck_assert_int_eq(ctx.nspans, 0);
+    OSRegex_FreePattern(&reg);
+
+    /* Groups that did not take part in the match are skipped */
+    ck_assert_int_eq(OSPcre2_Compile("for (\\S+) (?:at (\\S+) )?from (\\S+)", &pcre2, 0), 1);
+    ck_assert_ptr_ne((void *)OSPcre2_Execute_spans(str, &pcre2, &ctx), NULL);
+    ck_assert_int_eq(ctx.nspans, 2);
+    ck_assert_int_eq(ctx.spans[0].offset, 35);
+    ck_assert_int_eq(ctx.spans[0].length, 4);
+    ck_assert_int_eq(ctx.spans[1].offset, 45);
+    ck_assert_int_eq(ctx.spans[1].length, 9);
+
+    /* The copying API still works on the same context */
+    ck_assert_ptr_ne((void *)OSPcre2_Execute_ex(str, &pcre2, &ctx), NULL);
+    ck_assert_str_eq(ctx.sub_strings[0], "root");
+    ck_assert_str_eq(ctx.sub_strings[1], "192.1.1.1");
+    ck_assert_ptr_eq(ctx.sub_strings[2], NULL);
+    OSPcre2_FreePattern(&pcre2);
+    OSRegex_FreeCtx(&ctx);
+}
+END_TEST
+
 START_TEST(test_hostnamemap)
 {
     unsigned char test = 0;
@@ -863,6 +952,8 @@ Suite *test_suite(void)
     tcase_add_test(tc_strbreak, test_strbreak);
 
     tcase_add_test(tc_regexextraction, test_regexextraction);
+    tcase_add_test(tc_regexextraction, test_regexextraction_ctx);
+    tcase_add_test(tc_regexextraction, test_regexextraction_spans);
 
     tcase_add_test(tc_hostnamemap, test_hostnamemap);
 
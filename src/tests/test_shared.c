@@ -9,8 +9,12 @@
 
 #include <check.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 
 #include "../headers/custom_output_search.h"
+#include "../headers/shared.h"
+
+#define AB_TEST_ALERTS  100
 
 Suite *test_suite(void);
 
@@ -42,6 +46,354 @@ START_TEST(test_searchAndReplace)
 }
 END_TEST
 
+START_TEST(test_syscheck_index)
+{
+    char dir[] = "/tmp/test_shared.XXXXXX";
+    char log_path[256];
+    char idx_path[256];
+    char name[64];
+    sk_idx *idx;
+    sk_idx_entry *entry;
+    struct stat st, st2;
+    FILE *fp;
+    int i;
+
+    ck_assert_ptr_ne(mkdtemp(dir), NULL);
+    snprintf(log_path, sizeof(log_path), "%s/(agent) 10.0.0.1->syscheck", dir);
+
+    sk_idx_path(log_path, idx_path, sizeof(idx_path));
+    ck_assert_str_eq(strrchr(idx_path, '/'), "/.(agent) 10.0.0.1->syscheck.idx");
+
+    /* Old text database, with a commented (changed) entry */
+    fp = fopen(log_path, "w");
+    ck_assert_ptr_ne(fp, NULL);
+    fprintf(fp, "#++10:33188:0:0:aaa:bbb !1400000000 /etc/passwd\n");
+    fprintf(fp, "+++20:33188:0:0:ccc:ddd !1400000001 /etc/hosts\n");
+    fprintf(fp, "!++11:33188:0:0:eee:fff !1400000002 /etc/passwd\n");
+    fprintf(fp, "+++30:33188:0:0:ggg:hhh /etc/old format\n");
+    fclose(fp);
+
+    ck_assert_int_eq(sk_idx_import(log_path), 0);
+
+    idx = sk_idx_open(log_path);
+    ck_assert_ptr_ne(idx, NULL);
+
+    entry = sk_idx_get(idx, "/etc/passwd");
+    ck_assert_ptr_ne(entry, NULL);
+    ck_assert_str_eq(sk_idx_sum(entry), "11:33188:0:0:eee:fff");
+    ck_assert_str_eq(entry->marks, "!++");
+    ck_assert_int_eq((int)entry->time, 1400000002);
+    ck_assert_int_eq((int)entry->log_pos, 95);
+
+    entry = sk_idx_get(idx, "/etc/old format");
+    ck_assert_ptr_ne(entry, NULL);
+    ck_assert_str_eq(sk_idx_sum(entry), "30:33188:0:0:ggg:hhh");
+
+    ck_assert_ptr_eq(sk_idx_get(idx, "/etc/shadow"), NULL);
+
+    /* Updates in place, new entries and a checksum that does not fit */
+    ck_assert_int_eq(sk_idx_put(idx, "/etc/hosts", "!++", "21:33188:0:0:iii:jjj", 1400000003, 500), 0);
+    for (i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "/usr/bin/file%d", i);
+        ck_assert_int_eq(sk_idx_put(idx, name, "+++", "1:2:3:4:5:6", i, (uint64_t)i), 0);
+    }
+    ck_assert_int_eq(sk_idx_put(idx, "/usr/bin/file7", "!!+",
+                                "123456789012345678901234567890:33188:0:0:"
+                                "0123456789abcdef0123456789abcdef:"
+                                "0123456789abcdef0123456789abcdef01234567", 7, 7), 0);
+    sk_idx_sync(idx, 1234);
+    sk_idx_close(idx);
+
+    /* The index keeps the changes while the log size matches */
+    fp = fopen(log_path, "a");
+    ck_assert_ptr_ne(fp, NULL);
+    while (ftell(fp) < 1234) {
+        fputc('#', fp);
+    }
+    fclose(fp);
+
+    idx = sk_idx_open(log_path);
+    ck_assert_ptr_ne(idx, NULL);
+
+    entry = sk_idx_get(idx, "/etc/hosts");
+    ck_assert_ptr_ne(entry, NULL);
+    ck_assert_str_eq(sk_idx_sum(entry), "21:33188:0:0:iii:jjj");
+    ck_assert_int_eq((int)entry->log_pos, 500);
+
+    entry = sk_idx_get(idx, "/usr/bin/file7");
+    ck_assert_ptr_ne(entry, NULL);
+    ck_assert_str_eq(entry->marks, "!!+");
+    ck_assert_int_eq((int)strlen(sk_idx_sum(entry)), 114);
+
+    entry = sk_idx_get(idx, "/usr/bin/file4999");
+    ck_assert_ptr_ne(entry, NULL);
+    ck_assert_int_eq((int)entry->time, 4999);
+
+    /* A different log size rebuilds it from the log */
+    ck_assert_int_eq(sk_idx_check(idx, 1234), 0);
+    ck_assert_ptr_ne(sk_idx_get(idx, "/usr/bin/file1"), NULL);
+    ck_assert_int_eq(sk_idx_check(idx, 1), 0);
+    ck_assert_ptr_eq(sk_idx_get(idx, "/usr/bin/file1"), NULL);
+    ck_assert_ptr_ne(sk_idx_get(idx, "/etc/passwd"), NULL);
+
+    /* Marks are set in the index mapped, even if the log grew */
+    ck_assert_int_eq(stat(idx_path, &st), 0);
+    fp = fopen(log_path, "a");
+    ck_assert_ptr_ne(fp, NULL);
+    fprintf(fp, "+++40:33188:0:0:kkk:lll !1400000004 /etc/group\n");
+    fclose(fp);
+
+    ck_assert_int_eq(sk_idx_mark(log_path, "/etc/passwd", "!!?"), 1);
+    ck_assert_int_eq(sk_idx_mark(log_path, "/etc/group", "!!?"), 0);
+    ck_assert_str_eq(sk_idx_get(idx, "/etc/passwd")->marks, "!!?");
+    ck_assert_int_eq(stat(idx_path, &st2), 0);
+    ck_assert_int_eq((int)st.st_ino, (int)st2.st_ino);
+    sk_idx_close(idx);
+
+    unlink(log_path);
+    unlink(idx_path);
+    rmdir(dir);
+}
+END_TEST
+
+START_TEST(test_mq_batch)
+{
+    int fds[2];
+    char buffer[MQ_BATCH_MAXSIZE + 1];
+    char message[64];
+    mq_record record;
+    size_t pos = 0;
+    ssize_t size;
+    int i, count;
+
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+    /* Nothing is sent until the batch is flushed */
+    SetMQBatch(4096);
+    ck_assert_int_eq(SendMSG(fds[0], "first", "/var/log/messages", LOCALFILE_MQ), 0);
+    ck_assert_int_eq(SendMSG(fds[0], "1:/var/log/secure:second: with colon", "(agent) 10.0.0.1", SECURE_MQ), 0);
+    ck_assert_int_eq(SendMSG(fds[0], "1:keepalive", "(agent) 10.0.0.1", SECURE_MQ), 0);
+    ck_assert_int_eq(recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT), -1);
+
+    ck_assert_int_eq(FlushMSG(fds[0]), 0);
+    size = recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+    ck_assert_int_gt(size, 0);
+    ck_assert_int_eq(IsMQBatch(buffer, (size_t)size), 1);
+
+    ck_assert_int_eq(ReadMQBatch(buffer, (size_t)size, &pos, &record), 1);
+    ck_assert_int_eq(record.loc, LOCALFILE_MQ);
+    ck_assert_str_eq(record.location, "/var/log/messages");
+    ck_assert_int_eq((int)record.location_size, 17);
+    ck_assert_str_eq(record.message, "first");
+    ck_assert_int_eq((int)record.message_size, 5);
+
+    ck_assert_int_eq(ReadMQBatch(buffer, (size_t)size, &pos, &record), 1);
+    ck_assert_int_eq(record.loc, '1');
+    ck_assert_str_eq(record.location, "(agent) 10.0.0.1->/var/log/secure");
+    ck_assert_str_eq(record.message, "second: with colon");
+
+    ck_assert_int_eq(ReadMQBatch(buffer, (size_t)size, &pos, &record), 0);
+
+    /* Truncated batch */
+    pos = 0;
+    ck_assert_int_eq(ReadMQBatch(buffer, (size_t)size - 3, &pos, &record), 1);
+    ck_assert_int_eq(ReadMQBatch(buffer, (size_t)size - 3, &pos, &record), -1);
+
+    /* Full batches are sent on their own */
+    SetMQBatch(256);
+    for (i = 0; i < 100; i++) {
+        snprintf(message, sizeof(message), "message %d", i);
+        ck_assert_int_eq(SendMSG(fds[0], message, "location", LOCALFILE_MQ), 0);
+    }
+    ck_assert_int_eq(FlushMSG(fds[0]), 0);
+
+    for (count = 0; (size = recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT)) > 0; ) {
+        ck_assert_int_le((int)size, 256);
+        for (pos = 0; ReadMQBatch(buffer, (size_t)size, &pos, &record) > 0; count++) {
+            snprintf(message, sizeof(message), "message %d", count);
+            ck_assert_str_eq(record.message, message);
+        }
+    }
+    ck_assert_int_eq(count, 100);
+
+    /* Text messages without a batch */
+    SetMQBatch(0);
+    ck_assert_int_eq(SendMSG(fds[0], "text", "location", LOCALFILE_MQ), 0);
+    size = recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+    ck_assert_int_eq(IsMQBatch(buffer, (size_t)size), 0);
+    ck_assert_str_eq(buffer, "1:location:text");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+START_TEST(test_alert_data)
+{
+    const char *text =
+        "** Alert 1792209955.0: - syslog,errors,\n"
+        "2026 Oct 17 04:05:55 triumph->/var/log/messages\n"
+        "Rule: 1001 (level 2) -> 'File missing. Root access unrestricted.'\n"
+        "Src IP: 10.0.0.2\n"
+        "Feb 15 16:08:14 triumph PAM-securetty[741]: Couldn't open /etc/securetty\n"
+        "\n"
+        "** Alert 1792209955.228: mail  - syslog, su,\n"
+        "2026 Oct 17 04:05:55 bogus.com->/var/log/messages\n"
+        "Rule: 5305 (level 4) -> 'First time (su) is executed by user.'\n"
+        "User: root\n"
+        "Sep 11 01:40:59 bogus.com su: ericx to root on /dev/ttyu0\n"
+        "\n";
+    alert_data *al_data;
+    FILE *fp;
+
+    al_data = ParseAlertData(0, text);
+    ck_assert_ptr_ne(al_data, NULL);
+    ck_assert_int_eq(al_data->rule, 1001);
+    ck_assert_int_eq(al_data->level, 2);
+    ck_assert_str_eq(al_data->alertid, "1792209955.0");
+    ck_assert_str_eq(al_data->location, "triumph->/var/log/messages");
+    ck_assert_str_eq(al_data->srcip, "10.0.0.2");
+    ck_assert_ptr_ne(al_data->log, NULL);
+    ck_assert_ptr_ne(al_data->log[0], NULL);
+    ck_assert_ptr_eq(al_data->log[1], NULL);
+    FreeAlertData(al_data);
+
+    /* Only the alerts to be e-mailed */
+    al_data = ParseAlertData(CRALERT_MAIL_SET, text);
+    ck_assert_ptr_ne(al_data, NULL);
+    ck_assert_int_eq(al_data->rule, 5305);
+    ck_assert_str_eq(al_data->user, "root");
+    FreeAlertData(al_data);
+
+    /* The same as read from the log */
+    fp = fmemopen((void *)text, strlen(text), "r");
+    ck_assert_ptr_ne(fp, NULL);
+    al_data = GetAlertData(CRALERT_MAIL_SET, fp);
+    ck_assert_ptr_ne(al_data, NULL);
+    ck_assert_int_eq(al_data->rule, 5305);
+    ck_assert_int_eq((int)ftell(fp), (int)strlen(text));
+    FreeAlertData(al_data);
+    ck_assert_ptr_eq(GetAlertData(0, fp), NULL);
+    fclose(fp);
+
+    /* Incomplete */
+    ck_assert_ptr_eq(ParseAlertData(0, "** Alert 1792209955.0: - syslog,errors,\n"), NULL);
+}
+END_TEST
+
+/* Write an alert to the log and publish it, as analysisd does */
+static void publish_alert(FILE *fp, const struct tm *p, int n)
+{
+    char text[OS_SIZE_1024];
+    alert_data *al_data;
+    alert_bus_pos pos;
+
+    snprintf(text, sizeof(text),
+             "** Alert 1792209955.%d: - syslog,errors,\n"
+             "2026 Oct 17 04:05:55 triumph->/var/log/messages\n"
+             "Rule: 1001 (level 2) -> 'File missing. Root access unrestricted.'\n"
+             "Src IP: 10.0.0.2\n"
+             "Feb 15 16:08:14 triumph PAM-securetty[741]: Couldn't open /etc/securetty %d\n"
+             "\n", n, n);
+
+    pos.year = p->tm_year + 1900;
+    pos.day = p->tm_mday;
+    strftime(pos.mon, sizeof(pos.mon), "%b", p);
+    pos.offset = ftell(fp);
+    fputs(text, fp);
+    fflush(fp);
+    pos.end = ftell(fp);
+
+    al_data = ParseAlertData(0, text);
+    ck_assert_ptr_ne(al_data, NULL);
+    AlertBus_Publish(al_data, 0, &pos);
+    FreeAlertData(al_data);
+}
+
+/* Read the next alert, which must be the n-th one */
+static void read_alert(file_queue *fileq, const struct tm *p, int n)
+{
+    char alertid[64];
+    alert_data *al_data;
+
+    al_data = Read_FileMonSeconds(fileq, p, 5);
+    ck_assert_ptr_ne(al_data, NULL);
+    snprintf(alertid, sizeof(alertid), "1792209955.%d", n);
+    ck_assert_str_eq(al_data->alertid, alertid);
+    FreeAlertData(al_data);
+}
+
+START_TEST(test_alert_bus)
+{
+    char log_dir[OS_FLSIZE + 1];
+    char log_path[OS_FLSIZE + 1];
+    char mon[4];
+    file_queue fileq;
+    struct tm *p;
+    time_t now;
+    FILE *fp;
+    int i;
+
+    now = time(NULL);
+    p = localtime(&now);
+    strftime(mon, sizeof(mon), "%b", p);
+
+    mkdir(DEFAULTDIR, 0700);
+    mkdir(DEFAULTDIR "/queue", 0700);
+    mkdir(DEFAULTDIR "/queue/alerts", 0700);
+    mkdir(DEFAULTDIR "/logs", 0700);
+    mkdir(ALERTS_PATH, 0700);
+    ck_assert_int_lt(snprintf(log_dir, sizeof(log_dir), "%s/%d",
+                              ALERTS_PATH, p->tm_year + 1900), (int)sizeof(log_dir));
+    mkdir(log_dir, 0700);
+    ck_assert_int_lt(snprintf(log_dir, sizeof(log_dir), "%s/%d/%s",
+                              ALERTS_PATH, p->tm_year + 1900, mon), (int)sizeof(log_dir));
+    mkdir(log_dir, 0700);
+    ck_assert_int_lt(snprintf(log_path, sizeof(log_path), "%s/ossec-alerts-%02d.log",
+                              log_dir, p->tm_mday), (int)sizeof(log_path));
+
+    fp = fopen(log_path, "w");
+    ck_assert_ptr_ne(fp, NULL);
+
+    /* A ring of a few alerts */
+    ck_assert_int_eq(AlertBus_Create(4096), 0);
+
+    memset(&fileq, 0, sizeof(fileq));
+    ck_assert_int_eq(Init_FileQueue(&fileq, p, 0), 0);
+    ck_assert_ptr_ne(fileq.bus, NULL);
+
+    /* The alerts overwritten before they were read come from the log */
+    for (i = 0; i < AB_TEST_ALERTS / 2; i++) {
+        publish_alert(fp, p, i);
+    }
+    for (i = 0; i < 5; i++) {
+        read_alert(&fileq, p, i);
+    }
+    for (i = AB_TEST_ALERTS / 2; i < AB_TEST_ALERTS; i++) {
+        publish_alert(fp, p, i);
+    }
+    for (i = 5; i < AB_TEST_ALERTS; i++) {
+        read_alert(&fileq, p, i);
+    }
+    ck_assert_ptr_eq(Read_FileMonSeconds(&fileq, p, 1), NULL);
+
+    /* analysisd restarted: the new bus is mapped */
+    ck_assert_int_eq(AlertBus_Create(4096), 0);
+    for (i = AB_TEST_ALERTS; i < AB_TEST_ALERTS + 3; i++) {
+        publish_alert(fp, p, i);
+    }
+    for (i = AB_TEST_ALERTS; i < AB_TEST_ALERTS + 3; i++) {
+        read_alert(&fileq, p, i);
+    }
+    ck_assert_ptr_ne(fileq.bus, NULL);
+    ck_assert_ptr_eq(Read_FileMonSeconds(&fileq, p, 1), NULL);
+
+    fclose(fp);
+    unlink(log_path);
+    AlertBus_Remove();
+}
+END_TEST
+
 Suite *test_suite(void)
 {
     Suite *s = suite_create("shared");
@@ -49,7 +401,24 @@ Suite *test_suite(void)
     TCase *tc_searchAndReplace = tcase_create("searchAndReplace");
     tcase_add_test(tc_searchAndReplace, test_searchAndReplace);
 
+    TCase *tc_syscheck_index = tcase_create("syscheck_index");
+    tcase_add_test(tc_syscheck_index, test_syscheck_index);
+
+    TCase *tc_mq_batch = tcase_create("mq_batch");
+    tcase_add_test(tc_mq_batch, test_mq_batch);
+
+    TCase *tc_alert_data = tcase_create("alert_data");
+    tcase_add_test(tc_alert_data, test_alert_data);
+
+    TCase *tc_alert_bus = tcase_create("alert_bus");
+    tcase_add_test(tc_alert_bus, test_alert_bus);
+    tcase_set_timeout(tc_alert_bus, 30);
+
     suite_add_tcase(s, tc_searchAndReplace);
+    suite_add_tcase(s, tc_syscheck_index);
+    suite_add_tcase(s, tc_mq_batch);
+    suite_add_tcase(s, tc_alert_data);
+    suite_add_tcase(s, tc_alert_bus);
 
     return (s);
 }
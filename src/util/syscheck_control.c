@@ -231,6 +231,15 @@ int main(int argc, char **argv)
                 snprintf(full_path, OS_MAXSTR, "%s/%s", SYSCHECK_DIR,
                          entry->d_name);
 
+                /* Indexes are never truncated, as analysisd may have them mapped */
+                if (entry->d_name[0] == '.' && strlen(entry->d_name) > strlen(SK_IDX_EXT) &&
+                        strcmp(entry->d_name + strlen(entry->d_name) - strlen(SK_IDX_EXT), SK_IDX_EXT) == 0) {
+                    if ((unlink(full_path)) != 0) {
+                        ErrorExit("%s: ERROR: Cannot delete %s: %s", ARGV0, full_path, strerror(errno));
+                    }
+                    continue;
+                }
+
                 fp = fopen(full_path, "w");
                 if (fp) {
                     fclose(fp);
@@ -286,6 +295,12 @@ int main(int argc, char **argv)
                 ErrorExit("%s: ERROR: Cannot delete %s: %s", ARGV0, final_dir, strerror(errno));
             }
 
+            /* Delete the index */
+            snprintf(final_dir, 1020, "/%s/.syscheck%s", SYSCHECK_DIR, SK_IDX_EXT);
+            if ((unlink(final_dir)) != 0 && errno != ENOENT) {
+                ErrorExit("%s: ERROR: Cannot delete %s: %s", ARGV0, final_dir, strerror(errno));
+            }
+
             if (json_output) {
                 cJSON_AddNumberToObject(json_root, "error", 0);
                 cJSON_AddStringToObject(json_root, "response", "Integrity check database updated");
@@ -15,6 +15,7 @@
 
 /* Prototypes */
 static void helpmsg(void) __attribute__((noreturn));
+static void import_db(const char *db_name);
 
 
 static void helpmsg()
@@ -25,10 +26,29 @@ static void helpmsg()
     printf("\t-l       List available agents.\n");
     printf("\t-a       Update (clear) syscheck database for all agents.\n");
     printf("\t-u <id>  Update (clear) syscheck database for a specific agent.\n");
-    printf("\t-u local Update (clear) syscheck database locally.\n\n");
+    printf("\t-u local Update (clear) syscheck database locally.\n");
+    printf("\t-i <id>  Rebuild the index of the syscheck database of an agent\n");
+    printf("\t         (or of all agents with 'all', or locally with 'local').\n\n");
     exit(1);
 }
 
+/* Build the index of a syscheck database */
+static void import_db(const char *db_name)
+{
+    char full_path[OS_MAXSTR + 1];
+    struct stat statbuf;
+
+    snprintf(full_path, OS_MAXSTR, "%s/%s", SYSCHECK_DIR, db_name);
+    if (stat(full_path, &statbuf) < 0 || !S_ISREG(statbuf.st_mode)) {
+        return;
+    }
+
+    if (sk_idx_import(full_path) < 0) {
+        ErrorExit("%s: ERROR: Cannot import %s", ARGV0, full_path);
+    }
+    printf("** Imported '%s'.\n", db_name);
+}
+
 int main(int argc, char **argv)
 {
     const char *dir = DEFAULTDIR;
@@ -84,6 +104,56 @@ int main(int argc, char **argv)
             printf("\n** Option -u requires an extra argument\n");
             helpmsg();
         }
+    } else if (strcmp(argv[1], "-i") == 0) {
+        if (argc != 3) {
+            printf("\n** Option -i requires an extra argument\n");
+            helpmsg();
+        }
+
+        printf("\n");
+        if (strcmp(argv[2], "all") == 0) {
+            DIR *sys_dir;
+            struct dirent *entry;
+
+            sys_dir = opendir(SYSCHECK_DIR);
+            if (!sys_dir) {
+                ErrorExit("%s: Unable to open: '%s'", ARGV0, SYSCHECK_DIR);
+            }
+
+            /* Hidden files are the indexes and the cpt files */
+            while ((entry = readdir(sys_dir)) != NULL) {
+                if (entry->d_name[0] != '.') {
+                    import_db(entry->d_name);
+                }
+            }
+
+            closedir(sys_dir);
+        } else if (strcmp(argv[2], "local") == 0) {
+            import_db("syscheck");
+        } else {
+            int i;
+            char db_name[OS_FLSIZE + 1];
+            keystore keys;
+
+            OS_ReadKeys(&keys);
+
+            i = OS_IsAllowedID(&keys, argv[2]);
+            if (i < 0) {
+                printf("\n** Invalid agent id '%s'.\n", argv[2]);
+                helpmsg();
+            }
+
+            snprintf(db_name, OS_FLSIZE, "(%s) %s->syscheck",
+                     keys.keyentries[i]->name, keys.keyentries[i]->ip->ip);
+            import_db(db_name);
+
+            snprintf(db_name, OS_FLSIZE, "(%s) %s->syscheck-registry",
+                     keys.keyentries[i]->name, keys.keyentries[i]->ip->ip);
+            import_db(db_name);
+        }
+
+        printf("\n** Integrity check database index rebuilt.\n\n");
+        exit(0);
     } else if (strcmp(argv[1], "-a") == 0) {
         DIR *sys_dir;
         struct dirent *entry;
@@ -105,6 +175,15 @@ int main(int argc, char **argv)
 
             snprintf(full_path, OS_MAXSTR, "%s/%s", SYSCHECK_DIR, entry->d_name);
 
+            /* Indexes are never truncated, as analysisd may have them mapped */
+            if (entry->d_name[0] == '.' && strlen(entry->d_name) > strlen(SK_IDX_EXT) &&
+                    strcmp(entry->d_name + strlen(entry->d_name) - strlen(SK_IDX_EXT), SK_IDX_EXT) == 0) {
+                if ((unlink(full_path)) != 0) {
+                    ErrorExit("%s: ERROR: Cannot delete %s: %s", ARGV0, full_path, strerror(errno));
+                }
+                continue;
+            }
+
             fp = fopen(full_path, "w");
             if (fp) {
                 fclose(fp);
@@ -152,6 +231,12 @@ int main(int argc, char **argv)
             ErrorExit("%s: ERROR: Cannot open %s: %s", ARGV0, final_dir, strerror(errno));
         }
         /* unlink(final_dir); */
+
+        /* Delete the index */
+        snprintf(final_dir, 1020, "/%s/.syscheck%s", SYSCHECK_DIR, SK_IDX_EXT);
+        if ((unlink(final_dir)) != 0 && errno != ENOENT) {
+            ErrorExit("%s: ERROR: Cannot delete %s: %s", ARGV0, final_dir, strerror(errno));
+        }
     }
 
     /* External agents */